@@ -0,0 +1,508 @@
+// Renderer scaling benchmark. Generates scenes of 1k/10k/100k mixed primitives (untextured, and
+// textured with every projection mode), flies the camera along a fixed path on the headless
+// context and prints one JSON report so runs can be diffed between commits. It also saves and
+// reloads a large scene to time the .cgscene format, and races the spatial index against brute
+// force while thousands of objects move every frame.
+//
+//   CG_expri4_bench [--size WxH] [--frames N] [--warmup N] [--counts 1000,10000] [--scene-file N]
+//                   [--spatial N] [--out file.json]
+//
+// Run it from the repository root so the textures under resources/ resolve.
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "headless.h"
+#include "spatial_index.h"
+
+namespace {
+    struct BenchOptions {
+        int width = 1280;
+        int height = 720;
+        int frames = 240;
+        int warmup = 10;
+        std::vector<int> counts = { 1000, 10000, 100000 };
+        int sceneFileCount = 1000000; // 0 skips the save/load case
+        int spatialCount = 20000;     // 0 skips the spatial index case
+        std::string outputPath;
+    };
+
+    struct SceneFileResult {
+        int instances = 0;
+        double fileMb = 0.0;
+        double saveMs = 0.0;
+        double loadMs = 0.0;     // mean of kLoadRuns
+        double loadBestMs = 0.0;
+    };
+
+    constexpr int kLoadRuns = 3;
+
+    // per frame: every object moves, then the same queries run through the index and brute force
+    struct SpatialResult {
+        int objects = 0;
+        int frames = 0;
+        double updateMs = 0.0;      // index maintenance, per frame
+        double indexQueryMs = 0.0;  // per frame
+        double bruteQueryMs = 0.0;
+        double inPlaceShare = 0.0;  // updates that did not relocate
+        size_t nodes = 0;
+        int mismatches = 0;         // queries where both sides disagreed
+    };
+
+    constexpr int kSpatialFrames = 120;
+    constexpr int kRayQueries = 64;
+    constexpr int kBoxQueries = 32;
+    constexpr int kNearestQueries = 64;
+
+    struct CaseResult {
+        std::string name;
+        int primitives = 0;
+        bool textured = false;
+        double buildMs = 0.0;
+        double meanMs = 0.0;
+        double p95Ms = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+        double gpuMeanMs = 0.0;
+        double submitMeanMs = 0.0;
+        double drawCalls = 0.0;    // per frame
+        double stateChanges = 0.0; // per frame
+        int heapAllocations = 0;   // most operator new calls in one draw() after warmup, 0 when steady
+        int glErrors = 0;          // frames, warmup included, that left a GL error behind
+    };
+
+    const char* const kTextures[] = {
+        "resources/texture1.png",
+        "resources/texture2.jpg",
+        "resources/texture4.jpg",
+        "resources/texture_brick.jpg",
+    };
+
+    bool parseOptions(int argc, char** argv, BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            const bool hasValue = i + 1 < argc;
+            if (std::strcmp(argv[i], "--size") == 0 && hasValue) {
+                if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 ||
+                    options.width <= 0 || options.height <= 0) {
+                    std::cerr << "--size expects WxH" << std::endl;
+                    return false;
+                }
+            }
+            else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+                options.frames = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) {
+                options.warmup = std::max(0, std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--counts") == 0 && hasValue) {
+                options.counts.clear();
+                std::stringstream list(argv[++i]);
+                std::string item;
+                while (std::getline(list, item, ',')) {
+                    const int count = std::atoi(item.c_str());
+                    if (count > 0) {
+                        options.counts.push_back(count);
+                    }
+                }
+            }
+            else if (std::strcmp(argv[i], "--scene-file") == 0 && hasValue) {
+                options.sceneFileCount = std::max(0, std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--spatial") == 0 && hasValue) {
+                options.spatialCount = std::max(0, std::atoi(argv[++i]));
+            }
+            else if (std::strcmp(argv[i], "--out") == 0 && hasValue) {
+                options.outputPath = argv[++i];
+            }
+            else {
+                std::cerr << "Unknown argument: " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        return !options.counts.empty();
+    }
+
+    // deterministic layout on an XZ grid; the seed keeps scenes identical between runs
+    float buildScene(SceneRenderer& scene, int count, bool textured) {
+        scene.clear();
+        std::mt19937 rng(1234u);
+        std::uniform_real_distribution<float> jitter(-0.4f, 0.4f);
+        const PrimitiveType types[] = { PrimitiveType::Cube, PrimitiveType::Sphere, PrimitiveType::Cylinder,
+            PrimitiveType::Plane };
+        const TextureProjection projections[] = { TextureProjection::Planar, TextureProjection::Triplanar,
+            TextureProjection::Spherical, TextureProjection::Cylindrical, TextureProjection::Cube };
+
+        const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+        const float spacing = 2.0f;
+        const float half = static_cast<float>(side - 1) * spacing * 0.5f;
+        for (int i = 0; i < count; ++i) {
+            const glm::vec3 position(static_cast<float>(i % side) * spacing - half + jitter(rng),
+                0.5f + jitter(rng), static_cast<float>(i / side) * spacing - half + jitter(rng));
+            scene.addPrimitive(types[i % 4], position);
+            if (textured) {
+                scene.select(i);
+                scene.loadTextureForSelected(kTextures[i % 4]);
+                if (PrimitiveInstance* inst = scene.getSelectedMutable()) {
+                    inst->projection = projections[i % 5];
+                }
+            }
+        }
+        scene.clearSelection();
+        return half;
+    }
+
+    double percentile(std::vector<double> values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(values.size())));
+        return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    CaseResult runCase(HeadlessRenderer& renderer, const BenchOptions& options, int count, bool textured) {
+        CaseResult result;
+        result.primitives = count;
+        result.textured = textured;
+        result.name = std::to_string(count) + (textured ? "_textured" : "_plain");
+
+        SceneRenderer& scene = renderer.getScene();
+        const auto buildStart = std::chrono::steady_clock::now();
+        const float half = buildScene(scene, count, textured);
+        result.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+        const float extent = std::max(half, 4.0f);
+        const float aspect = static_cast<float>(renderer.getWidth()) / static_cast<float>(renderer.getHeight());
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, std::max(100.0f, extent * 4.0f));
+
+        std::vector<double> frameTimes;
+        frameTimes.reserve(static_cast<size_t>(options.frames));
+        const int total = options.warmup + options.frames;
+        for (int frame = 0; frame < total; ++frame) {
+            // one lap over the field, dipping low and climbing back up
+            const float t = static_cast<float>(frame) / static_cast<float>(total);
+            const float angle = glm::two_pi<float>() * t;
+            const glm::vec3 eye(std::cos(angle) * extent * 1.1f, extent * (0.25f + 0.15f * std::sin(angle * 2.0f)) + 2.0f,
+                std::sin(angle) * extent * 1.1f);
+            const glm::vec3 target(std::cos(angle + 0.6f) * extent * 0.3f, 0.0f, std::sin(angle + 0.6f) * extent * 0.3f);
+            const glm::mat4 view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+            const HeadlessRenderer::FrameTiming timing = renderer.renderFrame(view, projection, eye);
+            if (timing.glError != GL_NO_ERROR) {
+                if (result.glErrors == 0) {
+                    std::fprintf(stderr, "%s frame %d: GL error 0x%04x\n", result.name.c_str(), frame, timing.glError);
+                }
+                ++result.glErrors;
+            }
+            if (frame < options.warmup) {
+                continue; // first frames pay for uploads and the shadow map
+            }
+            frameTimes.push_back(timing.frameMs);
+            result.gpuMeanMs += timing.gpuMs;
+            result.submitMeanMs += timing.submitMs;
+            result.drawCalls += scene.getStats().drawCalls;
+            result.stateChanges += scene.getStats().stateChanges;
+            result.heapAllocations = std::max(result.heapAllocations, scene.getStats().heapAllocations);
+        }
+
+        const double frames = static_cast<double>(frameTimes.size());
+        double sum = 0.0;
+        for (double ms : frameTimes) {
+            sum += ms;
+        }
+        result.meanMs = sum / frames;
+        result.p95Ms = percentile(frameTimes, 0.95);
+        result.p99Ms = percentile(frameTimes, 0.99);
+        result.maxMs = *std::max_element(frameTimes.begin(), frameTimes.end());
+        result.gpuMeanMs /= frames;
+        result.submitMeanMs /= frames;
+        result.drawCalls /= frames;
+        result.stateChanges /= frames;
+        return result;
+    }
+
+    // save once, then load the same file a few times; later loads hit the page cache
+    SceneFileResult runSceneFileCase(SceneRenderer& scene, int count) {
+        using Clock = std::chrono::steady_clock;
+        SceneFileResult result;
+        buildScene(scene, count, false);
+        const std::string path = (std::filesystem::temp_directory_path() / "cg_scene_bench.cgscene").string();
+
+        auto start = Clock::now();
+        if (!scene.saveScene(path)) {
+            return result;
+        }
+        result.saveMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::error_code error;
+        result.fileMb = static_cast<double>(std::filesystem::file_size(path, error)) / (1024.0 * 1024.0);
+
+        result.loadBestMs = 1.0e30;
+        for (int run = 0; run < kLoadRuns; ++run) {
+            scene.clear();
+            start = Clock::now();
+            if (!scene.loadScene(path)) {
+                break;
+            }
+            const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            result.loadMs += ms / kLoadRuns;
+            result.loadBestMs = std::min(result.loadBestMs, ms);
+        }
+        result.instances = static_cast<int>(scene.instanceCount());
+        std::filesystem::remove(path, error);
+        scene.clear();
+        return result;
+    }
+
+    SpatialResult runSpatialCase(int count) {
+        using Clock = std::chrono::steady_clock;
+        const auto elapsedMs = [](Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        };
+        SpatialResult result;
+        result.objects = count;
+        result.frames = kSpatialFrames;
+
+        // a field roughly as dense as the rendering cases, objects drifting slowly with a few teleports
+        std::mt19937 rng(99u);
+        const float extent = std::sqrt(static_cast<float>(count)) * 2.0f;
+        std::uniform_real_distribution<float> across(-extent, extent);
+        std::uniform_real_distribution<float> height(0.0f, 10.0f);
+        std::uniform_real_distribution<float> size(0.3f, 1.5f);
+        std::uniform_real_distribution<float> drift(-0.05f, 0.05f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::vector<glm::vec3> centers(static_cast<size_t>(count));
+        std::vector<glm::vec3> velocities(static_cast<size_t>(count));
+        std::vector<float> radii(static_cast<size_t>(count));
+        std::vector<int> handles(static_cast<size_t>(count));
+        SpatialIndex index;
+        for (int i = 0; i < count; ++i) {
+            centers[static_cast<size_t>(i)] = glm::vec3(across(rng), height(rng), across(rng));
+            velocities[static_cast<size_t>(i)] = glm::vec3(drift(rng), drift(rng) * 0.2f, drift(rng));
+            radii[static_cast<size_t>(i)] = size(rng);
+            handles[static_cast<size_t>(i)] = index.insert(i, centers[static_cast<size_t>(i)], radii[static_cast<size_t>(i)]);
+        }
+        const SpatialIndex::Stats before = index.getStats();
+
+        std::vector<int> found;
+        std::vector<int> expected;
+        std::vector<SpatialIndex::RayHit> rayHits;
+        for (int frame = 0; frame < kSpatialFrames; ++frame) {
+            for (int i = 0; i < count; ++i) {
+                glm::vec3& center = centers[static_cast<size_t>(i)];
+                center += velocities[static_cast<size_t>(i)];
+                if (i % 100 == frame % 100) {
+                    center = glm::vec3(across(rng), height(rng), across(rng));
+                }
+            }
+            auto start = Clock::now();
+            for (int i = 0; i < count; ++i) {
+                index.update(handles[static_cast<size_t>(i)], centers[static_cast<size_t>(i)], radii[static_cast<size_t>(i)]);
+            }
+            result.updateMs += elapsedMs(start);
+
+            // the same query set for both sides
+            const float angle = glm::two_pi<float>() * static_cast<float>(frame) / static_cast<float>(kSpatialFrames);
+            const glm::vec3 eye(std::cos(angle) * extent, 15.0f, std::sin(angle) * extent);
+            const Frustum frustum = Frustum::fromMatrix(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, extent) *
+                glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+            std::vector<glm::vec3> points;
+            std::vector<glm::vec3> directions;
+            for (int q = 0; q < std::max(kRayQueries, std::max(kBoxQueries, kNearestQueries)); ++q) {
+                points.push_back(glm::vec3(across(rng), height(rng), across(rng)));
+                directions.push_back(glm::normalize(glm::vec3(unit(rng), unit(rng) * 0.2f, unit(rng)) + glm::vec3(1.0e-3f)));
+            }
+
+            size_t indexSum = 0;
+            start = Clock::now();
+            index.queryFrustum(frustum, false, found);
+            indexSum += found.size();
+            for (int q = 0; q < kRayQueries; ++q) {
+                index.queryRay(points[static_cast<size_t>(q)], directions[static_cast<size_t>(q)], 50.0f, rayHits);
+                indexSum += rayHits.size();
+            }
+            for (int q = 0; q < kBoxQueries; ++q) {
+                index.queryBox(points[static_cast<size_t>(q)] - glm::vec3(5.0f), points[static_cast<size_t>(q)] + glm::vec3(5.0f), found);
+                indexSum += found.size();
+            }
+            for (int q = 0; q < kNearestQueries; ++q) {
+                indexSum += static_cast<size_t>(index.nearest(points[static_cast<size_t>(q)], 20.0f) + 1);
+            }
+            result.indexQueryMs += elapsedMs(start);
+
+            size_t bruteSum = 0;
+            start = Clock::now();
+            expected.clear();
+            for (int i = 0; i < count; ++i) {
+                if (frustum.touchesSphere(centers[static_cast<size_t>(i)], radii[static_cast<size_t>(i)])) {
+                    expected.push_back(i);
+                }
+            }
+            bruteSum += expected.size();
+            for (int q = 0; q < kRayQueries; ++q) {
+                const glm::vec3& origin = points[static_cast<size_t>(q)];
+                const glm::vec3& direction = directions[static_cast<size_t>(q)];
+                for (int i = 0; i < count; ++i) {
+                    const glm::vec3 offset = origin - centers[static_cast<size_t>(i)];
+                    const float b = glm::dot(offset, direction);
+                    const float c = glm::dot(offset, offset) - radii[static_cast<size_t>(i)] * radii[static_cast<size_t>(i)];
+                    const float discriminant = b * b - c;
+                    if (c <= 0.0f || (discriminant >= 0.0f && b <= 0.0f && -b - std::sqrt(discriminant) <= 50.0f)) {
+                        ++bruteSum;
+                    }
+                }
+            }
+            for (int q = 0; q < kBoxQueries; ++q) {
+                const glm::vec3 boxMin = points[static_cast<size_t>(q)] - glm::vec3(5.0f);
+                const glm::vec3 boxMax = points[static_cast<size_t>(q)] + glm::vec3(5.0f);
+                for (int i = 0; i < count; ++i) {
+                    const glm::vec3 offset = centers[static_cast<size_t>(i)] - glm::clamp(centers[static_cast<size_t>(i)], boxMin, boxMax);
+                    if (glm::dot(offset, offset) <= radii[static_cast<size_t>(i)] * radii[static_cast<size_t>(i)]) {
+                        ++bruteSum;
+                    }
+                }
+            }
+            for (int q = 0; q < kNearestQueries; ++q) {
+                int best = -1;
+                float bestDistance2 = 20.0f * 20.0f;
+                for (int i = 0; i < count; ++i) {
+                    const glm::vec3 offset = centers[static_cast<size_t>(i)] - points[static_cast<size_t>(q)];
+                    const float distance2 = glm::dot(offset, offset);
+                    if (distance2 <= bestDistance2) {
+                        bestDistance2 = distance2;
+                        best = i;
+                    }
+                }
+                bruteSum += static_cast<size_t>(best + 1);
+            }
+            result.bruteQueryMs += elapsedMs(start);
+            if (indexSum != bruteSum) {
+                ++result.mismatches; // nearest ties can legitimately differ, anything else is a bug
+            }
+        }
+
+        const SpatialIndex::Stats after = index.getStats();
+        const double moves = static_cast<double>((after.inPlaceMoves - before.inPlaceMoves) + (after.relocations - before.relocations));
+        result.inPlaceShare = moves > 0.0 ? static_cast<double>(after.inPlaceMoves - before.inPlaceMoves) / moves : 0.0;
+        result.nodes = after.nodes;
+        result.updateMs /= kSpatialFrames;
+        result.indexQueryMs /= kSpatialFrames;
+        result.bruteQueryMs /= kSpatialFrames;
+        return result;
+    }
+
+    std::string jsonEscape(const std::string& text) {
+        std::string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                out += c;
+            }
+        }
+        return out;
+    }
+
+    std::string toJson(const BenchOptions& options, const std::vector<CaseResult>& results,
+        const SceneFileResult& sceneFile, const SpatialResult& spatial) {
+        std::ostringstream out;
+        out.setf(std::ios::fixed);
+        out.precision(4);
+        const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        out << "{\n  \"renderer\": \"" << jsonEscape(renderer ? renderer : "") << "\",\n"
+            << "  \"width\": " << options.width << ",\n  \"height\": " << options.height << ",\n"
+            << "  \"frames\": " << options.frames << ",\n  \"warmup\": " << options.warmup << ",\n"
+            << "  \"cases\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const CaseResult& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"primitives\": " << r.primitives
+                << ", \"textured\": " << (r.textured ? "true" : "false") << ", \"build_ms\": " << r.buildMs
+                << ", \"frame_ms\": {\"mean\": " << r.meanMs << ", \"p95\": " << r.p95Ms << ", \"p99\": " << r.p99Ms
+                << ", \"max\": " << r.maxMs << "}, \"gpu_ms\": " << r.gpuMeanMs << ", \"submit_ms\": " << r.submitMeanMs
+                << ", \"draw_calls\": " << r.drawCalls << ", \"state_changes\": " << r.stateChanges
+                << ", \"heap_allocs\": " << r.heapAllocations << ", \"gl_errors\": " << r.glErrors << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]";
+        if (options.sceneFileCount > 0) {
+            out << ",\n  \"scene_file\": {\"instances\": " << sceneFile.instances << ", \"file_mb\": " << sceneFile.fileMb
+                << ", \"save_ms\": " << sceneFile.saveMs << ", \"load_ms\": " << sceneFile.loadMs
+                << ", \"load_best_ms\": " << sceneFile.loadBestMs << "}";
+        }
+        if (options.spatialCount > 0) {
+            out << ",\n  \"spatial\": {\"objects\": " << spatial.objects << ", \"frames\": " << spatial.frames
+                << ", \"update_ms\": " << spatial.updateMs << ", \"index_query_ms\": " << spatial.indexQueryMs
+                << ", \"brute_query_ms\": " << spatial.bruteQueryMs << ", \"in_place_share\": " << spatial.inPlaceShare
+                << ", \"nodes\": " << spatial.nodes << ", \"mismatches\": " << spatial.mismatches << "}";
+        }
+        out << "\n}\n";
+        return out.str();
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    HeadlessRenderer renderer;
+    if (!renderer.init(options.width, options.height)) {
+        return 1;
+    }
+
+    std::vector<CaseResult> results;
+    int glErrors = 0;
+    for (int count : options.counts) {
+        for (bool textured : { false, true }) {
+            results.push_back(runCase(renderer, options, count, textured));
+            const CaseResult& r = results.back();
+            glErrors += r.glErrors;
+            std::fprintf(stderr, "%-16s mean %.3f ms  p95 %.3f  p99 %.3f  draws %.0f  heap allocs %d\n", r.name.c_str(), r.meanMs,
+                r.p95Ms, r.p99Ms, r.drawCalls, r.heapAllocations);
+        }
+    }
+
+    SceneFileResult sceneFile;
+    if (options.sceneFileCount > 0) {
+        sceneFile = runSceneFileCase(renderer.getScene(), options.sceneFileCount);
+        std::fprintf(stderr, "scene file %d instances (%.1f MB): save %.1f ms  load %.1f ms (best %.1f)\n",
+            sceneFile.instances, sceneFile.fileMb, sceneFile.saveMs, sceneFile.loadMs, sceneFile.loadBestMs);
+    }
+
+    SpatialResult spatial;
+    if (options.spatialCount > 0) {
+        spatial = runSpatialCase(options.spatialCount);
+        std::fprintf(stderr, "spatial %d moving: update %.3f ms  queries %.3f ms (brute force %.3f)  in place %.0f%%  mismatches %d\n",
+            spatial.objects, spatial.updateMs, spatial.indexQueryMs, spatial.bruteQueryMs, spatial.inPlaceShare * 100.0,
+            spatial.mismatches);
+    }
+
+    const std::string json = toJson(options, results, sceneFile, spatial);
+    std::cout << json;
+    if (!options.outputPath.empty()) {
+        std::ofstream file(options.outputPath, std::ios::trunc);
+        if (!file || !(file << json)) {
+            std::cerr << "Failed to write " << options.outputPath << std::endl;
+            return 1;
+        }
+    }
+    // timings from frames that raised GL errors are not worth comparing
+    return glErrors > 0 ? 1 : 0;
+}
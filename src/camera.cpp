@@ -37,6 +37,14 @@ void Camera::AdjustSpeed(float offset) {
     MovementSpeed = std::max(0.1f, MovementSpeed * factor);
 }
 
+void Camera::SetPose(const glm::vec3& position, float yaw, float pitch, float speed) {
+    Position = position;
+    Yaw = yaw;
+    Pitch = pitch;
+    MovementSpeed = std::max(0.1f, speed);
+    updateVectors();
+}
+
 void Camera::ProcessMouseMovement(float xoffset, float yoffset, bool constrainPitch) {
     xoffset *= MouseSensitivity;
     yoffset *= MouseSensitivity;
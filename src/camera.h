@@ -22,6 +22,10 @@ public:
     float GetSpeed() const { return MovementSpeed; }
     glm::vec3 GetPosition() const { return Position; }
     glm::vec3 GetFront() const { return Front; }
+    float GetYaw() const { return Yaw; }
+    float GetPitch() const { return Pitch; }
+    // restores a saved camera, e.g. at the start of an input replay
+    void SetPose(const glm::vec3& position, float yaw, float pitch, float speed);
 
 private:
     void updateVectors();
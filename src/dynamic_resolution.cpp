@@ -0,0 +1,166 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    constexpr float kScaleStep = 0.05f;
+    constexpr int kAdjustInterval = 8; // frames between scale changes, lets the timer catch up
+    constexpr float kGrowThreshold = 0.75f;
+
+    float snapScale(float scale) {
+        scale = std::round(scale / kScaleStep) * kScaleStep;
+        return std::clamp(scale, DynamicResolution::kMinScale, DynamicResolution::kMaxScale);
+    }
+}
+
+DynamicResolution::DynamicResolution() = default;
+
+DynamicResolution::~DynamicResolution() {
+    destroyTarget();
+    if (queries[0]) {
+        glDeleteQueries(4, queries);
+    }
+}
+
+void DynamicResolution::init() {
+    if (initialized) {
+        return;
+    }
+    glGenQueries(4, queries);
+    initialized = true;
+}
+
+bool DynamicResolution::ensureTarget(int width, int height) {
+    if (fbo && width == targetWidth && height == targetHeight) {
+        return true;
+    }
+    destroyTarget();
+
+    // allocated at window size once; lower scales render into the lower-left sub-rectangle
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cerr << "Dynamic resolution framebuffer incomplete" << std::endl;
+        destroyTarget();
+        return false;
+    }
+    targetWidth = width;
+    targetHeight = height;
+    return true;
+}
+
+void DynamicResolution::destroyTarget() {
+    if (fbo) {
+        glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+    }
+    if (colorBuffer) {
+        glDeleteRenderbuffers(1, &colorBuffer);
+        colorBuffer = 0;
+    }
+    if (depthBuffer) {
+        glDeleteRenderbuffers(1, &depthBuffer);
+        depthBuffer = 0;
+    }
+    targetWidth = targetHeight = 0;
+}
+
+void DynamicResolution::beginScene(int width, int height) {
+    windowWidth = width;
+    windowHeight = height;
+    if (!settings.enabled) {
+        stats.scale = snapScale(settings.fixedScale);
+    }
+
+    stats.renderWidth = std::max(1, static_cast<int>(std::lround(width * stats.scale)));
+    stats.renderHeight = std::max(1, static_cast<int>(std::lround(height * stats.scale)));
+    // full scale draws straight to the window and skips the blit
+    offscreen = initialized && width > 0 && height > 0 && stats.scale < kMaxScale && ensureTarget(width, height);
+    if (offscreen) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, stats.renderWidth, stats.renderHeight);
+    }
+    else {
+        stats.renderWidth = width;
+        stats.renderHeight = height;
+    }
+
+    if (initialized) {
+        readTimer();
+        glQueryCounter(queries[(frame & 1) * 2], GL_TIMESTAMP);
+        pending[frame & 1] = true;
+    }
+}
+
+void DynamicResolution::endScene() {
+    if (initialized) {
+        glQueryCounter(queries[(frame & 1) * 2 + 1], GL_TIMESTAMP);
+        ++frame;
+    }
+    if (offscreen) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, stats.renderWidth, stats.renderHeight, 0, 0, windowWidth, windowHeight,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+    }
+    if (settings.enabled) {
+        updateScale();
+    }
+}
+
+void DynamicResolution::readTimer() {
+    const int slot = frame & 1;
+    if (!pending[slot]) {
+        return;
+    }
+    // the end counter lands after the start one, so its availability covers both
+    GLint available = 0;
+    glGetQueryObjectiv(queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;
+    }
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(queries[slot * 2], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+    pending[slot] = false;
+    const GLuint64 elapsed = end > start ? end - start : 0;
+    const float ms = static_cast<float>(static_cast<double>(elapsed) / 1.0e6);
+    stats.gpuMs = stats.gpuMs > 0.0f ? stats.gpuMs + (ms - stats.gpuMs) * 0.2f : ms;
+}
+
+void DynamicResolution::updateScale() {
+    if (stats.gpuMs <= 0.0f || ++framesSinceChange < kAdjustInterval) {
+        return;
+    }
+    float desired = stats.scale;
+    if (stats.gpuMs > settings.targetMs) {
+        // fragment cost follows the pixel count, i.e. the square of the scale
+        desired = stats.scale * std::sqrt(settings.targetMs / stats.gpuMs);
+        desired = std::min(desired, stats.scale - kScaleStep);
+    }
+    else if (stats.gpuMs < settings.targetMs * kGrowThreshold) {
+        desired = stats.scale + kScaleStep; // grow slowly so it doesn't oscillate
+    }
+    desired = snapScale(desired);
+    if (desired != stats.scale) {
+        stats.scale = desired;
+        framesSinceChange = 0;
+    }
+}
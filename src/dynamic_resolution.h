@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Renders the 3D viewport into an offscreen framebuffer at 50-100% of the window size and
+// upscales it with a linear blit. The scale follows the measured GPU time of the viewport pass.
+class DynamicResolution {
+public:
+    struct Settings {
+        bool enabled = true;
+        float targetMs = 12.0f;  // GPU budget for grid, axes and scene
+        float fixedScale = 1.0f; // used while automatic scaling is off
+    };
+
+    struct Stats {
+        float scale = 1.0f;
+        float gpuMs = 0.0f; // smoothed
+        int renderWidth = 0;
+        int renderHeight = 0;
+    };
+
+    DynamicResolution();
+    ~DynamicResolution();
+
+    void init();
+    // binds the offscreen target (or the window at full scale) and sets the viewport
+    void beginScene(int windowWidth, int windowHeight);
+    // upscales to the window and restores the full viewport
+    void endScene();
+
+    Settings& getSettings() { return settings; }
+    const Stats& getStats() const { return stats; }
+    float getScale() const { return stats.scale; }
+
+    static constexpr float kMinScale = 0.5f;
+    static constexpr float kMaxScale = 1.0f;
+
+private:
+    bool ensureTarget(int width, int height);
+    void destroyTarget();
+    void readTimer();
+    void updateScale();
+
+    Settings settings;
+    Stats stats;
+    bool initialized = false;
+
+    GLuint fbo = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+
+    int windowWidth = 0;
+    int windowHeight = 0;
+    bool offscreen = false; // this frame renders to the FBO
+
+    // double-buffered GL_TIMESTAMP pairs (start, end), read one frame late. Timestamps don't
+    // nest like GL_TIME_ELAPSED, so the scene's own pass timers can run inside.
+    GLuint queries[4] = { 0, 0, 0, 0 };
+    bool pending[2] = { false, false };
+    int frame = 0;
+    int framesSinceChange = 0;
+};
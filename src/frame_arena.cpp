@@ -0,0 +1,60 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+FrameArena::~FrameArena() {
+    for (const Block& block : blocks) {
+        ::operator delete(block.data);
+    }
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    if (!blocks.empty()) {
+        const Block& block = blocks.back();
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+        const uintptr_t aligned = (base + offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        const size_t end = static_cast<size_t>(aligned - base) + bytes;
+        if (end <= block.size) {
+            usedBytes += end - offset;
+            peakBytes = std::max(peakBytes, usedBytes);
+            offset = end;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+    // operator new memory is aligned for any fundamental type, larger alignments need the padding
+    addBlock(bytes + (alignment > alignof(std::max_align_t) ? alignment : 0));
+    return allocate(bytes, alignment);
+}
+
+void FrameArena::addBlock(size_t minBytes) {
+    const size_t size = std::max(minBytes, blocks.empty() ? firstBlockBytes : blocks.back().size * 2);
+    blocks.push_back({ static_cast<char*>(::operator new(size)), size });
+    offset = 0;
+}
+
+void FrameArena::reset() {
+    if (blocks.size() > 1) {
+        // this frame overflowed: make room for all of it in a single block
+        const size_t total = capacity();
+        for (const Block& block : blocks) {
+            ::operator delete(block.data);
+        }
+        blocks.clear();
+        addBlock(total);
+    }
+    offset = 0;
+    usedBytes = 0;
+}
+
+size_t FrameArena::capacity() const {
+    size_t total = 0;
+    for (const Block& block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator for data that only lives until the end of the frame: draw lists, sort keys, scratch
+// arrays. Allocation is a pointer bump and nothing is freed on its own; reset() drops everything at
+// once. A frame that overflows the first block keeps going in extra blocks, and the next reset
+// replaces them with one block of the combined size, so a steady frame stops touching the heap.
+// Not thread-safe: one arena per thread, see WorkerPool::arena().
+class FrameArena {
+public:
+    static constexpr size_t kDefaultBlockBytes = 64u << 10;
+
+    explicit FrameArena(size_t blockBytes = kDefaultBlockBytes) : firstBlockBytes(blockBytes) {}
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment);
+    template <class T>
+    T* allocateArray(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+    // everything allocated so far becomes invalid
+    void reset();
+
+    size_t used() const { return usedBytes; }
+    size_t capacity() const;
+    size_t peak() const { return peakBytes; }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void addBlock(size_t minBytes);
+
+    std::vector<Block> blocks; // the last one is being filled
+    size_t offset = 0;         // into blocks.back()
+    size_t usedBytes = 0;      // since the last reset, padding included
+    size_t peakBytes = 0;
+    size_t firstBlockBytes;
+};
+
+// STL adapter: containers allocate from the arena and deallocation is a no-op. Reserve the final
+// size up front where it is known, since a growing container leaves its old buffers behind.
+template <class T>
+class FrameAllocator {
+public:
+    using value_type = T;
+
+    explicit FrameAllocator(FrameArena& frameArena) : arena(&frameArena) {}
+    template <class U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <class U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+    template <class U>
+    bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <class U>
+    friend class FrameAllocator;
+
+    FrameArena* arena;
+};
+
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
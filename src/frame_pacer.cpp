@@ -0,0 +1,149 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+    // sleep granularity can be a whole scheduler tick, so spin for the last stretch
+    constexpr auto kSpinWindow = std::chrono::microseconds(2000);
+    // longer gaps are stalls or idle time, not frame pacing
+    constexpr float kMaxSmoothedDelta = 0.25f;
+}
+
+void FramePacer::init() {
+    // the tear extensions are the platform names for swap interval -1
+    adaptiveAvailable = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+        glfwExtensionSupported("GLX_EXT_swap_control_tear");
+    apply(settings);
+}
+
+void FramePacer::apply(const Settings& newSettings) {
+    settings = newSettings;
+    if (settings.sync == SyncMode::Adaptive && !adaptiveAvailable) {
+        settings.sync = SyncMode::VSync;
+    }
+    switch (settings.sync) {
+    case SyncMode::Off: glfwSwapInterval(0); break;
+    case SyncMode::VSync: glfwSwapInterval(1); break;
+    case SyncMode::Adaptive: glfwSwapInterval(-1); break;
+    }
+    settings.targetFps = std::clamp(settings.targetFps, 0, 1000);
+
+    // a new mode starts a fresh measurement window
+    frameTimes.clear();
+    frameCursor = 0;
+    framesSinceSummary = 0;
+    current = Stats{};
+    nextDeadline = Clock::now();
+}
+
+float FramePacer::beginFrame() {
+    if (settings.targetFps > 0) {
+        const auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / settings.targetFps));
+        nextDeadline += period;
+        const auto now = Clock::now();
+        if (nextDeadline < now) {
+            nextDeadline = now; // fell behind: don't try to catch up with a burst of short frames
+        }
+        else {
+            waitUntil(nextDeadline);
+        }
+    }
+
+    const auto now = Clock::now();
+    if (!started) {
+        started = true;
+        lastFrame = now;
+        nextDeadline = now;
+        return 0.0f;
+    }
+    const float raw = std::chrono::duration<float>(now - lastFrame).count();
+    lastFrame = now;
+    lastRawMs = raw * 1000.0f;
+
+    if (frameTimes.size() < kStatsFrames) {
+        frameTimes.push_back(lastRawMs);
+    }
+    else {
+        frameTimes[frameCursor] = lastRawMs;
+    }
+    frameCursor = (frameCursor + 1) % kStatsFrames;
+    if (++framesSinceSummary >= 60) {
+        summarize();
+    }
+
+    if (!settings.smoothDelta) {
+        return raw;
+    }
+    if (raw > kMaxSmoothedDelta) {
+        recentDeltas.clear(); // resume from idle without averaging the gap in
+        recentCursor = 0;
+        return kMaxSmoothedDelta;
+    }
+    if (recentDeltas.size() < kSmoothFrames) {
+        recentDeltas.push_back(raw);
+    }
+    else {
+        recentDeltas[recentCursor] = raw;
+    }
+    recentCursor = (recentCursor + 1) % kSmoothFrames;
+    float sum = 0.0f;
+    for (float delta : recentDeltas) {
+        sum += delta;
+    }
+    return sum / static_cast<float>(recentDeltas.size());
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline) const {
+    const auto now = Clock::now();
+    if (deadline - now > kSpinWindow) {
+        std::this_thread::sleep_for(deadline - now - kSpinWindow);
+    }
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::summarize() {
+    framesSinceSummary = 0;
+    if (frameTimes.empty()) {
+        return;
+    }
+    Stats stats;
+    stats.samples = static_cast<int>(frameTimes.size());
+    double sum = 0.0;
+    for (float ms : frameTimes) {
+        sum += ms;
+        stats.maxMs = std::max(stats.maxMs, ms);
+    }
+    const double mean = sum / frameTimes.size();
+    double variance = 0.0;
+    for (float ms : frameTimes) {
+        variance += (ms - mean) * (ms - mean);
+    }
+    stats.meanMs = static_cast<float>(mean);
+    stats.jitterMs = static_cast<float>(std::sqrt(variance / frameTimes.size()));
+
+    std::vector<float> sorted = frameTimes;
+    const size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+    std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(p99), sorted.end());
+    stats.p99Ms = sorted[p99];
+
+    current = stats;
+    history[modeLabel()] = stats;
+}
+
+std::string FramePacer::modeLabel() const {
+    std::string label;
+    switch (settings.sync) {
+    case SyncMode::Off: label = "Off"; break;
+    case SyncMode::VSync: label = "VSync"; break;
+    case SyncMode::Adaptive: label = "Adaptive"; break;
+    }
+    if (settings.targetFps > 0) {
+        label += ", " + std::to_string(settings.targetFps) + " fps cap";
+    }
+    return label;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Swap interval control, an optional FPS cap (sleep, then spin for the last stretch) and a
+// smoothed delta time for camera movement. Frame-time jitter is recorded per pacing mode so
+// modes can be compared side by side.
+class FramePacer {
+public:
+    enum class SyncMode {
+        Off,
+        VSync,
+        Adaptive // swap interval -1: tear instead of waiting a whole refresh when late
+    };
+
+    struct Settings {
+        SyncMode sync = SyncMode::VSync;
+        int targetFps = 0; // 0 = no cap
+        bool smoothDelta = true;
+    };
+
+    struct Stats {
+        float meanMs = 0.0f;
+        float jitterMs = 0.0f; // standard deviation of the frame time
+        float p99Ms = 0.0f;
+        float maxMs = 0.0f;
+        int samples = 0;
+    };
+
+    // needs the current context: queries the tear extension and sets the swap interval
+    void init();
+    void apply(const Settings& newSettings);
+    const Settings& getSettings() const { return settings; }
+    bool adaptiveSupported() const { return adaptiveAvailable; }
+
+    // waits for the frame cap, then returns the (smoothed) delta time in seconds
+    float beginFrame();
+    float rawDeltaMs() const { return lastRawMs; }
+
+    const Stats& getStats() const { return current; }
+    // last summary per mode label, e.g. "VSync" or "Off, 144 fps cap"
+    const std::map<std::string, Stats>& getModeHistory() const { return history; }
+    std::string modeLabel() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void waitUntil(Clock::time_point deadline) const;
+    void summarize();
+
+    Settings settings;
+    bool adaptiveAvailable = false;
+    bool started = false;
+    Clock::time_point lastFrame;
+    Clock::time_point nextDeadline;
+    float lastRawMs = 0.0f;
+
+    static constexpr size_t kSmoothFrames = 8;
+    static constexpr size_t kStatsFrames = 240;
+    std::vector<float> recentDeltas; // seconds, ring of kSmoothFrames
+    size_t recentCursor = 0;
+    std::vector<float> frameTimes;   // ms, ring of kStatsFrames
+    size_t frameCursor = 0;
+    int framesSinceSummary = 0;
+    Stats current;
+    std::map<std::string, Stats> history;
+};
@@ -0,0 +1,57 @@
+#include "frustum.h"
+
+Frustum Frustum::fromRect(const glm::mat4& viewProjection, const glm::vec2& ndcMin, const glm::vec2& ndcMax) {
+    // glm is column-major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+    const glm::vec2 lo = glm::min(ndcMin, ndcMax);
+    const glm::vec2 hi = glm::max(ndcMin, ndcMax);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[0] - lo.x * rows[3]; // x_clip >= lo.x * w
+    frustum.planes[1] = hi.x * rows[3] - rows[0];
+    frustum.planes[2] = rows[1] - lo.y * rows[3];
+    frustum.planes[3] = hi.y * rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];        // near
+    frustum.planes[5] = rows[3] - rows[2];        // far
+    for (glm::vec4& plane : frustum.planes) {
+        const float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) {
+            plane /= length;
+        }
+    }
+    return frustum;
+}
+
+bool Frustum::touchesSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::enclosesSphere(const glm::vec3& center, float radius) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::touchesBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for (const glm::vec4& plane : planes) {
+        // the corner furthest along the plane normal
+        const glm::vec3 corner(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+            plane.y >= 0.0f ? boxMax.y : boxMin.y,
+            plane.z >= 0.0f ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
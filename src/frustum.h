@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// six inward-facing planes (xyz normal, w distance), normalized so plane tests give world distances
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // the part of the view volume behind an NDC rectangle, e.g. a marquee on screen
+    static Frustum fromRect(const glm::mat4& viewProjection, const glm::vec2& ndcMin, const glm::vec2& ndcMax);
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        return fromRect(viewProjection, glm::vec2(-1.0f), glm::vec2(1.0f));
+    }
+
+    // touching: any part inside, enclosed: entirely inside
+    bool touchesSphere(const glm::vec3& center, float radius) const;
+    bool enclosesSphere(const glm::vec3& center, float radius) const;
+    bool touchesBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+};
@@ -0,0 +1,167 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+GpuProfiler::Scope::Scope(GpuProfiler* target, const char* name) : profiler(target) {
+    if (profiler) {
+        profiler->begin(name);
+    }
+}
+
+GpuProfiler::Scope::~Scope() {
+    if (profiler) {
+        profiler->end();
+    }
+}
+
+GpuProfiler::GpuProfiler() = default;
+
+GpuProfiler::~GpuProfiler() {
+    for (FrameSlot& slot : slots) {
+        if (!slot.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        }
+    }
+}
+
+void GpuProfiler::init() {
+    initialized = true;
+}
+
+int GpuProfiler::zoneIndex(const char* name) {
+    for (size_t i = 0; i < zoneNames.size(); ++i) {
+        if (std::strcmp(zoneNames[i].c_str(), name) == 0) {
+            return static_cast<int>(i);
+        }
+    }
+    zoneNames.emplace_back(name);
+    accum.emplace_back();
+    zoneDepths.push_back(0);
+    return static_cast<int>(zoneNames.size() - 1);
+}
+
+int GpuProfiler::nextQuery() {
+    FrameSlot& slot = slots[current];
+    if (slot.usedQueries == static_cast<int>(slot.queries.size())) {
+        // grow in chunks; the zone count settles after the first frame
+        const size_t grow = std::max<size_t>(16, slot.queries.size());
+        slot.queries.resize(slot.queries.size() + grow);
+        glGenQueries(static_cast<GLsizei>(grow), slot.queries.data() + slot.queries.size() - grow);
+    }
+    return slot.usedQueries++;
+}
+
+void GpuProfiler::beginFrame() {
+    if (!initialized || !enabled) {
+        inFrame = false;
+        return;
+    }
+    current = (current + 1) % kFrames;
+    FrameSlot& slot = slots[current];
+    if (slot.pending) {
+        resolve(slot);
+    }
+    slot.usedQueries = 0;
+    slot.records.clear();
+    openRecords.clear();
+    inFrame = true;
+    begin("Frame");
+}
+
+void GpuProfiler::endFrame() {
+    if (!inFrame) {
+        return;
+    }
+    while (!openRecords.empty()) {
+        end(); // closes "Frame" and anything left open by mistake
+    }
+    slots[current].pending = true;
+    inFrame = false;
+}
+
+void GpuProfiler::begin(const char* name) {
+    if (!inFrame) {
+        return;
+    }
+    FrameSlot& slot = slots[current];
+    Record record;
+    record.zone = zoneIndex(name);
+    record.depth = static_cast<int>(openRecords.size());
+    record.startQuery = nextQuery();
+    glQueryCounter(slot.queries[static_cast<size_t>(record.startQuery)], GL_TIMESTAMP);
+    openRecords.push_back(static_cast<int>(slot.records.size()));
+    slot.records.push_back(record);
+}
+
+void GpuProfiler::end() {
+    if (!inFrame || openRecords.empty()) {
+        return;
+    }
+    FrameSlot& slot = slots[current];
+    Record& record = slot.records[static_cast<size_t>(openRecords.back())];
+    openRecords.pop_back();
+    record.endQuery = nextQuery();
+    glQueryCounter(slot.queries[static_cast<size_t>(record.endQuery)], GL_TIMESTAMP);
+}
+
+void GpuProfiler::resolve(FrameSlot& slot) {
+    slot.pending = false;
+    if (slot.records.empty()) {
+        return;
+    }
+    // the root zone's end is the last query issued, so it being ready means all are
+    const GLuint last = slot.queries[static_cast<size_t>(slot.records.front().endQuery)];
+    GLint available = 0;
+    glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        ++dropped;
+        return;
+    }
+
+    zoneOrder.clear();
+    for (const Record& record : slot.records) {
+        if (record.endQuery < 0) {
+            continue;
+        }
+        GLuint64 start = 0;
+        GLuint64 stop = 0;
+        glGetQueryObjectui64v(slot.queries[static_cast<size_t>(record.startQuery)], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(slot.queries[static_cast<size_t>(record.endQuery)], GL_QUERY_RESULT, &stop);
+        const float ms = stop > start ? static_cast<float>(static_cast<double>(stop - start) / 1.0e6) : 0.0f;
+
+        ZoneAccum& zone = accum[static_cast<size_t>(record.zone)];
+        zone.sumMs += ms;
+        zone.maxMs = std::max(zone.maxMs, ms);
+        ++zone.count;
+        zoneDepths[static_cast<size_t>(record.zone)] = record.depth;
+        if (std::find(zoneOrder.begin(), zoneOrder.end(), record.zone) == zoneOrder.end()) {
+            zoneOrder.push_back(record.zone);
+        }
+    }
+
+    if (++windowFrames >= kWindowFrames) {
+        publish();
+    }
+}
+
+void GpuProfiler::publish() {
+    results.clear();
+    for (int zone : zoneOrder) {
+        ZoneAccum& data = accum[static_cast<size_t>(zone)];
+        if (data.count == 0) {
+            continue;
+        }
+        ZoneStats stats;
+        stats.name = zoneNames[static_cast<size_t>(zone)];
+        stats.depth = zoneDepths[static_cast<size_t>(zone)];
+        // averaged per frame, so a zone entered twice a frame reports its total
+        stats.avgMs = static_cast<float>(data.sumMs / windowFrames);
+        stats.maxMs = data.maxMs;
+        results.push_back(stats);
+    }
+    for (ZoneAccum& data : accum) {
+        data = ZoneAccum{};
+    }
+    windowFrames = 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// Nested GPU zones timed with GL_TIMESTAMP query pairs. Each frame's queries live in one of
+// kFrames slots and are read back kFrames - 1 frames later; results that are still not
+// available then are dropped instead of waited for.
+class GpuProfiler {
+public:
+    struct ZoneStats {
+        std::string name;
+        int depth = 0;
+        float avgMs = 0.0f; // over the last window
+        float maxMs = 0.0f;
+    };
+
+    // RAII zone; a null profiler makes it a no-op
+    class Scope {
+    public:
+        Scope(GpuProfiler* profiler, const char* name);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler* profiler;
+    };
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    void init();
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() const { return enabled; }
+
+    // brackets everything drawn this frame as the root "Frame" zone
+    void beginFrame();
+    void endFrame();
+
+    // name must outlive the frame, string literals are expected
+    void begin(const char* name);
+    void end();
+
+    const std::vector<ZoneStats>& getResults() const { return results; }
+    int droppedFrames() const { return dropped; }
+
+    static constexpr int kFrames = 3;
+    static constexpr int kWindowFrames = 30;
+
+private:
+    struct Record {
+        int zone = 0;
+        int depth = 0;
+        int startQuery = 0;
+        int endQuery = -1;
+    };
+
+    struct FrameSlot {
+        std::vector<GLuint> queries;
+        int usedQueries = 0;
+        std::vector<Record> records;
+        bool pending = false;
+    };
+
+    struct ZoneAccum {
+        double sumMs = 0.0;
+        float maxMs = 0.0f;
+        int count = 0;
+    };
+
+    int zoneIndex(const char* name);
+    int nextQuery();
+    void resolve(FrameSlot& slot);
+    void publish();
+
+    bool initialized = false;
+    bool enabled = true;
+    bool inFrame = false;
+    FrameSlot slots[kFrames];
+    int current = 0;
+    std::vector<int> openRecords; // indices into the current slot's records
+
+    std::vector<std::string> zoneNames;
+    std::vector<ZoneAccum> accum;
+    std::vector<int> zoneDepths;
+    std::vector<int> zoneOrder; // order of first appearance in the last resolved frame
+    int windowFrames = 0;
+    int dropped = 0;
+    std::vector<ZoneStats> results;
+};
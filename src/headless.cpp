@@ -0,0 +1,204 @@
+#include "headless.h"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "png_writer.h"
+
+bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options) {
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && hasValue) {
+            int w = 0;
+            int h = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+                options.width = w;
+                options.height = h;
+            }
+            else {
+                std::cerr << "Ignoring --size " << argv[i] << ", expected WxH" << std::endl;
+            }
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outputDir = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--png-every") == 0 && hasValue) {
+            options.pngEvery = std::max(0, std::atoi(argv[++i]));
+        }
+    }
+    return headless;
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+    if (timerQueries[0]) {
+        glDeleteQueries(2, timerQueries);
+    }
+    if (fbo) {
+        glDeleteFramebuffers(1, &fbo);
+    }
+    if (colorBuffer) {
+        glDeleteRenderbuffers(1, &colorBuffer);
+    }
+    if (depthBuffer) {
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+}
+
+bool HeadlessRenderer::init(int targetWidth, int targetHeight) {
+    if (initialized) {
+        return true;
+    }
+    if (!context.create()) {
+        return false;
+    }
+    width = targetWidth;
+    height = targetHeight;
+
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Headless framebuffer incomplete" << std::endl;
+        return false;
+    }
+    glGenQueries(2, timerQueries);
+
+    // same state the windowed path sets up after loading GL
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+
+    grid.init(20, 1.0f);
+    axes.init();
+    scene.init();
+    initialized = true;
+    return true;
+}
+
+HeadlessRenderer::FrameTiming HeadlessRenderer::renderFrame(const glm::mat4& view, const glm::mat4& projection,
+    const glm::vec3& cameraPos) {
+    FrameTiming timing;
+    if (!initialized) {
+        return timing;
+    }
+    // drop errors left over from setup so the check below only sees this frame
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    glQueryCounter(timerQueries[0], GL_TIMESTAMP);
+    glClearColor(0.08f, 0.09f, 0.12f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    grid.draw(view, projection);
+    axes.draw(view, projection);
+    scene.draw(view, projection, cameraPos);
+    glQueryCounter(timerQueries[1], GL_TIMESTAMP);
+    const auto submitted = Clock::now();
+
+    glFinish();
+    const auto finished = Clock::now();
+    GLuint64 gpuStart = 0;
+    GLuint64 gpuEnd = 0;
+    glGetQueryObjectui64v(timerQueries[0], GL_QUERY_RESULT, &gpuStart);
+    glGetQueryObjectui64v(timerQueries[1], GL_QUERY_RESULT, &gpuEnd);
+    const GLuint64 elapsed = gpuEnd > gpuStart ? gpuEnd - gpuStart : 0;
+    timing.glError = glGetError();
+
+    timing.submitMs = std::chrono::duration<float, std::milli>(submitted - start).count();
+    timing.frameMs = std::chrono::duration<float, std::milli>(finished - start).count();
+    timing.gpuMs = static_cast<float>(static_cast<double>(elapsed) / 1.0e6);
+    return timing;
+}
+
+bool HeadlessRenderer::saveFrame(const std::string& path) const {
+    if (!initialized) {
+        return false;
+    }
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return writePng(path, width, height, pixels.data(), true);
+}
+
+int runHeadless(const HeadlessOptions& options) {
+    HeadlessRenderer renderer;
+    if (!renderer.init(options.width, options.height)) {
+        return 1;
+    }
+
+    // fixed demo layout so runs are comparable
+    SceneRenderer& scene = renderer.getScene();
+    const PrimitiveType types[] = { PrimitiveType::Cube, PrimitiveType::Sphere, PrimitiveType::Cylinder };
+    for (int z = -2; z <= 2; ++z) {
+        for (int x = -2; x <= 2; ++x) {
+            const PrimitiveType type = types[static_cast<size_t>((x + z + 4) % 3)];
+            scene.addPrimitive(type, glm::vec3(static_cast<float>(x) * 2.0f, 0.5f, static_cast<float>(z) * 2.0f));
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(options.outputDir, error);
+    if (error) {
+        std::cerr << "Cannot create output directory " << options.outputDir << ": " << error.message() << std::endl;
+        return 1;
+    }
+
+    const float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+    double submitSum = 0.0;
+    double gpuSum = 0.0;
+    double frameSum = 0.0;
+    for (int frame = 0; frame < options.frames; ++frame) {
+        // one full orbit over the run
+        const float angle = glm::two_pi<float>() * static_cast<float>(frame) / static_cast<float>(options.frames);
+        const glm::vec3 eye(std::cos(angle) * 14.0f, 7.0f, std::sin(angle) * 14.0f);
+        const glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        const HeadlessRenderer::FrameTiming timing = renderer.renderFrame(view, projection, eye);
+        submitSum += timing.submitMs;
+        gpuSum += timing.gpuMs;
+        frameSum += timing.frameMs;
+        std::printf("frame %d: submit %.3f ms  gpu %.3f ms  total %.3f ms\n", frame, timing.submitMs, timing.gpuMs,
+            timing.frameMs);
+
+        const bool lastFrame = frame == options.frames - 1;
+        if (lastFrame || (options.pngEvery > 0 && frame % options.pngEvery == 0)) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "frame_%04d.png", frame);
+            renderer.saveFrame((std::filesystem::path(options.outputDir) / name).string());
+        }
+    }
+
+    const double count = static_cast<double>(options.frames);
+    std::printf("%d frames at %dx%d: submit %.3f ms  gpu %.3f ms  total %.3f ms (mean)\n", options.frames,
+        options.width, options.height, submitSum / count, gpuSum / count, frameSum / count);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "axes.h"
+#include "grid.h"
+#include "headless_context.h"
+#include "scene.h"
+
+struct HeadlessOptions {
+    int width = 1280;
+    int height = 720;
+    int frames = 60;
+    std::string outputDir = "headless_out";
+    int pngEvery = 0; // 0 = only the last frame
+};
+
+// true when argv contains --headless; the other flags fill options:
+// --size WxH, --frames N, --out DIR, --png-every N
+bool parseHeadlessOptions(int argc, char** argv, HeadlessOptions& options);
+
+// renders a fixed demo scene with an orbiting camera, prints per-frame timings and writes PNGs
+int runHeadless(const HeadlessOptions& options);
+
+// grid, axes and scene drawn into an FBO on a headless context; shared by the benchmark
+class HeadlessRenderer {
+public:
+    struct FrameTiming {
+        float submitMs = 0.0f; // CPU time to issue the frame
+        float gpuMs = 0.0f;
+        float frameMs = 0.0f; // until the GPU finished
+        GLenum glError = GL_NO_ERROR; // first error the frame raised
+    };
+
+    HeadlessRenderer() = default;
+    ~HeadlessRenderer();
+
+    bool init(int width, int height);
+    SceneRenderer& getScene() { return scene; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // blocks until the frame is complete so timings are per frame
+    FrameTiming renderFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+    bool saveFrame(const std::string& path) const;
+
+private:
+    // declared first so it is destroyed after everything that owns GL objects
+    HeadlessContext context;
+    GridRenderer grid;
+    AxesRenderer axes;
+    SceneRenderer scene;
+
+    GLuint fbo = 0;
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+    GLuint timerQueries[2] = { 0, 0 }; // GL_TIMESTAMP start/end, the scene nests its own elapsed queries
+    int width = 0;
+    int height = 0;
+    bool initialized = false;
+};
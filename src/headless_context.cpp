@@ -0,0 +1,134 @@
+#include "headless_context.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+
+#ifdef CG_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::~HeadlessContext() {
+    destroy();
+}
+
+#ifdef CG_HAS_EGL
+
+namespace {
+    bool hasExtension(const char* list, const char* name) {
+        if (!list) {
+            return false;
+        }
+        const size_t length = std::strlen(name);
+        for (const char* found = std::strstr(list, name); found; found = std::strstr(found + length, name)) {
+            const bool startOk = found == list || found[-1] == ' ';
+            const bool endOk = found[length] == ' ' || found[length] == '\0';
+            if (startOk && endOk) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool HeadlessContext::create() {
+    destroy();
+
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    // prefer the surfaceless platform so no X11 or Wayland connection is attempted
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        const auto getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay) {
+            eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+    }
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        return false;
+    }
+    display = eglDisplay;
+
+    if (!hasExtension(eglQueryString(eglDisplay, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        std::cerr << "EGL display does not support surfaceless contexts" << std::endl;
+        destroy();
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL cannot create desktop OpenGL contexts" << std::endl;
+        destroy();
+        return false;
+    }
+
+    // EGL_SURFACE_TYPE defaults to EGL_WINDOW_BIT, which the surfaceless platform never offers
+    const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        std::cerr << "No EGL config with desktop OpenGL" << std::endl;
+        destroy();
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT) {
+        std::cerr << "Failed to create an OpenGL 3.3 core EGL context" << std::endl;
+        destroy();
+        return false;
+    }
+    context = eglContext;
+
+    if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        std::cerr << "Failed to make the EGL context current" << std::endl;
+        destroy();
+        return false;
+    }
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+        std::cerr << "Failed to load OpenGL functions" << std::endl;
+        destroy();
+        return false;
+    }
+    std::cout << "Headless EGL " << major << "." << minor << ", " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
+
+void HeadlessContext::destroy() {
+    if (!display) {
+        return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context) {
+        eglDestroyContext(display, context);
+        context = nullptr;
+    }
+    eglTerminate(display);
+    display = nullptr;
+}
+
+#else
+
+bool HeadlessContext::create() {
+    std::cerr << "Headless mode needs EGL; this build was made without CG_HAS_EGL" << std::endl;
+    return false;
+}
+
+void HeadlessContext::destroy() {
+    display = nullptr;
+    context = nullptr;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+// OpenGL 3.3 core context without a window or display server: EGL on the Mesa surfaceless
+// platform (llvmpipe works). Only available when built with CG_HAS_EGL.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // creates the context, makes it current and loads the GL entry points
+    bool create();
+    void destroy();
+
+private:
+    void* display = nullptr; // EGLDisplay
+    void* context = nullptr; // EGLContext
+};
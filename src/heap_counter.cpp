@@ -0,0 +1,42 @@
+#include "heap_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace heap {
+
+    namespace {
+        // plain thread_local: constant-initialised, so using it inside operator new needs no setup
+        thread_local uint64_t gAllocations = 0;
+    }
+
+    uint64_t allocations() {
+        return gAllocations;
+    }
+}
+
+// the array and sized forms forward to these by default
+void* operator new(std::size_t size) {
+    ++heap::gAllocations;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    ++heap::gAllocations;
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts calls to the global operator new (replaced in heap_counter.cpp), so a frame can check
+// that it stayed off the heap. Over-aligned allocations are not counted; nothing in the render
+// path asks for them.
+namespace heap {
+
+    // calls made on the calling thread so far. Per thread so loader or worker threads don't show up
+    // in the render thread's frame; jobs draw() hands to the worker pool are not counted either
+    uint64_t allocations();
+}
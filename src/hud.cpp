@@ -67,6 +67,11 @@ void HudRenderer::showDolly(float delta) {
     dollyTimer = 1.5f;
 }
 
+void HudRenderer::setRenderScale(float scale, bool visible) {
+    renderScale = scale;
+    renderScaleVisible = visible;
+}
+
 void HudRenderer::draw(int screenWidth, int screenHeight) {
     if (!initialized) {
         return;
@@ -97,6 +102,20 @@ void HudRenderer::draw(int screenWidth, int screenHeight) {
         drawBar(x, y, barWidth * magnitude, barHeight, color, 1.0f, screenWidth, screenHeight);
     }
 
+    if (renderScaleVisible) {
+        const float barWidth = 120.0f;
+        const float barHeight = 8.0f;
+        const float x = static_cast<float>(screenWidth) - barWidth - 20.0f;
+        const float y = 20.0f;
+        // green at native resolution, orange towards the 50% floor
+        const float t = glm::clamp((1.0f - renderScale) / 0.5f, 0.0f, 1.0f);
+        const glm::vec3 color = glm::mix(glm::vec3(0.15f, 0.75f, 0.3f), glm::vec3(0.95f, 0.55f, 0.15f), t);
+        drawBar(x, y, barWidth, barHeight, glm::vec3(0.3f, 0.3f, 0.35f), 1.0f, screenWidth, screenHeight);
+        drawBar(x, y, barWidth, barHeight, color, glm::clamp(renderScale, 0.0f, 1.0f), screenWidth, screenHeight);
+        // tick at the 50% floor
+        drawBar(x + barWidth * 0.5f - 1.0f, y - 3.0f, 2.0f, barHeight + 6.0f, glm::vec3(0.85f), 1.0f, screenWidth, screenHeight);
+    }
+
     glBindVertexArray(0);
     glEnable(GL_DEPTH_TEST);
 }
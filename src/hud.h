@@ -13,6 +13,9 @@ public:
     void updateTimers(float dt);
     void showSpeed(float speed);
     void showDolly(float delta);
+    // persistent bar in the top-right corner; hidden when visible is false
+    void setRenderScale(float scale, bool visible);
+    bool isAnimating() const { return speedTimer > 0.0f || dollyTimer > 0.0f; }
     void draw(int screenWidth, int screenHeight);
 
 private:
@@ -27,4 +30,6 @@ private:
     float speedTimer = 0.0f;
     float dollyValue = 0.0f;
     float dollyTimer = 0.0f;
+    float renderScale = 1.0f;
+    bool renderScaleVisible = false;
 };
@@ -0,0 +1,476 @@
+#include "input_log.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    const char kMagic[4] = { 'C', 'G', 'I', 'L' };
+    constexpr uint32_t kVersion = 3; // 2: instance parents, 3: multi-selection and button modifiers
+
+    template <typename T>
+    void put(std::vector<unsigned char>& out, const T& value) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putVec3(std::vector<unsigned char>& out, const glm::vec3& value) {
+        put(out, value.x);
+        put(out, value.y);
+        put(out, value.z);
+    }
+
+    void putString(std::vector<unsigned char>& out, const std::string& value) {
+        put(out, static_cast<uint32_t>(value.size()));
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    // bounds-checked cursor over the loaded file; any short read clears ok
+    struct Reader {
+        const std::vector<unsigned char>& data;
+        size_t offset = 0;
+        bool ok = true;
+
+        template <typename T>
+        T get() {
+            T value{};
+            if (!ok || offset + sizeof(T) > data.size()) {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, data.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return value;
+        }
+
+        glm::vec3 getVec3() {
+            const float x = get<float>();
+            const float y = get<float>();
+            const float z = get<float>();
+            return glm::vec3(x, y, z);
+        }
+
+        std::string getString() {
+            const uint32_t length = get<uint32_t>();
+            if (!ok || offset + length > data.size()) {
+                ok = false;
+                return std::string();
+            }
+            std::string value(reinterpret_cast<const char*>(data.data() + offset), length);
+            offset += length;
+            return value;
+        }
+
+        bool atEnd() const { return offset >= data.size(); }
+    };
+
+    void writeSnapshot(std::vector<unsigned char>& out, const InputLogScene& snapshot) {
+        out.insert(out.end(), kMagic, kMagic + 4);
+        put(out, kVersion);
+        put(out, static_cast<int32_t>(snapshot.width));
+        put(out, static_cast<int32_t>(snapshot.height));
+        putVec3(out, snapshot.cameraPosition);
+        put(out, snapshot.cameraYaw);
+        put(out, snapshot.cameraPitch);
+        put(out, snapshot.cameraSpeed);
+        put(out, static_cast<int32_t>(snapshot.mode));
+        put(out, snapshot.lastClickAge);
+
+        put(out, static_cast<uint32_t>(snapshot.meshPaths.size()));
+        for (const std::string& meshPath : snapshot.meshPaths) {
+            putString(out, meshPath);
+        }
+        put(out, static_cast<uint32_t>(snapshot.instances.size()));
+        for (size_t i = 0; i < snapshot.instances.size(); ++i) {
+            const PrimitiveInstance& inst = snapshot.instances[i];
+            put(out, static_cast<uint8_t>(inst.type));
+            put(out, static_cast<int32_t>(inst.meshId));
+            put(out, static_cast<int32_t>(inst.parent));
+            putVec3(out, inst.position);
+            putVec3(out, inst.scale);
+            putVec3(out, inst.rotation);
+            putVec3(out, inst.color);
+            put(out, static_cast<uint8_t>(inst.isStatic ? 1 : 0));
+            put(out, static_cast<uint8_t>(inst.castsShadow ? 1 : 0));
+            const Material& material = snapshot.materials[i];
+            putVec3(out, material.ambient);
+            putVec3(out, material.diffuse);
+            putVec3(out, material.specular);
+            put(out, material.shininess);
+            put(out, material.ambientStrength);
+            put(out, material.diffuseStrength);
+            put(out, material.specularStrength);
+        }
+
+        putVec3(out, snapshot.light.position);
+        putVec3(out, snapshot.light.color);
+        put(out, snapshot.light.ambient);
+        put(out, snapshot.light.diffuse);
+        put(out, snapshot.light.specular);
+        put(out, snapshot.light.shininess);
+        put(out, static_cast<uint32_t>(snapshot.pointLights.size()));
+        for (const PointLight& pointLight : snapshot.pointLights) {
+            putVec3(out, pointLight.position);
+            putVec3(out, pointLight.color);
+            put(out, pointLight.intensity);
+            put(out, pointLight.radius);
+        }
+        put(out, static_cast<int32_t>(snapshot.selectedIndex));
+        put(out, static_cast<uint32_t>(snapshot.selection.size()));
+        for (int index : snapshot.selection) {
+            put(out, static_cast<int32_t>(index));
+        }
+        put(out, static_cast<int32_t>(snapshot.selectedLight));
+    }
+
+    bool readSnapshot(Reader& in, InputLogScene& snapshot) {
+        char magic[4] = {};
+        for (char& c : magic) {
+            c = in.get<char>();
+        }
+        if (!in.ok || std::memcmp(magic, kMagic, 4) != 0) {
+            std::cerr << "Not an input log" << std::endl;
+            return false;
+        }
+        const uint32_t version = in.get<uint32_t>();
+        if (version != kVersion) {
+            std::cerr << "Unsupported input log version " << version << std::endl;
+            return false;
+        }
+        snapshot.width = in.get<int32_t>();
+        snapshot.height = in.get<int32_t>();
+        snapshot.cameraPosition = in.getVec3();
+        snapshot.cameraYaw = in.get<float>();
+        snapshot.cameraPitch = in.get<float>();
+        snapshot.cameraSpeed = in.get<float>();
+        snapshot.mode = in.get<int32_t>();
+        snapshot.lastClickAge = in.get<float>();
+
+        const uint32_t meshCount = in.get<uint32_t>();
+        for (uint32_t i = 0; i < meshCount && in.ok; ++i) {
+            snapshot.meshPaths.push_back(in.getString());
+        }
+        const uint32_t instanceCount = in.get<uint32_t>();
+        for (uint32_t i = 0; i < instanceCount && in.ok; ++i) {
+            PrimitiveInstance inst;
+            inst.type = static_cast<PrimitiveType>(in.get<uint8_t>());
+            inst.meshId = in.get<int32_t>();
+            inst.parent = in.get<int32_t>();
+            inst.position = in.getVec3();
+            inst.scale = in.getVec3();
+            inst.rotation = in.getVec3();
+            inst.color = in.getVec3();
+            inst.isStatic = in.get<uint8_t>() != 0;
+            inst.castsShadow = in.get<uint8_t>() != 0;
+            Material material;
+            material.ambient = in.getVec3();
+            material.diffuse = in.getVec3();
+            material.specular = in.getVec3();
+            material.shininess = in.get<float>();
+            material.ambientStrength = in.get<float>();
+            material.diffuseStrength = in.get<float>();
+            material.specularStrength = in.get<float>();
+            snapshot.instances.push_back(inst);
+            snapshot.materials.push_back(material);
+        }
+
+        snapshot.light.position = in.getVec3();
+        snapshot.light.color = in.getVec3();
+        snapshot.light.ambient = in.get<float>();
+        snapshot.light.diffuse = in.get<float>();
+        snapshot.light.specular = in.get<float>();
+        snapshot.light.shininess = in.get<float>();
+        const uint32_t pointLightCount = in.get<uint32_t>();
+        for (uint32_t i = 0; i < pointLightCount && in.ok; ++i) {
+            PointLight pointLight;
+            pointLight.position = in.getVec3();
+            pointLight.color = in.getVec3();
+            pointLight.intensity = in.get<float>();
+            pointLight.radius = in.get<float>();
+            snapshot.pointLights.push_back(pointLight);
+        }
+        snapshot.selectedIndex = in.get<int32_t>();
+        const uint32_t selectionCount = in.get<uint32_t>();
+        for (uint32_t i = 0; i < selectionCount && in.ok; ++i) {
+            snapshot.selection.push_back(in.get<int32_t>());
+        }
+        snapshot.selectedLight = in.get<int32_t>();
+        return in.ok;
+    }
+
+    void hashBytes(uint64_t& hash, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    void hashVec3(uint64_t& hash, const glm::vec3& value) {
+        const float components[3] = { value.x, value.y, value.z };
+        hashBytes(hash, components, sizeof(components));
+    }
+}
+
+InputLogScene captureScene(const SceneRenderer& scene) {
+    InputLogScene snapshot;
+    for (const ImportedMeshInfo& mesh : scene.getImportedMeshes()) {
+        snapshot.meshPaths.push_back(strings::text(mesh.path));
+    }
+    snapshot.instances = scene.getInstances();
+    for (const PrimitiveInstance& inst : snapshot.instances) {
+        snapshot.materials.push_back(scene.getMaterial(inst.materialId));
+    }
+    snapshot.light = scene.getLightSettings();
+    snapshot.pointLights = scene.getPointLights();
+    snapshot.selectedIndex = scene.getSelectedIndex();
+    snapshot.selection = scene.getSelection();
+    snapshot.selectedLight = scene.getSelectedLight();
+    return snapshot;
+}
+
+void restoreScene(SceneRenderer& scene, const InputLogScene& snapshot) {
+    scene.clear();
+    scene.clearPointLights();
+    scene.clearLightSelection();
+
+    std::vector<int> meshIds;
+    for (const std::string& meshPath : snapshot.meshPaths) {
+        meshIds.push_back(scene.importMesh(meshPath));
+    }
+
+    for (size_t i = 0; i < snapshot.instances.size(); ++i) {
+        const PrimitiveInstance& source = snapshot.instances[i];
+        const bool validMesh = source.meshId >= 0 && source.meshId < static_cast<int>(meshIds.size()) &&
+            meshIds[static_cast<size_t>(source.meshId)] >= 0;
+        if (source.type != PrimitiveType::Mesh) {
+            scene.addPrimitive(source.type, source.position);
+        }
+        else if (validMesh) {
+            scene.addMeshInstance(meshIds[static_cast<size_t>(source.meshId)], source.position);
+        }
+        else {
+            // keep indices aligned with the log when a mesh file went missing
+            std::cerr << "Replay: missing mesh for instance " << i << ", using a cube" << std::endl;
+            scene.addPrimitive(PrimitiveType::Cube, source.position);
+        }
+
+        const int index = static_cast<int>(scene.instanceCount()) - 1;
+        scene.select(index);
+        if (PrimitiveInstance* inst = scene.getSelectedMutable()) {
+            inst->parent = source.parent; // may point ahead, resolved when the scene next updates transforms
+            inst->scale = source.scale;
+            inst->rotation = source.rotation;
+            inst->color = source.color;
+            inst->castsShadow = source.castsShadow;
+        }
+        scene.setInstanceMaterial(index, snapshot.materials[i]);
+        scene.setInstanceStatic(index, source.isStatic);
+    }
+    scene.clearSelection();
+
+    scene.getLightSettings() = snapshot.light;
+    for (const PointLight& pointLight : snapshot.pointLights) {
+        scene.addPointLight(pointLight);
+    }
+    scene.select(snapshot.selection, SelectMode::Replace);
+    if (snapshot.selectedIndex >= 0) {
+        scene.select(snapshot.selectedIndex, SelectMode::Add); // primary again
+    }
+    if (snapshot.selectedLight != SceneRenderer::kNoLight) {
+        scene.selectLight(snapshot.selectedLight);
+    }
+}
+
+uint64_t sceneStateHash(const SceneRenderer& scene) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const PrimitiveInstance& inst : scene.getInstances()) {
+        const int header[2] = { static_cast<int>(inst.type), inst.parent };
+        hashBytes(hash, header, sizeof(header));
+        hashVec3(hash, inst.position);
+        hashVec3(hash, inst.scale);
+        hashVec3(hash, inst.rotation);
+        hashVec3(hash, inst.color);
+    }
+    hashVec3(hash, scene.getLightSettings().position);
+    for (const PointLight& pointLight : scene.getPointLights()) {
+        hashVec3(hash, pointLight.position);
+    }
+    const int selection[2] = { scene.getSelectedIndex(), scene.getSelectedLight() };
+    hashBytes(hash, selection, sizeof(selection));
+    const std::vector<int>& selected = scene.getSelection();
+    hashBytes(hash, selected.data(), selected.size() * sizeof(int));
+    return hash;
+}
+
+InputRecorder::~InputRecorder() {
+    stop();
+}
+
+bool InputRecorder::start(const std::string& logPath, const InputLogScene& snapshot, double now) {
+    stop();
+    file.open(logPath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Cannot write input log " << logPath << std::endl;
+        return false;
+    }
+    path = logPath;
+    buffer.clear();
+    writeSnapshot(buffer, snapshot);
+    startTime = now;
+    lastMode = snapshot.mode;
+    eventCount = 0;
+    frameCount = 0;
+    recording = true;
+    flush();
+    return true;
+}
+
+void InputRecorder::stop() {
+    if (!recording) {
+        return;
+    }
+    flush();
+    file.close();
+    recording = false;
+    std::cout << "Input log " << path << ": " << frameCount << " frames, " << eventCount << " events" << std::endl;
+}
+
+void InputRecorder::beginEvent(InputEventType type, double now) {
+    put(buffer, static_cast<uint8_t>(type));
+    put(buffer, static_cast<float>(now - startTime));
+    ++eventCount;
+}
+
+void InputRecorder::recordMode(int mode) {
+    if (!recording || mode == lastMode) {
+        return;
+    }
+    lastMode = mode;
+    put(buffer, static_cast<uint8_t>(InputEventType::Mode));
+    put(buffer, static_cast<uint8_t>(mode));
+}
+
+void InputRecorder::recordCursor(double now, double x, double y) {
+    if (!recording) {
+        return;
+    }
+    beginEvent(InputEventType::Cursor, now);
+    put(buffer, x);
+    put(buffer, y);
+}
+
+void InputRecorder::recordButton(double now, int button, int action, int mods, double x, double y) {
+    if (!recording) {
+        return;
+    }
+    beginEvent(InputEventType::Button, now);
+    put(buffer, static_cast<uint8_t>(button));
+    put(buffer, static_cast<uint8_t>(action));
+    put(buffer, static_cast<uint8_t>(mods));
+    put(buffer, x);
+    put(buffer, y);
+}
+
+void InputRecorder::recordScroll(double now, double yoffset) {
+    if (!recording) {
+        return;
+    }
+    beginEvent(InputEventType::Scroll, now);
+    put(buffer, static_cast<float>(yoffset));
+}
+
+void InputRecorder::recordResize(double now, int width, int height) {
+    if (!recording) {
+        return;
+    }
+    beginEvent(InputEventType::Resize, now);
+    put(buffer, static_cast<int32_t>(width));
+    put(buffer, static_cast<int32_t>(height));
+}
+
+void InputRecorder::recordFrame(double now, float deltaTime, unsigned int keyMask) {
+    if (!recording) {
+        return;
+    }
+    put(buffer, static_cast<uint8_t>(InputEventType::Frame));
+    put(buffer, static_cast<float>(now - startTime));
+    put(buffer, deltaTime);
+    put(buffer, static_cast<uint16_t>(keyMask));
+    ++frameCount;
+    flush();
+}
+
+void InputRecorder::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+    if (!file) {
+        std::cerr << "Input log write failed, recording stopped" << std::endl;
+        recording = false;
+    }
+}
+
+bool InputLog::load(const std::string& logPath) {
+    std::ifstream file(logPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open input log " << logPath << std::endl;
+        return false;
+    }
+    const std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    scene = InputLogScene();
+    events.clear();
+    frames = 0;
+    Reader in{ data };
+    if (!readSnapshot(in, scene)) {
+        std::cerr << "Corrupt input log header in " << logPath << std::endl;
+        return false;
+    }
+
+    while (!in.atEnd() && in.ok) {
+        InputEvent event;
+        event.type = static_cast<InputEventType>(in.get<uint8_t>());
+        if (event.type == InputEventType::Mode) {
+            event.mode = in.get<uint8_t>();
+            events.push_back(event);
+            continue;
+        }
+        event.time = in.get<float>();
+        switch (event.type) {
+        case InputEventType::Frame:
+            event.deltaTime = in.get<float>();
+            event.keyMask = in.get<uint16_t>();
+            ++frames;
+            break;
+        case InputEventType::Cursor:
+            event.x = in.get<double>();
+            event.y = in.get<double>();
+            break;
+        case InputEventType::Button:
+            event.button = in.get<uint8_t>();
+            event.action = in.get<uint8_t>();
+            event.mods = in.get<uint8_t>();
+            event.x = in.get<double>();
+            event.y = in.get<double>();
+            break;
+        case InputEventType::Scroll:
+            event.y = in.get<float>();
+            break;
+        case InputEventType::Resize:
+            event.width = in.get<int32_t>();
+            event.height = in.get<int32_t>();
+            break;
+        default:
+            std::cerr << "Unknown input event in " << logPath << ", stopping at byte " << in.offset << std::endl;
+            return !events.empty();
+        }
+        if (in.ok) {
+            events.push_back(event);
+        }
+    }
+    // a truncated tail (the app was killed mid-frame) only loses the last partial frame
+    return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+// Compact binary log of the viewport input stream (cursor, buttons, scroll, polled key state) for
+// deterministic replays. Only events the viewport handled are stored; whatever ImGui captured is not.
+enum class InputEventType : uint8_t { Frame = 1, Cursor, Button, Scroll, Resize, Mode };
+
+struct InputEvent {
+    InputEventType type = InputEventType::Frame;
+    float time = 0.0f; // seconds since recording started
+    double x = 0.0;    // cursor position; x unused and y the offset for Scroll
+    double y = 0.0;
+    int button = 0;
+    int action = 0;
+    int mods = 0;   // Button: GLFW modifier bits
+    int width = 0;  // Resize
+    int height = 0;
+    int mode = 0;   // Mode: UiLayer::TransformMode
+    float deltaTime = 0.0f;   // Frame: the live frame delta
+    unsigned int keyMask = 0; // Frame: one bit per tracked key
+};
+
+// scene, camera and viewport state at the moment recording started
+struct InputLogScene {
+    int width = 0;
+    int height = 0;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float cameraYaw = 0.0f;
+    float cameraPitch = 0.0f;
+    float cameraSpeed = 0.0f;
+    int mode = 0;
+    float lastClickAge = 1.0e6f; // seconds since the last left click, for double-click detection
+    std::vector<std::string> meshPaths;
+    std::vector<PrimitiveInstance> instances; // textures are not captured
+    std::vector<Material> materials;          // one per instance
+    LightSettings light;
+    std::vector<PointLight> pointLights;
+    int selectedIndex = -1;
+    std::vector<int> selection; // every selected instance, selectedIndex included
+    int selectedLight = SceneRenderer::kNoLight;
+};
+
+// copies instances, lights and selection; camera and viewport fields are left to the caller
+InputLogScene captureScene(const SceneRenderer& scene);
+// rebuilds the scene from a snapshot, re-importing meshes by path
+void restoreScene(SceneRenderer& scene, const InputLogScene& snapshot);
+// FNV-1a over instance transforms, colours, lights and selection; equal hashes mean equal replays
+uint64_t sceneStateHash(const SceneRenderer& scene);
+
+class InputRecorder {
+public:
+    InputRecorder() = default;
+    ~InputRecorder();
+
+    // now is the application clock; every event time is stored relative to it
+    bool start(const std::string& path, const InputLogScene& snapshot, double now);
+    void stop();
+    bool isRecording() const { return recording; }
+    const std::string& getPath() const { return path; }
+
+    // written only when it differs from the last recorded mode
+    void recordMode(int mode);
+    void recordCursor(double now, double x, double y);
+    void recordButton(double now, int button, int action, int mods, double x, double y);
+    void recordScroll(double now, double yoffset);
+    void recordResize(double now, int width, int height);
+    // closes the events of one frame; the buffer is flushed to disk here
+    void recordFrame(double now, float deltaTime, unsigned int keyMask);
+
+private:
+    void beginEvent(InputEventType type, double now);
+    void flush();
+
+    std::ofstream file;
+    std::string path;
+    std::vector<unsigned char> buffer;
+    double startTime = 0.0;
+    int lastMode = -1;
+    size_t eventCount = 0;
+    size_t frameCount = 0;
+    bool recording = false;
+};
+
+class InputLog {
+public:
+    bool load(const std::string& path);
+    const InputLogScene& getScene() const { return scene; }
+    const std::vector<InputEvent>& getEvents() const { return events; }
+    size_t frameCount() const { return frames; }
+
+private:
+    InputLogScene scene;
+    std::vector<InputEvent> events;
+    size_t frames = 0;
+};
@@ -0,0 +1,394 @@
+#include "json_stream.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void JsonWriter::newline(size_t depth) {
+    out.put('\n');
+    for (size_t i = 0; i < depth; ++i) {
+        out.write("  ", 2);
+    }
+}
+
+void JsonWriter::beginValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (scopes.empty()) {
+        return;
+    }
+    Scope& scope = scopes.back();
+    if (!scope.empty) {
+        out.put(',');
+    }
+    if (scope.inlineItems) {
+        if (!scope.empty) {
+            out.put(' ');
+        }
+    }
+    else {
+        newline(scopes.size());
+    }
+    scope.empty = false;
+}
+
+void JsonWriter::beginObject() {
+    beginValue();
+    out.put('{');
+    scopes.push_back(Scope{ false, false, true });
+}
+
+void JsonWriter::endObject() {
+    const Scope scope = scopes.back();
+    scopes.pop_back();
+    if (!scope.empty) {
+        newline(scopes.size());
+    }
+    out.put('}');
+    if (scopes.empty()) {
+        out.put('\n');
+    }
+}
+
+void JsonWriter::beginArray(bool inlineItems) {
+    beginValue();
+    out.put('[');
+    scopes.push_back(Scope{ true, inlineItems, true });
+}
+
+void JsonWriter::endArray() {
+    const Scope scope = scopes.back();
+    scopes.pop_back();
+    if (!scope.empty && !scope.inlineItems) {
+        newline(scopes.size());
+    }
+    out.put(']');
+}
+
+void JsonWriter::key(const char* name) {
+    Scope& scope = scopes.back();
+    if (!scope.empty) {
+        out.put(',');
+    }
+    newline(scopes.size());
+    scope.empty = false;
+    writeString(name, std::strlen(name));
+    out.write(": ", 2);
+    afterKey = true;
+}
+
+void JsonWriter::value(float number) {
+    beginValue();
+    if (!std::isfinite(number)) {
+        out.put('0'); // JSON has no inf/nan
+        return;
+    }
+    // shortest form that reads back to the same float, so diffs stay small and round trips exact
+    char text[32];
+    for (int precision = 6; precision <= 9; ++precision) {
+        std::snprintf(text, sizeof(text), "%.*g", precision, static_cast<double>(number));
+        if (std::strtof(text, nullptr) == number) {
+            break;
+        }
+    }
+    out << text;
+}
+
+void JsonWriter::value(double number) {
+    beginValue();
+    if (!std::isfinite(number)) {
+        out.put('0');
+        return;
+    }
+    char text[32];
+    for (int precision = 15; precision <= 17; ++precision) {
+        std::snprintf(text, sizeof(text), "%.*g", precision, number);
+        if (std::strtod(text, nullptr) == number) {
+            break;
+        }
+    }
+    out << text;
+}
+
+void JsonWriter::value(int number) {
+    beginValue();
+    out << number;
+}
+
+void JsonWriter::value(bool flag) {
+    beginValue();
+    out << (flag ? "true" : "false");
+}
+
+void JsonWriter::value(const std::string& text) {
+    beginValue();
+    writeString(text.data(), text.size());
+}
+
+void JsonWriter::value(const char* text) {
+    beginValue();
+    writeString(text, std::strlen(text));
+}
+
+void JsonWriter::writeString(const char* text, size_t length) {
+    out.put('"');
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        switch (c) {
+        case '"': out.write("\\\"", 2); break;
+        case '\\': out.write("\\\\", 2); break;
+        case '\n': out.write("\\n", 2); break;
+        case '\r': out.write("\\r", 2); break;
+        case '\t': out.write("\\t", 2); break;
+        default:
+            if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            }
+            else {
+                out.put(static_cast<char>(c));
+            }
+            break;
+        }
+    }
+    out.put('"');
+}
+
+int JsonReader::peek() {
+    if (position == filled) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        filled = static_cast<size_t>(in.gcount());
+        position = 0;
+        if (filled == 0) {
+            return EOF;
+        }
+    }
+    return static_cast<unsigned char>(buffer[position]);
+}
+
+int JsonReader::get() {
+    const int c = peek();
+    if (c != EOF) {
+        ++position;
+        if (c == '\n') {
+            ++line;
+        }
+    }
+    return c;
+}
+
+void JsonReader::skipWhitespace() {
+    for (int c = peek(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c = peek()) {
+        get();
+    }
+}
+
+bool JsonReader::fail(const char* message) {
+    error = "line " + std::to_string(line) + ": " + message;
+    return false;
+}
+
+bool JsonReader::readString(std::string& text) {
+    text.clear();
+    get(); // opening quote
+    while (true) {
+        int c = get();
+        if (c == EOF) {
+            return fail("unterminated string");
+        }
+        if (c == '"') {
+            return true;
+        }
+        if (c < 0x20) {
+            return fail("control character in string");
+        }
+        if (c != '\\') {
+            text.push_back(static_cast<char>(c));
+            continue;
+        }
+        c = get();
+        switch (c) {
+        case '"': text.push_back('"'); break;
+        case '\\': text.push_back('\\'); break;
+        case '/': text.push_back('/'); break;
+        case 'b': text.push_back('\b'); break;
+        case 'f': text.push_back('\f'); break;
+        case 'n': text.push_back('\n'); break;
+        case 'r': text.push_back('\r'); break;
+        case 't': text.push_back('\t'); break;
+        case 'u': {
+            unsigned int code = 0;
+            for (int i = 0; i < 4; ++i) {
+                const int h = get();
+                code <<= 4;
+                if (h >= '0' && h <= '9') code |= static_cast<unsigned int>(h - '0');
+                else if (h >= 'a' && h <= 'f') code |= static_cast<unsigned int>(h - 'a' + 10);
+                else if (h >= 'A' && h <= 'F') code |= static_cast<unsigned int>(h - 'A' + 10);
+                else return fail("bad \\u escape");
+            }
+            // a lone surrogate half is kept as-is; pairs are not combined
+            if (code < 0x80) {
+                text.push_back(static_cast<char>(code));
+            }
+            else if (code < 0x800) {
+                text.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                text.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            else {
+                text.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                text.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                text.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            break;
+        }
+        default:
+            return fail("bad escape");
+        }
+    }
+}
+
+bool JsonReader::readLiteral(const char* literal) {
+    for (const char* c = literal; *c; ++c) {
+        if (get() != *c) {
+            return fail("bad literal");
+        }
+    }
+    return true;
+}
+
+bool JsonReader::readNumber(double& value) {
+    scratch.clear();
+    for (int c = peek(); (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'; c = peek()) {
+        scratch.push_back(static_cast<char>(get()));
+    }
+    char* end = nullptr;
+    value = std::strtod(scratch.c_str(), &end);
+    if (scratch.empty() || end != scratch.c_str() + scratch.size()) {
+        return fail("bad number");
+    }
+    return true;
+}
+
+bool JsonReader::readKey(JsonHandler& handler) {
+    skipWhitespace();
+    if (peek() != '"') {
+        return fail("expected a key");
+    }
+    if (!readString(scratch)) {
+        return false;
+    }
+    if (!handler.key(scratch)) {
+        return fail("stopped by handler");
+    }
+    skipWhitespace();
+    if (get() != ':') {
+        return fail("expected ':'");
+    }
+    return true;
+}
+
+bool JsonReader::parseScalar(JsonHandler& handler) {
+    const int c = peek();
+    bool accepted = true;
+    if (c == '"') {
+        if (!readString(scratch)) {
+            return false;
+        }
+        accepted = handler.string(scratch);
+    }
+    else if (c == 't' || c == 'f') {
+        if (!readLiteral(c == 't' ? "true" : "false")) {
+            return false;
+        }
+        accepted = handler.boolean(c == 't');
+    }
+    else if (c == 'n') {
+        if (!readLiteral("null")) {
+            return false;
+        }
+        accepted = handler.null();
+    }
+    else if (c == '-' || (c >= '0' && c <= '9')) {
+        double value = 0.0;
+        if (!readNumber(value)) {
+            return false;
+        }
+        accepted = handler.number(value);
+    }
+    else {
+        return fail(c == EOF ? "unexpected end of file" : "unexpected character");
+    }
+    return accepted || fail("stopped by handler");
+}
+
+bool JsonReader::parse(JsonHandler& handler) {
+    error.clear();
+    std::vector<char> stack; // '{' or '[' per open container
+    bool expectValue = true;
+    while (true) {
+        if (expectValue) {
+            skipWhitespace();
+            const int c = peek();
+            if (c == '{' || c == '[') {
+                get();
+                const bool object = c == '{';
+                if (stack.size() >= kMaxDepth) {
+                    return fail("nesting too deep");
+                }
+                if (!(object ? handler.startObject() : handler.startArray())) {
+                    return fail("stopped by handler");
+                }
+                skipWhitespace();
+                if (peek() == (object ? '}' : ']')) {
+                    get();
+                    if (!(object ? handler.endObject() : handler.endArray())) {
+                        return fail("stopped by handler");
+                    }
+                }
+                else {
+                    stack.push_back(static_cast<char>(c));
+                    if (object && !readKey(handler)) {
+                        return false;
+                    }
+                    continue;
+                }
+            }
+            else if (!parseScalar(handler)) {
+                return false;
+            }
+            expectValue = false;
+        }
+
+        // a value just finished: close containers or move on to the next member
+        skipWhitespace();
+        if (stack.empty()) {
+            return peek() == EOF || fail("trailing characters");
+        }
+        const int c = get();
+        if (c == ',') {
+            if (stack.back() == '{' && !readKey(handler)) {
+                return false;
+            }
+            expectValue = true;
+        }
+        else if (c == '}' && stack.back() == '{') {
+            stack.pop_back();
+            if (!handler.endObject()) {
+                return fail("stopped by handler");
+            }
+        }
+        else if (c == ']' && stack.back() == '[') {
+            stack.pop_back();
+            if (!handler.endArray()) {
+                return fail("stopped by handler");
+            }
+        }
+        else {
+            return fail("expected ',' or a closing bracket");
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Streaming JSON writer: values go straight to the stream, nothing is kept but the nesting stack.
+// Objects are written one member per line; arrays opened with inlineItems stay on one line.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream& out) : out(out) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray(bool inlineItems = false);
+    void endArray();
+    void key(const char* name);
+
+    void value(float number);
+    void value(double number);
+    void value(int number);
+    void value(bool flag);
+    void value(const std::string& text);
+    void value(const char* text);
+
+private:
+    struct Scope {
+        bool array = false;
+        bool inlineItems = false;
+        bool empty = true;
+    };
+
+    void beginValue();
+    void newline(size_t depth);
+    void writeString(const char* text, size_t length);
+
+    std::ostream& out;
+    std::vector<Scope> scopes;
+    bool afterKey = false;
+};
+
+// SAX callbacks; returning false stops the parse
+class JsonHandler {
+public:
+    virtual ~JsonHandler() = default;
+    virtual bool startObject() { return true; }
+    virtual bool endObject() { return true; }
+    virtual bool startArray() { return true; }
+    virtual bool endArray() { return true; }
+    virtual bool key(const std::string& /*name*/) { return true; }
+    virtual bool string(const std::string& /*text*/) { return true; }
+    virtual bool number(double /*value*/) { return true; }
+    virtual bool boolean(bool /*value*/) { return true; }
+    virtual bool null() { return true; }
+};
+
+// Iterative pull parser over a fixed read buffer, so memory stays bounded by the nesting depth and
+// the longest string, whatever the file size.
+class JsonReader {
+public:
+    explicit JsonReader(std::istream& in) : in(in), buffer(kBufferSize) {}
+
+    bool parse(JsonHandler& handler);
+    // "line N: message" after a failed parse
+    const std::string& getError() const { return error; }
+
+private:
+    static constexpr size_t kBufferSize = 1 << 16;
+    static constexpr size_t kMaxDepth = 256;
+
+    int peek();
+    int get();
+    void skipWhitespace();
+    bool fail(const char* message);
+    bool readKey(JsonHandler& handler);
+    bool readString(std::string& text);
+    bool readLiteral(const char* literal);
+    bool readNumber(double& value);
+    bool parseScalar(JsonHandler& handler);
+
+    std::istream& in;
+    std::vector<char> buffer;
+    size_t position = 0;
+    size_t filled = 0;
+    size_t line = 1;
+    std::string scratch;
+    std::string error;
+};
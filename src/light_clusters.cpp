@@ -0,0 +1,117 @@
+#include "light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "worker_pool.h"
+
+int LightClusterGrid::sliceForDepth(float depth) const {
+    if (depth <= nearPlane) {
+        return 0;
+    }
+    const float t = std::log(depth / nearPlane) / std::log(farPlane / nearPlane);
+    return std::clamp(static_cast<int>(std::floor(t * static_cast<float>(kSlices))), 0, kSlices - 1);
+}
+
+void LightClusterGrid::build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+    float nearZ, float farZ, WorkerPool& pool) {
+    nearPlane = nearZ;
+    farPlane = farZ;
+    clusterRanges.assign(kClusterCount, glm::uvec2(0u));
+    indices.clear();
+    bounds.clear();
+
+    // conservative tile/slice ranges per light from its view-space bounding box
+    FrameVector<unsigned int> boundsLight{ FrameAllocator<unsigned int>(pool.arena(0)) };
+    boundsLight.reserve(lights.size());
+    for (size_t i = 0; i < lights.size(); ++i) {
+        const glm::vec3 c = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+        const float r = lights[i].radius;
+        const float dMin = -c.z - r;
+        const float dMax = -c.z + r;
+        if (r <= 0.0f || dMax < nearPlane || dMin > farPlane) {
+            continue;
+        }
+
+        LightBounds b{ 0, kTilesX - 1, 0, kTilesY - 1, sliceForDepth(dMin), sliceForDepth(std::min(dMax, farPlane)) };
+        if (dMin > nearPlane) {
+            // every corner is in front of the near plane, so the projection is well defined
+            glm::vec2 lo(1e9f);
+            glm::vec2 hi(-1e9f);
+            for (int k = 0; k < 8; ++k) {
+                const glm::vec3 corner = c + glm::vec3((k & 1) ? r : -r, (k & 2) ? r : -r, (k & 4) ? r : -r);
+                const glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+                const glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+                lo = glm::min(lo, ndc);
+                hi = glm::max(hi, ndc);
+            }
+            if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) {
+                continue;
+            }
+            b.x0 = std::clamp(static_cast<int>(std::floor((lo.x * 0.5f + 0.5f) * kTilesX)), 0, kTilesX - 1);
+            b.x1 = std::clamp(static_cast<int>(std::floor((hi.x * 0.5f + 0.5f) * kTilesX)), 0, kTilesX - 1);
+            b.y0 = std::clamp(static_cast<int>(std::floor((lo.y * 0.5f + 0.5f) * kTilesY)), 0, kTilesY - 1);
+            b.y1 = std::clamp(static_cast<int>(std::floor((hi.y * 0.5f + 0.5f) * kTilesY)), 0, kTilesY - 1);
+        }
+        bounds.push_back(b);
+        boundsLight.push_back(static_cast<unsigned int>(i));
+    }
+    if (bounds.empty()) {
+        return;
+    }
+
+    // slices are independent, so each worker fills whole slices without synchronisation, into its own arena
+    sliceLists.resize(kSlices);
+    constexpr int kTilesPerSlice = kTilesX * kTilesY;
+    pool.parallelFor(kSlices, 1, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t z = begin; z < end; ++z) {
+            const int slice = static_cast<int>(z);
+            unsigned int counts[kTilesPerSlice] = {};
+            for (const LightBounds& b : bounds) {
+                if (slice < b.z0 || slice > b.z1) {
+                    continue;
+                }
+                for (int y = b.y0; y <= b.y1; ++y) {
+                    for (int x = b.x0; x <= b.x1; ++x) {
+                        ++counts[y * kTilesX + x];
+                    }
+                }
+            }
+
+            unsigned int cursor[kTilesPerSlice];
+            unsigned int total = 0;
+            glm::uvec2* ranges = &clusterRanges[static_cast<size_t>(slice) * kTilesPerSlice];
+            for (int t = 0; t < kTilesPerSlice; ++t) {
+                ranges[t] = glm::uvec2(total, counts[t]);
+                cursor[t] = total;
+                total += counts[t];
+            }
+
+            unsigned int* out = pool.arena(worker).allocateArray<unsigned int>(total);
+            sliceLists[z] = SliceList{ out, total };
+            for (size_t l = 0; l < bounds.size(); ++l) {
+                const LightBounds& b = bounds[l];
+                if (slice < b.z0 || slice > b.z1) {
+                    continue;
+                }
+                for (int y = b.y0; y <= b.y1; ++y) {
+                    for (int x = b.x0; x <= b.x1; ++x) {
+                        out[cursor[y * kTilesX + x]++] = boundsLight[l];
+                    }
+                }
+            }
+        }
+    });
+
+    // concatenate slices and rebase their local offsets
+    unsigned int base = 0;
+    for (int z = 0; z < kSlices; ++z) {
+        glm::uvec2* ranges = &clusterRanges[static_cast<size_t>(z) * kTilesPerSlice];
+        for (int t = 0; t < kTilesPerSlice; ++t) {
+            ranges[t].x += base;
+        }
+        const SliceList& list = sliceLists[static_cast<size_t>(z)];
+        indices.insert(indices.end(), list.indices, list.indices + list.count);
+        base += list.count;
+    }
+}
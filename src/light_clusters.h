@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class WorkerPool;
+
+struct PointLight {
+    glm::vec3 position = glm::vec3(0.0f, 2.0f, 0.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+    float radius = 4.0f; // attenuation reaches zero here
+};
+
+// CPU light assignment for clustered forward shading: the view frustum is split into
+// kTilesX * kTilesY screen tiles and kSlices exponential depth slices.
+class LightClusterGrid {
+public:
+    static constexpr int kTilesX = 16;
+    static constexpr int kTilesY = 9;
+    static constexpr int kSlices = 24;
+    static constexpr int kClusterCount = kTilesX * kTilesY * kSlices;
+
+    // scratch comes from the pool's arenas, which the caller resets between frames
+    void build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+        float nearPlane, float farPlane, WorkerPool& pool);
+
+    // per cluster: x = offset into lightIndices(), y = light count
+    const std::vector<glm::uvec2>& clusters() const { return clusterRanges; }
+    const std::vector<unsigned int>& lightIndices() const { return indices; }
+
+private:
+    struct LightBounds {
+        int x0, x1, y0, y1, z0, z1;
+    };
+
+    int sliceForDepth(float depth) const;
+
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    std::vector<LightBounds> bounds;
+    std::vector<glm::uvec2> clusterRanges;
+    std::vector<unsigned int> indices;
+    // per slice, in the worker arenas until merged after the parallel pass
+    struct SliceList {
+        const unsigned int* indices = nullptr;
+        unsigned int count = 0;
+    };
+    std::vector<SliceList> sliceLists;
+};
@@ -9,12 +9,32 @@
 
 #include "axes.h"
 #include "camera.h"
+#include "dynamic_resolution.h"
+#include "frame_pacer.h"
+#include "gpu_profiler.h"
+#include "headless.h"
 #include "grid.h"
 #include "hud.h"
+#include "input_log.h"
+#include "redraw_scheduler.h"
 #include "scene.h"
+#include "scene_journal.h"
+#include "undo_history.h"
+#include "trace.h"
 #include "ui_layer.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <limits>
 #include <cmath>
+#include <string>
+#include <vector>
 
 namespace {
     int gScreenWidth = 1920;
@@ -23,7 +43,6 @@ namespace {
     bool gRightMouseDown = false;
     bool gLeftMouseDown = false;
     bool gDraggingObject = false;
-    bool gLightSelected = false;
     bool gFirstDrag = true;
     double gLastX = 0.0;
     double gLastY = 0.0;
@@ -31,23 +50,118 @@ namespace {
     glm::vec3 gDragPlaneNormal(0.0f, 1.0f, 0.0f);
     glm::vec3 gDragPlanePoint(0.0f);
     glm::vec3 gDragOffset(0.0f);
+    // marquee selection: left drag over empty space in Select mode
+    bool gMarqueeActive = false;
+    int gMarqueeMods = 0;
+    glm::vec2 gMarqueeStart(0.0f);
+    glm::vec2 gMarqueeEnd(0.0f);
 
     struct AppContext {
         HudRenderer* hud = nullptr;
         UiLayer* ui = nullptr;
         SceneRenderer* scene = nullptr;
+        RedrawScheduler* redraw = nullptr;
+        InputRecorder* recorder = nullptr;
+        GLFWwindow* window = nullptr; // null while replaying
     };
+
+    // keys processInput polls; bit i of a key mask stands for kInputKeys[i]
+    const int kInputKeys[] = { GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D, GLFW_KEY_R, GLFW_KEY_F,
+        GLFW_KEY_T, GLFW_KEY_G, GLFW_KEY_Y, GLFW_KEY_H };
+
+    unsigned int pollKeyMask(GLFWwindow* window) {
+        unsigned int mask = 0;
+        for (size_t i = 0; i < std::size(kInputKeys); ++i) {
+            if (glfwGetKey(window, kInputKeys[i]) == GLFW_PRESS) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+
+    bool keyDown(unsigned int mask, int key) {
+        for (size_t i = 0; i < std::size(kInputKeys); ++i) {
+            if (kInputKeys[i] == key) {
+                return (mask & (1u << i)) != 0;
+            }
+        }
+        return false;
+    }
+
+    // the recorder while a log is open, after it noted the transform mode the next event runs under
+    InputRecorder* activeRecorder(AppContext* ctx) {
+        if (!ctx || !ctx->recorder || !ctx->recorder->isRecording()) {
+            return nullptr;
+        }
+        if (ctx->ui) {
+            ctx->recorder->recordMode(static_cast<int>(ctx->ui->getMode()));
+        }
+        return ctx->recorder;
+    }
+
+    // --record or F10: the log starts with a snapshot so a replay begins from the same state
+    bool startInputRecording(AppContext& ctx, const std::string& path) {
+        if (!ctx.recorder || !ctx.scene) {
+            return false;
+        }
+        const double now = glfwGetTime();
+        InputLogScene snapshot = captureScene(*ctx.scene);
+        snapshot.width = gScreenWidth;
+        snapshot.height = gScreenHeight;
+        snapshot.cameraPosition = gCamera.GetPosition();
+        snapshot.cameraYaw = gCamera.GetYaw();
+        snapshot.cameraPitch = gCamera.GetPitch();
+        snapshot.cameraSpeed = gCamera.GetSpeed();
+        snapshot.mode = ctx.ui ? static_cast<int>(ctx.ui->getMode()) : 0;
+        snapshot.lastClickAge = static_cast<float>(std::min(now - gLastLeftClickTime, 1.0e6));
+        if (!ctx.recorder->start(path, snapshot, now)) {
+            return false;
+        }
+        std::cout << "Recording input to " << path << ", F10 stops" << std::endl;
+        return true;
+    }
+
+    // how much history F9 and --trace write out
+    constexpr double kTraceSeconds = 10.0;
+
+    // first F9 starts recording if it was off, later presses dump the recent history
+    void dumpTrace() {
+        if (!trace::isEnabled()) {
+            trace::setEnabled(true);
+            std::cout << "CPU tracing enabled, press F9 again to write a trace" << std::endl;
+            return;
+        }
+        trace::dumpChromeTrace("trace_" + std::to_string(std::time(nullptr)) + ".json", kTraceSeconds);
+    }
+
+    // any window event means the picture may change
+    void requestRedraw(GLFWwindow* window) {
+        AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+        if (ctx && ctx->redraw) {
+            ctx->redraw->requestRedraw();
+        }
+    }
+
+    // held buttons or keys keep moving the camera or the selection without new events
+    bool interactionActive(GLFWwindow* window) {
+        return gRightMouseDown || gDraggingObject || pollKeyMask(window) != 0;
+    }
+}
+
+// the projection picking works with, matching the one the frame is rendered with
+glm::mat4 pickProjection() {
+    return glm::perspective(glm::radians(45.0f), static_cast<float>(gScreenWidth) / static_cast<float>(gScreenHeight), 0.1f, 100.0f);
+}
+
+glm::vec2 screenToNdc(double xpos, double ypos) {
+    return glm::vec2((2.0f * static_cast<float>(xpos)) / static_cast<float>(gScreenWidth) - 1.0f,
+        1.0f - (2.0f * static_cast<float>(ypos)) / static_cast<float>(gScreenHeight));
 }
 
 glm::vec3 screenRayDirection(double xpos, double ypos) {
-    const float x = static_cast<float>(xpos);
-    const float y = static_cast<float>(ypos);
-    const float ndcX = (2.0f * x) / static_cast<float>(gScreenWidth) - 1.0f;
-    const float ndcY = 1.0f - (2.0f * y) / static_cast<float>(gScreenHeight);
-
-    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(gScreenWidth) / static_cast<float>(gScreenHeight), 0.1f, 100.0f);
-    const glm::mat4 invProj = glm::inverse(projection);
-    glm::vec4 eye = invProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    const glm::vec2 ndc = screenToNdc(xpos, ypos);
+    const glm::mat4 invProj = glm::inverse(pickProjection());
+    glm::vec4 eye = invProj * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
     eye.z = -1.0f;
     eye.w = 0.0f;
 
@@ -76,39 +190,9 @@ bool raySphereHit(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm
     return true;
 }
 
-int pickInstance(double xpos, double ypos, const SceneRenderer& scene) {
-    const auto& instances = scene.getInstances();
-    if (instances.empty()) {
-        return -1;
-    }
-
-    const glm::vec3 rayOrigin = gCamera.GetPosition();
-    const glm::vec3 rayDir = screenRayDirection(xpos, ypos);
-
-    float closest = std::numeric_limits<float>::max();
-    int best = -1;
-
-    for (size_t i = 0; i < instances.size(); ++i) {
-        float baseRadius = 0.8f;
-        switch (instances[i].type) {
-        case PrimitiveType::Cube: baseRadius = 0.9f; break;
-        case PrimitiveType::Sphere: baseRadius = 0.6f; break;
-        case PrimitiveType::Cylinder: baseRadius = 0.8f; break;
-        case PrimitiveType::Plane: baseRadius = 0.8f; break;
-        }
-        const float scaleMax = glm::compMax(instances[i].scale);
-        const float radius = baseRadius * scaleMax;
-
-        float tHit = 0.0f;
-        if (raySphereHit(rayOrigin, rayDir, instances[i].position, radius, tHit)) {
-            if (tHit < closest) {
-                closest = tHit;
-                best = static_cast<int>(i);
-            }
-        }
-    }
-
-    return best;
+int pickInstance(double xpos, double ypos, SceneRenderer& scene) {
+    TRACE_ZONE("pickInstance");
+    return scene.raycast(gCamera.GetPosition(), screenRayDirection(xpos, ypos));
 }
 
 bool rayPlaneIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& planePoint, const glm::vec3& planeNormal, glm::vec3& outPoint) {
@@ -124,62 +208,56 @@ bool rayPlaneIntersection(const glm::vec3& rayOrigin, const glm::vec3& rayDir, c
     return true;
 }
 
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+// the handlers below only see the values passed in, so a recorded log can drive them without GLFW
+void handleResize(int width, int height) {
     gScreenWidth = width;
     gScreenHeight = height;
-    glViewport(0, 0, width, height);
 }
 
-void scroll_callback(GLFWwindow* window, double /*xoffset*/, double yoffset) {
-    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
-    if (ctx && ctx->ui && ctx->ui->WantCaptureMouse()) {
-        return;
-    }
-
-    if (ctx && ctx->scene && ctx->ui && ctx->ui->getMode() == UiLayer::TransformMode::Translate) {
+void handleScroll(AppContext& ctx, double yoffset) {
+    if (ctx.scene && ctx.ui && ctx.ui->getMode() == UiLayer::TransformMode::Translate) {
         const float depthStep = 0.25f * static_cast<float>(yoffset);
-        if (gLightSelected) {
-            ctx->scene->getLightSettings().position += gCamera.GetFront() * depthStep;
+        if (const glm::vec3* lightPos = ctx.scene->getSelectedLightPosition()) {
+            ctx.scene->setSelectedLightPosition(*lightPos + gCamera.GetFront() * depthStep);
             return;
         }
-        if (ctx->scene->getSelectedIndex() >= 0) {
-            ctx->scene->translateSelected(gCamera.GetFront() * depthStep);
+        if (ctx.scene->getSelectedIndex() >= 0) {
+            ctx.scene->translateSelected(gCamera.GetFront() * depthStep);
             return;
         }
     }
 
     if (gRightMouseDown) {
         gCamera.AdjustSpeed(static_cast<float>(yoffset));
-        HudRenderer* hud = ctx ? ctx->hud : nullptr;
-        if (hud) {
-            hud->showSpeed(gCamera.GetSpeed());
+        if (ctx.hud) {
+            ctx.hud->showSpeed(gCamera.GetSpeed());
         }
     }
     else {
         gCamera.Dolly(static_cast<float>(yoffset));
-        HudRenderer* hud = ctx ? ctx->hud : nullptr;
-        if (hud) {
-            hud->showDolly(static_cast<float>(yoffset));
+        if (ctx.hud) {
+            ctx.hud->showDolly(static_cast<float>(yoffset));
         }
     }
 }
 
-void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
-    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
-    if (ctx && ctx->ui && ctx->ui->WantCaptureMouse()) {
-        return;
+void handleCursor(AppContext& ctx, double xpos, double ypos) {
+    if (gMarqueeActive) {
+        gMarqueeEnd = glm::vec2(static_cast<float>(xpos), static_cast<float>(ypos));
+        if (ctx.ui) {
+            ctx.ui->setMarquee(true, gMarqueeStart, gMarqueeEnd);
+        }
     }
-
-    if (gDraggingObject && ctx && ctx->scene && ctx->ui && ctx->ui->getMode() == UiLayer::TransformMode::Translate) {
+    if (gDraggingObject && ctx.scene && ctx.ui && ctx.ui->getMode() == UiLayer::TransformMode::Translate) {
         const glm::vec3 rayOrigin = gCamera.GetPosition();
         const glm::vec3 rayDir = screenRayDirection(xpos, ypos);
         glm::vec3 hit;
         if (rayPlaneIntersection(rayOrigin, rayDir, gDragPlanePoint, gDragPlaneNormal, hit)) {
-            if (gLightSelected) {
-                ctx->scene->getLightSettings().position = hit + gDragOffset;
+            if (ctx.scene->isLightSelected()) {
+                ctx.scene->setSelectedLightPosition(hit + gDragOffset);
             }
-            else if (ctx->scene->getSelectedIndex() >= 0) {
-                ctx->scene->setSelectedPosition(hit + gDragOffset);
+            else if (ctx.scene->getSelectedIndex() >= 0) {
+                ctx.scene->setSelectedPosition(hit + gDragOffset);
             }
         }
     }
@@ -203,95 +281,148 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     gCamera.ProcessMouseMovement(static_cast<float>(xoffset), static_cast<float>(yoffset));
 }
 
-bool pickLight(double xpos, double ypos, const SceneRenderer& scene) {
+// returns -1 for the main light, a point light index, or SceneRenderer::kNoLight
+int pickLight(double xpos, double ypos, const SceneRenderer& scene) {
     const glm::vec3 rayOrigin = gCamera.GetPosition();
     const glm::vec3 rayDir = screenRayDirection(xpos, ypos);
-    const glm::vec3 lightPos = scene.getLightSettings().position;
+    float closest = std::numeric_limits<float>::max();
+    int best = SceneRenderer::kNoLight;
+
     float tHit = 0.0f;
-    return raySphereHit(rayOrigin, rayDir, lightPos, 0.6f, tHit);
+    if (raySphereHit(rayOrigin, rayDir, scene.getLightSettings().position, 0.6f, tHit)) {
+        closest = tHit;
+        best = -1;
+    }
+    const auto& pointLights = scene.getPointLights();
+    for (size_t i = 0; i < pointLights.size(); ++i) {
+        if (raySphereHit(rayOrigin, rayDir, pointLights[i].position, 0.3f, tHit) && tHit < closest) {
+            closest = tHit;
+            best = static_cast<int>(i);
+        }
+    }
+    return best;
 }
 
-void mouse_button_callback(GLFWwindow* window, int button, int action, int /*mods*/) {
-    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
-    if (ctx && ctx->ui && ctx->ui->WantCaptureMouse()) {
-        return;
+// selects what the marquee covers: dragged rightwards only what lies entirely inside, leftwards
+// everything it touches. Shift adds to the selection, Ctrl removes from it
+void finishMarquee(AppContext& ctx, double xpos, double ypos) {
+    gMarqueeActive = false;
+    gMarqueeEnd = glm::vec2(static_cast<float>(xpos), static_cast<float>(ypos));
+    if (ctx.ui) {
+        ctx.ui->setMarquee(false, gMarqueeStart, gMarqueeEnd);
     }
+    const glm::vec2 extent = glm::abs(gMarqueeEnd - gMarqueeStart);
+    if (!ctx.scene || extent.x < 4.0f || extent.y < 4.0f) {
+        return; // a click rather than a drag
+    }
+    const bool enclosed = gMarqueeEnd.x >= gMarqueeStart.x;
+    const Frustum frustum = Frustum::fromRect(pickProjection() * gCamera.GetViewMatrix(),
+        screenToNdc(gMarqueeStart.x, gMarqueeStart.y), screenToNdc(gMarqueeEnd.x, gMarqueeEnd.y));
+    std::vector<int> hits;
+    ctx.scene->queryFrustum(frustum, enclosed, hits);
+    const SelectMode mode = (gMarqueeMods & GLFW_MOD_SHIFT) ? SelectMode::Add :
+        (gMarqueeMods & GLFW_MOD_CONTROL) ? SelectMode::Remove : SelectMode::Replace;
+    ctx.scene->clearLightSelection();
+    ctx.scene->select(hits, mode);
+}
 
+// xpos/ypos is the cursor at the time of the click, now the time used for double-click detection;
+// mods are the GLFW modifier bits held at the click
+void handleMouseButton(AppContext& ctx, int button, int action, int mods, double xpos, double ypos, double now) {
     if (button == GLFW_MOUSE_BUTTON_RIGHT) {
         if (action == GLFW_PRESS) {
             gRightMouseDown = true;
             gFirstDrag = true;
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-            glfwGetCursorPos(window, &gLastX, &gLastY);
+            if (ctx.window) {
+                glfwSetInputMode(ctx.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+            }
+            gLastX = xpos;
+            gLastY = ypos;
         }
         else if (action == GLFW_RELEASE) {
             gRightMouseDown = false;
             gFirstDrag = true;
-            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+            if (ctx.window) {
+                glfwSetInputMode(ctx.window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+            }
         }
     }
 
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
         if (action == GLFW_PRESS) {
             gLeftMouseDown = true;
-            double xpos = 0.0;
-            double ypos = 0.0;
-            glfwGetCursorPos(window, &xpos, &ypos);
-            const double now = glfwGetTime();
             const bool isDoubleClick = (now - gLastLeftClickTime) < 0.25;
             gLastLeftClickTime = now;
 
-            if (ctx && ctx->scene) {
-                const int hit = pickInstance(xpos, ypos, *ctx->scene);
-                const bool lightHit = pickLight(xpos, ypos, *ctx->scene);
-
-                if (isDoubleClick) {
+            if (ctx.scene) {
+                const int hit = pickInstance(xpos, ypos, *ctx.scene);
+                const int lightHit = pickLight(xpos, ypos, *ctx.scene);
+                // Shift adds the clicked instance to the selection, Ctrl toggles it
+                const SelectMode extend = (mods & GLFW_MOD_CONTROL) ? SelectMode::Toggle :
+                    (mods & GLFW_MOD_SHIFT) ? SelectMode::Add : SelectMode::Replace;
+
+                if (extend != SelectMode::Replace && hit >= 0) {
+                    ctx.scene->clearLightSelection();
+                    ctx.scene->select(hit, extend);
+                    gDraggingObject = false;
+                }
+                else if (isDoubleClick) {
                     if (hit >= 0) {
-                        gLightSelected = false;
-                        if (ctx->scene->getSelectedIndex() == hit) {
-                            ctx->scene->clearSelection();
+                        ctx.scene->clearLightSelection();
+                        if (ctx.scene->getSelectedIndex() == hit) {
+                            ctx.scene->clearSelection();
                             gDraggingObject = false;
                         }
                         else {
-                            ctx->scene->select(hit);
+                            ctx.scene->select(hit);
                         }
                     }
-                    else if (lightHit) {
-                        ctx->scene->clearSelection();
-                        gLightSelected = !gLightSelected;
+                    else if (lightHit != SceneRenderer::kNoLight) {
+                        ctx.scene->clearSelection();
+                        if (ctx.scene->getSelectedLight() == lightHit) {
+                            ctx.scene->clearLightSelection();
+                        }
+                        else {
+                            ctx.scene->selectLight(lightHit);
+                        }
                         gDraggingObject = false;
                     }
                     else {
-                        ctx->scene->clearSelection();
-                        gLightSelected = false;
+                        ctx.scene->clearSelection();
+                        ctx.scene->clearLightSelection();
                         gDraggingObject = false;
                     }
                 }
+                else if (ctx.ui && ctx.ui->getMode() == UiLayer::TransformMode::Select && hit < 0 &&
+                    lightHit == SceneRenderer::kNoLight) {
+                    gMarqueeActive = true;
+                    gMarqueeMods = mods;
+                    gMarqueeStart = glm::vec2(static_cast<float>(xpos), static_cast<float>(ypos));
+                    gMarqueeEnd = gMarqueeStart;
+                    ctx.ui->setMarquee(true, gMarqueeStart, gMarqueeEnd);
+                }
                 else {
                     // single click: allow drag if already selected in translate mode
-                    if (ctx->ui && ctx->ui->getMode() == UiLayer::TransformMode::Translate) {
-                        if (ctx->scene->getSelectedIndex() >= 0 && !gLightSelected) {
-                            const PrimitiveInstance* inst = ctx->scene->getSelected();
-                            if (inst) {
-                                const glm::vec3 rayOrigin = gCamera.GetPosition();
-                                const glm::vec3 rayDir = screenRayDirection(xpos, ypos);
-                                gDragPlaneNormal = gCamera.GetFront();
-                                gDragPlanePoint = inst->position;
-                                glm::vec3 hitPoint;
-                                if (rayPlaneIntersection(rayOrigin, rayDir, gDragPlanePoint, gDragPlaneNormal, hitPoint)) {
-                                    gDragOffset = inst->position - hitPoint;
-                                    gDraggingObject = true;
-                                }
+                    if (ctx.ui && ctx.ui->getMode() == UiLayer::TransformMode::Translate) {
+                        if (ctx.scene->getSelectedIndex() >= 0 && !ctx.scene->isLightSelected()) {
+                            const glm::vec3 rayOrigin = gCamera.GetPosition();
+                            const glm::vec3 rayDir = screenRayDirection(xpos, ypos);
+                            gDragPlaneNormal = gCamera.GetFront();
+                            gDragPlanePoint = ctx.scene->getWorldPosition(ctx.scene->getSelectedIndex());
+                            glm::vec3 hitPoint;
+                            if (rayPlaneIntersection(rayOrigin, rayDir, gDragPlanePoint, gDragPlaneNormal, hitPoint)) {
+                                gDragOffset = gDragPlanePoint - hitPoint;
+                                gDraggingObject = true;
                             }
                         }
-                        else if (gLightSelected) {
+                        else if (const glm::vec3* lightPos = ctx.scene->getSelectedLightPosition()) {
                             const glm::vec3 rayOrigin = gCamera.GetPosition();
                             const glm::vec3 rayDir = screenRayDirection(xpos, ypos);
                             gDragPlaneNormal = gCamera.GetFront();
-                            gDragPlanePoint = ctx->scene->getLightSettings().position;
+                            gDragPlanePoint = *lightPos;
                             glm::vec3 hitPoint;
                             if (rayPlaneIntersection(rayOrigin, rayDir, gDragPlanePoint, gDragPlaneNormal, hitPoint)) {
-                                gDragOffset = ctx->scene->getLightSettings().position - hitPoint;
+                                gDragOffset = *lightPos - hitPoint;
                                 gDraggingObject = true;
                             }
                         }
@@ -302,82 +433,87 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int /*mod
         else if (action == GLFW_RELEASE) {
             gLeftMouseDown = false;
             gDraggingObject = false;
+            if (gMarqueeActive) {
+                finishMarquee(ctx, xpos, ypos);
+            }
+            // a finished drag is one undo step even if the next one starts right away
+            if (ctx.scene && ctx.scene->getHistory()) {
+                ctx.scene->getHistory()->seal();
+            }
         }
     }
 }
 
-void processInput(GLFWwindow* window, float deltaTime, SceneRenderer& scene, UiLayer& ui) {
-    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
-    if (ctx && ctx->ui && ctx->ui->WantCaptureKeyboard()) {
-        return;
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, true);
-    }
+// keys is a mask over kInputKeys, polled live or read back from an input log
+void processInput(unsigned int keys, float deltaTime, SceneRenderer& scene, UiLayer::TransformMode mode) {
+    TRACE_ZONE("processInput");
 
     // camera movement only when RMB is held
     if (gRightMouseDown) {
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+        if (keyDown(keys, GLFW_KEY_W)) {
             gCamera.ProcessKeyboard(Camera::MoveDir::Forward, deltaTime);
         }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+        if (keyDown(keys, GLFW_KEY_S)) {
             gCamera.ProcessKeyboard(Camera::MoveDir::Backward, deltaTime);
         }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+        if (keyDown(keys, GLFW_KEY_A)) {
             gCamera.ProcessKeyboard(Camera::MoveDir::Left, deltaTime);
         }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+        if (keyDown(keys, GLFW_KEY_D)) {
             gCamera.ProcessKeyboard(Camera::MoveDir::Right, deltaTime);
         }
     }
-
     // transforms regardless of RMB
     const int selected = scene.getSelectedIndex();
-    const bool hasSelection = selected >= 0 || gLightSelected;
+    const bool lightSelected = scene.isLightSelected();
+    const bool hasSelection = selected >= 0 || lightSelected;
     const float moveStep = 0.01f;
     const float rotStep = 1.0f;
     const float scaleStep = 0.01f;
 
     if (hasSelection) {
-        switch (ui.getMode()) {
+        switch (mode) {
         case UiLayer::TransformMode::Translate:
-            if (gLightSelected) {
-                auto& light = scene.getLightSettings();
-                if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) light.position += glm::vec3(moveStep, 0.0f, 0.0f);
-                if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) light.position += glm::vec3(-moveStep, 0.0f, 0.0f);
-                if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) light.position += glm::vec3(0.0f, moveStep, 0.0f);
-                if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) light.position += glm::vec3(0.0f, -moveStep, 0.0f);
-                if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) light.position += glm::vec3(0.0f, 0.0f, moveStep);
-                if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) light.position += glm::vec3(0.0f, 0.0f, -moveStep);
+            if (lightSelected) {
+                const glm::vec3 previous = *scene.getSelectedLightPosition();
+                glm::vec3 lightPos = previous;
+                if (keyDown(keys, GLFW_KEY_R)) lightPos += glm::vec3(moveStep, 0.0f, 0.0f);
+                if (keyDown(keys, GLFW_KEY_F)) lightPos += glm::vec3(-moveStep, 0.0f, 0.0f);
+                if (keyDown(keys, GLFW_KEY_T)) lightPos += glm::vec3(0.0f, moveStep, 0.0f);
+                if (keyDown(keys, GLFW_KEY_G)) lightPos += glm::vec3(0.0f, -moveStep, 0.0f);
+                if (keyDown(keys, GLFW_KEY_Y)) lightPos += glm::vec3(0.0f, 0.0f, moveStep);
+                if (keyDown(keys, GLFW_KEY_H)) lightPos += glm::vec3(0.0f, 0.0f, -moveStep);
+                if (lightPos != previous) {
+                    scene.setSelectedLightPosition(lightPos);
+                }
             }
             else {
-                if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) scene.translateSelected(glm::vec3(moveStep, 0.0f, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) scene.translateSelected(glm::vec3(-moveStep, 0.0f, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) scene.translateSelected(glm::vec3(0.0f, moveStep, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) scene.translateSelected(glm::vec3(0.0f, -moveStep, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) scene.translateSelected(glm::vec3(0.0f, 0.0f, moveStep));
-                if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) scene.translateSelected(glm::vec3(0.0f, 0.0f, -moveStep));
+                if (keyDown(keys, GLFW_KEY_R)) scene.translateSelected(glm::vec3(moveStep, 0.0f, 0.0f));
+                if (keyDown(keys, GLFW_KEY_F)) scene.translateSelected(glm::vec3(-moveStep, 0.0f, 0.0f));
+                if (keyDown(keys, GLFW_KEY_T)) scene.translateSelected(glm::vec3(0.0f, moveStep, 0.0f));
+                if (keyDown(keys, GLFW_KEY_G)) scene.translateSelected(glm::vec3(0.0f, -moveStep, 0.0f));
+                if (keyDown(keys, GLFW_KEY_Y)) scene.translateSelected(glm::vec3(0.0f, 0.0f, moveStep));
+                if (keyDown(keys, GLFW_KEY_H)) scene.translateSelected(glm::vec3(0.0f, 0.0f, -moveStep));
             }
             break;
         case UiLayer::TransformMode::Rotate:
-            if (!gLightSelected) {
-                if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) scene.rotateSelected(glm::vec3(rotStep, 0.0f, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) scene.rotateSelected(glm::vec3(-rotStep, 0.0f, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) scene.rotateSelected(glm::vec3(0.0f, rotStep, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) scene.rotateSelected(glm::vec3(0.0f, -rotStep, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) scene.rotateSelected(glm::vec3(0.0f, 0.0f, rotStep));
-                if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) scene.rotateSelected(glm::vec3(0.0f, 0.0f, -rotStep));
+            if (!lightSelected) {
+                if (keyDown(keys, GLFW_KEY_R)) scene.rotateSelected(glm::vec3(rotStep, 0.0f, 0.0f));
+                if (keyDown(keys, GLFW_KEY_F)) scene.rotateSelected(glm::vec3(-rotStep, 0.0f, 0.0f));
+                if (keyDown(keys, GLFW_KEY_T)) scene.rotateSelected(glm::vec3(0.0f, rotStep, 0.0f));
+                if (keyDown(keys, GLFW_KEY_G)) scene.rotateSelected(glm::vec3(0.0f, -rotStep, 0.0f));
+                if (keyDown(keys, GLFW_KEY_Y)) scene.rotateSelected(glm::vec3(0.0f, 0.0f, rotStep));
+                if (keyDown(keys, GLFW_KEY_H)) scene.rotateSelected(glm::vec3(0.0f, 0.0f, -rotStep));
             }
             break;
         case UiLayer::TransformMode::Scale:
-            if (!gLightSelected) {
-                if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) scene.scaleSelected(glm::vec3(scaleStep, 0.0f, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) scene.scaleSelected(glm::vec3(-scaleStep, 0.0f, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) scene.scaleSelected(glm::vec3(0.0f, scaleStep, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) scene.scaleSelected(glm::vec3(0.0f, -scaleStep, 0.0f));
-                if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) scene.scaleSelected(glm::vec3(0.0f, 0.0f, scaleStep));
-                if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) scene.scaleSelected(glm::vec3(0.0f, 0.0f, -scaleStep));
+            if (!lightSelected) {
+                if (keyDown(keys, GLFW_KEY_R)) scene.scaleSelected(glm::vec3(scaleStep, 0.0f, 0.0f));
+                if (keyDown(keys, GLFW_KEY_F)) scene.scaleSelected(glm::vec3(-scaleStep, 0.0f, 0.0f));
+                if (keyDown(keys, GLFW_KEY_T)) scene.scaleSelected(glm::vec3(0.0f, scaleStep, 0.0f));
+                if (keyDown(keys, GLFW_KEY_G)) scene.scaleSelected(glm::vec3(0.0f, -scaleStep, 0.0f));
+                if (keyDown(keys, GLFW_KEY_Y)) scene.scaleSelected(glm::vec3(0.0f, 0.0f, scaleStep));
+                if (keyDown(keys, GLFW_KEY_H)) scene.scaleSelected(glm::vec3(0.0f, 0.0f, -scaleStep));
             }
             break;
         case UiLayer::TransformMode::Select:
@@ -387,7 +523,250 @@ void processInput(GLFWwindow* window, float deltaTime, SceneRenderer& scene, UiL
     }
 }
 
-int main() {
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    requestRedraw(window);
+    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+    if (InputRecorder* recorder = activeRecorder(ctx)) {
+        recorder->recordResize(glfwGetTime(), width, height);
+    }
+    handleResize(width, height);
+    glViewport(0, 0, width, height);
+}
+
+void scroll_callback(GLFWwindow* window, double /*xoffset*/, double yoffset) {
+    requestRedraw(window);
+    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+    if (!ctx || (ctx->ui && ctx->ui->WantCaptureMouse())) {
+        return;
+    }
+    if (InputRecorder* recorder = activeRecorder(ctx)) {
+        recorder->recordScroll(glfwGetTime(), yoffset);
+    }
+    handleScroll(*ctx, yoffset);
+}
+
+void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
+    requestRedraw(window);
+    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+    if (!ctx || (ctx->ui && ctx->ui->WantCaptureMouse())) {
+        return;
+    }
+    if (InputRecorder* recorder = activeRecorder(ctx)) {
+        recorder->recordCursor(glfwGetTime(), xpos, ypos);
+    }
+    handleCursor(*ctx, xpos, ypos);
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    requestRedraw(window);
+    AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+    if (!ctx || (ctx->ui && ctx->ui->WantCaptureMouse())) {
+        return;
+    }
+    double xpos = 0.0;
+    double ypos = 0.0;
+    glfwGetCursorPos(window, &xpos, &ypos);
+    const double now = glfwGetTime();
+    if (InputRecorder* recorder = activeRecorder(ctx)) {
+        recorder->recordButton(now, button, action, mods, xpos, ypos);
+    }
+    handleMouseButton(*ctx, button, action, mods, xpos, ypos, now);
+}
+
+void key_callback(GLFWwindow* window, int key, int /*scancode*/, int action, int mods) {
+    if ((key == GLFW_KEY_Z || key == GLFW_KEY_Y) && (mods & GLFW_MOD_CONTROL) && action != GLFW_RELEASE) {
+        AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+        UndoHistory* history = ctx && ctx->scene ? ctx->scene->getHistory() : nullptr;
+        // the input log has no undo events, so a replay would diverge; the shortcuts are off while recording
+        const bool recording = ctx && ctx->recorder && ctx->recorder->isRecording();
+        if (history && !recording && !(ctx->ui && ctx->ui->WantCaptureKeyboard())) {
+            // Ctrl+Z undoes, Ctrl+Y or Ctrl+Shift+Z redoes; holding the keys repeats
+            if (key == GLFW_KEY_Z && !(mods & GLFW_MOD_SHIFT)) {
+                history->undo(*ctx->scene);
+            }
+            else {
+                history->redo(*ctx->scene);
+            }
+        }
+    }
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+        dumpTrace();
+    }
+    if (key == GLFW_KEY_F10 && action == GLFW_PRESS) {
+        AppContext* ctx = reinterpret_cast<AppContext*>(glfwGetWindowUserPointer(window));
+        if (ctx && ctx->recorder && ctx->recorder->isRecording()) {
+            ctx->recorder->stop();
+        }
+        else if (ctx) {
+            startInputRecording(*ctx, "input_" + std::to_string(std::time(nullptr)) + ".cglog");
+        }
+    }
+    requestRedraw(window);
+}
+
+void window_refresh_callback(GLFWwindow* window) {
+    requestRedraw(window);
+}
+
+// --replay: drives the handlers above from an input log on the headless renderer, one fixed step per
+// recorded frame. Prints timings and a scene hash; replays of the same log must print the same hash.
+int runReplay(const std::string& path, float fixedDt, const std::string& csvPath) {
+    InputLog log;
+    if (!log.load(path)) {
+        return 1;
+    }
+    const InputLogScene& start = log.getScene();
+    HeadlessRenderer renderer;
+    if (!renderer.init(start.width, start.height)) {
+        return 1;
+    }
+    SceneRenderer& scene = renderer.getScene();
+    restoreScene(scene, start);
+    gCamera.SetPose(start.cameraPosition, start.cameraYaw, start.cameraPitch, start.cameraSpeed);
+    handleResize(start.width, start.height);
+    gLastLeftClickTime = -static_cast<double>(start.lastClickAge);
+
+    // never initialised, so it captures nothing and only carries the transform mode
+    UiLayer ui;
+    ui.setMode(static_cast<UiLayer::TransformMode>(start.mode));
+    AppContext ctx;
+    ctx.ui = &ui;
+    ctx.scene = &scene;
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<double> inputTimes;
+    std::vector<HeadlessRenderer::FrameTiming> frameTimings;
+    double inputMs = 0.0;
+    for (const InputEvent& event : log.getEvents()) {
+        const auto begin = Clock::now();
+        switch (event.type) {
+        case InputEventType::Mode:
+            ui.setMode(static_cast<UiLayer::TransformMode>(event.mode));
+            break;
+        case InputEventType::Cursor:
+            handleCursor(ctx, event.x, event.y);
+            break;
+        case InputEventType::Button:
+            handleMouseButton(ctx, event.button, event.action, event.mods, event.x, event.y, event.time);
+            break;
+        case InputEventType::Scroll:
+            handleScroll(ctx, event.y);
+            break;
+        case InputEventType::Resize:
+            handleResize(event.width, event.height);
+            break;
+        case InputEventType::Frame:
+            processInput(event.keyMask, fixedDt > 0.0f ? fixedDt : event.deltaTime, scene, ui.getMode());
+            break;
+        }
+        inputMs += std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+        if (event.type != InputEventType::Frame) {
+            continue;
+        }
+
+        const float aspect = static_cast<float>(gScreenWidth) / static_cast<float>(gScreenHeight);
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+        frameTimings.push_back(renderer.renderFrame(gCamera.GetViewMatrix(), projection, gCamera.GetPosition()));
+        inputTimes.push_back(inputMs);
+        inputMs = 0.0;
+    }
+
+    if (frameTimings.empty()) {
+        std::cerr << "Input log " << path << " has no frames" << std::endl;
+        return 1;
+    }
+    std::vector<double> frameMs;
+    double inputSum = 0.0;
+    double frameSum = 0.0;
+    double gpuSum = 0.0;
+    for (size_t i = 0; i < frameTimings.size(); ++i) {
+        frameMs.push_back(frameTimings[i].frameMs);
+        inputSum += inputTimes[i];
+        frameSum += frameTimings[i].frameMs;
+        gpuSum += frameTimings[i].gpuMs;
+    }
+    std::sort(frameMs.begin(), frameMs.end());
+    const double frames = static_cast<double>(frameMs.size());
+    const size_t p95 = std::min(frameMs.size() - 1, static_cast<size_t>(std::ceil(0.95 * frames)) - 1);
+    std::printf("replay %s: %zu frames, %zu events, step %s\n", path.c_str(), frameTimings.size(),
+        log.getEvents().size(), fixedDt > 0.0f ? std::to_string(fixedDt).c_str() : "recorded");
+    std::printf("input  mean %.3f ms  max %.3f ms\n", inputSum / frames,
+        *std::max_element(inputTimes.begin(), inputTimes.end()));
+    std::printf("frame  mean %.3f ms  p95 %.3f ms  max %.3f ms  gpu %.3f ms\n", frameSum / frames, frameMs[p95],
+        frameMs.back(), gpuSum / frames);
+    std::printf("scene hash %016llx\n", static_cast<unsigned long long>(sceneStateHash(scene)));
+
+    if (!csvPath.empty()) {
+        std::ofstream csv(csvPath, std::ios::trunc);
+        csv << "frame,input_ms,submit_ms,gpu_ms,frame_ms\n";
+        for (size_t i = 0; i < frameTimings.size(); ++i) {
+            csv << i << ',' << inputTimes[i] << ',' << frameTimings[i].submitMs << ',' << frameTimings[i].gpuMs << ','
+                << frameTimings[i].frameMs << '\n';
+        }
+        if (!csv) {
+            std::cerr << "Failed to write " << csvPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // --trace records CPU zones from startup and writes trace.json on exit
+    bool traceOnExit = false;
+    // --record LOG writes the input stream from startup; --replay LOG [--replay-dt S] [--replay-out CSV] plays one back
+    std::string recordPath;
+    // --autosave DIR picks the journal directory, --no-autosave turns crash recovery off
+    std::string autosaveDir = "autosave";
+    std::string replayPath;
+    std::string replayCsv;
+    float replayDt = 1.0f / 60.0f; // 0 replays the recorded frame deltas
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--trace") == 0) {
+            traceOnExit = true;
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+            recordPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) {
+            replayPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay-dt") == 0 && hasValue) {
+            replayDt = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--replay-out") == 0 && hasValue) {
+            replayCsv = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--autosave") == 0 && hasValue) {
+            autosaveDir = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--no-autosave") == 0) {
+            autosaveDir.clear();
+        }
+    }
+    trace::setThreadName("Main");
+    trace::setEnabled(traceOnExit);
+
+    if (!replayPath.empty()) {
+        const int result = runReplay(replayPath, replayDt, replayCsv);
+        if (traceOnExit) {
+            trace::dumpChromeTrace("trace.json", kTraceSeconds);
+        }
+        return result;
+    }
+
+    // --headless renders offscreen through EGL without GLFW or a display
+    HeadlessOptions headlessOptions;
+    if (parseHeadlessOptions(argc, argv, headlessOptions)) {
+        const int result = runHeadless(headlessOptions);
+        if (traceOnExit) {
+            trace::dumpChromeTrace("trace.json", kTraceSeconds);
+        }
+        return result;
+    }
+
     if (!glfwInit()) {
         return -1;
     }
@@ -407,6 +786,8 @@ int main() {
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetCursorPosCallback(window, cursor_position_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
     if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress))) {
         glfwTerminate();
@@ -428,28 +809,88 @@ int main() {
     SceneRenderer scene;
     scene.init();
 
+    // restores the last session (snapshot plus journal) before anything else sees the scene
+    SceneJournal journal;
+    if (!autosaveDir.empty()) {
+        journal.open(autosaveDir, scene);
+    }
+    // attached after recovery so replayed records are not undoable
+    UndoHistory history;
+    scene.setHistory(&history);
+
     UiLayer ui;
     ui.init(window);
 
+    RedrawScheduler redraw;
+    redraw.init(window);
+    ui.setRedrawScheduler(&redraw);
+
+    GpuProfiler profiler;
+    profiler.init();
+    scene.setProfiler(&profiler);
+    ui.setGpuProfiler(&profiler);
+
+    DynamicResolution resolution;
+    resolution.init();
+    ui.setDynamicResolution(&resolution);
+
+    FramePacer pacer;
+    pacer.init();
+    ui.setFramePacer(&pacer);
+
+    InputRecorder recorder;
+
     AppContext ctx;
     ctx.hud = &hud;
     ctx.ui = &ui;
     ctx.scene = &scene;
+    ctx.redraw = &redraw;
+    ctx.recorder = &recorder;
+    ctx.window = window;
     glfwSetWindowUserPointer(window, &ctx);
+    if (!recordPath.empty()) {
+        startInputRecording(ctx, recordPath);
+    }
 
-    float lastFrame = 0.0f;
+    glm::mat4 lastView(0.0f);
+    unsigned int lastRevision = scene.getRevision();
 
     while (!glfwWindowShouldClose(window)) {
-        const float currentFrame = static_cast<float>(glfwGetTime());
-        const float deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        if (!redraw.waitForFrame()) {
+            continue; // nothing changed, stay asleep
+        }
+
+        TRACE_ZONE("Frame");
+        float deltaTime = 0.0f;
+        {
+            // the FPS cap waits here, after events were pumped, so input is as fresh as possible
+            TRACE_ZONE("FramePacer::beginFrame");
+            deltaTime = pacer.beginFrame();
+        }
+        if (redraw.isOnDemand()) {
+            deltaTime = std::min(deltaTime, 0.1f); // the first frame after a long idle must not jump
+        }
 
         hud.updateTimers(deltaTime);
         ui.setCameraSpeed(gCamera.GetSpeed());
         ui.beginFrame();
 
-        processInput(window, deltaTime, scene, ui);
+        unsigned int keys = 0;
+        if (!ui.WantCaptureKeyboard()) {
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                glfwSetWindowShouldClose(window, true);
+            }
+            keys = pollKeyMask(window);
+        }
+        if (InputRecorder* active = activeRecorder(&ctx)) {
+            active->recordFrame(glfwGetTime(), deltaTime, keys);
+        }
+        processInput(keys, deltaTime, scene, ui.getMode());
 
+        profiler.beginFrame();
+        profiler.begin("Viewport");
+        // the 3D viewport renders at the dynamic scale; HUD and ImGui stay at native resolution
+        resolution.beginScene(gScreenWidth, gScreenHeight);
         glClearColor(0.08f, 0.09f, 0.12f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -457,18 +898,52 @@ int main() {
         const glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
         const glm::mat4 view = gCamera.GetViewMatrix();
 
+        profiler.begin("Grid");
         grid.draw(view, projection);
+        profiler.end();
+        profiler.begin("Axes");
         axes.draw(view, projection);
+        profiler.end();
+        profiler.begin("Scene");
         scene.draw(view, projection, gCamera.GetPosition());
-
+        profiler.end();
+        profiler.begin("Upscale");
+        resolution.endScene();
+        profiler.end();
+        profiler.end();
+
+        hud.setRenderScale(resolution.getScale(), resolution.getSettings().enabled);
+        profiler.begin("HUD");
         hud.draw(gScreenWidth, gScreenHeight);
+        profiler.end();
         ui.draw(scene, gCamera);
+        journal.update();
+        profiler.begin("ImGui");
         ui.render();
+        profiler.end();
+        profiler.endFrame();
+
+        {
+            TRACE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        redraw.frameRendered();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // keep drawing while anything is still in motion or changed during this frame
+        if (interactionActive(window) || hud.isAnimating() || ui.isAnimating() || view != lastView ||
+            scene.getRevision() != lastRevision) {
+            redraw.requestRedraw(1);
+        }
+        lastView = view;
+        lastRevision = scene.getRevision();
     }
 
+    if (traceOnExit) {
+        trace::dumpChromeTrace("trace.json", kTraceSeconds);
+    }
+    recorder.stop();
+    scene.setHistory(nullptr);
+    journal.close();
     ui.shutdown();
     glfwTerminate();
     return 0;
@@ -0,0 +1,124 @@
+#include "material_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    void hashFloat(size_t& seed, float value) {
+        if (value == 0.0f) {
+            value = 0.0f; // -0 and +0 compare equal, so they must hash equal
+        }
+        unsigned int bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        seed ^= bits + 0x9e3779b9u + (seed << 6) + (seed >> 2);
+    }
+
+    const Material kMissingMaterial{};
+}
+
+bool operator==(const Material& a, const Material& b) {
+    return a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular &&
+        a.shininess == b.shininess && a.ambientStrength == b.ambientStrength &&
+        a.diffuseStrength == b.diffuseStrength && a.specularStrength == b.specularStrength;
+}
+
+size_t MaterialHash::operator()(const Material& material) const {
+    size_t seed = 0;
+    for (int i = 0; i < 3; ++i) {
+        hashFloat(seed, material.ambient[i]);
+        hashFloat(seed, material.diffuse[i]);
+        hashFloat(seed, material.specular[i]);
+    }
+    hashFloat(seed, material.shininess);
+    hashFloat(seed, material.ambientStrength);
+    hashFloat(seed, material.diffuseStrength);
+    hashFloat(seed, material.specularStrength);
+    return seed;
+}
+
+int MaterialTable::intern(const Material& material) {
+    const auto found = lookup.find(material);
+    if (found != lookup.end()) {
+        ++entries[static_cast<size_t>(found->second)].refs;
+        return found->second;
+    }
+
+    int id = 0;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    }
+    else {
+        id = static_cast<int>(entries.size());
+        entries.emplace_back();
+    }
+    Entry& entry = entries[static_cast<size_t>(id)];
+    entry.material = material;
+    entry.refs = 1;
+    entry.interned = true;
+    lookup.emplace(material, id);
+    writeTexels(id);
+    return id;
+}
+
+void MaterialTable::addRef(int id) {
+    if (valid(id)) {
+        ++entries[static_cast<size_t>(id)].refs;
+    }
+}
+
+void MaterialTable::release(int id) {
+    if (!valid(id)) {
+        return;
+    }
+    Entry& entry = entries[static_cast<size_t>(id)];
+    if (--entry.refs > 0) {
+        return;
+    }
+    if (entry.interned) {
+        lookup.erase(entry.material);
+        entry.interned = false;
+    }
+    freeIds.push_back(id);
+}
+
+void MaterialTable::update(int id, const Material& material) {
+    if (!valid(id)) {
+        return;
+    }
+    Entry& entry = entries[static_cast<size_t>(id)];
+    if (entry.interned) {
+        lookup.erase(entry.material);
+    }
+    entry.material = material;
+    // if another entry already holds these values both stay; only one can be the lookup target
+    entry.interned = lookup.emplace(material, id).second;
+    writeTexels(id);
+}
+
+const Material& MaterialTable::get(int id) const {
+    return valid(id) ? entries[static_cast<size_t>(id)].material : kMissingMaterial;
+}
+
+bool MaterialTable::takeDirtyRange(int& begin, int& end) {
+    if (dirtyBegin >= dirtyEnd) {
+        return false;
+    }
+    begin = dirtyBegin;
+    end = dirtyEnd;
+    dirtyBegin = INT_MAX;
+    dirtyEnd = 0;
+    return true;
+}
+
+void MaterialTable::writeTexels(int id) {
+    texelData.resize(entries.size() * kTexelsPerMaterial);
+    const Material& m = entries[static_cast<size_t>(id)].material;
+    glm::vec4* texel = &texelData[static_cast<size_t>(id) * kTexelsPerMaterial];
+    texel[0] = glm::vec4(m.ambient, m.ambientStrength);
+    texel[1] = glm::vec4(m.diffuse, m.diffuseStrength);
+    texel[2] = glm::vec4(m.specular, m.specularStrength);
+    texel[3] = glm::vec4(m.shininess, 0.0f, 0.0f, 0.0f);
+    dirtyBegin = std::min(dirtyBegin, id);
+    dirtyEnd = std::max(dirtyEnd, id + 1);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <climits>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+struct Material {
+    glm::vec3 ambient = glm::vec3(0.2f);
+    glm::vec3 diffuse = glm::vec3(0.8f);
+    glm::vec3 specular = glm::vec3(0.5f);
+    float shininess = 32.0f;
+    float ambientStrength = 1.0f;
+    float diffuseStrength = 1.0f;
+    float specularStrength = 1.0f;
+};
+
+bool operator==(const Material& a, const Material& b);
+
+struct MaterialHash {
+    size_t operator()(const Material& material) const;
+};
+
+// Reference-counted, deduplicated material records. Identical values intern to one id, and the
+// whole table is mirrored into kTexelsPerMaterial RGBA32F texels per entry for the shader.
+class MaterialTable {
+public:
+    static constexpr int kTexelsPerMaterial = 4;
+
+    // id of an entry with exactly these values (adding a reference), or a new entry
+    int intern(const Material& material);
+    void addRef(int id);
+    void release(int id);
+    // rewrites an entry in place, so every instance using it changes at once
+    void update(int id, const Material& material);
+
+    bool valid(int id) const { return id >= 0 && id < static_cast<int>(entries.size()) && entries[static_cast<size_t>(id)].refs > 0; }
+    const Material& get(int id) const;
+    int users(int id) const { return valid(id) ? entries[static_cast<size_t>(id)].refs : 0; }
+    int liveCount() const { return static_cast<int>(entries.size() - freeIds.size()); }
+    int capacity() const { return static_cast<int>(entries.size()); }
+
+    const std::vector<glm::vec4>& texels() const { return texelData; }
+    // entries written since the last call, as [begin, end) ids; false when nothing changed
+    bool takeDirtyRange(int& begin, int& end);
+
+private:
+    struct Entry {
+        Material material;
+        int refs = 0;
+        bool interned = false; // reachable through lookup
+    };
+
+    void writeTexels(int id);
+
+    std::vector<Entry> entries;
+    std::vector<int> freeIds;
+    std::unordered_map<Material, int, MaterialHash> lookup;
+    std::vector<glm::vec4> texelData;
+    int dirtyBegin = INT_MAX;
+    int dirtyEnd = 0;
+};
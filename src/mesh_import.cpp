@@ -0,0 +1,977 @@
+#include "mesh_import.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+
+namespace {
+    thread_local const char* gFailureReason = "";
+
+    bool fail(const char* reason) {
+        gFailureReason = reason;
+        return false;
+    }
+
+    void pushVertex(MeshData& mesh, const glm::vec3& pos, const glm::vec3& normal) {
+        mesh.vertices.push_back(pos.x); mesh.vertices.push_back(pos.y); mesh.vertices.push_back(pos.z);
+        mesh.vertices.push_back(normal.x); mesh.vertices.push_back(normal.y); mesh.vertices.push_back(normal.z);
+    }
+
+    // false for zero-length or non-finite normals (exporters write "vn 0 0 0"), which normalize would turn
+    // into NaN; callers treat the vertex as having no normal and generate one
+    bool normalizeNormal(const glm::vec3& normal, glm::vec3& out) {
+        const float length = glm::length(normal);
+        if (!(length > 1.0e-12f) || !std::isfinite(length)) {
+            out = glm::vec3(0.0f);
+            return false;
+        }
+        out = normal / length;
+        return true;
+    }
+
+    void computeBounds(MeshData& mesh) {
+        if (mesh.vertices.empty()) {
+            mesh.boundsMin = mesh.boundsMax = glm::vec3(0.0f);
+            return;
+        }
+        glm::vec3 lo(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]);
+        glm::vec3 hi = lo;
+        for (size_t i = 0; i + 5 < mesh.vertices.size(); i += 6) {
+            const glm::vec3 p(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        mesh.boundsMin = lo;
+        mesh.boundsMax = hi;
+    }
+
+    // Area-weighted smooth normals for vertices flagged in `missing`; vertices sharing a group id
+    // (the OBJ position index, or the vertex itself for glTF) are averaged together.
+    void fillMissingNormals(MeshData& mesh, const std::vector<unsigned int>& group, size_t groupCount,
+        const std::vector<unsigned char>& missing) {
+        std::vector<glm::vec3> accum(groupCount, glm::vec3(0.0f));
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            const unsigned int i0 = mesh.indices[t];
+            const unsigned int i1 = mesh.indices[t + 1];
+            const unsigned int i2 = mesh.indices[t + 2];
+            const glm::vec3 p0(mesh.vertices[i0 * 6], mesh.vertices[i0 * 6 + 1], mesh.vertices[i0 * 6 + 2]);
+            const glm::vec3 p1(mesh.vertices[i1 * 6], mesh.vertices[i1 * 6 + 1], mesh.vertices[i1 * 6 + 2]);
+            const glm::vec3 p2(mesh.vertices[i2 * 6], mesh.vertices[i2 * 6 + 1], mesh.vertices[i2 * 6 + 2]);
+            const glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            accum[group[i0]] += faceNormal;
+            accum[group[i1]] += faceNormal;
+            accum[group[i2]] += faceNormal;
+        }
+        for (size_t v = 0; v < missing.size(); ++v) {
+            if (!missing[v]) {
+                continue;
+            }
+            const glm::vec3 n = accum[group[v]];
+            const float len = glm::length(n);
+            const glm::vec3 normal = len > 1e-12f ? n / len : glm::vec3(0.0f, 1.0f, 0.0f);
+            mesh.vertices[v * 6 + 3] = normal.x;
+            mesh.vertices[v * 6 + 4] = normal.y;
+            mesh.vertices[v * 6 + 5] = normal.z;
+        }
+    }
+
+    // ---- OBJ ----
+
+    const char* skipBlank(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* skipLine(const char* p, const char* end) {
+        while (p < end && *p != '\n') {
+            ++p;
+        }
+        return p < end ? p + 1 : end;
+    }
+
+    bool parseFloats(const char*& p, const char* end, float* out, int count) {
+        for (int i = 0; i < count; ++i) {
+            p = skipBlank(p, end);
+            if (p < end && *p == '+') {
+                ++p;
+            }
+            const auto res = std::from_chars(p, end, out[i]);
+            if (res.ec != std::errc()) {
+                return false;
+            }
+            p = res.ptr;
+        }
+        return true;
+    }
+
+    // resolves 1-based / negative OBJ references into 0-based indices, -1 when absent or invalid
+    int resolveObjIndex(long value, size_t count) {
+        if (value > 0 && static_cast<size_t>(value) <= count) {
+            return static_cast<int>(value - 1);
+        }
+        if (value < 0 && static_cast<size_t>(-value) <= count) {
+            return static_cast<int>(static_cast<long>(count) + value);
+        }
+        return -1;
+    }
+
+    // ---- glTF JSON (the JSON chunk of a .glb is small, so a tiny DOM is fine here) ----
+
+    struct JsonValue {
+        enum class Type { Null, Bool, Number, String, Array, Object };
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue* find(const char* key) const {
+            if (type != Type::Object) {
+                return nullptr;
+            }
+            for (const auto& [name, value] : members) {
+                if (name == key) {
+                    return &value;
+                }
+            }
+            return nullptr;
+        }
+
+        const JsonValue* at(size_t index) const {
+            return type == Type::Array && index < items.size() ? &items[index] : nullptr;
+        }
+
+        double numberOr(const char* key, double fallback) const {
+            const JsonValue* v = find(key);
+            return v && v->type == Type::Number ? v->number : fallback;
+        }
+
+        int intOr(const char* key, int fallback) const {
+            return static_cast<int>(numberOr(key, static_cast<double>(fallback)));
+        }
+    };
+
+    class JsonParser {
+    public:
+        JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+        bool parse(JsonValue& out) {
+            return parseValue(out, 0);
+        }
+
+    private:
+        void skipWs() {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+                ++p;
+            }
+        }
+
+        bool parseValue(JsonValue& out, int depth) {
+            if (depth > 64) {
+                return false;
+            }
+            skipWs();
+            if (p >= end) {
+                return false;
+            }
+            switch (*p) {
+            case '{': return parseObject(out, depth);
+            case '[': return parseArray(out, depth);
+            case '"':
+                out.type = JsonValue::Type::String;
+                return parseString(out.string);
+            case 't': return parseLiteral("true", out, JsonValue::Type::Bool, true);
+            case 'f': return parseLiteral("false", out, JsonValue::Type::Bool, false);
+            case 'n': return parseLiteral("null", out, JsonValue::Type::Null, false);
+            default: return parseNumber(out);
+            }
+        }
+
+        bool parseLiteral(const char* word, JsonValue& out, JsonValue::Type type, bool value) {
+            const size_t len = std::strlen(word);
+            if (static_cast<size_t>(end - p) < len || std::strncmp(p, word, len) != 0) {
+                return false;
+            }
+            p += len;
+            out.type = type;
+            out.boolean = value;
+            return true;
+        }
+
+        bool parseNumber(JsonValue& out) {
+            const auto res = std::from_chars(p, end, out.number);
+            if (res.ec != std::errc()) {
+                return false;
+            }
+            p = res.ptr;
+            out.type = JsonValue::Type::Number;
+            return true;
+        }
+
+        bool parseString(std::string& out) {
+            ++p; // opening quote
+            while (p < end && *p != '"') {
+                if (*p == '\\') {
+                    if (++p >= end) {
+                        return false;
+                    }
+                    switch (*p) {
+                    case 'n': out.push_back('\n'); break;
+                    case 't': out.push_back('\t'); break;
+                    case 'r': out.push_back('\r'); break;
+                    case 'b': out.push_back('\b'); break;
+                    case 'f': out.push_back('\f'); break;
+                    case 'u': {
+                        unsigned int code = 0;
+                        if (end - p < 5 || std::from_chars(p + 1, p + 5, code, 16).ptr != p + 5) {
+                            return false;
+                        }
+                        p += 4;
+                        if (code < 0x80) {
+                            out.push_back(static_cast<char>(code));
+                        }
+                        else if (code < 0x800) {
+                            out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                        }
+                        else {
+                            out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                        }
+                        break;
+                    }
+                    default: out.push_back(*p); break;
+                    }
+                    ++p;
+                }
+                else {
+                    out.push_back(*p++);
+                }
+            }
+            if (p >= end) {
+                return false;
+            }
+            ++p; // closing quote
+            return true;
+        }
+
+        bool parseArray(JsonValue& out, int depth) {
+            out.type = JsonValue::Type::Array;
+            ++p;
+            skipWs();
+            if (p < end && *p == ']') {
+                ++p;
+                return true;
+            }
+            while (p < end) {
+                out.items.emplace_back();
+                if (!parseValue(out.items.back(), depth + 1)) {
+                    return false;
+                }
+                skipWs();
+                if (p < end && *p == ',') {
+                    ++p;
+                    continue;
+                }
+                if (p < end && *p == ']') {
+                    ++p;
+                    return true;
+                }
+                return false;
+            }
+            return false;
+        }
+
+        bool parseObject(JsonValue& out, int depth) {
+            out.type = JsonValue::Type::Object;
+            ++p;
+            skipWs();
+            if (p < end && *p == '}') {
+                ++p;
+                return true;
+            }
+            while (p < end) {
+                skipWs();
+                if (p >= end || *p != '"') {
+                    return false;
+                }
+                out.members.emplace_back();
+                if (!parseString(out.members.back().first)) {
+                    return false;
+                }
+                skipWs();
+                if (p >= end || *p != ':') {
+                    return false;
+                }
+                ++p;
+                if (!parseValue(out.members.back().second, depth + 1)) {
+                    return false;
+                }
+                skipWs();
+                if (p < end && *p == ',') {
+                    ++p;
+                    continue;
+                }
+                if (p < end && *p == '}') {
+                    ++p;
+                    return true;
+                }
+                return false;
+            }
+            return false;
+        }
+
+        const char* p;
+        const char* end;
+    };
+
+    // ---- GLB ----
+
+    constexpr uint32_t kGlbMagic = 0x46546C67;      // "glTF"
+    constexpr uint32_t kGlbChunkJson = 0x4E4F534A;  // "JSON"
+    constexpr uint32_t kGlbChunkBin = 0x004E4942;   // "BIN\0"
+
+    constexpr int kComponentUByte = 5121;
+    constexpr int kComponentUShort = 5123;
+    constexpr int kComponentUInt = 5125;
+    constexpr int kComponentFloat = 5126;
+
+    uint32_t readU32(const unsigned char* p) {
+        uint32_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    struct GlbContext {
+        const JsonValue* root = nullptr;
+        const unsigned char* bin = nullptr;
+        size_t binSize = 0;
+    };
+
+    struct AccessorView {
+        const unsigned char* data = nullptr;
+        size_t stride = 0;
+        size_t count = 0;
+        int componentType = 0;
+        int components = 0;
+    };
+
+    int componentSize(int componentType) {
+        switch (componentType) {
+        case 5120: case 5121: return 1;
+        case 5122: case 5123: return 2;
+        case 5125: case 5126: return 4;
+        default: return 0;
+        }
+    }
+
+    int componentsForType(const std::string& type) {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        return 0;
+    }
+
+    // a byte count or offset from the JSON: integral, non-negative and at most limit, checked before the
+    // cast since converting a negative or huge double to size_t is undefined
+    bool sizeField(const JsonValue& object, const char* key, size_t limit, size_t& out) {
+        const double value = object.numberOr(key, 0.0);
+        if (!(value >= 0.0) || value > static_cast<double>(limit) || value != std::floor(value)) {
+            return false;
+        }
+        out = static_cast<size_t>(value);
+        return out <= limit;
+    }
+
+    bool resolveAccessor(const GlbContext& ctx, int index, AccessorView& view) {
+        const JsonValue* accessors = ctx.root->find("accessors");
+        const JsonValue* accessor = accessors ? accessors->at(static_cast<size_t>(index)) : nullptr;
+        if (!accessor) {
+            return fail("accessor index out of range");
+        }
+        if (accessor->find("sparse")) {
+            return fail("sparse accessors are not supported");
+        }
+        const JsonValue* typeValue = accessor->find("type");
+        view.components = typeValue ? componentsForType(typeValue->string) : 0;
+        view.componentType = accessor->intOr("componentType", 0);
+        const size_t elemSize = static_cast<size_t>(componentSize(view.componentType) * view.components);
+        if (elemSize == 0) {
+            return fail("unsupported accessor format");
+        }
+        if (!sizeField(*accessor, "count", ctx.binSize, view.count)) {
+            return fail("invalid accessor count");
+        }
+
+        const JsonValue* views = ctx.root->find("bufferViews");
+        const JsonValue* bufferView = views ? views->at(static_cast<size_t>(accessor->intOr("bufferView", -1))) : nullptr;
+        if (!bufferView) {
+            return fail("accessor without buffer view");
+        }
+        if (bufferView->intOr("buffer", 0) != 0) {
+            return fail("only the embedded GLB buffer is supported");
+        }
+        size_t viewOffset = 0;
+        size_t viewLength = 0;
+        size_t accessorOffset = 0;
+        if (!sizeField(*bufferView, "byteOffset", ctx.binSize, viewOffset) ||
+            !sizeField(*bufferView, "byteLength", ctx.binSize, viewLength) ||
+            !sizeField(*accessor, "byteOffset", ctx.binSize, accessorOffset) ||
+            !sizeField(*bufferView, "byteStride", ctx.binSize, view.stride)) {
+            return fail("invalid buffer view range");
+        }
+        if (view.stride == 0) {
+            view.stride = elemSize;
+        }
+        if (view.stride < elemSize) {
+            return fail("buffer view stride smaller than its elements");
+        }
+        // each term is bounded by binSize, so none of these can wrap
+        if (viewLength > ctx.binSize - viewOffset) {
+            return fail("accessor exceeds binary chunk");
+        }
+        if (view.count > 0 && (accessorOffset > viewLength || elemSize > viewLength - accessorOffset ||
+            view.count - 1 > (viewLength - accessorOffset - elemSize) / view.stride)) {
+            return fail("accessor exceeds binary chunk");
+        }
+        view.data = ctx.bin + viewOffset + accessorOffset;
+        return true;
+    }
+
+    glm::vec3 readVec3(const AccessorView& view, size_t i) {
+        float v[3];
+        std::memcpy(v, view.data + i * view.stride, sizeof(v));
+        return glm::vec3(v[0], v[1], v[2]);
+    }
+
+    unsigned int readIndex(const AccessorView& view, size_t i) {
+        const unsigned char* p = view.data + i * view.stride;
+        switch (view.componentType) {
+        case kComponentUByte: return *p;
+        case kComponentUShort: { uint16_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+        default: return readU32(p);
+        }
+    }
+
+    glm::mat4 nodeTransform(const JsonValue& node) {
+        const JsonValue* matrix = node.find("matrix");
+        if (matrix && matrix->items.size() == 16) {
+            glm::mat4 m(1.0f);
+            for (int c = 0; c < 4; ++c) {
+                for (int r = 0; r < 4; ++r) {
+                    m[c][r] = static_cast<float>(matrix->items[static_cast<size_t>(c * 4 + r)].number);
+                }
+            }
+            return m;
+        }
+
+        glm::mat4 m(1.0f);
+        const JsonValue* t = node.find("translation");
+        if (t && t->items.size() == 3) {
+            m = glm::translate(m, glm::vec3(static_cast<float>(t->items[0].number), static_cast<float>(t->items[1].number),
+                static_cast<float>(t->items[2].number)));
+        }
+        const JsonValue* r = node.find("rotation");
+        if (r && r->items.size() == 4) {
+            const float x = static_cast<float>(r->items[0].number);
+            const float y = static_cast<float>(r->items[1].number);
+            const float z = static_cast<float>(r->items[2].number);
+            const float w = static_cast<float>(r->items[3].number);
+            glm::mat4 rot(1.0f);
+            rot[0][0] = 1.0f - 2.0f * (y * y + z * z);
+            rot[0][1] = 2.0f * (x * y + z * w);
+            rot[0][2] = 2.0f * (x * z - y * w);
+            rot[1][0] = 2.0f * (x * y - z * w);
+            rot[1][1] = 1.0f - 2.0f * (x * x + z * z);
+            rot[1][2] = 2.0f * (y * z + x * w);
+            rot[2][0] = 2.0f * (x * z + y * w);
+            rot[2][1] = 2.0f * (y * z - x * w);
+            rot[2][2] = 1.0f - 2.0f * (x * x + y * y);
+            m = m * rot;
+        }
+        const JsonValue* s = node.find("scale");
+        if (s && s->items.size() == 3) {
+            m = glm::scale(m, glm::vec3(static_cast<float>(s->items[0].number), static_cast<float>(s->items[1].number),
+                static_cast<float>(s->items[2].number)));
+        }
+        return m;
+    }
+
+    bool appendGlbMesh(const GlbContext& ctx, int meshIndex, const glm::mat4& transform, MeshData& out,
+        std::vector<unsigned char>& missingNormals) {
+        const JsonValue* meshes = ctx.root->find("meshes");
+        const JsonValue* mesh = meshes ? meshes->at(static_cast<size_t>(meshIndex)) : nullptr;
+        const JsonValue* primitives = mesh ? mesh->find("primitives") : nullptr;
+        if (!primitives) {
+            return fail("mesh index out of range");
+        }
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+        for (const JsonValue& prim : primitives->items) {
+            if (prim.intOr("mode", 4) != 4) {
+                continue; // only triangle lists are imported
+            }
+            const JsonValue* attributes = prim.find("attributes");
+            const JsonValue* posRef = attributes ? attributes->find("POSITION") : nullptr;
+            if (!posRef) {
+                continue;
+            }
+            AccessorView positions;
+            if (!resolveAccessor(ctx, static_cast<int>(posRef->number), positions)) {
+                return false;
+            }
+            if (positions.componentType != kComponentFloat || positions.components != 3) {
+                return fail("POSITION must be float VEC3");
+            }
+            AccessorView normals;
+            const JsonValue* normalRef = attributes->find("NORMAL");
+            const bool hasNormals = normalRef && resolveAccessor(ctx, static_cast<int>(normalRef->number), normals) &&
+                normals.componentType == kComponentFloat && normals.components == 3 && normals.count == positions.count;
+
+            const size_t base = out.vertices.size() / 6;
+            for (size_t i = 0; i < positions.count; ++i) {
+                const glm::vec3 p = glm::vec3(transform * glm::vec4(readVec3(positions, i), 1.0f));
+                glm::vec3 n(0.0f);
+                const bool valid = hasNormals && normalizeNormal(normalMatrix * readVec3(normals, i), n);
+                pushVertex(out, p, n);
+                missingNormals.push_back(valid ? 0 : 1);
+            }
+
+            const JsonValue* indicesRef = prim.find("indices");
+            if (indicesRef) {
+                AccessorView indices;
+                if (!resolveAccessor(ctx, static_cast<int>(indicesRef->number), indices)) {
+                    return false;
+                }
+                if (indices.components != 1 || (indices.componentType != kComponentUByte &&
+                    indices.componentType != kComponentUShort && indices.componentType != kComponentUInt)) {
+                    return fail("unsupported index format");
+                }
+                for (size_t i = 0; i + 2 < indices.count; i += 3) {
+                    const unsigned int a = readIndex(indices, i);
+                    const unsigned int b = readIndex(indices, i + 1);
+                    const unsigned int c = readIndex(indices, i + 2);
+                    if (a >= positions.count || b >= positions.count || c >= positions.count) {
+                        return fail("index out of range");
+                    }
+                    out.indices.push_back(static_cast<unsigned int>(base + a));
+                    out.indices.push_back(static_cast<unsigned int>(base + b));
+                    out.indices.push_back(static_cast<unsigned int>(base + c));
+                }
+            }
+            else {
+                for (size_t i = 0; i + 2 < positions.count; i += 3) {
+                    out.indices.push_back(static_cast<unsigned int>(base + i));
+                    out.indices.push_back(static_cast<unsigned int>(base + i + 1));
+                    out.indices.push_back(static_cast<unsigned int>(base + i + 2));
+                }
+            }
+        }
+        return true;
+    }
+
+    bool appendGlbNode(const GlbContext& ctx, int nodeIndex, const glm::mat4& parent, MeshData& out,
+        std::vector<unsigned char>& missingNormals, int depth) {
+        const JsonValue* nodes = ctx.root->find("nodes");
+        const JsonValue* node = nodes ? nodes->at(static_cast<size_t>(nodeIndex)) : nullptr;
+        if (!node || depth > 64) {
+            return fail("invalid node hierarchy");
+        }
+        const glm::mat4 world = parent * nodeTransform(*node);
+        const JsonValue* mesh = node->find("mesh");
+        if (mesh && !appendGlbMesh(ctx, static_cast<int>(mesh->number), world, out, missingNormals)) {
+            return false;
+        }
+        const JsonValue* children = node->find("children");
+        if (children) {
+            for (const JsonValue& child : children->items) {
+                if (!appendGlbNode(ctx, static_cast<int>(child.number), world, out, missingNormals, depth + 1)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // ---- cache ----
+
+    constexpr char kCacheMagic[8] = { 'C', 'G', 'M', 'E', 'S', 'H', '\0', '\0' };
+    constexpr uint32_t kCacheVersion = 2; // 2: zero-length source normals are regenerated instead of NaN
+    constexpr size_t kCacheDataOffset = 128; // keeps the vertex block 16-byte aligned in the mapping
+
+    struct MeshCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t floatsPerVertex;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+    static_assert(sizeof(MeshCacheHeader) <= kCacheDataOffset, "mesh cache header overflows data offset");
+
+    bool sourceStamp(const char* path, uint64_t& size, int64_t& time) {
+        std::error_code ec;
+        size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+        if (ec) {
+            return false;
+        }
+        const auto stamp = std::filesystem::last_write_time(path, ec);
+        if (ec) {
+            return false;
+        }
+        time = static_cast<int64_t>(stamp.time_since_epoch().count());
+        return true;
+    }
+}
+
+const char* meshi_failure_reason() {
+    return gFailureReason;
+}
+
+bool meshi_load(const char* path, MeshData& out) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == ".obj") {
+        return meshi_load_obj(path, out);
+    }
+    if (ext == ".glb") {
+        return meshi_load_glb(path, out);
+    }
+    return fail("unknown mesh extension");
+}
+
+bool meshi_load_obj(const char* path, MeshData& out) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return fail("can't open file");
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::unordered_map<uint64_t, unsigned int> vertexLookup;
+    std::vector<unsigned int> positionOf;
+    std::vector<unsigned char> missingNormals;
+    std::vector<unsigned int> face;
+
+    out = MeshData{};
+    const char* p = reinterpret_cast<const char*>(file.data());
+    const char* end = p + file.size();
+
+    while (p < end) {
+        p = skipBlank(p, end);
+        if (end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            float v[3];
+            if (!parseFloats(p, end, v, 3)) {
+                return fail("malformed vertex position");
+            }
+            positions.emplace_back(v[0], v[1], v[2]);
+        }
+        else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 3;
+            float n[3];
+            if (!parseFloats(p, end, n, 3)) {
+                return fail("malformed vertex normal");
+            }
+            normals.emplace_back(n[0], n[1], n[2]);
+        }
+        else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            p += 2;
+            face.clear();
+            while (true) {
+                p = skipBlank(p, end);
+                if (p >= end || *p == '\n' || *p == '#') {
+                    break;
+                }
+                long refs[3] = { 0, 0, 0 };
+                for (int slot = 0; slot < 3; ++slot) {
+                    if (p < end && *p != '/') {
+                        const auto res = std::from_chars(p, end, refs[slot]);
+                        if (res.ec != std::errc()) {
+                            return fail("malformed face");
+                        }
+                        p = res.ptr;
+                    }
+                    if (p < end && *p == '/') {
+                        ++p;
+                    }
+                    else {
+                        break;
+                    }
+                }
+                const int pos = resolveObjIndex(refs[0], positions.size());
+                if (pos < 0) {
+                    return fail("face references missing vertex");
+                }
+                const int nrm = resolveObjIndex(refs[2], normals.size());
+                const uint64_t key = (static_cast<uint64_t>(pos) << 32) | static_cast<uint32_t>(nrm + 1);
+                const auto [it, inserted] = vertexLookup.emplace(key, static_cast<unsigned int>(positionOf.size()));
+                if (inserted) {
+                    glm::vec3 n(0.0f);
+                    const bool valid = nrm >= 0 && normalizeNormal(normals[static_cast<size_t>(nrm)], n);
+                    pushVertex(out, positions[static_cast<size_t>(pos)], n);
+                    positionOf.push_back(static_cast<unsigned int>(pos));
+                    missingNormals.push_back(valid ? 0 : 1);
+                }
+                face.push_back(it->second);
+            }
+            // fan-triangulate polygons
+            for (size_t k = 1; k + 1 < face.size(); ++k) {
+                out.indices.push_back(face[0]);
+                out.indices.push_back(face[k]);
+                out.indices.push_back(face[k + 1]);
+            }
+        }
+        p = skipLine(p, end);
+    }
+
+    if (out.indices.empty()) {
+        return fail("no faces");
+    }
+    if (std::find(missingNormals.begin(), missingNormals.end(), 1) != missingNormals.end()) {
+        fillMissingNormals(out, positionOf, positions.size(), missingNormals);
+    }
+    computeBounds(out);
+    return true;
+}
+
+bool meshi_load_glb(const char* path, MeshData& out) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return fail("can't open file");
+    }
+    const unsigned char* data = file.data();
+    const size_t size = file.size();
+    if (size < 20 || readU32(data) != kGlbMagic) {
+        return fail("not a binary glTF file");
+    }
+    if (readU32(data + 4) != 2) {
+        return fail("unsupported glTF version");
+    }
+
+    const char* json = nullptr;
+    size_t jsonSize = 0;
+    GlbContext ctx;
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const size_t chunkLength = readU32(data + offset);
+        const uint32_t chunkType = readU32(data + offset + 4);
+        offset += 8;
+        if (chunkLength > size - offset) {
+            return fail("truncated chunk");
+        }
+        if (chunkType == kGlbChunkJson && !json) {
+            json = reinterpret_cast<const char*>(data + offset);
+            jsonSize = chunkLength;
+        }
+        else if (chunkType == kGlbChunkBin && !ctx.bin) {
+            ctx.bin = data + offset;
+            ctx.binSize = chunkLength;
+        }
+        offset += (chunkLength + 3) & ~static_cast<size_t>(3);
+    }
+    if (!json) {
+        return fail("missing JSON chunk");
+    }
+
+    JsonValue root;
+    JsonParser parser(json, json + jsonSize);
+    if (!parser.parse(root) || root.type != JsonValue::Type::Object) {
+        return fail("malformed glTF JSON");
+    }
+    ctx.root = &root;
+
+    out = MeshData{};
+    std::vector<unsigned char> missingNormals;
+    const JsonValue* scenes = root.find("scenes");
+    const JsonValue* scene = scenes ? scenes->at(static_cast<size_t>(root.intOr("scene", 0))) : nullptr;
+    const JsonValue* sceneNodes = scene ? scene->find("nodes") : nullptr;
+    if (sceneNodes) {
+        for (const JsonValue& node : sceneNodes->items) {
+            if (!appendGlbNode(ctx, static_cast<int>(node.number), glm::mat4(1.0f), out, missingNormals, 0)) {
+                return false;
+            }
+        }
+    }
+    else if (const JsonValue* meshes = root.find("meshes")) {
+        for (size_t i = 0; i < meshes->items.size(); ++i) {
+            if (!appendGlbMesh(ctx, static_cast<int>(i), glm::mat4(1.0f), out, missingNormals)) {
+                return false;
+            }
+        }
+    }
+
+    if (out.indices.empty()) {
+        return fail("no triangle primitives");
+    }
+    if (std::find(missingNormals.begin(), missingNormals.end(), 1) != missingNormals.end()) {
+        std::vector<unsigned int> group(missingNormals.size());
+        for (size_t i = 0; i < group.size(); ++i) {
+            group[i] = static_cast<unsigned int>(i);
+        }
+        fillMissingNormals(out, group, group.size(), missingNormals);
+    }
+    computeBounds(out);
+    return true;
+}
+
+void meshi_optimize(MeshData& mesh) {
+    struct VertexKey {
+        uint32_t bits[6];
+        bool operator==(const VertexKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            uint64_t h = 1469598103934665603ull;
+            for (uint32_t b : key.bits) {
+                h = (h ^ b) * 1099511628211ull;
+            }
+            return static_cast<size_t>(h);
+        }
+    };
+
+    // weld bit-identical vertices
+    const size_t vertexCount = mesh.vertices.size() / 6;
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash> welded;
+    welded.reserve(vertexCount);
+    std::vector<unsigned int> weldRemap(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        VertexKey key;
+        std::memcpy(key.bits, &mesh.vertices[v * 6], sizeof(key.bits));
+        weldRemap[v] = welded.emplace(key, static_cast<unsigned int>(v)).first->second;
+    }
+
+    // drop degenerate triangles, then renumber vertices in first-use order for fetch locality
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> order(vertexCount, unassigned);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    std::vector<unsigned int> indices;
+    indices.reserve(mesh.indices.size());
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        const unsigned int tri[3] = { weldRemap[mesh.indices[t]], weldRemap[mesh.indices[t + 1]], weldRemap[mesh.indices[t + 2]] };
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+            continue;
+        }
+        for (unsigned int src : tri) {
+            if (order[src] == unassigned) {
+                order[src] = static_cast<unsigned int>(vertices.size() / 6);
+                vertices.insert(vertices.end(), mesh.vertices.begin() + src * 6, mesh.vertices.begin() + src * 6 + 6);
+            }
+            indices.push_back(order[src]);
+        }
+    }
+
+    mesh.vertices = std::move(vertices);
+    mesh.indices = std::move(indices);
+    computeBounds(mesh);
+}
+
+std::string meshi_cache_path(const char* sourcePath) {
+    return std::string(sourcePath) + ".meshcache";
+}
+
+bool meshi_cache_write(const char* sourcePath, const MeshData& mesh) {
+    MeshCacheHeader header{};
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.floatsPerVertex = 6;
+    if (!sourceStamp(sourcePath, header.sourceSize, header.sourceTime)) {
+        return fail("can't stat source file");
+    }
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size() / 6);
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    for (int i = 0; i < 3; ++i) {
+        header.boundsMin[i] = mesh.boundsMin[i];
+        header.boundsMax[i] = mesh.boundsMax[i];
+    }
+
+    // write next to the final path and rename, so a crash never leaves a half-written cache behind
+    const std::string finalPath = meshi_cache_path(sourcePath);
+    const std::string tempPath = finalPath + ".tmp";
+    FILE* f = std::fopen(tempPath.c_str(), "wb");
+    if (!f) {
+        return fail("can't create cache file");
+    }
+    unsigned char block[kCacheDataOffset] = {};
+    std::memcpy(block, &header, sizeof(header));
+    bool ok = std::fwrite(block, 1, sizeof(block), f) == sizeof(block);
+    ok = ok && std::fwrite(mesh.vertices.data(), sizeof(float), mesh.vertices.size(), f) == mesh.vertices.size();
+    ok = ok && std::fwrite(mesh.indices.data(), sizeof(unsigned int), mesh.indices.size(), f) == mesh.indices.size();
+    ok = (std::fclose(f) == 0) && ok;
+
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tempPath, finalPath, ec);
+    }
+    if (!ok || ec) {
+        std::filesystem::remove(tempPath, ec);
+        return fail("can't write cache file");
+    }
+    return true;
+}
+
+bool meshi_cache_open(const char* sourcePath, MappedFile& file, MeshCacheView& view) {
+    if (!file.open(meshi_cache_path(sourcePath))) {
+        return fail("no cache file");
+    }
+    MeshCacheHeader header{};
+    if (file.size() < kCacheDataOffset) {
+        file.close();
+        return fail("truncated cache file");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || header.version != kCacheVersion ||
+        header.floatsPerVertex != 6) {
+        file.close();
+        return fail("cache format mismatch");
+    }
+
+    // a cache without its source is still usable; a cache older than its source is not
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (sourceStamp(sourcePath, sourceSize, sourceTime) &&
+        (sourceSize != header.sourceSize || sourceTime != header.sourceTime)) {
+        file.close();
+        return fail("cache is stale");
+    }
+
+    const size_t vertexBytes = static_cast<size_t>(header.vertexCount) * 6 * sizeof(float);
+    const size_t indexBytes = static_cast<size_t>(header.indexCount) * sizeof(unsigned int);
+    if (file.size() < kCacheDataOffset + vertexBytes + indexBytes) {
+        file.close();
+        return fail("truncated cache file");
+    }
+
+    view.vertices = reinterpret_cast<const float*>(file.data() + kCacheDataOffset);
+    view.indices = reinterpret_cast<const unsigned int*>(file.data() + kCacheDataOffset + vertexBytes);
+    // the indices go straight to the GPU, so a corrupt cache must not point past the vertices
+    for (unsigned int i = 0; i < header.indexCount; ++i) {
+        if (view.indices[i] >= header.vertexCount) {
+            file.close();
+            view = MeshCacheView();
+            return fail("cache index out of range");
+        }
+    }
+    view.vertexCount = header.vertexCount;
+    view.indexCount = header.indexCount;
+    view.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    view.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// stbi-style mesh loading helpers. All loaders produce the layout SceneRenderer::createMesh
+// expects: interleaved position + normal (6 floats per vertex) with 32-bit triangle indices.
+
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// Read-only view into a mapped <source>.meshcache file; pointers stay valid while the MappedFile is open.
+struct MeshCacheView {
+    const float* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// dispatches on extension (.obj / .glb)
+bool meshi_load(const char* path, MeshData& out);
+bool meshi_load_obj(const char* path, MeshData& out);
+bool meshi_load_glb(const char* path, MeshData& out);
+
+// welds identical vertices, reorders them by first use and recomputes bounds
+void meshi_optimize(MeshData& mesh);
+
+std::string meshi_cache_path(const char* sourcePath);
+bool meshi_cache_write(const char* sourcePath, const MeshData& mesh);
+// succeeds only if the cache exists, matches the source file's size and timestamp and every index is in range
+bool meshi_cache_open(const char* sourcePath, MappedFile& file, MeshCacheView& view);
+
+const char* meshi_failure_reason();
@@ -0,0 +1,111 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+        static uint32_t table[256];
+        static bool tableReady = false;
+        if (!tableReady) {
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            tableReady = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void putU32(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> chunk;
+        chunk.reserve(data.size() + 12);
+        putU32(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        // the CRC covers the type and the data, not the length
+        putU32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba, bool flipY) {
+    if (width <= 0 || height <= 0 || !rgba) {
+        return false;
+    }
+
+    // scanlines with filter byte 0 in front of each row
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * static_cast<size_t>(height));
+    for (int y = 0; y < height; ++y) {
+        const int srcRow = flipY ? height - 1 - y : y;
+        const unsigned char* row = rgba + static_cast<size_t>(srcRow) * rowBytes;
+        raw.push_back(0);
+        raw.insert(raw.end(), row, row + rowBytes);
+    }
+
+    // zlib stream made of stored blocks
+    std::vector<unsigned char> zlib = { 0x78, 0x01 };
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    size_t offset = 0;
+    while (true) {
+        const size_t blockSize = std::min<size_t>(65535, raw.size() - offset);
+        const bool last = offset + blockSize == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(blockSize & 0xFF));
+        zlib.push_back(static_cast<unsigned char>(blockSize >> 8));
+        zlib.push_back(static_cast<unsigned char>(~blockSize & 0xFF));
+        zlib.push_back(static_cast<unsigned char>((~blockSize >> 8) & 0xFF));
+        for (size_t i = 0; i < blockSize; ++i) {
+            const unsigned char byte = raw[offset + i];
+            adlerA = (adlerA + byte) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+            zlib.push_back(byte);
+        }
+        offset += blockSize;
+        if (last) {
+            break;
+        }
+    }
+    putU32(zlib, (adlerB << 16) | adlerA);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to write PNG: " << path << std::endl;
+        return false;
+    }
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header;
+    putU32(header, static_cast<uint32_t>(width));
+    putU32(header, static_cast<uint32_t>(height));
+    header.push_back(8); // bit depth
+    header.push_back(6); // RGBA
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Minimal RGBA8 PNG writer (stored deflate blocks, no compression) for headless frame dumps.
+// Rows are taken bottom-up when flipY is set, matching glReadPixels.
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba, bool flipY);
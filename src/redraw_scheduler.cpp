@@ -0,0 +1,80 @@
+#include "redraw_scheduler.h"
+
+#include <algorithm>
+
+namespace {
+    // upper bound on a single sleep so stats and timers keep ticking
+    constexpr double kMaxWait = 0.5;
+    constexpr double kStatsWindow = 1.0;
+}
+
+void RedrawScheduler::init(GLFWwindow* targetWindow) {
+    window = targetWindow;
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (mode && mode->refreshRate > 0) {
+        refreshRate = static_cast<double>(mode->refreshRate);
+    }
+    windowStart = glfwGetTime();
+}
+
+void RedrawScheduler::setOnDemand(bool enabled) {
+    onDemand = enabled;
+    requestRedraw();
+}
+
+void RedrawScheduler::requestRedraw(int frames) {
+    pendingFrames = std::max(pendingFrames, frames);
+}
+
+void RedrawScheduler::requestRedrawAsync() {
+    asyncRequest = true;
+    glfwPostEmptyEvent();
+}
+
+bool RedrawScheduler::waitForFrame() {
+    if (!onDemand) {
+        glfwPollEvents();
+        updateWindow(glfwGetTime());
+        return true;
+    }
+
+    // events delivered through the callbacks call requestRedraw before this returns
+    glfwPollEvents();
+    if (asyncRequest.exchange(false)) {
+        requestRedraw();
+    }
+    if (pendingFrames > 0) {
+        updateWindow(glfwGetTime());
+        return true;
+    }
+
+    const double before = glfwGetTime();
+    glfwWaitEventsTimeout(kMaxWait);
+    const double after = glfwGetTime();
+    windowIdle += after - before;
+    stats.idleSeconds += after - before;
+    if (asyncRequest.exchange(false)) {
+        requestRedraw();
+    }
+    updateWindow(after);
+    return pendingFrames > 0;
+}
+
+void RedrawScheduler::frameRendered() {
+    pendingFrames = std::max(0, pendingFrames - 1);
+    ++windowFrames;
+}
+
+void RedrawScheduler::updateWindow(double now) {
+    const double elapsed = now - windowStart;
+    if (elapsed < kStatsWindow) {
+        return;
+    }
+    const double possibleFrames = elapsed * refreshRate;
+    stats.renderedFrames = windowFrames;
+    stats.skippedFraction = static_cast<float>(std::clamp(1.0 - windowFrames / possibleFrames, 0.0, 1.0));
+    stats.idleFraction = static_cast<float>(std::clamp(windowIdle / elapsed, 0.0, 1.0));
+    windowStart = now;
+    windowIdle = 0.0;
+    windowFrames = 0;
+}
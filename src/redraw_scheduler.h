@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <atomic>
+
+// Decides whether the main loop renders a frame. In on-demand mode the loop sleeps in
+// glfwWaitEventsTimeout until input arrives or something requests a redraw.
+class RedrawScheduler {
+public:
+    struct Stats {
+        float skippedFraction = 0.0f; // share of display refreshes not rendered, last window
+        float idleFraction = 0.0f;    // share of wall time spent blocked waiting for events
+        double idleSeconds = 0.0;     // total since start
+        int renderedFrames = 0;       // in the last window
+    };
+
+    void init(GLFWwindow* window);
+
+    void setOnDemand(bool enabled);
+    bool isOnDemand() const { return onDemand; }
+
+    // keep rendering for the next `frames` frames (ImGui needs a couple to settle after input)
+    void requestRedraw(int frames = kSettleFrames);
+    // safe from any thread, e.g. when a background load finishes
+    void requestRedrawAsync();
+
+    // pumps events, blocking while there is nothing to draw; true when a frame should be rendered
+    bool waitForFrame();
+    void frameRendered();
+
+    const Stats& getStats() const { return stats; }
+
+    static constexpr int kSettleFrames = 3;
+
+private:
+    void updateWindow(double now);
+
+    GLFWwindow* window = nullptr;
+    bool onDemand = false;
+    int pendingFrames = kSettleFrames;
+    std::atomic<bool> asyncRequest{ false };
+    double refreshRate = 60.0;
+    double windowStart = 0.0;
+    double windowIdle = 0.0;
+    int windowFrames = 0;
+    Stats stats;
+};
@@ -0,0 +1,346 @@
+#include "scatter.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include "worker_pool.h"
+
+namespace {
+    constexpr int kTileCells = 4;        // Poisson disk tile edge, in grid cells
+    constexpr int kPoissonAttempts = 24; // darts per grid cell
+    constexpr int kPoissonRetries = 4;
+    // separate streams for placement, per-instance attributes and the palette
+    constexpr uint32_t kAttributeSalt = 0x68e31da4u;
+    constexpr uint32_t kPaletteSalt = 0xb5297a4du;
+
+    // lowbias32
+    uint32_t hashU32(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // tiny random stream, cheap enough to seed one per instance or tile
+    struct Random {
+        uint32_t state;
+
+        Random(uint32_t seed, uint32_t stream) : state(hashU32(seed ^ hashU32(stream + 0x9e3779b9u))) {}
+        uint32_t next() {
+            state = state * 747796405u + 2891336453u;
+            return hashU32(state);
+        }
+        float unit() { return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f); }
+        float range(float lo, float hi) { return lo + (hi - lo) * unit(); }
+    };
+
+    struct Face {
+        glm::vec3 origin; // corner the edges start from
+        glm::vec3 u;
+        glm::vec3 v;
+        glm::vec3 normal; // outward
+        float area = 0.0f;
+        bool upright = false; // normal is +y with u along x, so rotations apply as they are
+    };
+
+    struct Placement {
+        glm::vec3 position;
+        int face;
+    };
+
+    void addFace(std::vector<Face>& faces, const glm::vec3& origin, const glm::vec3& u, const glm::vec3& v, const glm::vec3& outward) {
+        Face face;
+        face.origin = origin;
+        face.u = u;
+        face.v = v;
+        face.normal = glm::cross(u, v);
+        face.area = glm::length(face.normal);
+        if (face.area <= 1e-6f) {
+            return; // flattened, e.g. a cube scaled to zero on one axis
+        }
+        face.normal /= face.area;
+        if (glm::dot(face.normal, outward) < 0.0f) {
+            face.normal = -face.normal;
+        }
+        faces.push_back(face);
+    }
+
+    void surfaceFaces(const ScatterSurface& surface, std::vector<Face>& faces) {
+        const glm::mat3 basis(surface.world);
+        const glm::vec3 center(surface.world[3]);
+        if (surface.type == PrimitiveType::Plane) {
+            // the 2x2 quad at y = 0, top side only
+            addFace(faces, center + basis * glm::vec3(-1.0f, 0.0f, -1.0f), basis[0] * 2.0f, basis[2] * 2.0f, basis[1]);
+            return;
+        }
+        // unit cube, every face
+        for (int axis = 0; axis < 3; ++axis) {
+            const int a = (axis + 1) % 3;
+            const int b = (axis + 2) % 3;
+            for (float side : { -1.0f, 1.0f }) {
+                glm::vec3 corner(0.0f);
+                corner[axis] = 0.5f * side;
+                corner[a] = -0.5f;
+                corner[b] = -0.5f;
+                addFace(faces, center + basis * corner, basis[a], basis[b], basis[axis] * side);
+            }
+        }
+    }
+
+    void jitteredGrid(float width, float height, int count, uint32_t seed, WorkerPool& pool, std::vector<glm::vec2>& out) {
+        const int columns = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count) * width / height))));
+        const int rows = std::max(1, (count + columns - 1) / columns);
+        const int64_t cells = static_cast<int64_t>(columns) * rows;
+        out.resize(static_cast<size_t>(count));
+        pool.parallelFor(out.size(), 1024, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                // spread the points over all cells, so the spare ones are scattered instead of one empty strip
+                const int64_t cell = static_cast<int64_t>(i) * cells / count;
+                Random random(seed, static_cast<uint32_t>(i));
+                const float x = (static_cast<float>(cell % columns) + random.unit()) / static_cast<float>(columns);
+                const float y = (static_cast<float>(cell / columns) + random.unit()) / static_cast<float>(rows);
+                out[i] = glm::vec2(x * width, y * height);
+            }
+        });
+    }
+
+    // dart throwing over a grid of spacing / sqrt(2) cells: a cell holds at most one point and every
+    // conflict lies within two cells. Tiles run in four checkerboard phases; tiles of one phase are a
+    // whole tile apart, so their searches never meet and they can be filled in parallel
+    void poissonDisk(float width, float height, float spacing, uint32_t seed, WorkerPool& pool, std::vector<glm::vec2>& out) {
+        const float cellSize = spacing / std::sqrt(2.0f);
+        const int columns = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+        const int rows = std::max(1, static_cast<int>(std::ceil(height / cellSize)));
+        const int tilesX = (columns + kTileCells - 1) / kTileCells;
+        const int tilesY = (rows + kTileCells - 1) / kTileCells;
+        const float spacing2 = spacing * spacing;
+        std::vector<glm::vec2> points(static_cast<size_t>(columns) * rows);
+        std::vector<uint8_t> occupied(points.size(), 0);
+
+        for (int phase = 0; phase < 4; ++phase) {
+            const int phaseX = phase & 1;
+            const int phaseY = phase >> 1;
+            const int phaseColumns = (tilesX - phaseX + 1) / 2;
+            const int phaseRows = (tilesY - phaseY + 1) / 2;
+            if (phaseColumns <= 0 || phaseRows <= 0) {
+                continue;
+            }
+            pool.parallelFor(static_cast<size_t>(phaseColumns) * phaseRows, 4, [&](size_t begin, size_t end, unsigned) {
+                for (size_t t = begin; t < end; ++t) {
+                    const int tileX = phaseX + 2 * static_cast<int>(t % static_cast<size_t>(phaseColumns));
+                    const int tileY = phaseY + 2 * static_cast<int>(t / static_cast<size_t>(phaseColumns));
+                    const int x0 = tileX * kTileCells;
+                    const int y0 = tileY * kTileCells;
+                    const int x1 = std::min(x0 + kTileCells, columns);
+                    const int y1 = std::min(y0 + kTileCells, rows);
+                    Random random(seed, static_cast<uint32_t>(tileY * tilesX + tileX));
+                    const int attempts = kPoissonAttempts * (x1 - x0) * (y1 - y0);
+                    for (int attempt = 0; attempt < attempts; ++attempt) {
+                        const glm::vec2 p((static_cast<float>(x0) + random.unit() * static_cast<float>(x1 - x0)) * cellSize,
+                            (static_cast<float>(y0) + random.unit() * static_cast<float>(y1 - y0)) * cellSize);
+                        if (p.x >= width || p.y >= height) {
+                            continue;
+                        }
+                        const int cx = std::min(static_cast<int>(p.x / cellSize), columns - 1);
+                        const int cy = std::min(static_cast<int>(p.y / cellSize), rows - 1);
+                        if (occupied[static_cast<size_t>(cy) * columns + cx]) {
+                            continue;
+                        }
+                        bool clear = true;
+                        for (int ny = std::max(cy - 2, 0); clear && ny <= std::min(cy + 2, rows - 1); ++ny) {
+                            for (int nx = std::max(cx - 2, 0); nx <= std::min(cx + 2, columns - 1); ++nx) {
+                                const size_t n = static_cast<size_t>(ny) * columns + nx;
+                                if (occupied[n]) {
+                                    const glm::vec2 d = points[n] - p;
+                                    if (glm::dot(d, d) < spacing2) {
+                                        clear = false;
+                                        break;
+                                    }
+                                }
+                            }
+                        }
+                        if (clear) {
+                            const size_t cell = static_cast<size_t>(cy) * columns + cx;
+                            occupied[cell] = 1;
+                            points[cell] = p;
+                        }
+                    }
+                }
+            });
+        }
+
+        out.clear();
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (occupied[i]) {
+                out.push_back(points[i]);
+            }
+        }
+    }
+
+    // count points in [0, width) x [0, height)
+    void samplePlanar(float width, float height, int count, ScatterPattern pattern, uint32_t seed, WorkerPool& pool,
+        std::vector<glm::vec2>& out) {
+        out.clear();
+        if (count <= 0 || width <= 0.0f || height <= 0.0f) {
+            return;
+        }
+        if (pattern == ScatterPattern::JitteredGrid) {
+            jitteredGrid(width, height, count, seed, pool, out);
+            return;
+        }
+
+        // saturated dart throwing packs about 0.87 area / spacing^2 points; aim a little under that and
+        // tighten the spacing when a pass still falls short
+        float spacing = std::sqrt(0.7f * width * height / static_cast<float>(count));
+        for (int retry = 0; retry < kPoissonRetries; ++retry) {
+            poissonDisk(width, height, spacing, seed + static_cast<uint32_t>(retry), pool, out);
+            if (out.size() >= static_cast<size_t>(count)) {
+                break;
+            }
+            spacing *= 0.85f;
+        }
+        // dropping random points keeps the spacing intact
+        if (out.size() > static_cast<size_t>(count)) {
+            Random random(seed, 0xffffffffu);
+            for (size_t i = 0; i < static_cast<size_t>(count); ++i) {
+                std::swap(out[i], out[i + random.next() % (out.size() - i)]);
+            }
+            out.resize(static_cast<size_t>(count));
+        }
+    }
+
+    // degrees for r = Rx * Ry * Rz, the order modelMatrix in scene.cpp applies them; r is indexed [column][row]
+    glm::vec3 eulerDegrees(const glm::mat3& r) {
+        const float sinY = std::clamp(r[2][0], -1.0f, 1.0f);
+        const float y = std::asin(sinY);
+        float x = 0.0f;
+        float z = 0.0f;
+        if (std::fabs(sinY) < 0.9999f) {
+            x = std::atan2(-r[2][1], r[2][2]);
+            z = std::atan2(-r[1][0], r[0][0]);
+        }
+        else {
+            x = std::atan2(r[1][2], r[1][1]);
+        }
+        return glm::vec3(glm::degrees(x), glm::degrees(y), glm::degrees(z));
+    }
+
+    glm::mat3 eulerMatrix(const glm::vec3& degrees) {
+        glm::mat4 r(1.0f);
+        r = glm::rotate(r, glm::radians(degrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        r = glm::rotate(r, glm::radians(degrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        r = glm::rotate(r, glm::radians(degrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        return glm::mat3(r);
+    }
+
+    // distance from the centre to the bottom of the unscaled primitive
+    float restingHeight(PrimitiveType type) {
+        return type == PrimitiveType::Plane ? 0.0f : 0.5f;
+    }
+}
+
+void buildScatter(const ScatterSettings& settings, const ScatterSurface* surface, const SceneRenderer& scene,
+    WorkerPool& pool, ScatterResult& out) {
+    out.instances.clear();
+    out.palette.clear();
+    if (settings.count <= 0) {
+        return;
+    }
+
+    std::vector<Face> faces;
+    float heightRange = 0.0f;
+    if (surface) {
+        surfaceFaces(*surface, faces);
+    }
+    else {
+        const glm::vec3 extent = glm::max(settings.regionMax - settings.regionMin, glm::vec3(0.0f));
+        Face face;
+        face.origin = settings.regionMin;
+        face.u = glm::vec3(extent.x, 0.0f, 0.0f);
+        face.v = glm::vec3(0.0f, 0.0f, extent.z);
+        face.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        face.area = extent.x * extent.z;
+        face.upright = true;
+        if (face.area > 0.0f) {
+            faces.push_back(face);
+        }
+        heightRange = extent.y;
+    }
+    if (faces.empty()) {
+        return;
+    }
+
+    // split the count by area; rounding the running total keeps the sum exact
+    float totalArea = 0.0f;
+    for (const Face& face : faces) {
+        totalArea += face.area;
+    }
+    std::vector<Placement> placements;
+    placements.reserve(static_cast<size_t>(settings.count));
+    std::vector<glm::vec2> points;
+    float areaSoFar = 0.0f;
+    int placedSoFar = 0;
+    for (size_t f = 0; f < faces.size(); ++f) {
+        const Face& face = faces[f];
+        areaSoFar += face.area;
+        const int upTo = static_cast<int>(std::lround(static_cast<double>(settings.count) * areaSoFar / totalArea));
+        const int faceCount = upTo - placedSoFar;
+        placedSoFar = upTo;
+
+        const float width = glm::length(face.u);
+        const float height = glm::length(face.v);
+        samplePlanar(width, height, faceCount, settings.pattern, hashU32(settings.seed + static_cast<uint32_t>(f)), pool, points);
+        for (const glm::vec2& p : points) {
+            placements.push_back({ face.origin + face.u * (p.x / width) + face.v * (p.y / height), static_cast<int>(f) });
+        }
+    }
+
+    const int variants = std::max(1, settings.variants);
+    out.palette.reserve(static_cast<size_t>(variants));
+    for (int i = 0; i < variants; ++i) {
+        Random random(settings.seed ^ kPaletteSalt, static_cast<uint32_t>(i));
+        glm::vec3 color = settings.color;
+        for (int c = 0; c < 3; ++c) {
+            color[c] *= 1.0f + settings.colorJitter * (random.unit() * 2.0f - 1.0f);
+        }
+        out.palette.push_back(scene.defaultMaterialFor(glm::clamp(color, 0.0f, 1.0f)));
+    }
+
+    const PrimitiveType mixed[] = { PrimitiveType::Cube, PrimitiveType::Sphere, PrimitiveType::Cylinder };
+    const float scaleMin = std::min(settings.scaleMin, settings.scaleMax);
+    const float scaleMax = std::max(settings.scaleMin, settings.scaleMax);
+    out.instances.resize(placements.size());
+    pool.parallelFor(placements.size(), 512, [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i) {
+            const Placement& placement = placements[i];
+            const Face& face = faces[static_cast<size_t>(placement.face)];
+            Random random(settings.seed ^ kAttributeSalt, static_cast<uint32_t>(i));
+
+            PrimitiveInstance& inst = out.instances[i];
+            inst.type = settings.mixTypes ? mixed[random.next() % 3] : settings.type;
+            const float scale = random.range(scaleMin, scaleMax);
+            inst.scale = settings.uniformScale ? glm::vec3(scale) :
+                glm::vec3(scale, random.range(scaleMin, scaleMax), random.range(scaleMin, scaleMax));
+            const glm::vec3 rotation(random.range(-1.0f, 1.0f) * settings.maxRotation.x,
+                random.range(-1.0f, 1.0f) * settings.maxRotation.y, random.range(-1.0f, 1.0f) * settings.maxRotation.z);
+            if (face.upright) {
+                inst.rotation = rotation;
+            }
+            else {
+                // local +y onto the face normal, then the random turn in that frame
+                const glm::vec3 tangent = glm::normalize(face.u - face.normal * glm::dot(face.u, face.normal));
+                const glm::mat3 align(tangent, face.normal, glm::cross(tangent, face.normal));
+                inst.rotation = eulerDegrees(align * eulerMatrix(rotation));
+            }
+            // tilted instances may sink in a little; the lift only covers the upright extent
+            const float lift = restingHeight(inst.type) * inst.scale.y + random.unit() * heightRange;
+            inst.position = placement.position + face.normal * lift;
+            inst.materialId = static_cast<int>(random.next() % static_cast<uint32_t>(variants));
+            inst.color = out.palette[static_cast<size_t>(inst.materialId)].diffuse;
+        }
+    });
+}
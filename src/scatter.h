@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "material_table.h"
+#include "scene.h"
+
+class WorkerPool;
+
+enum class ScatterPattern {
+    JitteredGrid, // one point per grid cell, fast and even
+    PoissonDisk   // no two points closer than a spacing derived from the count
+};
+
+struct ScatterSettings {
+    int count = 500;
+    ScatterPattern pattern = ScatterPattern::PoissonDisk;
+    PrimitiveType type = PrimitiveType::Cube;
+    bool mixTypes = false; // cube, sphere and cylinder picked at random instead of type
+    // used when there is no target surface: x/z span the area, each instance gets a height in the y range
+    glm::vec3 regionMin = glm::vec3(-20.0f, 0.0f, -20.0f);
+    glm::vec3 regionMax = glm::vec3(20.0f, 0.0f, 20.0f);
+    float scaleMin = 0.5f;
+    float scaleMax = 1.5f;
+    bool uniformScale = true;
+    glm::vec3 maxRotation = glm::vec3(0.0f, 180.0f, 0.0f); // degrees either way, y turns around the surface normal
+    glm::vec3 color = glm::vec3(0.45f, 0.65f, 0.35f);
+    float colorJitter = 0.25f; // relative, per channel
+    int variants = 8;          // palette size, instances pick one each
+    uint32_t seed = 1;
+};
+
+// a plane (its top side) or cube (all six faces) to scatter onto, by its world matrix
+struct ScatterSurface {
+    PrimitiveType type = PrimitiveType::Plane;
+    glm::mat4 world = glm::mat4(1.0f);
+};
+
+struct ScatterResult {
+    std::vector<PrimitiveInstance> instances; // materialId indexes palette, see SceneRenderer::addInstances
+    std::vector<Material> palette;
+};
+
+// Places settings.count instances over the surface, or the region when surface is null, resting on it
+// along its normal. Points and per-instance attributes are generated on the pool; every instance draws
+// from its own hash-seeded stream, so the result depends on the seed only, not on the thread count.
+// A Poisson disk can come back with fewer instances when the area cannot hold them.
+void buildScatter(const ScatterSettings& settings, const ScatterSurface* surface, const SceneRenderer& scene,
+    WorkerPool& pool, ScatterResult& out);
@@ -4,41 +4,110 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cmath>
 #include <filesystem>
+#include <iostream>
+#include <limits>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "stb_image.h"
+#include "heap_counter.h"
+#include "mapped_file.h"
+#include "mesh_import.h"
+#include "scene_file.h"
+#include "scene_journal.h"
+#include "undo_history.h"
+#include "trace.h"
 
 namespace {
-    GLint toGlWrap(TextureWrapMode mode) {
-        switch (mode) {
-        case TextureWrapMode::ClampToEdge: return GL_CLAMP_TO_EDGE;
-        case TextureWrapMode::MirroredRepeat: return GL_MIRRORED_REPEAT;
-        case TextureWrapMode::Repeat:
-        default: return GL_REPEAT;
-        }
+    glm::mat4 modelMatrix(const PrimitiveInstance& instance) {
+        glm::mat4 model(1.0f);
+        model = glm::translate(model, instance.position);
+        model = glm::rotate(model, glm::radians(instance.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(instance.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, glm::radians(instance.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::scale(model, instance.scale);
+        return model;
     }
 
-    GLint toGlMinFilter(TextureFilterMode mode) {
-        return mode == TextureFilterMode::Nearest ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+    // interned file name of a path, what the UI shows
+    StringId fileNameOf(const std::string& path) {
+        return strings::intern(std::filesystem::path(path).filename().string());
     }
 
-    GLint toGlMagFilter(TextureFilterMode mode) {
-        return mode == TextureFilterMode::Nearest ? GL_NEAREST : GL_LINEAR;
+    // inverse of modelMatrix for a matrix without shear; sheared input (a non-uniform scale under a
+    // rotated parent) comes back as the nearest rotation and scale
+    void decomposeModel(const glm::mat4& model, glm::vec3& position, glm::vec3& rotationDegrees, glm::vec3& scale) {
+        position = glm::vec3(model[3]);
+        scale = glm::vec3(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])));
+        if (glm::determinant(glm::mat3(model)) < 0.0f) {
+            scale.x = -scale.x;
+        }
+        glm::mat3 r(1.0f);
+        for (int c = 0; c < 3; ++c) {
+            if (std::fabs(scale[c]) > 1e-6f) {
+                r[c] = glm::vec3(model[c]) / scale[c];
+            }
+        }
+        // r = Rx * Ry * Rz, indexed r[column][row]
+        const float sinY = std::clamp(r[2][0], -1.0f, 1.0f);
+        const float y = std::asin(sinY);
+        float x = 0.0f;
+        float z = 0.0f;
+        if (std::fabs(sinY) < 0.9999f) {
+            x = std::atan2(-r[2][1], r[2][2]);
+            z = std::atan2(-r[1][0], r[0][0]);
+        }
+        else {
+            x = std::atan2(r[1][2], r[1][1]); // gimbal lock, z folded into x
+        }
+        rotationDegrees = glm::vec3(glm::degrees(x), glm::degrees(y), glm::degrees(z));
     }
+
+    // instances can share a static batch when everything the fragment shader reads matches
+    // and they agree on shadow casting
+    bool sameBatchState(const PrimitiveInstance& a, const PrimitiveInstance& b) {
+        const bool texturedA = a.hasTexture && a.texturePage >= 0;
+        const bool texturedB = b.hasTexture && b.texturePage >= 0;
+        if (texturedA != texturedB) {
+            return false;
+        }
+        if (texturedA && (a.texturePage != b.texturePage || a.textureLayer != b.textureLayer ||
+            a.projection != b.projection || a.planarAxis != b.planarAxis || a.uvScale != b.uvScale ||
+            a.wrapMode != b.wrapMode || a.filterMode != b.filterMode)) {
+            return false;
+        }
+        return a.materialId == b.materialId && a.castsShadow == b.castsShadow;
+    }
+
+    constexpr size_t kMaxBatchVertices = 1u << 20;
+
+    // texture units: 1-3 cluster buffers, 4 shadow cube map, then the texture array pages
+    // and the material table
+    constexpr GLuint kLinearPageUnit = 5;
+    constexpr GLuint kNearestPageUnit = kLinearPageUnit + TextureArrayPool::kPageCount;
+    constexpr GLuint kMaterialUnit = kNearestPageUnit + TextureArrayPool::kPageCount;
 }
 
 SceneRenderer::SceneRenderer() = default;
 
 SceneRenderer::~SceneRenderer() {
-    for (auto& inst : instances) {
-        if (inst.textureId) {
-            glDeleteTextures(1, &inst.textureId);
-            inst.textureId = 0;
-        }
+    textures.destroy();
+    destroyStaticBatches();
+    destroyPassTimer(prepassTimer);
+    destroyPassTimer(colorPassTimer);
+    destroyPassTimer(shadowTimer);
+    destroyShadowMap();
+    if (instanceBuffer) {
+        glDeleteBuffers(1, &instanceBuffer);
     }
+    destroyTextureBuffer(lightBuffer);
+    destroyTextureBuffer(clusterBuffer);
+    destroyTextureBuffer(clusterIndexBuffer);
+    destroyTextureBuffer(materialBuffer);
     for (auto& [_, mesh] : meshes) {
         destroyMesh(mesh);
     }
@@ -53,18 +122,31 @@ void SceneRenderer::init() {
         #version 330 core
         layout (location = 0) in vec3 aPos;
         layout (location = 1) in vec3 aNormal;
+        layout (location = 2) in mat4 aModel;
+        layout (location = 6) in vec4 aParams;
+        layout (location = 7) in vec4 aColor;
+        layout (location = 8) in ivec4 aTexture;
 
-        uniform mat4 model;
         uniform mat4 view;
         uniform mat4 projection;
 
         out vec3 vNormal;
         out vec3 vWorldPos;
+        out float vViewDepth;
+        flat out vec4 vParams;
+        flat out vec4 vColor;
+        flat out ivec4 vTexture;
+
+        invariant gl_Position; // must match the depth pre-pass bit for bit
 
         void main() {
-            vec4 worldPos = model * vec4(aPos, 1.0);
+            vec4 worldPos = aModel * vec4(aPos, 1.0);
             vWorldPos = worldPos.xyz;
-            vNormal = mat3(transpose(inverse(model))) * aNormal;
+            vViewDepth = -(view * worldPos).z;
+            vNormal = mat3(transpose(inverse(aModel))) * aNormal;
+            vParams = aParams;
+            vColor = aColor;
+            vTexture = aTexture;
             gl_Position = projection * view * worldPos;
         }
     )";
@@ -73,6 +155,10 @@ void SceneRenderer::init() {
         #version 330 core
         in vec3 vNormal;
         in vec3 vWorldPos;
+        in float vViewDepth;
+        flat in vec4 vParams;
+        flat in vec4 vColor;
+        flat in ivec4 vTexture;
 
         uniform vec3 lightPos;
         uniform vec3 lightColor;
@@ -80,21 +166,65 @@ void SceneRenderer::init() {
         uniform float ambientStrength;
         uniform float diffuseStrength;
         uniform float specularStrength;
-        uniform float shininess;
-        uniform float matAmbientStrength;
-        uniform float matDiffuseStrength;
-        uniform float matSpecularStrength;
-        uniform vec3 matAmbient;
-        uniform vec3 matDiffuse;
-        uniform vec3 matSpecular;
-        uniform bool useTexture;
-        uniform int projectionMode;
-        uniform int planarAxis;
-        uniform vec2 uvScale;
-        uniform sampler2D diffuseTex;
+        uniform float lightShininess;
+        uniform bool highlight;
+        uniform samplerBuffer materialData; // 4 texels per material, indexed by vTexture.w
+
+        // one texture array per size class, bound with a linear and a nearest sampler
+        uniform sampler2DArray linearPages[5];
+        uniform sampler2DArray nearestPages[5];
+
+        // per-instance texture state, unpacked from vTexture.z in main()
+        int projectionMode;
+        int planarAxis;
+        vec2 uvScale;
+
+        // clustered point lights
+        uniform int pointLightCount;
+        uniform samplerBuffer pointLightData;    // 2 texels per light: position/radius, radiance
+        uniform usamplerBuffer clusterRanges;    // offset, count
+        uniform usamplerBuffer clusterLightIndices;
+        uniform ivec3 clusterDims;
+        uniform vec2 viewportSize;
+        uniform float clusterNear;
+        uniform float clusterFar;
+
+        // main light shadow cube map, stores distance to the light / shadowFar
+        uniform bool useShadows;
+        uniform samplerCube shadowMap;
+        uniform float shadowFar;
+        uniform float shadowBias;
+        uniform int shadowFilter;
 
         out vec4 FragColor;
 
+        const vec3 pcfOffsets[20] = vec3[](
+            vec3(1, 1, 1), vec3(1, -1, 1), vec3(-1, -1, 1), vec3(-1, 1, 1),
+            vec3(1, 1, -1), vec3(1, -1, -1), vec3(-1, -1, -1), vec3(-1, 1, -1),
+            vec3(1, 1, 0), vec3(1, -1, 0), vec3(-1, -1, 0), vec3(-1, 1, 0),
+            vec3(1, 0, 1), vec3(-1, 0, 1), vec3(1, 0, -1), vec3(-1, 0, -1),
+            vec3(0, 1, 1), vec3(0, -1, 1), vec3(0, -1, -1), vec3(0, 1, -1));
+
+        float shadowFactor(vec3 worldPos, float NdotL) {
+            vec3 toFrag = worldPos - lightPos;
+            float current = length(toFrag);
+            if (current >= shadowFar) {
+                return 1.0;
+            }
+            float bias = shadowBias * (1.5 - NdotL);
+            if (shadowFilter == 0) {
+                return current - bias > texture(shadowMap, toFrag).r * shadowFar ? 0.0 : 1.0;
+            }
+            int taps = shadowFilter == 1 ? 8 : 20;
+            float spread = (1.0 + current / shadowFar) * 0.02 * current;
+            float lit = 0.0;
+            for (int i = 0; i < taps; ++i) {
+                float closest = texture(shadowMap, toFrag + pcfOffsets[i] * spread).r * shadowFar;
+                lit += current - bias > closest ? 0.0 : 1.0;
+            }
+            return lit / float(taps);
+        }
+
         vec2 computeUV(vec3 worldPos, vec3 normal) {
             vec2 uv = vec2(0.0);
             if (projectionMode == 0) {
@@ -142,7 +272,66 @@ void SceneRenderer::init() {
             return uv * uvScale;
         }
 
+        vec3 samplePage(int page, bool nearest, vec3 coord, vec2 dx, vec2 dy) {
+            // sampler arrays only take constant indices in GLSL 3.30
+            if (nearest) {
+                if (page == 0) return textureGrad(nearestPages[0], coord, dx, dy).rgb;
+                if (page == 1) return textureGrad(nearestPages[1], coord, dx, dy).rgb;
+                if (page == 2) return textureGrad(nearestPages[2], coord, dx, dy).rgb;
+                if (page == 3) return textureGrad(nearestPages[3], coord, dx, dy).rgb;
+                return textureGrad(nearestPages[4], coord, dx, dy).rgb;
+            }
+            if (page == 0) return textureGrad(linearPages[0], coord, dx, dy).rgb;
+            if (page == 1) return textureGrad(linearPages[1], coord, dx, dy).rgb;
+            if (page == 2) return textureGrad(linearPages[2], coord, dx, dy).rgb;
+            if (page == 3) return textureGrad(linearPages[3], coord, dx, dy).rgb;
+            return textureGrad(linearPages[4], coord, dx, dy).rgb;
+        }
+
+        vec3 sampleTexture(vec2 uv, int wrapMode, int filterMode) {
+            int page = vTexture.x;
+            vec2 dx = dFdx(uv);
+            vec2 dy = dFdy(uv);
+            if (wrapMode == 1) {
+                float halfTexel = 0.5 / float(128 << page);
+                uv = clamp(uv, vec2(halfTexel), vec2(1.0 - halfTexel));
+            } else if (wrapMode == 2) {
+                uv = 1.0 - abs(mod(uv, 2.0) - 1.0);
+            }
+            return samplePage(page, filterMode == 0, vec3(uv, float(vTexture.y)), dx, dy);
+        }
+
         void main() {
+            projectionMode = vTexture.z & 15;
+            planarAxis = (vTexture.z >> 4) & 15;
+            uvScale = vParams.xy;
+            vec3 matAmbient = vColor.rgb * vColor.a;
+            vec3 matDiffuse = vColor.rgb;
+            vec3 matSpecular = vec3(1.0);
+            float matAmbientStrength = 1.0;
+            float matDiffuseStrength = 1.0;
+            float matSpecularStrength = 1.0;
+            float shininess = 16.0;
+            if (vTexture.w >= 0) {
+                int base = vTexture.w * 4;
+                vec4 ambientData = texelFetch(materialData, base);
+                vec4 diffuseData = texelFetch(materialData, base + 1);
+                vec4 specularData = texelFetch(materialData, base + 2);
+                matAmbient = ambientData.rgb;
+                matDiffuse = diffuseData.rgb;
+                matSpecular = specularData.rgb;
+                matAmbientStrength = ambientData.a;
+                matDiffuseStrength = diffuseData.a;
+                matSpecularStrength = specularData.a;
+                shininess = texelFetch(materialData, base + 3).r * lightShininess;
+            }
+            bool useTexture = vTexture.x >= 0 && !highlight;
+            if (highlight) {
+                matAmbient = vec3(1.0, 0.9, 0.3) * 0.25;
+                matDiffuse = vec3(1.0, 0.9, 0.3);
+                matSpecular = vec3(1.0);
+            }
+
             vec3 N = normalize(vNormal);
             vec3 L = normalize(lightPos - vWorldPos);
             float diff = max(dot(N, L), 0.0);
@@ -154,165 +343,1706 @@ void SceneRenderer::init() {
             vec3 texSample = vec3(1.0);
             if (useTexture) {
                 vec2 uv = computeUV(vWorldPos, N);
-                texSample = texture(diffuseTex, uv).rgb;
+                texSample = sampleTexture(uv, (vTexture.z >> 8) & 15, (vTexture.z >> 12) & 15);
             }
 
             vec3 ambientBase = matAmbient * texSample;
             vec3 diffuseBase = matDiffuse * texSample;
 
-            vec3 ambient = ambientStrength * matAmbientStrength * lightColor * ambientBase;
-            vec3 diffuse = diffuseStrength * matDiffuseStrength * diff * lightColor * diffuseBase;
-            vec3 specular = specularStrength * matSpecularStrength * spec * lightColor * matSpecular;
+            float shadow = useShadows ? shadowFactor(vWorldPos, diff) : 1.0;
+            vec3 ambient = ambientStrength * matAmbientStrength * lightColor * ambientBase;
+            vec3 diffuse = shadow * diffuseStrength * matDiffuseStrength * diff * lightColor * diffuseBase;
+            vec3 specular = shadow * specularStrength * matSpecularStrength * spec * lightColor * matSpecular;
+
+            vec3 pointLighting = vec3(0.0);
+            if (pointLightCount > 0) {
+                float sliceF = log(vViewDepth / clusterNear) / log(clusterFar / clusterNear) * float(clusterDims.z);
+                int slice = clamp(int(floor(sliceF)), 0, clusterDims.z - 1);
+                ivec2 tile = clamp(ivec2(gl_FragCoord.xy / viewportSize * vec2(clusterDims.xy)), ivec2(0), clusterDims.xy - 1);
+                int cluster = (slice * clusterDims.y + tile.y) * clusterDims.x + tile.x;
+                uvec2 range = texelFetch(clusterRanges, cluster).xy;
+                for (uint i = 0u; i < range.y; ++i) {
+                    int li = int(texelFetch(clusterLightIndices, int(range.x + i)).r);
+                    vec4 posRadius = texelFetch(pointLightData, li * 2);
+                    vec3 radiance = texelFetch(pointLightData, li * 2 + 1).rgb;
+                    vec3 toLight = posRadius.xyz - vWorldPos;
+                    float dist = length(toLight);
+                    if (dist >= posRadius.w) {
+                        continue;
+                    }
+                    float falloff = 1.0 - (dist * dist) / (posRadius.w * posRadius.w);
+                    falloff *= falloff;
+                    vec3 Lp = toLight / max(dist, 1e-4);
+                    float pd = max(dot(N, Lp), 0.0);
+                    float ps = pow(max(dot(N, normalize(Lp + V)), 0.0), shininess);
+                    pointLighting += falloff * radiance * (diffuseStrength * matDiffuseStrength * pd * diffuseBase +
+                        specularStrength * matSpecularStrength * ps * matSpecular);
+                }
+            }
+
+            FragColor = vec4(ambient + diffuse + specular + pointLighting, 1.0);
+        }
+    )";
+
+    const char* depthVertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 2) in mat4 aModel;
+
+        uniform mat4 view;
+        uniform mat4 projection;
+
+        invariant gl_Position;
+
+        void main() {
+            vec4 worldPos = aModel * vec4(aPos, 1.0);
+            gl_Position = projection * view * worldPos;
+        }
+    )";
+
+    const char* depthFragmentShader = R"(
+        #version 330 core
+        void main() {
+        }
+    )";
+
+    const char* overdrawFragmentShader = R"(
+        #version 330 core
+        out vec4 FragColor;
+        void main() {
+            // accumulated additively: ~10 layers saturate to white
+            FragColor = vec4(0.10, 0.06, 0.03, 1.0);
+        }
+    )";
+
+    const char* shadowVertexShader = R"(
+        #version 330 core
+        layout (location = 0) in vec3 aPos;
+        layout (location = 2) in mat4 aModel;
+
+        uniform mat4 faceViewProjection;
+
+        out vec3 vWorldPos;
+
+        void main() {
+            vec4 worldPos = aModel * vec4(aPos, 1.0);
+            vWorldPos = worldPos.xyz;
+            gl_Position = faceViewProjection * worldPos;
+        }
+    )";
+
+    const char* shadowFragmentShader = R"(
+        #version 330 core
+        in vec3 vWorldPos;
+
+        uniform vec3 lightPos;
+        uniform float shadowFar;
+
+        void main() {
+            // linear distance so every face compares the same way
+            gl_FragDepth = length(vWorldPos - lightPos) / shadowFar;
+        }
+    )";
+
+    litShader = Shader(vertexShader, fragmentShader);
+    litShader.use();
+    for (int i = 0; i < TextureArrayPool::kPageCount; ++i) {
+        const std::string index = "[" + std::to_string(i) + "]";
+        litShader.setInt(("linearPages" + index).c_str(), static_cast<int>(kLinearPageUnit) + i);
+        litShader.setInt(("nearestPages" + index).c_str(), static_cast<int>(kNearestPageUnit) + i);
+    }
+    litShader.setInt("pointLightData", 1);
+    litShader.setInt("clusterRanges", 2);
+    litShader.setInt("clusterLightIndices", 3);
+    litShader.setInt("shadowMap", 4);
+    litShader.setInt("materialData", static_cast<int>(kMaterialUnit));
+    litShader.setFloat("shadowFar", kShadowFar);
+    litShader.setIVec3("clusterDims", glm::ivec3(LightClusterGrid::kTilesX, LightClusterGrid::kTilesY, LightClusterGrid::kSlices));
+    depthShader = Shader(depthVertexShader, depthFragmentShader);
+    overdrawShader = Shader(depthVertexShader, overdrawFragmentShader);
+    shadowShader = Shader(shadowVertexShader, shadowFragmentShader);
+    shadowShader.use();
+    shadowShader.setFloat("shadowFar", kShadowFar);
+    initialized = true;
+}
+
+void SceneRenderer::addPrimitive(PrimitiveType type, const glm::vec3& position) {
+    ++revision;
+    if (type == PrimitiveType::Mesh) {
+        return; // imported meshes go through addMeshInstance
+    }
+    ensureMesh(type);
+    instances.push_back(makeInstance(type, position));
+    batchedMask.push_back(0);
+    selectionMask.push_back(0);
+    worldMatrices.push_back(modelMatrix(instances.back()));
+    hierarchyDirty = true;
+    const int index = static_cast<int>(instances.size()) - 1;
+    trackInstance(index);
+    if (journal) {
+        journal->recordInstance(JournalOp::AddInstance, *this, index);
+    }
+    if (history) {
+        history->recordAdd(*this, index);
+    }
+}
+
+int SceneRenderer::importMesh(const std::string& filepath) {
+    TRACE_ZONE("SceneRenderer::importMesh");
+    ++revision;
+    const StringId pathId = strings::intern(filepath);
+    for (size_t i = 0; i < importedMeshes.size(); ++i) {
+        if (importedMeshes[i].path == pathId) {
+            return static_cast<int>(i);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    ImportedMeshInfo info;
+    info.name = fileNameOf(filepath);
+    info.path = pathId;
+
+    Mesh mesh;
+    MappedFile cacheFile;
+    MeshCacheView cache;
+    // a missing, stale or corrupt cache falls through to a fresh import, which rewrites it
+    if (meshi_cache_open(filepath.c_str(), cacheFile, cache)) {
+        // upload straight from the mapping, no parsing or intermediate copies
+        mesh = createMesh(cache.vertices, static_cast<size_t>(cache.vertexCount) * 6, cache.indices, cache.indexCount);
+        info.boundsMin = cache.boundsMin;
+        info.boundsMax = cache.boundsMax;
+        info.vertexCount = cache.vertexCount;
+        info.indexCount = cache.indexCount;
+        info.fromCache = true;
+    }
+    else {
+        MeshData data;
+        if (!meshi_load(filepath.c_str(), data)) {
+            std::cerr << "Mesh import failed (" << filepath << "): " << meshi_failure_reason() << std::endl;
+            return -1;
+        }
+        meshi_optimize(data);
+        if (!meshi_cache_write(filepath.c_str(), data)) {
+            std::cerr << "Mesh cache not written (" << filepath << "): " << meshi_failure_reason() << std::endl;
+        }
+        mesh = createMesh(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size());
+        info.boundsMin = data.boundsMin;
+        info.boundsMax = data.boundsMax;
+        info.vertexCount = static_cast<unsigned int>(data.vertices.size() / 6);
+        info.indexCount = static_cast<unsigned int>(data.indices.size());
+    }
+
+    info.radius = std::max(glm::length(info.boundsMin), glm::length(info.boundsMax));
+    info.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const int id = static_cast<int>(importedMeshes.size());
+    meshes[kImportedMeshKeyBase + id] = mesh;
+    importedMeshes.push_back(info);
+    return id;
+}
+
+void SceneRenderer::addMeshInstance(int meshId, const glm::vec3& position) {
+    ++revision;
+    if (meshId < 0 || meshId >= static_cast<int>(importedMeshes.size())) {
+        return;
+    }
+    PrimitiveInstance inst = makeInstance(PrimitiveType::Mesh, position);
+    inst.meshId = meshId;
+    instances.push_back(inst);
+    batchedMask.push_back(0);
+    selectionMask.push_back(0);
+    worldMatrices.push_back(modelMatrix(inst));
+    hierarchyDirty = true;
+    const int index = static_cast<int>(instances.size()) - 1;
+    trackInstance(index);
+    if (journal) {
+        journal->recordInstance(JournalOp::AddInstance, *this, index);
+    }
+    if (history) {
+        history->recordAdd(*this, index);
+    }
+}
+
+int SceneRenderer::addInstance(const PrimitiveInstance& instance, const Material& material, const std::string& texturePath, int index) {
+    ++revision;
+    if (instance.type == PrimitiveType::Mesh) {
+        if (instance.meshId < 0 || instance.meshId >= static_cast<int>(importedMeshes.size())) {
+            return -1;
+        }
+    }
+    else {
+        ensureMesh(instance.type);
+    }
+
+    PrimitiveInstance inst = instance;
+    inst.materialId = materials.intern(material);
+    inst.texturePage = -1;
+    inst.textureLayer = -1;
+    inst.hasTexture = false;
+    inst.textureName = kEmptyString;
+    TextureSlot slot;
+    if (!texturePath.empty() && textures.acquire(strings::intern(texturePath), slot)) {
+        inst.texturePage = slot.page;
+        inst.textureLayer = slot.layer;
+        inst.hasTexture = true;
+        inst.textureName = fileNameOf(texturePath);
+    }
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
+        index = static_cast<int>(instances.size());
+        if (inst.isStatic) {
+            invalidateStaticBatches();
+        }
+    }
+    else {
+        // later instances shift up, and batches refer to them by position
+        invalidateStaticBatches();
+        if (selectedIndex >= index) {
+            ++selectedIndex;
+        }
+        for (int& selected : selection) {
+            if (selected >= index) {
+                ++selected;
+            }
+        }
+        for (PrimitiveInstance& other : instances) {
+            if (other.parent >= index) {
+                ++other.parent;
+            }
+        }
+    }
+    worldMatrices.insert(worldMatrices.begin() + index, modelMatrix(inst));
+    instances.insert(instances.begin() + index, std::move(inst));
+    batchedMask.insert(batchedMask.begin() + index, 0);
+    selectionMask.insert(selectionMask.begin() + index, 0);
+    hierarchyDirty = true;
+    trackInstance(index);
+    if (journal) {
+        journal->recordInstance(JournalOp::AddInstance, *this, index);
+    }
+    if (history) {
+        history->recordAdd(*this, index);
+    }
+    return index;
+}
+
+int SceneRenderer::addInstances(const std::vector<PrimitiveInstance>& batch, const std::vector<Material>& palette) {
+    TRACE_ZONE("SceneRenderer::addInstances");
+    ++revision;
+    const int first = static_cast<int>(instances.size());
+    // the palette holds one reference per entry while the batch adds its own
+    std::vector<int> paletteIds;
+    paletteIds.reserve(palette.size());
+    for (const Material& material : palette) {
+        paletteIds.push_back(materials.intern(material));
+    }
+    const size_t total = instances.size() + batch.size();
+    instances.reserve(total);
+    worldMatrices.reserve(total);
+    batchedMask.reserve(total);
+    selectionMask.reserve(total);
+    spatialHandles.reserve(total);
+
+    for (const PrimitiveInstance& source : batch) {
+        if (source.type == PrimitiveType::Mesh) {
+            if (source.meshId < 0 || source.meshId >= static_cast<int>(importedMeshes.size())) {
+                continue;
+            }
+        }
+        else {
+            ensureMesh(source.type);
+        }
+        PrimitiveInstance inst = source;
+        inst.parent = -1;
+        if (source.materialId >= 0 && source.materialId < static_cast<int>(paletteIds.size())) {
+            inst.materialId = paletteIds[static_cast<size_t>(source.materialId)];
+            materials.addRef(inst.materialId);
+        }
+        else {
+            inst.materialId = materials.intern(defaultMaterialFor(inst.color));
+        }
+        inst.hasTexture = false;
+        inst.texturePage = -1;
+        inst.textureLayer = -1;
+        inst.textureName = kEmptyString;
+        if (inst.isStatic) {
+            invalidateStaticBatches();
+        }
+        worldMatrices.push_back(modelMatrix(inst));
+        instances.push_back(std::move(inst));
+        batchedMask.push_back(0);
+        selectionMask.push_back(0);
+        // appended at the end, so nothing after it needs renumbering as in trackInstance
+        const int index = static_cast<int>(instances.size()) - 1;
+        spatialHandles.push_back(spatial.insert(index, glm::vec3(worldMatrices.back()[3]), worldRadius(index)));
+    }
+    for (int id : paletteIds) {
+        materials.release(id);
+    }
+    hierarchyDirty = true;
+
+    const int added = static_cast<int>(instances.size()) - first;
+    if (added == 0) {
+        return first;
+    }
+    if (journal) {
+        journal->requestSnapshot();
+    }
+    if (history) {
+        // one command for the whole range: undo truncates, redo appends the packed states again
+        history->beginGroup("Add " + std::to_string(added) + " instances");
+        history->recordAddRange(*this, first);
+        history->endGroup();
+    }
+    return first;
+}
+
+SceneFileInstanceState SceneRenderer::captureInstance(int index) const {
+    SceneFileInstanceState state;
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
+        return state;
+    }
+    const PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    state.record = toSceneFileInstance(inst);
+    state.material = toSceneFileMaterial(materials.get(inst.materialId));
+    if (inst.hasTexture) {
+        state.texturePath = getTexturePath(inst);
+    }
+    if (inst.type == PrimitiveType::Mesh && inst.meshId >= 0 && inst.meshId < static_cast<int>(importedMeshes.size())) {
+        state.meshPath = strings::text(importedMeshes[static_cast<size_t>(inst.meshId)].path);
+    }
+    return state;
+}
+
+int SceneRenderer::insertInstance(int index, const SceneFileInstanceState& state) {
+    if (state.record.type > static_cast<uint8_t>(PrimitiveType::Mesh)) {
+        return -1;
+    }
+    PrimitiveInstance inst = fromSceneFileInstance(state.record);
+    if (inst.type == PrimitiveType::Mesh) {
+        inst.meshId = importMesh(state.meshPath);
+        if (inst.meshId < 0) {
+            inst.type = PrimitiveType::Cube; // keeps later indices lined up
+        }
+    }
+    return addInstance(inst, fromSceneFileMaterial(state.material), state.texturePath, index);
+}
+
+float SceneRenderer::getMeshRadius(int meshId) const {
+    if (meshId < 0 || meshId >= static_cast<int>(importedMeshes.size())) {
+        return 0.8f;
+    }
+    return importedMeshes[static_cast<size_t>(meshId)].radius;
+}
+
+float SceneRenderer::worldRadius(int index) const {
+    const PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    const float localScale = std::max(std::fabs(inst.scale.x), std::max(std::fabs(inst.scale.y), std::fabs(inst.scale.z)));
+    const glm::mat4& world = worldMatrices[static_cast<size_t>(index)];
+    const float worldScale = std::max(glm::length(glm::vec3(world[0])),
+        std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+    return localScale > 0.0f ? boundingRadius(inst) * worldScale / localScale : 0.0f;
+}
+
+float SceneRenderer::boundingRadius(const PrimitiveInstance& instance) const {
+    float baseRadius = 0.0f;
+    switch (instance.type) {
+    case PrimitiveType::Cube: baseRadius = 0.867f; break;      // half diagonal of the unit cube
+    case PrimitiveType::Sphere: baseRadius = 0.5f; break;
+    case PrimitiveType::Cylinder: baseRadius = 0.708f; break;  // rim at r 0.5, y 0.5
+    case PrimitiveType::Plane: baseRadius = 1.415f; break;     // corners of the 2x2 quad
+    case PrimitiveType::Mesh: baseRadius = getMeshRadius(instance.meshId); break;
+    }
+    return baseRadius * std::max(std::fabs(instance.scale.x), std::max(std::fabs(instance.scale.y), std::fabs(instance.scale.z)));
+}
+
+Material SceneRenderer::defaultMaterialFor(const glm::vec3& color) const {
+    Material material;
+    getDefaultMaterial(material.ambient, material.diffuse, material.specular, material.shininess,
+        material.ambientStrength, material.diffuseStrength, material.specularStrength);
+    material.diffuse = color;
+    material.ambient = color * 0.2f;
+    return material;
+}
+
+PrimitiveInstance SceneRenderer::makeInstance(PrimitiveType type, const glm::vec3& position) {
+    PrimitiveInstance inst{};
+    inst.type = type;
+    inst.position = position;
+    inst.scale = glm::vec3(1.0f);
+    inst.rotation = glm::vec3(0.0f);
+    inst.color = colorForType(type);
+    inst.materialId = materials.intern(defaultMaterialFor(inst.color));
+    inst.hasTexture = false;
+    inst.texturePage = -1;
+    inst.textureLayer = -1;
+    inst.wrapMode = TextureWrapMode::Repeat;
+    inst.filterMode = TextureFilterMode::Linear;
+    inst.projection = TextureProjection::Planar;
+    inst.planarAxis = PlanarAxis::Y;
+    inst.uvScale = glm::vec2(1.0f);
+    return inst;
+}
+
+int SceneRenderer::meshKey(const PrimitiveInstance& instance) {
+    if (instance.type == PrimitiveType::Mesh) {
+        return kImportedMeshKeyBase + instance.meshId;
+    }
+    return static_cast<int>(instance.type);
+}
+
+void SceneRenderer::releaseInstanceResources(PrimitiveInstance& instance) {
+    TextureSlot slot{ instance.texturePage, instance.textureLayer };
+    textures.release(slot);
+    instance.texturePage = -1;
+    instance.textureLayer = -1;
+    materials.release(instance.materialId);
+    instance.materialId = -1;
+}
+
+void SceneRenderer::setInstanceMaterial(int index, const Material& material) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
+        return;
+    }
+    PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    const Material before = materials.get(inst.materialId);
+    // intern before releasing so an unchanged material never drops to zero references
+    const int id = materials.intern(material);
+    materials.release(inst.materialId);
+    if (id != inst.materialId && inst.isStatic) {
+        invalidateStaticBatches();
+    }
+    inst.materialId = id;
+    if (journal) {
+        journal->recordMaterial(JournalOp::SetMaterial, index, material);
+    }
+    if (history) {
+        history->recordMaterial(UndoOp::Material, index, before, material);
+    }
+}
+
+void SceneRenderer::setSelectionMaterial(const Material& material) {
+    ++revision;
+    if (history && selection.size() > 1) {
+        history->beginGroup("Material of " + std::to_string(selection.size()) + " instances", true);
+    }
+    for (int index : selection) {
+        setInstanceMaterial(index, material);
+    }
+    if (history && selection.size() > 1) {
+        history->endGroup();
+    }
+}
+
+void SceneRenderer::setInstanceFields(int index, const SceneFileInstance& record) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
+        return;
+    }
+    PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    const SceneFileInstance before = toSceneFileInstance(inst);
+    const PrimitiveInstance source = fromSceneFileInstance(record);
+    inst.position = source.position;
+    inst.scale = source.scale;
+    inst.rotation = source.rotation;
+    if (inst.parent != source.parent) {
+        inst.parent = source.parent < static_cast<int>(instances.size()) ? source.parent : -1;
+        hierarchyDirty = true; // a cycle is cut when the hierarchy is rebuilt
+    }
+    markTransformDirty(index);
+    inst.color = source.color;
+    inst.uvScale = source.uvScale;
+    inst.wrapMode = source.wrapMode;
+    inst.filterMode = source.filterMode;
+    inst.projection = source.projection;
+    inst.planarAxis = source.planarAxis;
+    inst.castsShadow = source.castsShadow;
+    if (inst.isStatic != source.isStatic) {
+        inst.isStatic = source.isStatic;
+        invalidateStaticBatches();
+    }
+    else if (inst.isStatic && !selectionMask[static_cast<size_t>(index)]) {
+        invalidateStaticBatches(); // its baked copy moved
+    }
+    if (journal) {
+        journal->recordInstance(JournalOp::SetInstance, *this, index);
+    }
+    recordFields(index, before);
+}
+
+void SceneRenderer::recordFields(int index, const SceneFileInstance& before) {
+    if (history) {
+        history->recordFields(index, before, toSceneFileInstance(instances[static_cast<size_t>(index)]));
+    }
+}
+
+bool SceneRenderer::setParent(int index, int parent) {
+    const int count = static_cast<int>(instances.size());
+    if (index < 0 || index >= count || parent < -1 || parent >= count) {
+        return false;
+    }
+    for (int ancestor = parent; ancestor >= 0; ancestor = instances[static_cast<size_t>(ancestor)].parent) {
+        if (ancestor == index) {
+            return false;
+        }
+    }
+    PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    if (inst.parent == parent) {
+        return true;
+    }
+    ++revision;
+    updateTransforms();
+    const SceneFileInstance before = toSceneFileInstance(inst);
+    const glm::mat4 parentMatrix = parent >= 0 ? worldMatrices[static_cast<size_t>(parent)] : glm::mat4(1.0f);
+    decomposeModel(glm::inverse(parentMatrix) * worldMatrices[static_cast<size_t>(index)], inst.position, inst.rotation, inst.scale);
+    inst.parent = parent;
+    hierarchyDirty = true;
+    if (journal) {
+        journal->recordInstance(JournalOp::SetInstance, *this, index);
+    }
+    recordFields(index, before);
+    return true;
+}
+
+void SceneRenderer::markTransformDirty(int index) {
+    if (hierarchyDirty) {
+        return; // everything is recomputed after the rebuild anyway
+    }
+    if (!transformQueued[static_cast<size_t>(index)]) {
+        transformQueued[static_cast<size_t>(index)] = 1;
+        dirtyTransforms.push_back(index);
+    }
+}
+
+glm::mat4 SceneRenderer::parentWorld(int index) const {
+    const int parent = instances[static_cast<size_t>(index)].parent;
+    return parent >= 0 ? worldMatrices[static_cast<size_t>(parent)] : glm::mat4(1.0f);
+}
+
+void SceneRenderer::updateWorldMatrix(int index) {
+    const PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    const glm::mat4 world = inst.parent >= 0 ? worldMatrices[static_cast<size_t>(inst.parent)] * modelMatrix(inst) : modelMatrix(inst);
+    glm::mat4& cached = worldMatrices[static_cast<size_t>(index)];
+    if (batchedMask[static_cast<size_t>(index)] && world != cached) {
+        invalidateStaticBatches(); // a baked instance moved with its parent
+    }
+    cached = world;
+    spatial.update(spatialHandles[static_cast<size_t>(index)], glm::vec3(world[3]), worldRadius(index));
+}
+
+void SceneRenderer::trackInstance(int index) {
+    const int handle = spatial.insert(index, glm::vec3(worldMatrices[static_cast<size_t>(index)][3]), worldRadius(index));
+    spatialHandles.insert(spatialHandles.begin() + index, handle);
+    // items are instance indices, so everything after an insertion is renumbered
+    for (size_t i = static_cast<size_t>(index) + 1; i < spatialHandles.size(); ++i) {
+        spatial.setItem(spatialHandles[i], static_cast<int>(i));
+    }
+}
+
+void SceneRenderer::rebuildHierarchy() {
+    TRACE_ZONE("SceneRenderer::rebuildHierarchy");
+    const int count = static_cast<int>(instances.size());
+    // children of each instance as contiguous ranges of childList; the scratch vectors are members so
+    // their capacity carries over between rebuilds
+    childStart.assign(static_cast<size_t>(count) + 1, 0);
+    for (PrimitiveInstance& inst : instances) {
+        if (inst.parent >= count) {
+            inst.parent = -1;
+        }
+        if (inst.parent >= 0) {
+            ++childStart[static_cast<size_t>(inst.parent) + 1];
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        childStart[static_cast<size_t>(i) + 1] += childStart[static_cast<size_t>(i)];
+    }
+    childList.assign(static_cast<size_t>(childStart.back()), 0);
+    childFill.assign(childStart.begin(), childStart.end() - 1);
+    for (int i = 0; i < count; ++i) {
+        const int parent = instances[static_cast<size_t>(i)].parent;
+        if (parent >= 0) {
+            childList[static_cast<size_t>(childFill[static_cast<size_t>(parent)]++)] = i;
+        }
+    }
+
+    hierarchy.clear();
+    hierarchy.reserve(static_cast<size_t>(count));
+    hierarchySlot.assign(static_cast<size_t>(count), -1);
+    std::vector<std::pair<int, int>>& stack = hierarchyStack;
+    stack.clear();
+    const auto enter = [&](int index) {
+        hierarchySlot[static_cast<size_t>(index)] = static_cast<int>(hierarchy.size());
+        hierarchy.push_back({ index, instances[static_cast<size_t>(index)].parent, static_cast<int>(stack.size()), 0 });
+        stack.push_back({ index, childStart[static_cast<size_t>(index)] });
+    };
+    const auto visit = [&](int root) {
+        enter(root);
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.second < childStart[static_cast<size_t>(top.first) + 1]) {
+                const int child = childList[static_cast<size_t>(top.second++)];
+                if (hierarchySlot[static_cast<size_t>(child)] < 0) {
+                    enter(child);
+                }
+            }
+            else {
+                hierarchy[static_cast<size_t>(hierarchySlot[static_cast<size_t>(top.first)])].end = static_cast<int>(hierarchy.size());
+                stack.pop_back();
+            }
+        }
+    };
+    for (int i = 0; i < count; ++i) {
+        if (instances[static_cast<size_t>(i)].parent < 0) {
+            visit(i);
+        }
+    }
+    // whatever is left hangs off a cycle; cut it loose there
+    for (int i = 0; i < count; ++i) {
+        if (hierarchySlot[static_cast<size_t>(i)] < 0) {
+            instances[static_cast<size_t>(i)].parent = -1;
+            visit(i);
+        }
+    }
+
+    worldMatrices.resize(static_cast<size_t>(count), glm::mat4(1.0f));
+    transformQueued.assign(static_cast<size_t>(count), 0);
+    dirtyTransforms.clear();
+    hierarchyDirty = false;
+}
+
+void SceneRenderer::updateTransforms() {
+    if (!hierarchyDirty) {
+        // a parent changed through getSelectedMutable() needs the structure rebuilt
+        for (int index : dirtyTransforms) {
+            if (instances[static_cast<size_t>(index)].parent != hierarchy[static_cast<size_t>(hierarchySlot[static_cast<size_t>(index)])].parent) {
+                hierarchyDirty = true;
+                break;
+            }
+        }
+    }
+    if (hierarchyDirty) {
+        rebuildHierarchy();
+        for (const HierarchyNode& node : hierarchy) {
+            updateWorldMatrix(node.instance);
+        }
+        stats.transformsUpdated += static_cast<int>(hierarchy.size());
+        return;
+    }
+    if (dirtyTransforms.empty()) {
+        return;
+    }
+    // subtrees are contiguous in depth-first order, so walking the queued instances in that order
+    // skips every one that lies inside a subtree already updated
+    std::sort(dirtyTransforms.begin(), dirtyTransforms.end(), [this](int a, int b) {
+        return hierarchySlot[static_cast<size_t>(a)] < hierarchySlot[static_cast<size_t>(b)];
+    });
+    int covered = 0;
+    for (int index : dirtyTransforms) {
+        transformQueued[static_cast<size_t>(index)] = 0;
+        const int slot = hierarchySlot[static_cast<size_t>(index)];
+        if (slot < covered) {
+            continue;
+        }
+        covered = hierarchy[static_cast<size_t>(slot)].end;
+        for (int entry = slot; entry < covered; ++entry) {
+            updateWorldMatrix(hierarchy[static_cast<size_t>(entry)].instance);
+        }
+        stats.transformsUpdated += covered - slot;
+    }
+    dirtyTransforms.clear();
+}
+
+void SceneRenderer::editMaterial(int materialId, const Material& material) {
+    ++revision;
+    const Material before = materials.get(materialId);
+    materials.update(materialId, material);
+    if (journal || history) {
+        // ids are not stable across a reload, so the edit is addressed through an instance that uses it
+        for (size_t i = 0; i < instances.size(); ++i) {
+            if (instances[i].materialId == materialId) {
+                if (journal) {
+                    journal->recordMaterial(JournalOp::EditMaterial, static_cast<int>(i), material);
+                }
+                if (history) {
+                    history->recordMaterial(UndoOp::SharedMaterial, static_cast<int>(i), before, material);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void SceneRenderer::uploadMaterials() {
+    int begin = 0;
+    int end = 0;
+    stats.materials = materials.liveCount();
+    stats.materialUploads = 0;
+    if (!materials.takeDirtyRange(begin, end)) {
+        return;
+    }
+    const auto& texels = materials.texels();
+    if (materials.capacity() > materialBufferCapacity) {
+        // grow with headroom so adding materials rarely reallocates
+        const int capacity = std::max(64, materials.capacity() * 2);
+        FrameVector<glm::vec4> padded(static_cast<size_t>(capacity) * MaterialTable::kTexelsPerMaterial, glm::vec4(0.0f),
+            FrameAllocator<glm::vec4>(frameArena));
+        std::copy(texels.begin(), texels.end(), padded.begin());
+        uploadTextureBuffer(materialBuffer, GL_RGBA32F, padded.data(), padded.size() * sizeof(glm::vec4));
+        materialBufferCapacity = capacity;
+        stats.materialUploads = static_cast<int>(padded.size() * sizeof(glm::vec4));
+        return;
+    }
+    // only the entries that changed; a shared edit is a single 64 byte write
+    const size_t offset = static_cast<size_t>(begin) * MaterialTable::kTexelsPerMaterial;
+    const size_t count = static_cast<size_t>(end - begin) * MaterialTable::kTexelsPerMaterial;
+    glBindBuffer(GL_TEXTURE_BUFFER, materialBuffer.buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, static_cast<GLintptr>(offset * sizeof(glm::vec4)),
+        static_cast<GLsizeiptr>(count * sizeof(glm::vec4)), &texels[offset]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    stats.materialUploads = static_cast<int>(count * sizeof(glm::vec4));
+}
+
+void SceneRenderer::clear() {
+    ++revision;
+    if (history && !instances.empty()) {
+        history->recordClear(*this);
+    }
+    for (auto& inst : instances) {
+        releaseInstanceResources(inst);
+    }
+    instances.clear();
+    batchedMask.clear();
+    worldMatrices.clear();
+    spatial.clear();
+    spatialHandles.clear();
+    hierarchyDirty = true;
+    selectedIndex = -1;
+    selection.clear();
+    selectionMask.clear();
+    selectionStale = false;
+    invalidateStaticBatches();
+    if (journal) {
+        journal->recordClear();
+    }
+}
+
+bool SceneRenderer::saveScene(const std::string& path) const {
+    TRACE_ZONE("SceneRenderer::saveScene");
+    SceneFileTables tables;
+    buildSceneTables(tables);
+    return writeSceneFile(path, tables);
+}
+
+void SceneRenderer::buildSceneTables(SceneFileTables& tables) const {
+    TRACE_ZONE("SceneRenderer::buildSceneTables");
+    tables.light = light;
+    for (const ImportedMeshInfo& info : importedMeshes) {
+        tables.meshPaths.push_back(strings::text(info.path));
+    }
+
+    // shared materials and texture layers become one table entry each
+    std::vector<int32_t> materialIndex(static_cast<size_t>(materials.capacity()), -1);
+    std::unordered_map<StringId, int32_t> textureIndex; // by path
+    tables.instances.reserve(instances.size());
+    for (const PrimitiveInstance& inst : instances) {
+        SceneFileInstance record = toSceneFileInstance(inst);
+        if (inst.type == PrimitiveType::Mesh) {
+            record.mesh = inst.meshId;
+        }
+
+        if (materials.valid(inst.materialId)) {
+            int32_t& index = materialIndex[static_cast<size_t>(inst.materialId)];
+            if (index < 0) {
+                index = static_cast<int32_t>(tables.materials.size());
+                tables.materials.push_back(toSceneFileMaterial(materials.get(inst.materialId)));
+            }
+            record.material = index;
+        }
+
+        const StringId texturePath = inst.hasTexture ? textures.pathOf(TextureSlot{ inst.texturePage, inst.textureLayer }) : kEmptyString;
+        if (texturePath != kEmptyString) {
+            const auto found = textureIndex.emplace(texturePath, static_cast<int32_t>(tables.texturePaths.size()));
+            if (found.second) {
+                tables.texturePaths.push_back(strings::text(texturePath));
+            }
+            record.texture = found.first->second;
+        }
+        tables.instances.push_back(record);
+    }
+
+    for (const PointLight& pointLight : pointLights) {
+        tables.pointLights.push_back(toSceneFilePointLight(pointLight));
+    }
+}
+
+bool SceneRenderer::loadScene(const std::string& path) {
+    TRACE_ZONE("SceneRenderer::loadScene");
+    MappedFile file;
+    SceneFileView view;
+    if (!openSceneFile(path, file, view)) {
+        return false;
+    }
+
+    SceneReplaceScope replace(*this);
+    clear();
+    pointLights.clear();
+    selectedLight = kNoLight;
+    light = view.light;
+
+    // resolve the small tables once; each table entry holds one reference until the instances took theirs
+    std::vector<int> meshIds;
+    for (const std::string& meshPath : view.meshPaths) {
+        meshIds.push_back(importMesh(meshPath));
+    }
+    std::vector<int> materialIds;
+    for (uint32_t i = 0; i < view.materialCount; ++i) {
+        materialIds.push_back(materials.intern(fromSceneFileMaterial(view.materials[i])));
+    }
+    std::vector<TextureSlot> textureSlots(view.texturePaths.size());
+    std::vector<StringId> textureNames(view.texturePaths.size());
+    for (size_t i = 0; i < view.texturePaths.size(); ++i) {
+        if (!textures.acquire(strings::intern(view.texturePaths[i]), textureSlots[i])) {
+            std::cerr << "Scene texture missing: " << view.texturePaths[i] << std::endl;
+        }
+        textureNames[i] = fileNameOf(view.texturePaths[i]);
+    }
+    for (PrimitiveType type : { PrimitiveType::Cube, PrimitiveType::Sphere, PrimitiveType::Cylinder, PrimitiveType::Plane }) {
+        ensureMesh(type);
+    }
+
+    // records are read straight from the mapping
+    size_t skipped = 0;
+    instances.reserve(view.instanceCount);
+    std::vector<int> loadedIndex(view.instanceCount, -1); // record -> instance, parents are remapped below
+    for (uint32_t i = 0; i < view.instanceCount; ++i) {
+        const SceneFileInstance& record = view.instances[i];
+        if (record.type > static_cast<uint8_t>(PrimitiveType::Mesh)) {
+            ++skipped;
+            continue;
+        }
+        PrimitiveInstance inst = fromSceneFileInstance(record);
+        if (inst.type == PrimitiveType::Mesh) {
+            if (record.mesh < 0 || record.mesh >= static_cast<int32_t>(meshIds.size()) ||
+                meshIds[static_cast<size_t>(record.mesh)] < 0) {
+                ++skipped;
+                continue;
+            }
+            inst.meshId = meshIds[static_cast<size_t>(record.mesh)];
+        }
+
+        if (record.material >= 0 && record.material < static_cast<int32_t>(materialIds.size())) {
+            inst.materialId = materialIds[static_cast<size_t>(record.material)];
+            materials.addRef(inst.materialId);
+        }
+        else {
+            inst.materialId = materials.intern(defaultMaterialFor(inst.color));
+        }
+
+        inst.texturePage = -1;
+        inst.textureLayer = -1;
+        if (record.texture >= 0 && record.texture < static_cast<int32_t>(textureSlots.size()) &&
+            textureSlots[static_cast<size_t>(record.texture)].valid()) {
+            const TextureSlot& slot = textureSlots[static_cast<size_t>(record.texture)];
+            textures.addRef(slot);
+            inst.texturePage = slot.page;
+            inst.textureLayer = slot.layer;
+            inst.hasTexture = true;
+            inst.textureName = textureNames[static_cast<size_t>(record.texture)];
+        }
+        loadedIndex[i] = static_cast<int>(instances.size());
+        instances.push_back(std::move(inst));
+    }
+    for (PrimitiveInstance& inst : instances) {
+        inst.parent = inst.parent >= 0 && inst.parent < static_cast<int>(loadedIndex.size()) ?
+            loadedIndex[static_cast<size_t>(inst.parent)] : -1;
+    }
+    batchedMask.assign(instances.size(), 0);
+    selectionMask.assign(instances.size(), 0);
+    worldMatrices.assign(instances.size(), glm::mat4(1.0f));
+    hierarchyDirty = true;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        // roots are placed right away, children move to their world position on the first update
+        spatialHandles.push_back(spatial.insert(static_cast<int>(i), instances[i].position, boundingRadius(instances[i])));
+    }
+
+    for (int id : materialIds) {
+        materials.release(id);
+    }
+    for (TextureSlot& slot : textureSlots) {
+        textures.release(slot);
+    }
+    for (uint32_t i = 0; i < view.pointLightCount; ++i) {
+        pointLights.push_back(fromSceneFilePointLight(view.pointLights[i]));
+    }
+    if (skipped > 0) {
+        std::cerr << "Scene " << path << ": skipped " << skipped << " instances with unknown types or meshes" << std::endl;
+    }
+    invalidateStaticBatches();
+    ++revision;
+    return true;
+}
+
+void SceneRenderer::draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos) {
+    if (!initialized) {
+        return;
+    }
+    TRACE_ZONE("SceneRenderer::draw");
+    const uint64_t heapBefore = heap::allocations();
+    // last frame's transient data is dead by now
+    frameArena.reset();
+    workerPool.resetArenas();
+
+    stats.transformsUpdated = 0;
+    updateTransforms();
+    if (staticBatchesDirty) {
+        rebuildStaticBatches();
+    }
+    stats.drawCalls = 0;
+    stats.stateChanges = 0;
+    {
+        TRACE_ZONE("SceneRenderer::buildInstanceStream");
+        buildInstanceStream(view);
+    }
+    updateShadowMap();
+
+    bindProgram(litShader);
+    litShader.setMat4("view", view);
+    litShader.setMat4("projection", projection);
+    litShader.setVec3("cameraPos", cameraPos);
+
+    litShader.setVec3("lightPos", light.position);
+    litShader.setVec3("lightColor", light.color);
+    litShader.setFloat("ambientStrength", light.ambient);
+    litShader.setFloat("diffuseStrength", light.diffuse);
+    litShader.setFloat("specularStrength", light.specular);
+    litShader.setFloat("lightShininess", light.shininess);
+    litShader.setInt("highlight", 0);
+    litShader.setInt("useShadows", settings.shadows && shadowCubeMap ? 1 : 0);
+    litShader.setFloat("shadowBias", settings.shadowBias);
+    litShader.setInt("shadowFilter", static_cast<int>(settings.shadowFilter));
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, settings.shadows ? shadowCubeMap : 0);
+    glActiveTexture(GL_TEXTURE0);
+    // every instance texture is reachable from here on, nothing is bound per object
+    textures.bind(kLinearPageUnit, kNearestPageUnit);
+    stats.texturePages = textures.pageCount();
+    stats.textureLayers = textures.layerCount();
+    uploadMaterials();
+    glActiveTexture(GL_TEXTURE0 + kMaterialUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, materialBuffer.texture);
+    glActiveTexture(GL_TEXTURE0);
+    {
+        GpuProfiler::Scope zone(profiler, "Light clusters");
+        updateLightClusters(view, projection);
+    }
+
+    if (settings.depthPrepass) {
+        GpuProfiler::Scope zone(profiler, "Depth pre-pass");
+        beginPassTimer(prepassTimer);
+        bindProgram(depthShader);
+        depthShader.setMat4("view", view);
+        depthShader.setMat4("projection", projection);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        drawGeometry(depthShader, false);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        endPassTimer(prepassTimer);
+
+        // depth is final: shade each visible pixel exactly once
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    {
+        GpuProfiler::Scope zone(profiler, "Colour pass");
+        beginPassTimer(colorPassTimer);
+        if (settings.showOverdraw) {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            bindProgram(overdrawShader);
+            overdrawShader.setMat4("view", view);
+            overdrawShader.setMat4("projection", projection);
+            drawGeometry(overdrawShader, false);
+            glDisable(GL_BLEND);
+        }
+        else {
+            bindProgram(litShader);
+            drawGeometry(litShader, true);
+        }
+        endPassTimer(colorPassTimer);
+    }
+
+    if (settings.depthPrepass) {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    // running average of the whole scene cost for whichever strategy is active
+    const float sceneMs = (settings.depthPrepass ? prepassTimer.ms : 0.0f) + colorPassTimer.ms;
+    float& strategyMs = settings.depthPrepass ? stats.prepassStrategyMs : stats.sortedStrategyMs;
+    strategyMs = strategyMs == 0.0f ? sceneMs : strategyMs + (sceneMs - strategyMs) * 0.05f;
+    stats.prepassMs = settings.depthPrepass ? prepassTimer.ms : 0.0f;
+    stats.colorPassMs = colorPassTimer.ms;
+
+    // light indicator and point light gizmos in one instanced draw
+    if (gizmoRun.count > 0) {
+        GpuProfiler::Scope zone(profiler, "Gizmos");
+        bindProgram(litShader);
+        litShader.setInt("useShadows", 0); // the indicator sits inside the cube map
+        drawRun(gizmoRun);
+        glBindVertexArray(0);
+    }
+    stats.heapAllocations = static_cast<int>(heap::allocations() - heapBefore);
+}
+
+void SceneRenderer::updateLightClusters(const glm::mat4& view, const glm::mat4& projection) {
+    stats.pointLights = static_cast<int>(pointLights.size());
+    litShader.setInt("pointLightCount", static_cast<int>(pointLights.size()));
+    if (pointLights.empty()) {
+        stats.clusterLightRefs = 0;
+        stats.clusterBuildMs = 0.0f;
+        return;
+    }
+
+    // near/far recovered from the perspective matrix so the slicing always matches the camera
+    const float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    const float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    const auto start = std::chrono::steady_clock::now();
+    clusterGrid.build(pointLights, view, projection, nearPlane, farPlane, workerPool);
+    stats.clusterBuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.clusterLightRefs = static_cast<int>(clusterGrid.lightIndices().size());
+
+    lightTexels.resize(pointLights.size() * 2);
+    for (size_t i = 0; i < pointLights.size(); ++i) {
+        lightTexels[i * 2] = glm::vec4(pointLights[i].position, pointLights[i].radius);
+        lightTexels[i * 2 + 1] = glm::vec4(pointLights[i].color * pointLights[i].intensity, 0.0f);
+    }
+    uploadTextureBuffer(lightBuffer, GL_RGBA32F, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+    uploadTextureBuffer(clusterBuffer, GL_RG32UI, clusterGrid.clusters().data(), clusterGrid.clusters().size() * sizeof(glm::uvec2));
+    uploadTextureBuffer(clusterIndexBuffer, GL_R32UI, clusterGrid.lightIndices().data(),
+        clusterGrid.lightIndices().size() * sizeof(unsigned int));
+
+    GLint viewport[4] = { 0, 0, 1, 1 };
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    litShader.setVec2("viewportSize", glm::vec2(static_cast<float>(viewport[2]), static_cast<float>(viewport[3])));
+    litShader.setFloat("clusterNear", nearPlane);
+    litShader.setFloat("clusterFar", farPlane);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, lightBuffer.texture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterBuffer.texture);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, clusterIndexBuffer.texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+unsigned int SceneRenderer::shadowFacesTouched(const glm::vec3& center, float radius) const {
+    const glm::vec3 v = center - shadowLightPos;
+    if (glm::length(v) - radius > kShadowFar) {
+        return 0;
+    }
+    // each face frustum is bounded by the planes major +- minor = 0 (normals of length sqrt 2)
+    const float slack = radius * 1.41421356f;
+    unsigned int mask = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float a = v[(axis + 1) % 3];
+        const float b = v[(axis + 2) % 3];
+        for (int sign = 0; sign < 2; ++sign) {
+            const float major = sign == 0 ? v[axis] : -v[axis];
+            if (major + slack >= std::fabs(a) && major + slack >= std::fabs(b) && major + radius > 0.0f) {
+                mask |= 1u << (axis * 2 + sign);
+            }
+        }
+    }
+    return mask;
+}
+
+void SceneRenderer::updateShadowMap() {
+    stats.shadowFacesRendered = 0;
+    if (!settings.shadows) {
+        return;
+    }
+
+    const int size = std::clamp(settings.shadowMapSize, 64, 4096);
+    if (!shadowCubeMap || shadowMapAllocated != size) {
+        destroyShadowMap();
+        glGenTextures(1, &shadowCubeMap);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, shadowCubeMap);
+        for (int face = 0; face < 6; ++face) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        glGenFramebuffers(1, &shadowFbo);
+        shadowMapAllocated = size;
+        shadowDirtyFaces = 0x3F;
+    }
+
+    if (light.position != shadowLightPos) {
+        shadowLightPos = light.position;
+        shadowDirtyFaces = 0x3F;
+    }
+
+    // diff the casters against what the cache was rendered with; a change dirties
+    // the faces that saw the old placement and the faces that see the new one
+    const size_t casterCount = std::max(instances.size(), shadowCasters.size());
+    shadowCasters.resize(casterCount);
+    for (size_t i = 0; i < casterCount; ++i) {
+        ShadowCaster current;
+        if (i < instances.size() && instances[i].castsShadow) {
+            current = ShadowCaster{ worldMatrices[i], meshKey(instances[i]), worldRadius(static_cast<int>(i)) };
+        }
+        ShadowCaster& cached = shadowCasters[i];
+        if (current.mesh == cached.mesh && (current.mesh < 0 || current.model == cached.model)) {
+            continue;
+        }
+        if (shadowDirtyFaces != 0x3F) {
+            if (cached.mesh >= 0) {
+                shadowDirtyFaces |= shadowFacesTouched(glm::vec3(cached.model[3]), cached.radius);
+            }
+            if (current.mesh >= 0) {
+                shadowDirtyFaces |= shadowFacesTouched(glm::vec3(current.model[3]), current.radius);
+            }
+        }
+        cached = current;
+    }
+    shadowCasters.resize(instances.size());
+
+    if (!shadowDirtyFaces) {
+        return; // cached map is still valid
+    }
+
+    // faces each run can reach; batches have no single bound and go everywhere
+    FrameVector<unsigned int> runFaces(drawRuns.size(), 0, FrameAllocator<unsigned int>(frameArena));
+    for (size_t r = 0; r < drawRuns.size(); ++r) {
+        const DrawRun& run = drawRuns[r];
+        for (unsigned int slot = run.first; slot < run.first + run.count && run.castsShadow; ++slot) {
+            const unsigned int source = streamSource[slot];
+            runFaces[r] |= source == kNoSource ? 0x3Fu :
+                shadowFacesTouched(glm::vec3(shadowCasters[source].model[3]), shadowCasters[source].radius);
+        }
+    }
+
+    GLint previousFbo = 0;
+    GLint viewport[4] = { 0, 0, 0, 0 };
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFbo);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    GpuProfiler::Scope zone(profiler, "Shadow map");
+    beginPassTimer(shadowTimer);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFbo);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glViewport(0, 0, size, size);
+    bindProgram(shadowShader);
+    shadowShader.setVec3("lightPos", shadowLightPos);
+    for (int face = 0; face < 6; ++face) {
+        if (shadowDirtyFaces & (1u << face)) {
+            renderShadowFace(face, runFaces);
+            ++stats.shadowFacesRendered;
+        }
+    }
+    endPassTimer(shadowTimer);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFbo));
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    shadowDirtyFaces = 0;
+    ++stats.shadowMapUpdates;
+    stats.shadowPassMs = shadowTimer.ms;
+}
+
+void SceneRenderer::renderShadowFace(int face, const FrameVector<unsigned int>& runFaces) {
+    static const glm::vec3 directions[6] = {
+        { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+        { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+    static const glm::vec3 ups[6] = {
+        { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f },
+        { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, shadowCubeMap, 0);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, kShadowNear, kShadowFar);
+    shadowShader.setMat4("faceViewProjection",
+        projection * glm::lookAt(shadowLightPos, shadowLightPos + directions[face], ups[face]));
+
+    const unsigned int faceBit = 1u << face;
+    for (size_t r = 0; r < drawRuns.size(); ++r) {
+        if (drawRuns[r].castsShadow && (runFaces[r] & faceBit)) {
+            drawRun(drawRuns[r]);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+void SceneRenderer::destroyShadowMap() {
+    if (shadowFbo) {
+        glDeleteFramebuffers(1, &shadowFbo);
+        shadowFbo = 0;
+    }
+    if (shadowCubeMap) {
+        glDeleteTextures(1, &shadowCubeMap);
+        shadowCubeMap = 0;
+    }
+    shadowMapAllocated = 0;
+}
+
+void SceneRenderer::uploadTextureBuffer(TextureBuffer& target, GLenum format, const void* data, size_t bytes) {
+    if (!target.buffer) {
+        glGenBuffers(1, &target.buffer);
+        glGenTextures(1, &target.texture);
+    }
+    // never allocate an empty store; a zero-light cluster list still needs a valid texture
+    const unsigned int placeholder[4] = { 0, 0, 0, 0 };
+    if (bytes == 0) {
+        data = placeholder;
+        bytes = sizeof(placeholder);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(bytes), data, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, target.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, target.buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void SceneRenderer::destroyTextureBuffer(TextureBuffer& target) {
+    if (target.texture) {
+        glDeleteTextures(1, &target.texture);
+        target.texture = 0;
+    }
+    if (target.buffer) {
+        glDeleteBuffers(1, &target.buffer);
+        target.buffer = 0;
+    }
+}
+
+int SceneRenderer::addPointLight(const PointLight& pointLight) {
+    const int index = static_cast<int>(pointLights.size());
+    insertPointLight(index, pointLight);
+    return index;
+}
+
+void SceneRenderer::insertPointLight(int index, const PointLight& pointLight) {
+    ++revision;
+    index = std::clamp(index, 0, static_cast<int>(pointLights.size()));
+    pointLights.insert(pointLights.begin() + index, pointLight);
+    if (selectedLight >= index) {
+        ++selectedLight;
+    }
+    if (journal) {
+        journal->recordAddPointLight(index, pointLight);
+    }
+    if (history) {
+        history->recordAddPointLight(index, pointLight);
+    }
+}
+
+void SceneRenderer::removePointLight(int index) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(pointLights.size())) {
+        return;
+    }
+    if (history) {
+        history->recordRemovePointLight(index, pointLights[static_cast<size_t>(index)]);
+    }
+    pointLights.erase(pointLights.begin() + index);
+    if (journal) {
+        journal->recordRemovePointLight(index);
+    }
+    if (selectedLight == index) {
+        selectedLight = kNoLight;
+    }
+    else if (selectedLight > index) {
+        --selectedLight;
+    }
+}
+
+void SceneRenderer::clearPointLights() {
+    ++revision;
+    if (history && !pointLights.empty()) {
+        history->recordClearPointLights(pointLights);
+    }
+    pointLights.clear();
+    if (selectedLight >= 0) {
+        selectedLight = kNoLight;
+    }
+    if (journal) {
+        journal->recordClearPointLights();
+    }
+}
+
+void SceneRenderer::selectLight(int index) {
+    ++revision;
+    if (index == -1 || (index >= 0 && index < static_cast<int>(pointLights.size()))) {
+        selectedLight = index;
+    }
+}
+
+glm::vec3* SceneRenderer::getSelectedLightPosition() {
+    if (selectedLight == -1) {
+        return &light.position;
+    }
+    if (selectedLight >= 0 && selectedLight < static_cast<int>(pointLights.size())) {
+        return &pointLights[static_cast<size_t>(selectedLight)].position;
+    }
+    return nullptr;
+}
+
+void SceneRenderer::buildInstanceStream(const glm::mat4& view) {
+    // grouped by mesh (then shadow casting) so each group is one instanced draw
+    FrameVector<DrawItem> drawOrder{ FrameAllocator<DrawItem>(frameArena) };
+    drawOrder.reserve(instances.size());
+    for (size_t idx = 0; idx < instances.size(); ++idx) {
+        if (batchedMask[idx]) {
+            continue;
+        }
+        const PrimitiveInstance& inst = instances[idx];
+        const glm::vec4 viewPos = view * worldMatrices[idx][3];
+        drawOrder.push_back({ meshKey(inst), inst.castsShadow, -viewPos.z, static_cast<unsigned int>(idx) });
+    }
+    // group by mesh so each group is one draw; inside a group sort front-to-back, except with
+    // a pre-pass where the order no longer affects shading cost and insertion order is kept
+    const bool byDepth = settings.frontToBack && !settings.depthPrepass;
+    std::sort(drawOrder.begin(), drawOrder.end(), [byDepth](const DrawItem& a, const DrawItem& b) {
+        if (a.mesh != b.mesh) {
+            return a.mesh < b.mesh;
+        }
+        if (a.castsShadow != b.castsShadow) {
+            return a.castsShadow;
+        }
+        return byDepth && a.depth != b.depth ? a.depth < b.depth : a.instance < b.instance;
+    });
+
+    // batches, the draw order, the main light and point light markers, and at most the draw order again
+    // for the selection highlight
+    FrameVector<InstanceAttributes> instanceStream{ FrameAllocator<InstanceAttributes>(frameArena) };
+    instanceStream.reserve(staticBatches.size() + drawOrder.size() * (selection.empty() ? 1 : 2) + 1 + pointLights.size());
+    streamSource.clear();
+    drawRuns.clear();
+    selectedRuns.clear();
+    gizmoRun = DrawRun{};
+
+    // merged static geometry is already in world space
+    for (const auto& batch : staticBatches) {
+        DrawRun run{ batch.mesh.VAO, batch.mesh.indexCount, static_cast<unsigned int>(instanceStream.size()), 1,
+            batch.material.castsShadow };
+        instanceStream.push_back(packInstance(batch.material, glm::mat4(1.0f)));
+        streamSource.push_back(kNoSource);
+        drawRuns.push_back(run);
+    }
+
+    for (const DrawItem& item : drawOrder) {
+        const auto it = meshes.find(item.mesh);
+        if (it == meshes.end()) {
+            continue;
+        }
+        if (drawRuns.empty() || drawRuns.back().VAO != it->second.VAO || drawRuns.back().castsShadow != item.castsShadow) {
+            drawRuns.push_back({ it->second.VAO, it->second.indexCount, static_cast<unsigned int>(instanceStream.size()), 0,
+                item.castsShadow });
+        }
+        const PrimitiveInstance& inst = instances[item.instance];
+        instanceStream.push_back(packInstance(inst, worldMatrices[item.instance]));
+        streamSource.push_back(item.instance);
+        ++drawRuns.back().count;
+    }
+
+    ensureMesh(PrimitiveType::Cube);
+    const Mesh& cube = meshes[static_cast<int>(PrimitiveType::Cube)];
+    gizmoRun = { cube.VAO, cube.indexCount, static_cast<unsigned int>(instanceStream.size()), 0, false };
+    // markers carry their colour directly instead of a material entry
+    InstanceAttributes marker{};
+    marker.model = glm::scale(glm::translate(glm::mat4(1.0f), light.position), glm::vec3(0.3f));
+    marker.color = glm::vec4(light.color, 0.3f);
+    marker.texture = glm::ivec4(-1, 0, 0, -1);
+    instanceStream.push_back(marker);
+    // point light gizmos, the selected one drawn larger
+    for (size_t i = 0; i < pointLights.size(); ++i) {
+        const float size = static_cast<int>(i) == selectedLight ? 0.25f : 0.15f;
+        marker.model = glm::scale(glm::translate(glm::mat4(1.0f), pointLights[i].position), glm::vec3(size));
+        marker.color = glm::vec4(pointLights[i].color, 2.0f);
+        instanceStream.push_back(marker);
+    }
+    gizmoRun.count = static_cast<unsigned int>(instanceStream.size()) - gizmoRun.first;
+
+    // the selection again, in the same mesh order, for the wireframe highlight
+    for (size_t i = 0; i < drawOrder.size() && !selection.empty(); ++i) {
+        const DrawItem& item = drawOrder[i];
+        const auto it = meshes.find(item.mesh);
+        if (!selectionMask[item.instance] || it == meshes.end()) {
+            continue;
+        }
+        if (selectedRuns.empty() || selectedRuns.back().VAO != it->second.VAO) {
+            selectedRuns.push_back({ it->second.VAO, it->second.indexCount, static_cast<unsigned int>(instanceStream.size()), 0, false });
+        }
+        instanceStream.push_back(packInstance(instances[item.instance], worldMatrices[item.instance]));
+        ++selectedRuns.back().count;
+    }
+
+    if (!instanceBuffer) {
+        glGenBuffers(1, &instanceBuffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instanceStream.size() * sizeof(InstanceAttributes)),
+        instanceStream.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+SceneRenderer::InstanceAttributes SceneRenderer::packInstance(const PrimitiveInstance& instance, const glm::mat4& model) const {
+    InstanceAttributes attributes;
+    attributes.model = model;
+    attributes.params = glm::vec4(instance.uvScale.x, instance.uvScale.y, 0.0f, 0.0f);
+    attributes.color = glm::vec4(instance.color, 1.0f);
+    const bool textured = instance.hasTexture && instance.texturePage >= 0;
+    const int modes = static_cast<int>(instance.projection) | (static_cast<int>(instance.planarAxis) << 4) |
+        (static_cast<int>(instance.wrapMode) << 8) | (static_cast<int>(instance.filterMode) << 12);
+    attributes.texture = glm::ivec4(textured ? instance.texturePage : -1, instance.textureLayer, modes, instance.materialId);
+    return attributes;
+}
+
+void SceneRenderer::drawRun(const DrawRun& run) {
+    // no base instance in GL 3.3, so the per-instance pointers are offset to the run instead
+    glBindVertexArray(run.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    const size_t base = run.first * sizeof(InstanceAttributes);
+    const GLsizei stride = sizeof(InstanceAttributes);
+    for (GLuint column = 0; column < 4; ++column) {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, stride,
+            reinterpret_cast<void*>(base + offsetof(InstanceAttributes, model) + column * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(base + offsetof(InstanceAttributes, params)));
+    glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(base + offsetof(InstanceAttributes, color)));
+    glVertexAttribIPointer(8, 4, GL_INT, stride, reinterpret_cast<void*>(base + offsetof(InstanceAttributes, texture)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawElementsInstanced(GL_TRIANGLES, run.indexCount, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(run.count));
+    ++stats.drawCalls;
+    ++stats.stateChanges; // vertex array plus instance pointers
+}
+
+void SceneRenderer::bindProgram(const Shader& shader) {
+    shader.use();
+    ++stats.stateChanges;
+}
+
+void SceneRenderer::drawGeometry(const Shader& shader, bool withMaterials) {
+    for (const DrawRun& run : drawRuns) {
+        drawRun(run);
+    }
+
+    if (withMaterials && !selectedRuns.empty()) {
+        // draw outline in wireframe for selection highlight
+        GLint depthFunc = GL_LESS;
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        if (depthFunc == GL_EQUAL) {
+            glDepthFunc(GL_LEQUAL); // rasterized lines don't match the filled depth exactly
+        }
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        glLineWidth(2.0f);
+        shader.setInt("highlight", 1);
+        for (const DrawRun& run : selectedRuns) {
+            drawRun(run);
+        }
+        shader.setInt("highlight", 0);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDepthFunc(static_cast<GLenum>(depthFunc));
+    }
+
+    glBindVertexArray(0);
+}
 
-            FragColor = vec4(ambient + diffuse + specular, 1.0);
+void SceneRenderer::beginPassTimer(PassTimer& timer) {
+    if (!timer.queries[0]) {
+        glGenQueries(2, timer.queries);
+    }
+    const int slot = timer.frame & 1;
+    if (timer.pending[slot]) {
+        GLint available = 0;
+        glGetQueryObjectiv(timer.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(timer.queries[slot], GL_QUERY_RESULT, &elapsed);
+            timer.ms = static_cast<float>(static_cast<double>(elapsed) / 1.0e6);
         }
-    )";
+    }
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[slot]);
+    timer.pending[slot] = true;
+}
 
-    litShader = Shader(vertexShader, fragmentShader);
-    litShader.use();
-    litShader.setInt("diffuseTex", 0);
-    initialized = true;
+void SceneRenderer::endPassTimer(PassTimer& timer) {
+    glEndQuery(GL_TIME_ELAPSED);
+    ++timer.frame;
 }
 
-void SceneRenderer::addPrimitive(PrimitiveType type, const glm::vec3& position) {
-    ensureMesh(type);
-    glm::vec3 amb, diff, spec;
-    float shin = 32.0f;
-    float ambStr = 1.0f, diffStr = 1.0f, specStr = 1.0f;
-    getDefaultMaterial(amb, diff, spec, shin, ambStr, diffStr, specStr);
-    diff = colorForType(type);
-    amb = diff * 0.2f;
-    PrimitiveInstance inst{};
-    inst.type = type;
-    inst.position = position;
-    inst.scale = glm::vec3(1.0f);
-    inst.rotation = glm::vec3(0.0f);
-    inst.color = diff;
-    inst.matAmbient = amb;
-    inst.matDiffuse = diff;
-    inst.matSpecular = spec;
-    inst.matShininess = shin;
-    inst.matAmbientStrength = ambStr;
-    inst.matDiffuseStrength = diffStr;
-    inst.matSpecularStrength = specStr;
-    inst.hasTexture = false;
-    inst.textureId = 0;
-    inst.wrapMode = TextureWrapMode::Repeat;
-    inst.filterMode = TextureFilterMode::Linear;
-    inst.projection = TextureProjection::Planar;
-    inst.planarAxis = PlanarAxis::Y;
-    inst.uvScale = glm::vec2(1.0f);
-    instances.push_back(inst);
+void SceneRenderer::destroyPassTimer(PassTimer& timer) {
+    if (timer.queries[0]) {
+        glDeleteQueries(2, timer.queries);
+        timer.queries[0] = timer.queries[1] = 0;
+    }
 }
 
-void SceneRenderer::clear() {
-    for (auto& inst : instances) {
-        if (inst.textureId) {
-            glDeleteTextures(1, &inst.textureId);
-            inst.textureId = 0;
-        }
+void SceneRenderer::setFreezeStatic(bool enabled) {
+    ++revision;
+    if (freezeStatic == enabled) {
+        return;
     }
-    instances.clear();
-    selectedIndex = -1;
+    freezeStatic = enabled;
+    invalidateStaticBatches();
 }
 
-void SceneRenderer::draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos) {
-    if (!initialized) {
+void SceneRenderer::setInstanceStatic(int index, bool isStatic) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
         return;
     }
+    PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+    if (inst.isStatic != isStatic) {
+        const SceneFileInstance before = toSceneFileInstance(inst);
+        inst.isStatic = isStatic;
+        invalidateStaticBatches();
+        if (journal) {
+            journal->recordStatic(index, isStatic);
+        }
+        recordFields(index, before);
+    }
+}
 
-    litShader.use();
-    litShader.setMat4("view", view);
-    litShader.setMat4("projection", projection);
-    litShader.setVec3("cameraPos", cameraPos);
+void SceneRenderer::setSelectionStatic(bool isStatic) {
+    ++revision;
+    if (history && selection.size() > 1) {
+        history->beginGroup("Make " + std::to_string(selection.size()) + (isStatic ? " instances static" : " instances dynamic"));
+    }
+    for (int index : selection) {
+        setInstanceStatic(index, isStatic);
+    }
+    if (history && selection.size() > 1) {
+        history->endGroup();
+    }
+}
 
-    litShader.setVec3("lightPos", light.position);
-    litShader.setVec3("lightColor", light.color);
-    litShader.setFloat("ambientStrength", light.ambient);
-    litShader.setFloat("diffuseStrength", light.diffuse);
-    litShader.setFloat("specularStrength", light.specular);
-    // shininess will be set per-instance
+void SceneRenderer::rebuildStaticBatches() {
+    TRACE_ZONE("SceneRenderer::rebuildStaticBatches");
+    destroyStaticBatches();
+    stats.staticBatches = 0;
+    stats.batchedInstances = 0;
+    stats.drawCallsSaved = 0;
+    batchedMask.assign(instances.size(), 0);
+    staticBatchesDirty = false;
+    if (!freezeStatic) {
+        return;
+    }
 
-    for (const auto& instance : instances) {
-        const auto it = meshes.find(instance.type);
-        if (it == meshes.end()) {
+    // group eligible instances by shading state; selected ones stay individual
+    std::vector<std::pair<size_t, std::vector<size_t>>> groups; // representative, members
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const PrimitiveInstance& inst = instances[i];
+        if (!inst.isStatic || selectionMask[i] || meshes.find(meshKey(inst)) == meshes.end()) {
             continue;
         }
+        auto group = std::find_if(groups.begin(), groups.end(),
+            [&](const auto& g) { return sameBatchState(instances[g.first], inst); });
+        if (group == groups.end()) {
+            groups.push_back({ i, {} });
+            group = groups.end() - 1;
+        }
+        group->second.push_back(i);
+    }
 
-        glm::mat4 model(1.0f);
-        model = glm::translate(model, instance.position);
-        model = glm::rotate(model, glm::radians(instance.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(instance.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(instance.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::scale(model, instance.scale);
-        litShader.setMat4("model", model);
-        litShader.setVec3("matAmbient", instance.matAmbient);
-        litShader.setVec3("matDiffuse", instance.matDiffuse);
-        litShader.setVec3("matSpecular", instance.matSpecular);
-        litShader.setFloat("matAmbientStrength", instance.matAmbientStrength);
-        litShader.setFloat("matDiffuseStrength", instance.matDiffuseStrength);
-        litShader.setFloat("matSpecularStrength", instance.matSpecularStrength);
-        litShader.setFloat("shininess", instance.matShininess * light.shininess);
-        litShader.setInt("useTexture", instance.hasTexture && instance.textureId ? 1 : 0);
-        litShader.setInt("projectionMode", static_cast<int>(instance.projection));
-        litShader.setInt("planarAxis", static_cast<int>(instance.planarAxis));
-        litShader.setVec2("uvScale", instance.uvScale);
-
-        if (instance.hasTexture && instance.textureId) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, instance.textureId);
+    for (const auto& [representative, members] : groups) {
+        if (members.size() < 2) {
+            continue; // nothing to merge
         }
-        else {
-            glBindTexture(GL_TEXTURE_2D, 0);
+        std::vector<float> vertices;
+        std::vector<unsigned int> indices;
+        int mergedCount = 0;
+        const auto flush = [&]() {
+            if (mergedCount == 0) {
+                return;
+            }
+            StaticBatch batch;
+            batch.mesh = createMesh(vertices, indices);
+            batch.material = instances[representative];
+            batch.instanceCount = mergedCount;
+            staticBatches.push_back(batch);
+            vertices.clear();
+            indices.clear();
+            mergedCount = 0;
+        };
+
+        for (size_t idx : members) {
+            const PrimitiveInstance& inst = instances[idx];
+            const MeshData& source = bakeSource(meshKey(inst));
+            const size_t sourceVertices = source.vertices.size() / 6;
+            if (sourceVertices == 0) {
+                continue;
+            }
+            if (vertices.size() / 6 + sourceVertices > kMaxBatchVertices) {
+                flush();
+            }
+
+            const glm::mat4& model = worldMatrices[idx];
+            const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+            const unsigned int base = static_cast<unsigned int>(vertices.size() / 6);
+            for (size_t v = 0; v < sourceVertices; ++v) {
+                const float* src = &source.vertices[v * 6];
+                const glm::vec3 p = glm::vec3(model * glm::vec4(src[0], src[1], src[2], 1.0f));
+                const glm::vec3 n = glm::normalize(normalMatrix * glm::vec3(src[3], src[4], src[5]));
+                vertices.push_back(p.x); vertices.push_back(p.y); vertices.push_back(p.z);
+                vertices.push_back(n.x); vertices.push_back(n.y); vertices.push_back(n.z);
+            }
+            for (unsigned int index : source.indices) {
+                indices.push_back(base + index);
+            }
+            batchedMask[idx] = 1;
+            ++mergedCount;
+            ++stats.batchedInstances;
         }
+        flush();
+    }
 
-        glBindVertexArray(it->second.VAO);
-        glDrawElements(GL_TRIANGLES, it->second.indexCount, GL_UNSIGNED_INT, nullptr);
+    stats.staticBatches = static_cast<int>(staticBatches.size());
+    stats.drawCallsSaved = stats.batchedInstances - stats.staticBatches;
+}
 
-        const size_t idx = static_cast<size_t>(&instance - instances.data());
-        if (static_cast<int>(idx) == selectedIndex) {
-            // draw outline in wireframe for selection highlight
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            glLineWidth(2.0f);
-            const glm::vec3 highlight(1.0f, 0.9f, 0.3f);
-            litShader.setVec3("matAmbient", highlight * 0.25f);
-            litShader.setVec3("matDiffuse", highlight);
-            litShader.setVec3("matSpecular", glm::vec3(1.0f));
-            litShader.setFloat("matAmbientStrength", instance.matAmbientStrength);
-            litShader.setFloat("matDiffuseStrength", instance.matDiffuseStrength);
-            litShader.setFloat("matSpecularStrength", instance.matSpecularStrength);
-            litShader.setFloat("shininess", instance.matShininess * light.shininess);
-            litShader.setInt("useTexture", 0);
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glDrawElements(GL_TRIANGLES, it->second.indexCount, GL_UNSIGNED_INT, nullptr);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
+void SceneRenderer::destroyStaticBatches() {
+    for (auto& batch : staticBatches) {
+        destroyMesh(batch.mesh);
     }
+    staticBatches.clear();
+}
 
-    glBindVertexArray(0);
+const MeshData& SceneRenderer::bakeSource(int key) {
+    auto cached = bakeSources.find(key);
+    if (cached != bakeSources.end()) {
+        return cached->second;
+    }
 
-    // draw light indicator
-    ensureMesh(PrimitiveType::Cube);
-    const auto itLight = meshes.find(PrimitiveType::Cube);
-    if (itLight != meshes.end()) {
-        glm::mat4 model(1.0f);
-        model = glm::translate(model, light.position);
-        model = glm::scale(model, glm::vec3(0.3f));
-        litShader.setMat4("model", model);
-        litShader.setVec3("matAmbient", light.color * 0.3f);
-        litShader.setVec3("matDiffuse", light.color);
-        litShader.setVec3("matSpecular", glm::vec3(1.0f));
-        litShader.setFloat("matAmbientStrength", 1.0f);
-        litShader.setFloat("matDiffuseStrength", 1.0f);
-        litShader.setFloat("matSpecularStrength", 1.0f);
-        litShader.setFloat("shininess", 16.0f);
-        litShader.setInt("useTexture", 0);
-        litShader.setInt("projectionMode", 0);
-        litShader.setInt("planarAxis", 1);
-        litShader.setVec2("uvScale", glm::vec2(1.0f));
-        glBindVertexArray(itLight->second.VAO);
-        glDrawElements(GL_TRIANGLES, itLight->second.indexCount, GL_UNSIGNED_INT, nullptr);
+    // one-off readback of the uploaded geometry; only happens the first time a mesh is baked
+    MeshData& data = bakeSources[key];
+    const auto it = meshes.find(key);
+    if (it == meshes.end()) {
+        return data;
     }
+    glBindVertexArray(it->second.VAO);
+    GLint vertexBytes = 0;
+    GLint indexBytes = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, it->second.VBO);
+    glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &vertexBytes);
+    glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &indexBytes);
+    data.vertices.resize(static_cast<size_t>(vertexBytes) / sizeof(float));
+    data.indices.resize(static_cast<size_t>(indexBytes) / sizeof(unsigned int));
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, data.vertices.data());
+    glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, data.indices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return data;
 }
 
 SceneRenderer::Mesh SceneRenderer::buildCube() {
@@ -379,8 +2109,11 @@ SceneRenderer::Mesh SceneRenderer::buildPlane() {
 }
 
 SceneRenderer::Mesh SceneRenderer::buildSphere(int slices, int stacks) {
+    // sized exactly so nothing regrows
     std::vector<float> vertices;
     std::vector<unsigned int> indices;
+    vertices.reserve(static_cast<size_t>(stacks + 1) * (slices + 1) * 6);
+    indices.reserve(static_cast<size_t>(stacks) * slices * 6);
 
     for (int y = 0; y <= stacks; ++y) {
         const float v = static_cast<float>(y) / static_cast<float>(stacks);
@@ -425,12 +2158,15 @@ SceneRenderer::Mesh SceneRenderer::buildSphere(int slices, int stacks) {
 }
 
 SceneRenderer::Mesh SceneRenderer::buildCylinder(int slices) {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-
     const float halfHeight = 0.5f;
     const int ringSize = slices + 1;
 
+    // side rings (2), cap rings and centres; 12 indices per slice
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    vertices.reserve(static_cast<size_t>(4 * ringSize + 2) * 6);
+    indices.reserve(static_cast<size_t>(slices) * 12);
+
     // side vertices
     for (int i = 0; i < ringSize; ++i) {
         const float t = static_cast<float>(i) / static_cast<float>(slices);
@@ -513,6 +2249,11 @@ SceneRenderer::Mesh SceneRenderer::buildCylinder(int slices) {
 }
 
 SceneRenderer::Mesh SceneRenderer::createMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) {
+    return createMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+}
+
+SceneRenderer::Mesh SceneRenderer::createMesh(const float* vertices, size_t floatCount, const unsigned int* indices, size_t indexCount) {
+    TRACE_ZONE("SceneRenderer::createMesh");
     Mesh mesh;
 
     glGenVertexArrays(1, &mesh.VAO);
@@ -522,19 +2263,25 @@ SceneRenderer::Mesh SceneRenderer::createMesh(const std::vector<float>& vertices
     glBindVertexArray(mesh.VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, floatCount * sizeof(float), vertices, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void*>(0));
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
+    // per-instance attributes, pointed into the instance stream by drawRun
+    for (GLuint location = 2; location <= 8; ++location) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
     glBindVertexArray(0);
 
-    mesh.indexCount = static_cast<GLsizei>(indices.size());
+    mesh.indexCount = static_cast<GLsizei>(indexCount);
     return mesh;
 }
 
@@ -555,81 +2302,79 @@ void SceneRenderer::destroyMesh(Mesh& mesh) {
 }
 
 bool SceneRenderer::loadTextureForSelected(const std::string& filepath) {
+    ++revision;
     PrimitiveInstance* inst = getSelectedMutable();
     if (!inst) {
         return false;
     }
 
-    int width = 0, height = 0, channels = 0;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(filepath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
-    if (!data) {
+    // acquire first so reloading the same file never drops its layer
+    TextureSlot slot;
+    if (!textures.acquire(strings::intern(filepath), slot)) {
         return false;
     }
+    TextureSlot previous{ inst->texturePage, inst->textureLayer };
+    const std::string previousPath = inst->hasTexture ? strings::text(textures.pathOf(previous)) : std::string();
+    textures.release(previous);
 
-    if (inst->textureId) {
-        glDeleteTextures(1, &inst->textureId);
-        inst->textureId = 0;
-    }
-
-    glGenTextures(1, &inst->textureId);
-    glBindTexture(GL_TEXTURE_2D, inst->textureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
-
-    applyTextureSettings(*inst);
-
+    inst->texturePage = slot.page;
+    inst->textureLayer = slot.layer;
     inst->hasTexture = true;
-    inst->textureName = std::filesystem::path(filepath).filename().string();
-
-    glBindTexture(GL_TEXTURE_2D, 0);
+    inst->textureName = fileNameOf(filepath);
+    if (journal) {
+        journal->recordTexture(selectedIndex, filepath);
+    }
+    if (history) {
+        history->recordTexture(selectedIndex, previousPath, filepath);
+    }
     return true;
 }
 
+const std::string& SceneRenderer::getTexturePath(const PrimitiveInstance& instance) const {
+    return strings::text(textures.pathOf(TextureSlot{ instance.texturePage, instance.textureLayer }));
+}
+
 void SceneRenderer::removeTextureFromSelected() {
+    ++revision;
     PrimitiveInstance* inst = getSelectedMutable();
     if (!inst) {
         return;
     }
-    if (inst->textureId) {
-        glDeleteTextures(1, &inst->textureId);
-        inst->textureId = 0;
+    TextureSlot slot{ inst->texturePage, inst->textureLayer };
+    if (history && inst->hasTexture) {
+        history->recordTexture(selectedIndex, strings::text(textures.pathOf(slot)), std::string());
     }
+    textures.release(slot);
+    inst->texturePage = -1;
+    inst->textureLayer = -1;
     inst->hasTexture = false;
-    inst->textureName.clear();
-}
-
-void SceneRenderer::applyTextureSettings(PrimitiveInstance& inst) {
-    if (!inst.textureId) {
-        return;
+    inst->textureName = kEmptyString;
+    if (journal) {
+        journal->recordTexture(selectedIndex, std::string());
     }
-    glBindTexture(GL_TEXTURE_2D, inst.textureId);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, toGlWrap(inst.wrapMode));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, toGlWrap(inst.wrapMode));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, toGlMinFilter(inst.filterMode));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, toGlMagFilter(inst.filterMode));
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void SceneRenderer::ensureMesh(PrimitiveType type) {
-    if (meshes.find(type) != meshes.end()) {
+    const int key = static_cast<int>(type);
+    if (meshes.find(key) != meshes.end()) {
         return;
     }
 
     switch (type) {
     case PrimitiveType::Cube:
-        meshes[type] = buildCube();
+        meshes[key] = buildCube();
         break;
     case PrimitiveType::Sphere:
-        meshes[type] = buildSphere();
+        meshes[key] = buildSphere();
         break;
     case PrimitiveType::Cylinder:
-        meshes[type] = buildCylinder();
+        meshes[key] = buildCylinder();
         break;
     case PrimitiveType::Plane:
-        meshes[type] = buildPlane();
+        meshes[key] = buildPlane();
         break;
+    case PrimitiveType::Mesh:
+        break; // registered by importMesh
     }
 }
 
@@ -643,6 +2388,8 @@ glm::vec3 SceneRenderer::colorForType(PrimitiveType type) const {
         return glm::vec3(0.35f, 0.8f, 0.55f);
     case PrimitiveType::Plane:
         return glm::vec3(0.75f, 0.75f, 0.8f);
+    case PrimitiveType::Mesh:
+        return glm::vec3(0.7f, 0.68f, 0.62f);
     }
     return glm::vec3(0.8f);
 }
@@ -658,66 +2405,562 @@ void SceneRenderer::getDefaultMaterial(glm::vec3& ambient, glm::vec3& diffuse, g
     specularStrength = 1.0f;
 }
 
-void SceneRenderer::select(int index) {
-    if (index >= 0 && index < static_cast<int>(instances.size())) {
-        selectedIndex = index;
+void SceneRenderer::select(int index, SelectMode mode) {
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
+        ++revision;
+        return;
+    }
+    select(std::vector<int>{ index }, mode);
+}
+
+void SceneRenderer::select(const std::vector<int>& indices, SelectMode mode) {
+    ++revision;
+    const int count = static_cast<int>(instances.size());
+    if (mode == SelectMode::Replace) {
+        std::vector<int> sorted = indices;
+        std::sort(sorted.begin(), sorted.end());
+        for (int index : selection) {
+            if (!std::binary_search(sorted.begin(), sorted.end(), index)) {
+                setSelected(index, false);
+            }
+        }
+    }
+    for (int index : indices) {
+        if (index < 0 || index >= count) {
+            continue;
+        }
+        const bool selected = mode == SelectMode::Remove ? false :
+            mode == SelectMode::Toggle ? !isSelected(index) : true;
+        setSelected(index, selected);
+        if (selected) {
+            selectedIndex = index; // the last one picked becomes primary
+        }
+    }
+    if (selectionStale) {
+        selection.erase(std::remove_if(selection.begin(), selection.end(),
+            [this](int index) { return !selectionMask[static_cast<size_t>(index)]; }), selection.end());
+        selectionStale = false;
+    }
+    if (selectedIndex >= 0 && (selectedIndex >= count || !isSelected(selectedIndex))) {
+        selectedIndex = selection.empty() ? -1 : selection.back();
+    }
+}
+
+void SceneRenderer::setSelected(int index, bool selected) {
+    unsigned char& flag = selectionMask[static_cast<size_t>(index)];
+    if ((flag != 0) == selected) {
+        return;
+    }
+    flag = selected ? 1 : 0;
+    if (selected) {
+        selection.push_back(index);
+    }
+    else {
+        selectionStale = true; // dropped from the list in one pass afterwards
+    }
+    // selected instances are drawn on their own, so a baked one has to be un-baked and vice versa
+    if (instances[static_cast<size_t>(index)].isStatic) {
+        invalidateStaticBatches();
     }
 }
 
 void SceneRenderer::clearSelection() {
+    ++revision;
+    for (int index : selection) {
+        selectionMask[static_cast<size_t>(index)] = 0;
+        if (instances[static_cast<size_t>(index)].isStatic) {
+            invalidateStaticBatches();
+        }
+    }
+    selection.clear();
+    selectionStale = false;
     selectedIndex = -1;
 }
 
-void SceneRenderer::translateSelected(const glm::vec3& delta) {
-    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(instances.size())) {
+void SceneRenderer::selectionRoots(std::vector<int>& roots) const {
+    roots.clear();
+    for (int index : selection) {
+        bool covered = false;
+        for (int ancestor = instances[static_cast<size_t>(index)].parent; ancestor >= 0 && !covered;
+            ancestor = instances[static_cast<size_t>(ancestor)].parent) {
+            covered = selectionMask[static_cast<size_t>(ancestor)] != 0;
+        }
+        if (!covered) {
+            roots.push_back(index);
+        }
+    }
+}
+
+void SceneRenderer::transformSelection(JournalOp op, const glm::vec3& value) {
+    ++revision;
+    std::vector<int> roots;
+    selectionRoots(roots);
+    if (roots.empty()) {
         return;
     }
-    instances[static_cast<size_t>(selectedIndex)].position += delta;
+    updateTransforms();
+    // one history entry per gesture, however many instances it moves
+    const bool grouped = history && roots.size() > 1;
+    if (grouped) {
+        const char* verb = op == JournalOp::Rotate ? "Rotate " : op == JournalOp::Scale ? "Scale " : "Move ";
+        history->beginGroup(verb + std::to_string(roots.size()) + " instances", true);
+    }
+    for (int index : roots) {
+        PrimitiveInstance& inst = instances[static_cast<size_t>(index)];
+        const SceneFileInstance before = toSceneFileInstance(inst);
+        if (op == JournalOp::Translate) {
+            inst.position += glm::inverse(glm::mat3(parentWorld(index))) * value;
+        }
+        else if (op == JournalOp::Rotate) {
+            inst.rotation += value;
+        }
+        else if (op == JournalOp::Scale) {
+            glm::vec3 adjusted = value;
+            if (inst.type == PrimitiveType::Plane) {
+                adjusted.y = 0.0f; // lock height, allow in-plane scaling (x/z)
+            }
+            inst.scale = glm::max(inst.scale + adjusted, glm::vec3(0.1f));
+        }
+        else {
+            inst.position = glm::vec3(glm::inverse(parentWorld(index)) * glm::vec4(value, 1.0f));
+        }
+        markTransformDirty(index);
+        if (journal) {
+            journal->recordVector(op, index, value);
+        }
+        recordFields(index, before);
+    }
+    if (grouped) {
+        history->endGroup();
+    }
+}
+
+void SceneRenderer::translateSelected(const glm::vec3& delta) {
+    transformSelection(JournalOp::Translate, delta);
 }
 
 void SceneRenderer::rotateSelected(const glm::vec3& deltaDegrees) {
+    transformSelection(JournalOp::Rotate, deltaDegrees);
+}
+
+void SceneRenderer::scaleSelected(const glm::vec3& deltaScale) {
+    transformSelection(JournalOp::Scale, deltaScale);
+}
+
+void SceneRenderer::setSelectedPosition(const glm::vec3& position) {
     if (selectedIndex < 0 || selectedIndex >= static_cast<int>(instances.size())) {
+        ++revision;
+        return;
+    }
+    if (selection.size() > 1) {
+        updateTransforms();
+        transformSelection(JournalOp::Translate, position - getWorldPosition(selectedIndex));
         return;
     }
-    instances[static_cast<size_t>(selectedIndex)].rotation += deltaDegrees;
+    transformSelection(JournalOp::SetPosition, position);
 }
 
-void SceneRenderer::scaleSelected(const glm::vec3& deltaScale) {
-    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(instances.size())) {
+void SceneRenderer::setSelectedLightPosition(const glm::vec3& position) {
+    if (selectedLight == -1) {
+        const LightSettings before = light;
+        light.position = position;
+        noteLightEdited(before);
+    }
+    else if (selectedLight >= 0 && selectedLight < static_cast<int>(pointLights.size())) {
+        PointLight& pointLight = pointLights[static_cast<size_t>(selectedLight)];
+        const PointLight before = pointLight;
+        pointLight.position = position;
+        notePointLightEdited(selectedLight, before);
+    }
+}
+
+void SceneRenderer::removeSelected() {
+    ++revision;
+    std::vector<int> roots;
+    selectionRoots(roots);
+    if (roots.empty()) {
         return;
     }
-    auto& inst = instances[static_cast<size_t>(selectedIndex)];
-    glm::vec3 adjusted = deltaScale;
-    if (inst.type == PrimitiveType::Plane) {
-        adjusted.y = 0.0f; // lock height, allow in-plane scaling (x/z)
+    updateTransforms();
+    std::vector<int> doomed;
+    for (int root : roots) {
+        const int slot = hierarchySlot[static_cast<size_t>(root)];
+        for (int entry = slot; entry < hierarchy[static_cast<size_t>(slot)].end; ++entry) {
+            doomed.push_back(hierarchy[static_cast<size_t>(entry)].instance);
+        }
+    }
+    if (history) {
+        history->beginGroup(roots.size() > 1 ?
+            "Delete " + std::to_string(doomed.size()) + " instances" :
+            "Delete instance " + std::to_string(roots.front()) +
+            (doomed.size() > 1 ? " and " + std::to_string(doomed.size() - 1) + " children" : std::string()));
+        // recorded as if removed one at a time back to front, children before their parents, so undo can
+        // re-insert them in order; a Fenwick tree over removed indices gives each the index it would have had
+        std::vector<int> removedBelow(instances.size() + 1, 0);
+        const auto countBelow = [&removedBelow](int index) {
+            int sum = 0;
+            for (int i = index; i > 0; i -= i & -i) {
+                sum += removedBelow[static_cast<size_t>(i)];
+            }
+            return sum;
+        };
+        for (size_t k = doomed.size(); k-- > 0;) {
+            const int index = doomed[k];
+            SceneFileInstanceState state = captureInstance(index);
+            if (state.record.parent > 0) {
+                state.record.parent -= countBelow(state.record.parent - 1);
+            }
+            history->recordRemove(index - countBelow(index), state);
+            for (int i = index + 1; i < static_cast<int>(removedBelow.size()); i += i & -i) {
+                ++removedBelow[static_cast<size_t>(i)];
+            }
+        }
+        history->endGroup();
+    }
+
+    // compact every per-instance array in one pass; remap takes old indices to new ones, -1 = removed
+    const size_t count = instances.size();
+    std::vector<int> remap(count, 0);
+    for (int index : doomed) {
+        remap[static_cast<size_t>(index)] = -1;
+    }
+    bool baked = false;
+    int kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (remap[i] < 0) {
+            baked = baked || batchedMask[i];
+            releaseInstanceResources(instances[i]);
+            spatial.remove(spatialHandles[i]);
+            continue;
+        }
+        remap[i] = kept;
+        const size_t to = static_cast<size_t>(kept++);
+        if (to != i) {
+            instances[to] = std::move(instances[i]);
+            batchedMask[to] = batchedMask[i];
+            selectionMask[to] = selectionMask[i];
+            worldMatrices[to] = worldMatrices[i];
+            spatialHandles[to] = spatialHandles[i];
+            spatial.setItem(spatialHandles[to], kept - 1);
+        }
+    }
+    if (baked) {
+        invalidateStaticBatches();
+    }
+    instances.erase(instances.begin() + kept, instances.end());
+    batchedMask.erase(batchedMask.begin() + kept, batchedMask.end());
+    selectionMask.erase(selectionMask.begin() + kept, selectionMask.end());
+    worldMatrices.erase(worldMatrices.begin() + kept, worldMatrices.end());
+    spatialHandles.erase(spatialHandles.begin() + kept, spatialHandles.end());
+    for (PrimitiveInstance& inst : instances) {
+        if (inst.parent >= 0) {
+            inst.parent = remap[static_cast<size_t>(inst.parent)];
+        }
+    }
+    size_t selectedCount = 0;
+    for (int selected : selection) {
+        if (remap[static_cast<size_t>(selected)] >= 0) {
+            selection[selectedCount++] = remap[static_cast<size_t>(selected)];
+        }
+    }
+    selection.resize(selectedCount);
+    if (selectedIndex >= 0) {
+        selectedIndex = remap[static_cast<size_t>(selectedIndex)];
+    }
+    if (selectedIndex < 0) {
+        selectedIndex = selection.empty() ? -1 : selection.back();
+    }
+    hierarchyDirty = true;
+    if (journal) {
+        journal->requestSnapshot();
     }
-    inst.scale = glm::max(inst.scale + adjusted, glm::vec3(0.1f));
 }
 
-void SceneRenderer::setSelectedPosition(const glm::vec3& position) {
-    if (selectedIndex < 0 || selectedIndex >= static_cast<int>(instances.size())) {
+void SceneRenderer::removeInstance(int index) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
         return;
     }
-    instances[static_cast<size_t>(selectedIndex)].position = position;
+    if (history) {
+        history->recordRemove(*this, index);
+    }
+    if (batchedMask[static_cast<size_t>(index)]) {
+        invalidateStaticBatches(); // the selection is never baked, other instances may be
+    }
+    releaseInstanceResources(instances[static_cast<size_t>(index)]);
+    instances.erase(instances.begin() + index);
+    batchedMask.erase(batchedMask.begin() + index);
+    worldMatrices.erase(worldMatrices.begin() + index);
+    spatial.remove(spatialHandles[static_cast<size_t>(index)]);
+    spatialHandles.erase(spatialHandles.begin() + index);
+    for (size_t i = static_cast<size_t>(index); i < spatialHandles.size(); ++i) {
+        spatial.setItem(spatialHandles[i], static_cast<int>(i));
+    }
+    for (PrimitiveInstance& other : instances) {
+        if (other.parent == index) {
+            other.parent = -1;
+        }
+        else if (other.parent > index) {
+            --other.parent;
+        }
+    }
+    hierarchyDirty = true;
+    if (journal) {
+        journal->recordRemove(index);
+    }
+    if (selectionMask[static_cast<size_t>(index)]) {
+        selection.erase(std::find(selection.begin(), selection.end(), index));
+    }
+    selectionMask.erase(selectionMask.begin() + index);
+    for (int& selected : selection) {
+        if (selected > index) {
+            --selected;
+        }
+    }
+    if (selectedIndex == index) {
+        selectedIndex = selection.empty() ? -1 : selection.back();
+    }
+    else if (selectedIndex > index) {
+        --selectedIndex;
+    }
 }
 
-void SceneRenderer::removeSelected() {
+void SceneRenderer::truncateInstances(int count) {
+    ++revision;
+    count = std::max(count, 0);
+    if (count >= static_cast<int>(instances.size())) {
+        return;
+    }
+    bool baked = false;
+    for (size_t i = static_cast<size_t>(count); i < instances.size(); ++i) {
+        baked = baked || batchedMask[i];
+        releaseInstanceResources(instances[i]);
+        spatial.remove(spatialHandles[i]);
+    }
+    if (baked) {
+        invalidateStaticBatches();
+    }
+    instances.erase(instances.begin() + count, instances.end());
+    batchedMask.erase(batchedMask.begin() + count, batchedMask.end());
+    selectionMask.erase(selectionMask.begin() + count, selectionMask.end());
+    worldMatrices.erase(worldMatrices.begin() + count, worldMatrices.end());
+    spatialHandles.erase(spatialHandles.begin() + count, spatialHandles.end());
+    for (PrimitiveInstance& inst : instances) {
+        if (inst.parent >= count) {
+            inst.parent = -1;
+        }
+    }
+    selection.erase(std::remove_if(selection.begin(), selection.end(), [count](int selected) { return selected >= count; }),
+        selection.end());
+    if (selectedIndex >= count) {
+        selectedIndex = selection.empty() ? -1 : selection.back();
+    }
+    hierarchyDirty = true;
+    if (journal) {
+        journal->requestSnapshot();
+    }
+}
+
+void SceneRenderer::noteInstanceEdited(int index, const PrimitiveInstance& before) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(instances.size())) {
+        return;
+    }
+    markTransformDirty(index);
+    if (journal) {
+        journal->recordInstance(JournalOp::SetInstance, *this, index);
+    }
+    recordFields(index, toSceneFileInstance(before));
+}
+
+void SceneRenderer::noteSelectionEdited(const PrimitiveInstance& before) {
     if (selectedIndex < 0 || selectedIndex >= static_cast<int>(instances.size())) {
+        ++revision;
         return;
     }
-    PrimitiveInstance& inst = instances[static_cast<size_t>(selectedIndex)];
-    if (inst.textureId) {
-        glDeleteTextures(1, &inst.textureId);
-        inst.textureId = 0;
+    if (selection.size() < 2) {
+        noteInstanceEdited(selectedIndex, before);
+        return;
+    }
+    std::vector<int> roots;
+    selectionRoots(roots);
+    std::sort(roots.begin(), roots.end());
+    if (history) {
+        history->beginGroup("Edit " + std::to_string(selection.size()) + " instances", true);
+    }
+    noteInstanceEdited(selectedIndex, before);
+    const PrimitiveInstance primary = instances[static_cast<size_t>(selectedIndex)];
+    for (int index : selection) {
+        if (index == selectedIndex) {
+            continue;
+        }
+        PrimitiveInstance edited = instances[static_cast<size_t>(index)];
+        // children of a selected instance already follow it
+        if (std::binary_search(roots.begin(), roots.end(), index)) {
+            edited.position += primary.position - before.position;
+            edited.rotation += primary.rotation - before.rotation;
+            glm::vec3 scaleDelta = primary.scale - before.scale;
+            if (edited.type == PrimitiveType::Plane) {
+                scaleDelta.y = 0.0f;
+            }
+            edited.scale = glm::max(edited.scale + scaleDelta, glm::vec3(0.1f));
+        }
+        if (primary.color != before.color) edited.color = primary.color;
+        if (primary.uvScale != before.uvScale) edited.uvScale = primary.uvScale;
+        if (primary.wrapMode != before.wrapMode) edited.wrapMode = primary.wrapMode;
+        if (primary.filterMode != before.filterMode) edited.filterMode = primary.filterMode;
+        if (primary.projection != before.projection) edited.projection = primary.projection;
+        if (primary.planarAxis != before.planarAxis) edited.planarAxis = primary.planarAxis;
+        if (primary.castsShadow != before.castsShadow) edited.castsShadow = primary.castsShadow;
+        setInstanceFields(index, toSceneFileInstance(edited));
+    }
+    if (history) {
+        history->endGroup();
+    }
+}
+
+void SceneRenderer::queryFrustum(const Frustum& frustum, bool enclosed, std::vector<int>& out) {
+    updateTransforms();
+    spatial.queryFrustum(frustum, enclosed, out);
+}
+
+void SceneRenderer::queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& out) {
+    updateTransforms();
+    spatial.queryBox(boxMin, boxMax, out);
+}
+
+int SceneRenderer::nearestInstance(const glm::vec3& point, float maxDistance) {
+    updateTransforms();
+    return spatial.nearest(point, maxDistance);
+}
+
+int SceneRenderer::raycast(const glm::vec3& origin, const glm::vec3& direction, float* distance) {
+    updateTransforms();
+    std::vector<SpatialIndex::RayHit> candidates;
+    spatial.queryRay(origin, direction, std::numeric_limits<float>::max(), candidates);
+    std::sort(candidates.begin(), candidates.end(),
+        [](const SpatialIndex::RayHit& a, const SpatialIndex::RayHit& b) { return a.t < b.t; });
+
+    int best = -1;
+    float bestT = std::numeric_limits<float>::max();
+    for (const SpatialIndex::RayHit& candidate : candidates) {
+        if (candidate.t > bestT) {
+            break; // every remaining bounding sphere starts behind the hit
+        }
+        // into the instance's local space, where its bounds are axis aligned; t stays the same
+        const glm::mat4 toLocal = glm::inverse(worldMatrices[static_cast<size_t>(candidate.item)]);
+        const glm::vec3 localOrigin(toLocal * glm::vec4(origin, 1.0f));
+        const glm::vec3 localDirection(toLocal * glm::vec4(direction, 0.0f));
+        float t = 0.0f;
+        if (hitLocalBounds(instances[static_cast<size_t>(candidate.item)], localOrigin, localDirection, t) && t < bestT) {
+            bestT = t;
+            best = candidate.item;
+        }
+    }
+    if (distance && best >= 0) {
+        *distance = bestT;
+    }
+    return best;
+}
+
+bool SceneRenderer::hitLocalBounds(const PrimitiveInstance& instance, const glm::vec3& origin, const glm::vec3& direction,
+    float& t) const {
+    if (instance.type == PrimitiveType::Sphere) {
+        const float a = glm::dot(direction, direction);
+        const float b = glm::dot(origin, direction);
+        const float c = glm::dot(origin, origin) - 0.25f;
+        const float discriminant = b * b - a * c;
+        if (a <= 0.0f || discriminant < 0.0f) {
+            return false;
+        }
+        const float root = std::sqrt(discriminant);
+        t = (-b - root) / a;
+        if (t < 0.0f) {
+            t = (-b + root) / a; // inside
+        }
+        return t >= 0.0f;
+    }
+
+    glm::vec3 boxMin(-0.5f);
+    glm::vec3 boxMax(0.5f);
+    if (instance.type == PrimitiveType::Plane) {
+        boxMin = glm::vec3(-1.0f, -0.01f, -1.0f);
+        boxMax = glm::vec3(1.0f, 0.01f, 1.0f);
+    }
+    else if (instance.type == PrimitiveType::Mesh && instance.meshId >= 0 &&
+        instance.meshId < static_cast<int>(importedMeshes.size())) {
+        boxMin = importedMeshes[static_cast<size_t>(instance.meshId)].boundsMin;
+        boxMax = importedMeshes[static_cast<size_t>(instance.meshId)].boundsMax;
+    }
+    float enter = 0.0f;
+    float exit = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::fabs(direction[axis]) < 1e-8f) {
+            if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (boxMin[axis] - origin[axis]) / direction[axis];
+        float t1 = (boxMax[axis] - origin[axis]) / direction[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        enter = std::max(enter, t0);
+        exit = std::min(exit, t1);
+        if (enter > exit) {
+            return false;
+        }
+    }
+    t = enter;
+    return true;
+}
+
+void SceneRenderer::noteLightEdited(const LightSettings& before) {
+    ++revision;
+    if (journal) {
+        journal->recordLight(*this, -1);
+    }
+    if (history) {
+        history->recordLight(before, light);
+    }
+}
+
+void SceneRenderer::notePointLightEdited(int index, const PointLight& before) {
+    ++revision;
+    if (index < 0 || index >= static_cast<int>(pointLights.size())) {
+        return;
+    }
+    if (journal) {
+        journal->recordLight(*this, index);
+    }
+    if (history) {
+        history->recordPointLight(index, before, pointLights[static_cast<size_t>(index)]);
+    }
+}
+
+SceneReplaceScope::SceneReplaceScope(SceneRenderer& scene)
+    : scene(scene), journal(scene.getJournal()), history(scene.getHistory()) {
+    scene.setJournal(nullptr);
+    scene.setHistory(nullptr);
+}
+
+SceneReplaceScope::~SceneReplaceScope() {
+    scene.setJournal(journal);
+    scene.setHistory(history);
+    if (journal) {
+        journal->requestSnapshot();
+    }
+    if (history) {
+        history->clear();
     }
-    instances.erase(instances.begin() + selectedIndex);
-    selectedIndex = -1;
 }
 
 PrimitiveInstance* SceneRenderer::getSelectedMutable() {
     if (selectedIndex < 0 || selectedIndex >= static_cast<int>(instances.size())) {
         return nullptr;
     }
+    markTransformDirty(selectedIndex); // the caller may move it
     return &instances[static_cast<size_t>(selectedIndex)];
 }
 
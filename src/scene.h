@@ -3,17 +3,36 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#include "frame_arena.h"
+#include "gpu_profiler.h"
+#include "light_clusters.h"
+#include "material_table.h"
+#include "mesh_import.h"
 #include "shader.h"
+#include "spatial_index.h"
+#include "string_table.h"
+#include "texture_arrays.h"
+#include "worker_pool.h"
+
+class SceneJournal;
+enum class JournalOp : uint32_t;
+class UndoHistory;
+struct SceneFileInstance;
+struct SceneFileInstanceState;
+struct SceneFileTables;
 
 enum class PrimitiveType {
     Cube,
     Sphere,
     Cylinder,
-    Plane
+    Plane,
+    Mesh // imported asset, see PrimitiveInstance::meshId
 };
 
 enum class PlanarAxis {
@@ -33,6 +52,12 @@ enum class TextureFilterMode {
     Linear
 };
 
+enum class ShadowFilter {
+    Hard,  // single tap
+    Pcf8,  // 8 taps around the lookup direction
+    Pcf20  // 20 taps
+};
+
 enum class TextureProjection {
     Planar,
     Triplanar,
@@ -43,25 +68,91 @@ enum class TextureProjection {
 
 struct PrimitiveInstance {
     PrimitiveType type;
+    int meshId = -1; // index into SceneRenderer::getImportedMeshes() when type == Mesh
+    int parent = -1; // instance index; position, scale and rotation are relative to it
     glm::vec3 position;
     glm::vec3 scale;
     glm::vec3 rotation; // Euler degrees XYZ
     glm::vec3 color;
-    glm::vec3 matAmbient;
-    glm::vec3 matDiffuse;
-    glm::vec3 matSpecular;
-    float matShininess;
-    float matAmbientStrength;
-    float matDiffuseStrength;
-    float matSpecularStrength;
+    int materialId = -1; // shared entry in SceneRenderer::getMaterials()
     bool hasTexture = false;
-    GLuint textureId = 0;
-    std::string textureName;
+    int texturePage = -1; // slot in the shared texture arrays
+    int textureLayer = -1;
+    StringId textureName = kEmptyString; // file name for display, the full path is the texture slot's
     TextureWrapMode wrapMode = TextureWrapMode::Repeat;
     TextureFilterMode filterMode = TextureFilterMode::Linear;
     TextureProjection projection = TextureProjection::Planar;
     PlanarAxis planarAxis = PlanarAxis::Y;
     glm::vec2 uvScale = glm::vec2(1.0f);
+    bool isStatic = false; // baked into merged geometry while static freeze is on
+    bool castsShadow = true;
+};
+
+// copied wholesale by the draw, pick and undo paths, so it must stay plain data
+static_assert(std::is_trivially_copyable<PrimitiveInstance>::value, "PrimitiveInstance must stay trivially copyable");
+
+struct ImportedMeshInfo {
+    StringId name = kEmptyString;
+    StringId path = kEmptyString;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float radius = 0.0f;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    bool fromCache = false;
+    double loadMs = 0.0;
+};
+
+// how select() combines the given instances with the current selection
+enum class SelectMode {
+    Replace,
+    Add,
+    Toggle,
+    Remove
+};
+
+// one entry of the flattened scene graph, depth-first so every parent comes before its children
+struct HierarchyNode {
+    int instance = -1;
+    int parent = -1; // as resolved by the last rebuild
+    int depth = 0;
+    int end = 0;     // one past the last entry of this subtree
+};
+
+struct RenderStats {
+    int drawCalls = 0;
+    int stateChanges = 0; // program switches and vertex input rebinds issued by draw()
+    int staticBatches = 0;
+    int batchedInstances = 0;
+    int drawCallsSaved = 0;
+    // GPU time of the scene passes (ms), plus a running average per depth strategy
+    float prepassMs = 0.0f;
+    float colorPassMs = 0.0f;
+    float prepassStrategyMs = 0.0f;
+    float sortedStrategyMs = 0.0f;
+    int pointLights = 0;
+    int clusterLightRefs = 0;
+    float clusterBuildMs = 0.0f; // CPU light assignment
+    // shadow cube map: GPU time of the last update and how many faces it re-rendered
+    float shadowPassMs = 0.0f;
+    int shadowFacesRendered = 0;
+    int shadowMapUpdates = 0;
+    int texturePages = 0;
+    int textureLayers = 0;
+    int materials = 0;        // live entries in the material table
+    int materialUploads = 0;  // bytes written to the material buffer this frame
+    int transformsUpdated = 0; // world matrices recomputed since draw() began
+    int heapAllocations = 0;   // operator new calls on the render thread during the last draw(), 0 in a steady frame
+};
+
+struct RenderSettings {
+    bool depthPrepass = false; // depth-only pass first, then shade with GL_EQUAL
+    bool frontToBack = true;   // sort by view depth when the pre-pass is off
+    bool showOverdraw = false; // additive shaded-fragment heat map instead of lighting
+    bool shadows = true;       // omnidirectional shadow cube map for the main light
+    ShadowFilter shadowFilter = ShadowFilter::Pcf8;
+    int shadowMapSize = 1024;  // per cube face
+    float shadowBias = 0.05f;
 };
 
 struct LightSettings {
@@ -80,31 +171,150 @@ public:
 
     void init();
     void addPrimitive(PrimitiveType type, const glm::vec3& position = glm::vec3(0.0f));
+    // imports an .obj/.glb (or its .meshcache) once per path; returns the mesh id or -1
+    int importMesh(const std::string& filepath);
+    void addMeshInstance(int meshId, const glm::vec3& position = glm::vec3(0.0f));
+    // appends a copy of a fully described instance (or inserts it before index); its material is interned
+    // and the texture loaded by path. Returns the new index, or -1 for a mesh instance with an unknown meshId.
+    int addInstance(const PrimitiveInstance& instance, const Material& material, const std::string& texturePath, int index = -1);
+    // appends a batch in one pass (a scatter, say); each instance's materialId indexes palette and parents
+    // and textures are dropped. One undo entry, and a journal snapshot instead of a record per instance.
+    // Returns the index of the first one
+    int addInstances(const std::vector<PrimitiveInstance>& batch, const std::vector<Material>& palette);
+    // self-contained copy of one instance, and its inverse; meshes are re-imported by path, or become cubes
+    SceneFileInstanceState captureInstance(int index) const;
+    int insertInstance(int index, const SceneFileInstanceState& state);
+    const std::vector<ImportedMeshInfo>& getImportedMeshes() const { return importedMeshes; }
+    float getMeshRadius(int meshId) const;
+    // bounding sphere radius around instance.position, scale included
+    float boundingRadius(const PrimitiveInstance& instance) const;
     void clear();
+    // .cgscene files (see scene_file.h); load replaces instances, point lights and the main light
+    bool saveScene(const std::string& path) const;
+    bool loadScene(const std::string& path);
+    // the tables saveScene writes, without the file I/O
+    void buildSceneTables(SceneFileTables& tables) const;
     void draw(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
     size_t instanceCount() const { return instances.size(); }
     const std::vector<PrimitiveInstance>& getInstances() const { return instances; }
+    // the primary selection: what the inspector shows and drags are anchored to
     int getSelectedIndex() const { return selectedIndex; }
-    void select(int index);
+    void select(int index, SelectMode mode = SelectMode::Replace);
+    void select(const std::vector<int>& indices, SelectMode mode);
     void clearSelection();
+    bool isSelected(int index) const { return selectionMask[static_cast<size_t>(index)] != 0; }
+    // every selected instance in selection order, the primary one included
+    const std::vector<int>& getSelection() const { return selection; }
+    // the edits below apply to the whole selection in one pass; an instance whose ancestor is
+    // selected as well only follows that ancestor. Delta is in world space, rotate and scale act
+    // on the local transform
     void translateSelected(const glm::vec3& delta);
     void rotateSelected(const glm::vec3& deltaDegrees);
     void scaleSelected(const glm::vec3& deltaScale);
+    // world-space position of the primary selection, the rest of the selection moves along
     void setSelectedPosition(const glm::vec3& position);
+    void setSelectedLightPosition(const glm::vec3& position);
+    // removes the selected instances together with everything parented under them
     void removeSelected();
+    // removes one instance; its children become roots
+    void removeInstance(int index);
+    // drops every instance from index count on in one pass, the inverse of addInstances. Not recorded
+    // in the history, the journal takes a snapshot
+    void truncateInstances(int count);
     PrimitiveInstance* getSelectedMutable();
     const PrimitiveInstance* getSelected() const;
 
+    // scene graph: re-parents index (parent -1 = root) keeping its world placement; false when it
+    // would create a cycle
+    bool setParent(int index, int parent);
+    // recomputes world matrices of the subtrees touched since the last call; draw() calls it first
+    void updateTransforms();
+    // valid as of the last updateTransforms()
+    const glm::mat4& getWorldMatrix(int index) const { return worldMatrices[static_cast<size_t>(index)]; }
+    glm::vec3 getWorldPosition(int index) const { return glm::vec3(getWorldMatrix(index)[3]); }
+    const std::vector<HierarchyNode>& getHierarchy() const { return hierarchy; }
+
     glm::vec3 getDefaultColor(PrimitiveType type) const { return colorForType(type); }
     void getDefaultMaterial(glm::vec3& ambient, glm::vec3& diffuse, glm::vec3& specular, float& shininess,
         float& ambientStrength, float& diffuseStrength, float& specularStrength) const;
+    // materials are shared: setInstanceMaterial re-points one instance (interning the values),
+    // editMaterial rewrites an entry for every instance that uses it
+    const MaterialTable& getMaterials() const { return materials; }
+    const Material& getMaterial(int materialId) const { return materials.get(materialId); }
+    void setInstanceMaterial(int index, const Material& material);
+    void setSelectionMaterial(const Material& material);
+    // applies the record's transform, colour, texture mapping and flags; type, mesh, material and texture stay
+    void setInstanceFields(int index, const SceneFileInstance& record);
+    void editMaterial(int materialId, const Material& material);
+    Material defaultMaterialFor(const glm::vec3& color) const;
+
     bool loadTextureForSelected(const std::string& filepath);
+    // file the instance's texture was loaded from, empty when untextured
+    const std::string& getTexturePath(const PrimitiveInstance& instance) const;
     void removeTextureFromSelected();
-    void applyTextureSettings(PrimitiveInstance& instance);
+
+    // static batching: static instances are merged per material/texture while frozen;
+    // the selected instance is always drawn on its own so it can be edited
+    void setFreezeStatic(bool enabled);
+    // optional; sub-stages of draw() are reported as nested zones
+    void setProfiler(GpuProfiler* gpuProfiler) { profiler = gpuProfiler; }
+    // optional autosave journal; every mutating call below is recorded into it
+    void setJournal(SceneJournal* sceneJournal) { journal = sceneJournal; }
+    SceneJournal* getJournal() const { return journal; }
+    // optional undo/redo history, fed by the same calls
+    void setHistory(UndoHistory* undoHistory) { history = undoHistory; }
+    UndoHistory* getHistory() const { return history; }
+    bool isFreezeStatic() const { return freezeStatic; }
+    void setInstanceStatic(int index, bool isStatic);
+    void setSelectionStatic(bool isStatic);
+    const RenderStats& getStats() const { return stats; }
+
+    RenderSettings& getRenderSettings() { return settings; }
+    const RenderSettings& getRenderSettings() const { return settings; }
 
     LightSettings& getLightSettings() { return light; }
     const LightSettings& getLightSettings() const { return light; }
 
+    // point lights shaded through the cluster grid, in addition to the main light
+    int addPointLight(const PointLight& pointLight);
+    void insertPointLight(int index, const PointLight& pointLight);
+    void removePointLight(int index);
+    void clearPointLights();
+    std::vector<PointLight>& getPointLights() { return pointLights; }
+    const std::vector<PointLight>& getPointLights() const { return pointLights; }
+
+    // light selection: -1 is the main light, >= 0 a point light
+    static constexpr int kNoLight = -2;
+    void selectLight(int index);
+    void clearLightSelection() { selectedLight = kNoLight; ++revision; }
+    bool isLightSelected() const { return selectedLight != kNoLight; }
+    int getSelectedLight() const { return selectedLight; }
+    glm::vec3* getSelectedLightPosition();
+
+    WorkerPool& getWorkerPool() { return workerPool; }
+    // transient storage of the frame being drawn
+    const FrameArena& getFrameArena() const { return frameArena; }
+
+    // bumped by every mutating call above; direct edits through the mutable getters are not counted
+    unsigned int getRevision() const { return revision; }
+    // report direct edits made through getSelectedMutable() / getLightSettings() / getPointLights(),
+    // with the values from before the edit, so they reach the journal and the undo history
+    void noteInstanceEdited(int index, const PrimitiveInstance& before);
+    // inspector edit of the primary selection: transform changes are applied to the rest of the
+    // selection as deltas, other changed fields are copied
+    void noteSelectionEdited(const PrimitiveInstance& before);
+    // spatial queries over world bounding spheres, answered by the loose octree; enclosed = fully
+    // inside the frustum instead of touching it
+    void queryFrustum(const Frustum& frustum, bool enclosed, std::vector<int>& out);
+    void queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& out);
+    // instance whose world position is closest to point, -1 when none is within maxDistance
+    int nearestInstance(const glm::vec3& point, float maxDistance);
+    // nearest instance the ray hits, tested against its oriented local bounds; -1 when none
+    int raycast(const glm::vec3& origin, const glm::vec3& direction, float* distance = nullptr);
+    const SpatialIndex& getSpatialIndex() const { return spatial; }
+    void noteLightEdited(const LightSettings& before);
+    void notePointLightEdited(int index, const PointLight& before);
+
 private:
     struct Mesh {
         GLuint VAO = 0;
@@ -113,20 +323,195 @@ private:
         GLsizei indexCount = 0;
     };
 
+    struct StaticBatch {
+        Mesh mesh;
+        PrimitiveInstance material; // shading/texture state shared by every merged instance
+        int instanceCount = 0;
+    };
+
+    // double-buffered GL_TIME_ELAPSED query, read one frame late so it never stalls
+    struct PassTimer {
+        GLuint queries[2] = { 0, 0 };
+        bool pending[2] = { false, false };
+        int frame = 0;
+        float ms = 0.0f;
+    };
+
+    struct TextureBuffer {
+        GLuint buffer = 0;
+        GLuint texture = 0;
+    };
+
+    // per-instance vertex attributes (locations 2-10), one entry per drawn instance
+    struct InstanceAttributes {
+        glm::mat4 model;
+        glm::vec4 params;   // uvScale, unused
+        glm::vec4 color;    // marker colour and ambient scale, used when there is no material
+        glm::ivec4 texture; // page (-1 = untextured), layer, packed projection/axis/wrap/filter, material id
+    };
+
+    // contiguous slice of the instance stream drawn with one instanced call
+    struct DrawRun {
+        GLuint VAO = 0;
+        GLsizei indexCount = 0;
+        unsigned int first = 0;
+        unsigned int count = 0;
+        bool castsShadow = false;
+    };
+
+    struct DrawItem {
+        int mesh;
+        bool castsShadow;
+        float depth; // view depth
+        unsigned int instance;
+    };
+
+    // what the cached shadow map was rendered with, per instance
+    struct ShadowCaster {
+        glm::mat4 model = glm::mat4(0.0f);
+        int mesh = -1; // -1 when the instance casts no shadow
+        float radius = 0.0f;
+    };
+
     Mesh buildCube();
     Mesh buildPlane();
     Mesh buildSphere(int slices = 32, int stacks = 18);
     Mesh buildCylinder(int slices = 32);
     Mesh createMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+    Mesh createMesh(const float* vertices, size_t floatCount, const unsigned int* indices, size_t indexCount);
     void destroyMesh(Mesh& mesh);
     void ensureMesh(PrimitiveType type);
     glm::vec3 colorForType(PrimitiveType type) const;
+    PrimitiveInstance makeInstance(PrimitiveType type, const glm::vec3& position);
+    void releaseInstanceResources(PrimitiveInstance& instance);
+    void recordFields(int index, const SceneFileInstance& before);
+    void setSelected(int index, bool selected);
+    // selected instances without a selected ancestor, which is what batched edits move
+    void selectionRoots(std::vector<int>& roots) const;
+    void transformSelection(JournalOp op, const glm::vec3& value);
+    void markTransformDirty(int index);
+    void rebuildHierarchy();
+    void updateWorldMatrix(int index);
+    glm::mat4 parentWorld(int index) const;
+    float worldRadius(int index) const;
+    // adds the spatial index entry of a newly inserted instance
+    void trackInstance(int index);
+    bool hitLocalBounds(const PrimitiveInstance& instance, const glm::vec3& origin, const glm::vec3& direction, float& t) const;
+    void uploadMaterials();
+    void buildInstanceStream(const glm::mat4& view);
+    InstanceAttributes packInstance(const PrimitiveInstance& instance, const glm::mat4& model) const;
+    void drawRun(const DrawRun& run);
+    void bindProgram(const Shader& shader);
+    void drawGeometry(const Shader& shader, bool withMaterials);
+    void beginPassTimer(PassTimer& timer);
+    void endPassTimer(PassTimer& timer);
+    void destroyPassTimer(PassTimer& timer);
+    void updateLightClusters(const glm::mat4& view, const glm::mat4& projection);
+    void updateShadowMap();
+    void renderShadowFace(int face, const FrameVector<unsigned int>& runFaces);
+    void destroyShadowMap();
+    unsigned int shadowFacesTouched(const glm::vec3& center, float radius) const;
+    void uploadTextureBuffer(TextureBuffer& target, GLenum format, const void* data, size_t bytes);
+    void destroyTextureBuffer(TextureBuffer& target);
+    void rebuildStaticBatches();
+    void destroyStaticBatches();
+    const MeshData& bakeSource(int key);
+    void invalidateStaticBatches() { staticBatchesDirty = true; }
+    static int meshKey(const PrimitiveInstance& instance);
 
     Shader litShader;
+    Shader depthShader;
+    Shader overdrawShader;
+    Shader shadowShader;
     bool initialized = false;
+    unsigned int revision = 0;
+    RenderSettings settings;
+    PassTimer prepassTimer;
+    PassTimer colorPassTimer;
+    PassTimer shadowTimer;
+    GpuProfiler* profiler = nullptr;
+    SceneJournal* journal = nullptr;
+    UndoHistory* history = nullptr;
+    // transient per-frame data; reset at the start of draw(), the worker pool's arenas along with it.
+    // Only the render path allocates from it, anything else would pin its peak
+    FrameArena frameArena;
+    std::vector<unsigned int> streamSource; // instance index per stream entry, kNoSource for batches
+    static constexpr unsigned int kNoSource = ~0u;
+    std::vector<DrawRun> drawRuns;
+    std::vector<DrawRun> selectedRuns; // highlight copies of the selection, after the gizmos
+    DrawRun gizmoRun; // light indicator and point light markers
+    GLuint instanceBuffer = 0;
+    TextureArrayPool textures;
 
-    std::map<PrimitiveType, Mesh> meshes;
+    // built-ins are keyed by PrimitiveType, imported meshes by kImportedMeshKeyBase + meshId
+    static constexpr int kImportedMeshKeyBase = 1000;
+    std::map<int, Mesh> meshes;
+    std::vector<ImportedMeshInfo> importedMeshes;
     std::vector<PrimitiveInstance> instances;
     int selectedIndex = -1;
+    std::vector<int> selection;
+    std::vector<unsigned char> selectionMask; // per instance
+    bool selectionStale = false;              // selection still lists instances cleared in the mask
+
+    // resolved scene graph; structural changes rebuild it, transform edits only queue their subtree
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<HierarchyNode> hierarchy;
+    std::vector<int> hierarchySlot;              // instance -> entry in hierarchy
+    // rebuildHierarchy scratch, kept between rebuilds
+    std::vector<int> childStart;
+    std::vector<int> childList;
+    std::vector<int> childFill;
+    std::vector<std::pair<int, int>> hierarchyStack; // instance, next entry of its childList range
+    std::vector<int> dirtyTransforms;            // instances whose subtree needs new world matrices
+    std::vector<unsigned char> transformQueued;  // per instance, set while in dirtyTransforms
+    SpatialIndex spatial;                        // world bounding spheres, kept current by updateWorldMatrix
+    std::vector<int> spatialHandles;             // per instance
+    bool hierarchyDirty = true;
     LightSettings light;
+    std::vector<PointLight> pointLights;
+    int selectedLight = kNoLight;
+
+    WorkerPool workerPool;
+    LightClusterGrid clusterGrid;
+    std::vector<glm::vec4> lightTexels; // 2 texels per light: position/radius, radiance
+    TextureBuffer lightBuffer;
+    TextureBuffer clusterBuffer;
+    TextureBuffer clusterIndexBuffer;
+
+    MaterialTable materials;
+    TextureBuffer materialBuffer;
+    int materialBufferCapacity = 0; // entries the GPU buffer was allocated for
+
+    // shadow cube map, re-rendered per face only when something it sees changes
+    static constexpr float kShadowNear = 0.05f;
+    static constexpr float kShadowFar = 60.0f;
+    GLuint shadowFbo = 0;
+    GLuint shadowCubeMap = 0;
+    int shadowMapAllocated = 0;
+    unsigned int shadowDirtyFaces = 0x3F; // bit per cube face
+    glm::vec3 shadowLightPos = glm::vec3(0.0f);
+    std::vector<ShadowCaster> shadowCasters;
+
+    bool freezeStatic = false;
+    bool staticBatchesDirty = false;
+    std::vector<StaticBatch> staticBatches;
+    std::vector<unsigned char> batchedMask; // per instance, 1 when drawn through a static batch
+    std::map<int, MeshData> bakeSources;    // CPU copies of mesh geometry read back for baking
+    RenderStats stats;
+};
+
+// Detaches the journal and undo history while a whole scene is replaced (load, import, benchmark
+// build). Afterwards the journal writes a snapshot instead of a record per instance, and the
+// history starts over.
+class SceneReplaceScope {
+public:
+    explicit SceneReplaceScope(SceneRenderer& scene);
+    ~SceneReplaceScope();
+    SceneReplaceScope(const SceneReplaceScope&) = delete;
+    SceneReplaceScope& operator=(const SceneReplaceScope&) = delete;
+
+private:
+    SceneRenderer& scene;
+    SceneJournal* journal;
+    UndoHistory* history;
 };
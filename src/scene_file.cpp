@@ -0,0 +1,359 @@
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char kSceneMagic[8] = { 'C', 'G', 'S', 'C', 'E', 'N', 'E', '\0' };
+    constexpr uint32_t kSceneVersion = 1;
+    constexpr size_t kSceneDataOffset = 256;
+    constexpr size_t kTableAlignment = 16;
+
+    struct SceneFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t instanceCount;
+        uint32_t materialCount;
+        uint32_t pointLightCount;
+        uint32_t textureCount;
+        uint32_t meshCount;
+        uint64_t instanceOffset;
+        uint64_t materialOffset;
+        uint64_t pointLightOffset;
+        uint64_t stringOffset; // SceneFileString[textureCount + meshCount], textures first
+        uint64_t blobOffset;
+        uint64_t blobSize;
+        float light[10]; // position, color, ambient, diffuse, specular, shininess
+    };
+    static_assert(sizeof(SceneFileHeader) <= kSceneDataOffset, "scene header overflows data offset");
+
+    struct SceneFileString {
+        uint32_t offset; // into the blob
+        uint32_t length;
+    };
+
+    uint64_t alignTable(uint64_t offset) {
+        return (offset + kTableAlignment - 1) & ~static_cast<uint64_t>(kTableAlignment - 1);
+    }
+
+    // true when [offset, offset + count * stride) lies inside the file
+    bool tableFits(uint64_t offset, uint64_t count, uint64_t stride, uint64_t fileSize) {
+        return offset <= fileSize && count <= (fileSize - offset) / stride;
+    }
+
+    bool writePadded(FILE* f, const void* data, size_t bytes, uint64_t& written, uint64_t target) {
+        static const unsigned char zeros[kTableAlignment] = {};
+        while (written < target) {
+            const size_t pad = static_cast<size_t>(std::min<uint64_t>(target - written, sizeof(zeros)));
+            if (std::fwrite(zeros, 1, pad, f) != pad) {
+                return false;
+            }
+            written += pad;
+        }
+        if (bytes > 0 && std::fwrite(data, 1, bytes, f) != bytes) {
+            return false;
+        }
+        written += bytes;
+        return true;
+    }
+}
+
+SceneFileMaterial toSceneFileMaterial(const Material& material) {
+    SceneFileMaterial record{};
+    for (int i = 0; i < 3; ++i) {
+        record.ambient[i] = material.ambient[i];
+        record.diffuse[i] = material.diffuse[i];
+        record.specular[i] = material.specular[i];
+    }
+    record.shininess = material.shininess;
+    record.ambientStrength = material.ambientStrength;
+    record.diffuseStrength = material.diffuseStrength;
+    record.specularStrength = material.specularStrength;
+    return record;
+}
+
+Material fromSceneFileMaterial(const SceneFileMaterial& record) {
+    Material material;
+    material.ambient = glm::vec3(record.ambient[0], record.ambient[1], record.ambient[2]);
+    material.diffuse = glm::vec3(record.diffuse[0], record.diffuse[1], record.diffuse[2]);
+    material.specular = glm::vec3(record.specular[0], record.specular[1], record.specular[2]);
+    material.shininess = record.shininess;
+    material.ambientStrength = record.ambientStrength;
+    material.diffuseStrength = record.diffuseStrength;
+    material.specularStrength = record.specularStrength;
+    return material;
+}
+
+SceneFileInstance toSceneFileInstance(const PrimitiveInstance& instance) {
+    SceneFileInstance record{};
+    for (int i = 0; i < 3; ++i) {
+        record.position[i] = instance.position[i];
+        record.scale[i] = instance.scale[i];
+        record.rotation[i] = instance.rotation[i];
+        record.color[i] = instance.color[i];
+    }
+    record.uvScale[0] = instance.uvScale.x;
+    record.uvScale[1] = instance.uvScale.y;
+    record.material = -1;
+    record.texture = -1;
+    record.mesh = -1;
+    record.type = static_cast<uint8_t>(instance.type);
+    record.wrapMode = static_cast<uint8_t>(instance.wrapMode);
+    record.filterMode = static_cast<uint8_t>(instance.filterMode);
+    record.projection = static_cast<uint8_t>(instance.projection);
+    record.planarAxis = static_cast<uint8_t>(instance.planarAxis);
+    record.flags = static_cast<uint8_t>((instance.isStatic ? kSceneFileStatic : 0) | (instance.castsShadow ? kSceneFileCastsShadow : 0));
+    record.parent = instance.parent + 1;
+    return record;
+}
+
+PrimitiveInstance fromSceneFileInstance(const SceneFileInstance& record) {
+    PrimitiveInstance instance{};
+    instance.type = static_cast<PrimitiveType>(record.type);
+    instance.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+    instance.scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+    instance.rotation = glm::vec3(record.rotation[0], record.rotation[1], record.rotation[2]);
+    instance.color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+    instance.uvScale = glm::vec2(record.uvScale[0], record.uvScale[1]);
+    instance.wrapMode = static_cast<TextureWrapMode>(record.wrapMode);
+    instance.filterMode = static_cast<TextureFilterMode>(record.filterMode);
+    instance.projection = static_cast<TextureProjection>(record.projection);
+    instance.planarAxis = static_cast<PlanarAxis>(record.planarAxis);
+    instance.isStatic = (record.flags & kSceneFileStatic) != 0;
+    instance.castsShadow = (record.flags & kSceneFileCastsShadow) != 0;
+    instance.parent = record.parent - 1;
+    return instance;
+}
+
+SceneFilePointLight toSceneFilePointLight(const PointLight& pointLight) {
+    SceneFilePointLight record{};
+    for (int i = 0; i < 3; ++i) {
+        record.position[i] = pointLight.position[i];
+        record.color[i] = pointLight.color[i];
+    }
+    record.intensity = pointLight.intensity;
+    record.radius = pointLight.radius;
+    return record;
+}
+
+PointLight fromSceneFilePointLight(const SceneFilePointLight& record) {
+    PointLight pointLight;
+    pointLight.position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+    pointLight.color = glm::vec3(record.color[0], record.color[1], record.color[2]);
+    pointLight.intensity = record.intensity;
+    pointLight.radius = record.radius;
+    return pointLight;
+}
+
+void appendInstanceState(std::vector<char>& out, const SceneFileInstanceState& state) {
+    const auto put = [&out](const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        out.insert(out.end(), p, p + bytes);
+    };
+    put(&state.record, sizeof(state.record));
+    put(&state.material, sizeof(state.material));
+    for (const std::string* text : { &state.texturePath, &state.meshPath }) {
+        const uint32_t length = static_cast<uint32_t>(text->size());
+        put(&length, sizeof(length));
+        put(text->data(), text->size());
+    }
+}
+
+bool readInstanceState(const char* data, size_t size, size_t& offset, SceneFileInstanceState& state) {
+    const auto get = [&](void* out, size_t bytes) {
+        if (offset > size || bytes > size - offset) {
+            return false;
+        }
+        std::memcpy(out, data + offset, bytes);
+        offset += bytes;
+        return true;
+    };
+    if (!get(&state.record, sizeof(state.record)) || !get(&state.material, sizeof(state.material))) {
+        return false;
+    }
+    for (std::string* text : { &state.texturePath, &state.meshPath }) {
+        uint32_t length = 0;
+        if (!get(&length, sizeof(length)) || length > size - offset) {
+            return false;
+        }
+        text->assign(data + offset, length);
+        offset += length;
+    }
+    return true;
+}
+
+bool syncFile(FILE* f) {
+    if (std::fflush(f) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+bool syncDirectory(const std::string& directory) {
+#ifdef _WIN32
+    (void)directory;
+    return true;
+#else
+    const int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+bool writeSceneFile(const std::string& path, const SceneFileTables& tables, bool durable) {
+    SceneFileHeader header{};
+    std::memcpy(header.magic, kSceneMagic, sizeof(kSceneMagic));
+    header.version = kSceneVersion;
+    header.instanceCount = static_cast<uint32_t>(tables.instances.size());
+    header.materialCount = static_cast<uint32_t>(tables.materials.size());
+    header.pointLightCount = static_cast<uint32_t>(tables.pointLights.size());
+    header.textureCount = static_cast<uint32_t>(tables.texturePaths.size());
+    header.meshCount = static_cast<uint32_t>(tables.meshPaths.size());
+
+    std::vector<SceneFileString> strings;
+    std::string blob;
+    for (const auto* list : { &tables.texturePaths, &tables.meshPaths }) {
+        for (const std::string& text : *list) {
+            strings.push_back(SceneFileString{ static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(text.size()) });
+            blob += text;
+        }
+    }
+
+    const size_t instanceBytes = tables.instances.size() * sizeof(SceneFileInstance);
+    const size_t materialBytes = tables.materials.size() * sizeof(SceneFileMaterial);
+    const size_t pointLightBytes = tables.pointLights.size() * sizeof(SceneFilePointLight);
+    const size_t stringBytes = strings.size() * sizeof(SceneFileString);
+    header.instanceOffset = kSceneDataOffset;
+    header.materialOffset = alignTable(header.instanceOffset + instanceBytes);
+    header.pointLightOffset = alignTable(header.materialOffset + materialBytes);
+    header.stringOffset = alignTable(header.pointLightOffset + pointLightBytes);
+    header.blobOffset = alignTable(header.stringOffset + stringBytes);
+    header.blobSize = blob.size();
+
+    const LightSettings& light = tables.light;
+    const float lightValues[10] = { light.position.x, light.position.y, light.position.z, light.color.x, light.color.y,
+        light.color.z, light.ambient, light.diffuse, light.specular, light.shininess };
+    std::memcpy(header.light, lightValues, sizeof(lightValues));
+
+    // same write-then-rename as the mesh cache
+    const std::string tempPath = path + ".tmp";
+    FILE* f = std::fopen(tempPath.c_str(), "wb");
+    if (!f) {
+        std::cerr << "Cannot create scene file " << tempPath << std::endl;
+        return false;
+    }
+    unsigned char block[kSceneDataOffset] = {};
+    std::memcpy(block, &header, sizeof(header));
+    uint64_t written = 0;
+    bool ok = writePadded(f, block, sizeof(block), written, 0);
+    ok = ok && writePadded(f, tables.instances.data(), instanceBytes, written, header.instanceOffset);
+    ok = ok && writePadded(f, tables.materials.data(), materialBytes, written, header.materialOffset);
+    ok = ok && writePadded(f, tables.pointLights.data(), pointLightBytes, written, header.pointLightOffset);
+    ok = ok && writePadded(f, strings.data(), stringBytes, written, header.stringOffset);
+    ok = ok && writePadded(f, blob.data(), blob.size(), written, header.blobOffset);
+    ok = ok && (!durable || syncFile(f));
+    ok = (std::fclose(f) == 0) && ok;
+
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tempPath, path, ec);
+    }
+    if (!ok || ec) {
+        std::filesystem::remove(tempPath, ec);
+        std::cerr << "Failed to write scene file " << path << std::endl;
+        return false;
+    }
+    if (durable && !syncDirectory(std::filesystem::path(path).parent_path().string())) {
+        std::cerr << "Cannot sync the directory of " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool openSceneFile(const std::string& path, MappedFile& file, SceneFileView& view) {
+    if (!file.open(path)) {
+        std::cerr << "Cannot open scene file " << path << std::endl;
+        return false;
+    }
+    SceneFileHeader header{};
+    if (file.size() < kSceneDataOffset) {
+        file.close();
+        std::cerr << "Truncated scene file " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, kSceneMagic, sizeof(kSceneMagic)) != 0 || header.version != kSceneVersion) {
+        file.close();
+        std::cerr << "Not a scene file or unsupported version: " << path << std::endl;
+        return false;
+    }
+
+    const uint64_t fileSize = file.size();
+    const uint64_t stringCount = static_cast<uint64_t>(header.textureCount) + header.meshCount;
+    const bool aligned = header.instanceOffset % kTableAlignment == 0 && header.materialOffset % kTableAlignment == 0 &&
+        header.pointLightOffset % kTableAlignment == 0 && header.stringOffset % kTableAlignment == 0;
+    if (!aligned || !tableFits(header.instanceOffset, header.instanceCount, sizeof(SceneFileInstance), fileSize) ||
+        !tableFits(header.materialOffset, header.materialCount, sizeof(SceneFileMaterial), fileSize) ||
+        !tableFits(header.pointLightOffset, header.pointLightCount, sizeof(SceneFilePointLight), fileSize) ||
+        !tableFits(header.stringOffset, stringCount, sizeof(SceneFileString), fileSize) ||
+        !tableFits(header.blobOffset, header.blobSize, 1, fileSize)) {
+        file.close();
+        std::cerr << "Corrupt scene file tables: " << path << std::endl;
+        return false;
+    }
+
+    view.instances = reinterpret_cast<const SceneFileInstance*>(file.data() + header.instanceOffset);
+    view.instanceCount = header.instanceCount;
+    view.materials = reinterpret_cast<const SceneFileMaterial*>(file.data() + header.materialOffset);
+    view.materialCount = header.materialCount;
+    view.pointLights = reinterpret_cast<const SceneFilePointLight*>(file.data() + header.pointLightOffset);
+    view.pointLightCount = header.pointLightCount;
+
+    // path tables are tiny, so they are copied out
+    const SceneFileString* strings = reinterpret_cast<const SceneFileString*>(file.data() + header.stringOffset);
+    const char* blob = reinterpret_cast<const char*>(file.data() + header.blobOffset);
+    view.texturePaths.clear();
+    view.meshPaths.clear();
+    for (uint64_t i = 0; i < stringCount; ++i) {
+        const SceneFileString& entry = strings[i];
+        if (static_cast<uint64_t>(entry.offset) + entry.length > header.blobSize) {
+            file.close();
+            std::cerr << "Corrupt scene file strings: " << path << std::endl;
+            return false;
+        }
+        std::string text(blob + entry.offset, entry.length);
+        if (i < header.textureCount) {
+            view.texturePaths.push_back(std::move(text));
+        }
+        else {
+            view.meshPaths.push_back(std::move(text));
+        }
+    }
+
+    const float* light = header.light;
+    view.light.position = glm::vec3(light[0], light[1], light[2]);
+    view.light.color = glm::vec3(light[3], light[4], light[5]);
+    view.light.ambient = light[6];
+    view.light.diffuse = light[7];
+    view.light.specular = light[8];
+    view.light.shininess = light[9];
+    return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "scene.h"
+
+// Versioned binary scene (.cgscene): a 256-byte header, then tables of fixed-size records, each
+// 16-byte aligned so a mapped file is read in place. Instances refer to materials, textures and
+// meshes by table index; textures and meshes are stored as paths and loaded again on open.
+struct SceneFileInstance {
+    float position[3];
+    float scale[3];
+    float rotation[3];
+    float color[3];
+    float uvScale[2];
+    int32_t material;
+    int32_t texture; // -1 = untextured
+    int32_t mesh;    // -1 unless type is Mesh
+    uint8_t type;
+    uint8_t wrapMode;
+    uint8_t filterMode;
+    uint8_t projection;
+    uint8_t planarAxis;
+    uint8_t flags; // kSceneFileStatic | kSceneFileCastsShadow
+    uint8_t reserved[2];
+    int32_t parent; // instance index + 1, 0 = root (older files have zero here)
+};
+static_assert(sizeof(SceneFileInstance) == 80, "scene file instance record changed size");
+
+constexpr uint8_t kSceneFileStatic = 1;
+constexpr uint8_t kSceneFileCastsShadow = 2;
+
+struct SceneFileMaterial {
+    float ambient[3];
+    float diffuse[3];
+    float specular[3];
+    float shininess;
+    float ambientStrength;
+    float diffuseStrength;
+    float specularStrength;
+};
+static_assert(sizeof(SceneFileMaterial) == 52, "scene file material record changed size");
+
+struct SceneFilePointLight {
+    float position[3];
+    float color[3];
+    float intensity;
+    float radius;
+};
+static_assert(sizeof(SceneFilePointLight) == 32, "scene file point light record changed size");
+
+// one instance with its material and asset paths, independent of table indices; journal records
+// and undo states carry these
+struct SceneFileInstanceState {
+    SceneFileInstance record{};
+    SceneFileMaterial material{};
+    std::string texturePath;
+    std::string meshPath;
+};
+
+// everything a save writes; built by SceneRenderer::saveScene
+struct SceneFileTables {
+    std::vector<SceneFileInstance> instances;
+    std::vector<SceneFileMaterial> materials;
+    std::vector<SceneFilePointLight> pointLights;
+    std::vector<std::string> texturePaths;
+    std::vector<std::string> meshPaths;
+    LightSettings light;
+};
+
+// Read-only view into a mapped scene file; the record pointers stay valid while the MappedFile is open.
+struct SceneFileView {
+    const SceneFileInstance* instances = nullptr;
+    uint32_t instanceCount = 0;
+    const SceneFileMaterial* materials = nullptr;
+    uint32_t materialCount = 0;
+    const SceneFilePointLight* pointLights = nullptr;
+    uint32_t pointLightCount = 0;
+    std::vector<std::string> texturePaths;
+    std::vector<std::string> meshPaths;
+    LightSettings light;
+};
+
+// writes <path>.tmp and renames it over path, so a failed save keeps the previous file. A durable
+// write also fsyncs the file before the rename and the directory after it, so it survives a power loss
+bool writeSceneFile(const std::string& path, const SceneFileTables& tables, bool durable = false);
+// flush the stdio buffer and make the OS write it through
+bool syncFile(FILE* f);
+// makes new and renamed entries of a directory durable; Windows has no equivalent and returns true
+bool syncDirectory(const std::string& directory);
+// maps the file and checks magic, version and table bounds
+bool openSceneFile(const std::string& path, MappedFile& file, SceneFileView& view);
+
+SceneFileMaterial toSceneFileMaterial(const Material& material);
+Material fromSceneFileMaterial(const SceneFileMaterial& record);
+// material, texture and mesh are table indices the caller fills in; they come back as -1 / unset
+SceneFileInstance toSceneFileInstance(const PrimitiveInstance& instance);
+PrimitiveInstance fromSceneFileInstance(const SceneFileInstance& record);
+SceneFilePointLight toSceneFilePointLight(const PointLight& pointLight);
+PointLight fromSceneFilePointLight(const SceneFilePointLight& record);
+// length-prefixed paths after the two records; read returns false when the buffer is too short
+void appendInstanceState(std::vector<char>& out, const SceneFileInstanceState& state);
+bool readInstanceState(const char* data, size_t size, size_t& offset, SceneFileInstanceState& state);
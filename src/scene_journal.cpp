@@ -0,0 +1,556 @@
+#include "scene_journal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "trace.h"
+
+namespace {
+    constexpr char kJournalMagic[8] = { 'C', 'G', 'J', 'O', 'U', 'R', 'N', 'L' };
+    constexpr uint32_t kJournalVersion = 1;
+
+    struct JournalFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t generation; // matches the snapshot the records apply to
+    };
+
+    struct JournalRecordHeader {
+        uint32_t op;
+        int32_t index;
+        uint32_t size; // payload bytes
+        uint32_t checksum; // FNV-1a over op, index, size and payload; a torn tail fails it
+    };
+
+    uint32_t fnv1a(uint32_t hash, const void* data, size_t bytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < bytes; ++i) {
+            hash ^= p[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    uint32_t recordChecksum(const JournalRecordHeader& header, const void* payload) {
+        uint32_t hash = 2166136261u;
+        hash = fnv1a(hash, &header.op, sizeof(header.op));
+        hash = fnv1a(hash, &header.index, sizeof(header.index));
+        hash = fnv1a(hash, &header.size, sizeof(header.size));
+        return fnv1a(hash, payload, header.size);
+    }
+
+    void putBytes(std::vector<char>& out, const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        out.insert(out.end(), p, p + bytes);
+    }
+
+    void lightToFloats(const LightSettings& light, float values[10]) {
+        const float packed[10] = { light.position.x, light.position.y, light.position.z, light.color.x, light.color.y,
+            light.color.z, light.ambient, light.diffuse, light.specular, light.shininess };
+        std::memcpy(values, packed, sizeof(packed));
+    }
+
+    LightSettings lightFromFloats(const float values[10]) {
+        LightSettings light;
+        light.position = glm::vec3(values[0], values[1], values[2]);
+        light.color = glm::vec3(values[3], values[4], values[5]);
+        light.ambient = values[6];
+        light.diffuse = values[7];
+        light.specular = values[8];
+        light.shininess = values[9];
+        return light;
+    }
+
+    // bounds-checked cursor over one record's payload
+    struct PayloadReader {
+        const char* data;
+        size_t size;
+        size_t offset = 0;
+
+        bool read(void* out, size_t bytes) {
+            if (bytes > size - offset) {
+                return false;
+            }
+            std::memcpy(out, data + offset, bytes);
+            offset += bytes;
+            return true;
+        }
+
+        template <typename T>
+        bool read(T& out) {
+            return read(&out, sizeof(T));
+        }
+    };
+
+    // <prefix><number><extension> -> number, or -1
+    int generationOf(const std::string& name, const char* prefix, const char* extension) {
+        const size_t prefixLength = std::strlen(prefix);
+        const size_t extensionLength = std::strlen(extension);
+        if (name.size() <= prefixLength + extensionLength || name.compare(0, prefixLength, prefix) != 0 ||
+            name.compare(name.size() - extensionLength, extensionLength, extension) != 0) {
+            return -1;
+        }
+        const std::string digits = name.substr(prefixLength, name.size() - prefixLength - extensionLength);
+        if (digits.empty() || digits.size() > 9 || !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            return -1;
+        }
+        return std::stoi(digits);
+    }
+}
+
+SceneJournal::~SceneJournal() {
+    close();
+}
+
+std::string SceneJournal::snapshotPath(int number) const {
+    return (std::filesystem::path(directory) / ("snapshot-" + std::to_string(number) + ".cgscene")).string();
+}
+
+std::string SceneJournal::journalPath(int number) const {
+    return (std::filesystem::path(directory) / ("journal-" + std::to_string(number) + ".cgjournal")).string();
+}
+
+bool SceneJournal::open(const std::string& dir, SceneRenderer& scene) {
+    TRACE_ZONE("SceneJournal::open");
+    close();
+    directory = dir;
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        std::cerr << "Cannot create autosave directory " << directory << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    std::vector<int> snapshots;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        const int number = generationOf(entry.path().filename().string(), "snapshot-", ".cgscene");
+        if (number > 0) {
+            snapshots.push_back(number);
+        }
+    }
+    std::sort(snapshots.rbegin(), snapshots.rend());
+
+    // newest snapshot that still opens; an older one only loses the edits after it
+    generation = 0;
+    recoveredRecords = 0;
+    journalBytes = 0;
+    bool journalUsable = false;
+    for (int number : snapshots) {
+        if (!scene.loadScene(snapshotPath(number))) {
+            continue;
+        }
+        generation = number;
+        journalUsable = std::filesystem::exists(journalPath(number), ec) && replay(journalPath(number), scene);
+        if (!journalUsable && std::filesystem::exists(journalPath(number), ec)) {
+            std::cerr << "Autosave journal " << journalPath(number) << " is unreadable, using the snapshot alone" << std::endl;
+        }
+        scene.clearSelection();
+        scene.clearLightSelection();
+        break;
+    }
+
+    pending.clear();
+    snapshotRequested = false;
+    stopping = false;
+    writerGeneration = generation;
+    if (generation > 0) {
+        journalFile = journalUsable ? std::fopen(journalPath(generation).c_str(), "ab") : nullptr;
+        if (!journalFile) {
+            startGeneration(generation);
+        }
+    }
+    attached = &scene;
+    scene.setJournal(this);
+    if (generation == 0) {
+        snapshotRequested = true; // nothing to replay onto yet
+        update();
+    }
+    writer = std::thread(&SceneJournal::writerLoop, this);
+    std::cout << "Autosave: journaling to " << directory << std::endl;
+    return true;
+}
+
+void SceneJournal::close() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+    if (journalFile) {
+        syncFile(journalFile);
+        std::fclose(journalFile);
+        journalFile = nullptr;
+    }
+    if (attached) {
+        if (attached->getJournal() == this) {
+            attached->setJournal(nullptr);
+        }
+        attached = nullptr;
+    }
+}
+
+void SceneJournal::update() {
+    if (!attached || (!snapshotRequested && journalBytes < compactBytes)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (compaction) {
+        return; // the previous snapshot is still being written
+    }
+    lock.unlock();
+
+    // the tables are a flat copy of the scene; encoding and disk I/O happen on the writer thread
+    auto tables = std::make_unique<SceneFileTables>();
+    attached->buildSceneTables(*tables);
+
+    lock.lock();
+    compaction = std::move(tables);
+    compactSplit = pending.size();
+    lock.unlock();
+    wake.notify_one();
+    journalBytes = 0;
+    snapshotRequested = false;
+}
+
+void SceneJournal::append(JournalOp op, int index, const void* payload, size_t bytes) {
+    JournalRecordHeader header{};
+    header.op = static_cast<uint32_t>(op);
+    header.index = index;
+    header.size = static_cast<uint32_t>(bytes);
+    header.checksum = recordChecksum(header, payload);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        putBytes(pending, &header, sizeof(header));
+        putBytes(pending, payload, bytes);
+    }
+    journalBytes += sizeof(header) + bytes;
+    wake.notify_one();
+}
+
+void SceneJournal::recordInstance(JournalOp op, const SceneRenderer& scene, int index) {
+    if (index < 0 || index >= static_cast<int>(scene.instanceCount())) {
+        return;
+    }
+    std::vector<char> payload;
+    appendInstanceState(payload, scene.captureInstance(index));
+    append(op, index, payload.data(), payload.size());
+}
+
+void SceneJournal::recordRemove(int index) {
+    append(JournalOp::RemoveInstance, index, nullptr, 0);
+}
+
+void SceneJournal::recordVector(JournalOp op, int index, const glm::vec3& value) {
+    const float values[3] = { value.x, value.y, value.z };
+    append(op, index, values, sizeof(values));
+}
+
+void SceneJournal::recordMaterial(JournalOp op, int index, const Material& material) {
+    const SceneFileMaterial record = toSceneFileMaterial(material);
+    append(op, index, &record, sizeof(record));
+}
+
+void SceneJournal::recordTexture(int index, const std::string& path) {
+    append(JournalOp::SetTexture, index, path.data(), path.size());
+}
+
+void SceneJournal::recordStatic(int index, bool isStatic) {
+    const uint8_t flag = isStatic ? 1 : 0;
+    append(JournalOp::SetStatic, index, &flag, sizeof(flag));
+}
+
+void SceneJournal::recordClear() {
+    append(JournalOp::Clear, -1, nullptr, 0);
+}
+
+void SceneJournal::recordLight(const SceneRenderer& scene, int lightIndex) {
+    if (lightIndex == -1) {
+        float values[10];
+        lightToFloats(scene.getLightSettings(), values);
+        append(JournalOp::SetLight, -1, values, sizeof(values));
+    }
+    else if (lightIndex >= 0 && lightIndex < static_cast<int>(scene.getPointLights().size())) {
+        const SceneFilePointLight record = toSceneFilePointLight(scene.getPointLights()[static_cast<size_t>(lightIndex)]);
+        append(JournalOp::SetLight, lightIndex, &record, sizeof(record));
+    }
+}
+
+void SceneJournal::recordAddPointLight(int index, const PointLight& pointLight) {
+    const SceneFilePointLight record = toSceneFilePointLight(pointLight);
+    append(JournalOp::AddPointLight, index, &record, sizeof(record));
+}
+
+void SceneJournal::recordRemovePointLight(int index) {
+    append(JournalOp::RemovePointLight, index, nullptr, 0);
+}
+
+void SceneJournal::recordClearPointLights() {
+    append(JournalOp::ClearPointLights, -1, nullptr, 0);
+}
+
+bool SceneJournal::replay(const std::string& path, SceneRenderer& scene) {
+    TRACE_ZONE("SceneJournal::replay");
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return true; // crashed before the first batch: the snapshot is the whole state
+    }
+    const std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    JournalFileHeader fileHeader{};
+    if (data.size() < sizeof(fileHeader)) {
+        return false;
+    }
+    std::memcpy(&fileHeader, data.data(), sizeof(fileHeader));
+    if (std::memcmp(fileHeader.magic, kJournalMagic, sizeof(kJournalMagic)) != 0 || fileHeader.version != kJournalVersion ||
+        static_cast<int>(fileHeader.generation) != generation) {
+        return false;
+    }
+
+    size_t offset = sizeof(fileHeader);
+    while (data.size() - offset >= sizeof(JournalRecordHeader)) {
+        JournalRecordHeader header{};
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        const char* payload = data.data() + offset + sizeof(header);
+        if (header.size > data.size() - offset - sizeof(header) || recordChecksum(header, payload) != header.checksum) {
+            break; // torn write at the tail
+        }
+        if (!apply(static_cast<JournalOp>(header.op), header.index, payload, header.size, scene)) {
+            std::cerr << "Autosave journal record " << recoveredRecords << " does not match the scene, replay stopped" << std::endl;
+            break;
+        }
+        offset += sizeof(header) + header.size;
+        ++recoveredRecords;
+    }
+
+    // drop the unusable tail so new records append right after the last good one
+    if (offset < data.size()) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, offset, ec);
+    }
+    if (recoveredRecords > 0) {
+        std::cout << "Autosave: replayed " << recoveredRecords << " journal records onto snapshot " << generation << std::endl;
+    }
+    journalBytes = offset - sizeof(fileHeader);
+    return true;
+}
+
+bool SceneJournal::apply(JournalOp op, int index, const char* payload, size_t bytes, SceneRenderer& scene) {
+    PayloadReader in{ payload, bytes };
+    const bool validInstance = index >= 0 && index < static_cast<int>(scene.instanceCount());
+    float values[3] = {};
+    switch (op) {
+    case JournalOp::AddInstance:
+    case JournalOp::SetInstance: {
+        SceneFileInstanceState state;
+        size_t offset = 0;
+        if (!readInstanceState(payload, bytes, offset, state) || state.record.type > static_cast<uint8_t>(PrimitiveType::Mesh)) {
+            return false;
+        }
+        if (op == JournalOp::AddInstance) {
+            return scene.insertInstance(index, state) == index;
+        }
+        if (!validInstance) {
+            return false;
+        }
+        const std::string& texturePath = state.texturePath;
+        scene.select(index);
+        scene.setInstanceFields(index, state.record);
+        scene.setInstanceMaterial(index, fromSceneFileMaterial(state.material));
+        PrimitiveInstance* target = scene.getSelectedMutable();
+        if (texturePath.empty()) {
+            if (target->hasTexture) {
+                scene.removeTextureFromSelected();
+            }
+        }
+        else if (scene.getTexturePath(*target) != texturePath) {
+            scene.loadTextureForSelected(texturePath);
+        }
+        return true;
+    }
+    case JournalOp::RemoveInstance:
+        if (!validInstance) {
+            return false;
+        }
+        // the same mutator as the live edit: one instance, its children become roots
+        scene.removeInstance(index);
+        return true;
+    case JournalOp::Translate:
+    case JournalOp::Rotate:
+    case JournalOp::Scale:
+    case JournalOp::SetPosition: {
+        if (!validInstance || !in.read(values, sizeof(values))) {
+            return false;
+        }
+        const glm::vec3 value(values[0], values[1], values[2]);
+        scene.select(index);
+        if (op == JournalOp::Translate) scene.translateSelected(value);
+        else if (op == JournalOp::Rotate) scene.rotateSelected(value);
+        else if (op == JournalOp::Scale) scene.scaleSelected(value);
+        else scene.setSelectedPosition(value);
+        return true;
+    }
+    case JournalOp::SetMaterial:
+    case JournalOp::EditMaterial: {
+        SceneFileMaterial record{};
+        if (!validInstance || !in.read(record)) {
+            return false;
+        }
+        if (op == JournalOp::SetMaterial) {
+            scene.setInstanceMaterial(index, fromSceneFileMaterial(record));
+        }
+        else {
+            scene.editMaterial(scene.getInstances()[static_cast<size_t>(index)].materialId, fromSceneFileMaterial(record));
+        }
+        return true;
+    }
+    case JournalOp::SetTexture:
+        if (!validInstance) {
+            return false;
+        }
+        scene.select(index);
+        if (bytes == 0) {
+            scene.removeTextureFromSelected();
+        }
+        else {
+            scene.loadTextureForSelected(std::string(payload, bytes)); // a missing file only loses the texture
+        }
+        return true;
+    case JournalOp::SetStatic: {
+        uint8_t flag = 0;
+        if (!validInstance || !in.read(flag)) {
+            return false;
+        }
+        scene.setInstanceStatic(index, flag != 0);
+        return true;
+    }
+    case JournalOp::Clear:
+        scene.clear();
+        return true;
+    case JournalOp::SetLight:
+        if (index == -1) {
+            float light[10];
+            if (!in.read(light, sizeof(light))) {
+                return false;
+            }
+            scene.getLightSettings() = lightFromFloats(light);
+        }
+        else {
+            SceneFilePointLight record{};
+            if (index < 0 || index >= static_cast<int>(scene.getPointLights().size()) || !in.read(record)) {
+                return false;
+            }
+            scene.getPointLights()[static_cast<size_t>(index)] = fromSceneFilePointLight(record);
+        }
+        return true;
+    case JournalOp::AddPointLight: {
+        SceneFilePointLight record{};
+        if (!in.read(record)) {
+            return false;
+        }
+        if (index < 0) {
+            scene.addPointLight(fromSceneFilePointLight(record));
+        }
+        else {
+            scene.insertPointLight(index, fromSceneFilePointLight(record));
+        }
+        return true;
+    }
+    case JournalOp::RemovePointLight:
+        if (index < 0 || index >= static_cast<int>(scene.getPointLights().size())) {
+            return false;
+        }
+        scene.removePointLight(index);
+        return true;
+    case JournalOp::ClearPointLights:
+        scene.clearPointLights();
+        return true;
+    }
+    return false;
+}
+
+bool SceneJournal::startGeneration(int number) {
+    FILE* f = std::fopen(journalPath(number).c_str(), "wb");
+    JournalFileHeader header{};
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.version = kJournalVersion;
+    header.generation = static_cast<uint32_t>(number);
+    if (!f || std::fwrite(&header, sizeof(header), 1, f) != 1 || !syncFile(f)) {
+        if (f) {
+            std::fclose(f);
+        }
+        std::cerr << "Cannot create autosave journal " << journalPath(number) << std::endl;
+        return false;
+    }
+    // the old journal stays open until the new one exists, so a failure keeps appending to it
+    if (journalFile) {
+        std::fclose(journalFile);
+    }
+    journalFile = f;
+    return true;
+}
+
+void SceneJournal::writeBatch(const char* data, size_t bytes) {
+    if (bytes == 0 || !journalFile) {
+        return;
+    }
+    if (std::fwrite(data, 1, bytes, journalFile) != bytes || !syncFile(journalFile)) {
+        std::cerr << "Autosave journal write failed" << std::endl;
+    }
+}
+
+void SceneJournal::removeGeneration(int number) {
+    std::error_code ec;
+    std::filesystem::remove(snapshotPath(number), ec);
+    std::filesystem::remove(journalPath(number), ec);
+}
+
+void SceneJournal::writerLoop() {
+    trace::setThreadName("Autosave");
+    std::vector<char> batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || compaction || !pending.empty(); });
+        // gather edits for a while so a burst of records costs one write and one fsync
+        if (!stopping && !compaction) {
+            wake.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs), [this] { return stopping || compaction != nullptr; });
+        }
+        batch.clear();
+        batch.swap(pending);
+        std::unique_ptr<SceneFileTables> tables = std::move(compaction);
+        const size_t split = tables ? compactSplit : batch.size();
+        const bool stop = stopping;
+        lock.unlock();
+
+        TRACE_ZONE("SceneJournal::flush");
+        writeBatch(batch.data(), split);
+        if (tables) {
+            // the new generation only becomes visible once its snapshot is complete on disk: the snapshot
+            // is fsynced before its rename and the directory after it, and the old generation goes only
+            // once the new journal's directory entry is durable as well
+            const int next = writerGeneration + 1;
+            if (writeSceneFile(snapshotPath(next), *tables, true) && startGeneration(next)) {
+                if (syncDirectory(directory)) {
+                    removeGeneration(next - 2);
+                }
+                writerGeneration = next;
+            }
+            else {
+                std::cerr << "Autosave snapshot " << next << " failed, keeping the journal" << std::endl;
+            }
+        }
+        writeBatch(batch.data() + split, batch.size() - split);
+
+        lock.lock();
+        if (stop && pending.empty() && !compaction) {
+            break;
+        }
+    }
+}
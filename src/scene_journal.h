@@ -0,0 +1,113 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "scene.h"
+#include "scene_file.h"
+
+// one journal record per scene mutation; the index is the instance (or point light) it applies to
+enum class JournalOp : uint32_t {
+    AddInstance = 1, // SceneFileInstance, SceneFileMaterial, texture path, mesh path
+    SetInstance,     // same payload, overwrites the instance after inspector edits
+    RemoveInstance,
+    Translate,       // vec3 delta
+    Rotate,          // vec3 delta
+    Scale,           // vec3 delta
+    SetPosition,     // vec3
+    SetMaterial,     // SceneFileMaterial, re-points one instance
+    EditMaterial,    // SceneFileMaterial, rewrites the entry the instance shares
+    SetTexture,      // path, empty removes the texture
+    SetStatic,       // uint8
+    Clear,
+    SetLight,        // index -1: main light as 10 floats, >= 0: SceneFilePointLight
+    AddPointLight,   // SceneFilePointLight, inserted at index (-1 appends)
+    RemovePointLight,
+    ClearPointLights
+};
+
+// Crash-safe autosave: an append-only journal of scene mutations on top of the last snapshot.
+// Records are buffered on the main thread and written by a background thread in batches, one fsync
+// per batch. Once the journal passes a size threshold the scene is compacted into a new snapshot
+// (snapshot-<n>.cgscene) and journal-<n>.cgjournal starts empty; the previous generation is kept.
+class SceneJournal {
+public:
+    SceneJournal() = default;
+    ~SceneJournal();
+    SceneJournal(const SceneJournal&) = delete;
+    SceneJournal& operator=(const SceneJournal&) = delete;
+
+    // restores the newest snapshot plus its journal into scene, attaches to it and starts the writer
+    bool open(const std::string& directory, SceneRenderer& scene);
+    // writes and syncs whatever is buffered, then detaches
+    void close();
+    bool isOpen() const { return attached != nullptr; }
+
+    // main thread, once per frame: hands a compaction to the writer when one is due
+    void update();
+    // the next update() compacts, e.g. after a whole scene was loaded
+    void requestSnapshot() { snapshotRequested = true; }
+
+    void setCompactBytes(size_t bytes) { compactBytes = bytes; }
+    size_t getJournalBytes() const { return journalBytes; }
+    // snapshot the journal currently builds on
+    int getGeneration() const { return writerGeneration; }
+    size_t getRecoveredRecords() const { return recoveredRecords; }
+
+    // called by SceneRenderer's mutators
+    void recordInstance(JournalOp op, const SceneRenderer& scene, int index);
+    void recordRemove(int index);
+    void recordVector(JournalOp op, int index, const glm::vec3& value);
+    void recordMaterial(JournalOp op, int index, const Material& material);
+    void recordTexture(int index, const std::string& path);
+    void recordStatic(int index, bool isStatic);
+    void recordClear();
+    void recordLight(const SceneRenderer& scene, int lightIndex);
+    void recordAddPointLight(int index, const PointLight& pointLight);
+    void recordRemovePointLight(int index);
+    void recordClearPointLights();
+
+private:
+    static constexpr size_t kDefaultCompactBytes = 8u << 20;
+    static constexpr int kFlushIntervalMs = 500;
+
+    void append(JournalOp op, int index, const void* payload, size_t bytes);
+    bool replay(const std::string& path, SceneRenderer& scene);
+    bool apply(JournalOp op, int index, const char* payload, size_t bytes, SceneRenderer& scene);
+    void writerLoop();
+    bool startGeneration(int number);
+    void writeBatch(const char* data, size_t bytes);
+    void removeGeneration(int number);
+    std::string snapshotPath(int number) const;
+    std::string journalPath(int number) const;
+
+    SceneRenderer* attached = nullptr;
+    std::string directory;
+    size_t compactBytes = kDefaultCompactBytes;
+    size_t journalBytes = 0; // since the last snapshot, buffered records included
+    size_t recoveredRecords = 0;
+    bool snapshotRequested = false;
+    int generation = 0; // recovered snapshot while opening
+
+    // shared with the writer thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<char> pending;
+    std::unique_ptr<SceneFileTables> compaction; // snapshot to write before pending[compactSplit..]
+    size_t compactSplit = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    // writer thread only; the generation is also read by the UI
+    FILE* journalFile = nullptr;
+    std::atomic<int> writerGeneration{ 0 };
+};
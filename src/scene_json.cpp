@@ -0,0 +1,526 @@
+#include "scene_json.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "json_stream.h"
+#include "scene_journal.h"
+#include "trace.h"
+
+namespace {
+    constexpr int kJsonVersion = 1;
+
+    // names are written instead of enum values so files stay readable and survive enum reordering
+    const char* const kTypeNames[] = { "cube", "sphere", "cylinder", "plane", "mesh" };
+    const char* const kWrapNames[] = { "repeat", "clampToEdge", "mirroredRepeat" };
+    const char* const kFilterNames[] = { "nearest", "linear" };
+    const char* const kProjectionNames[] = { "planar", "triplanar", "spherical", "cylindrical", "cube" };
+    const char* const kAxisNames[] = { "x", "y", "z" };
+
+    template <size_t N>
+    int findName(const char* const (&names)[N], const std::string& name) {
+        for (size_t i = 0; i < N; ++i) {
+            if (name == names[i]) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    void writeVec3(JsonWriter& writer, const char* name, const glm::vec3& value) {
+        writer.key(name);
+        writer.beginArray(true);
+        writer.value(value.x);
+        writer.value(value.y);
+        writer.value(value.z);
+        writer.endArray();
+    }
+
+    void writeInstance(JsonWriter& writer, const SceneRenderer& scene, const PrimitiveInstance& inst) {
+        writer.beginObject();
+        writer.key("type");
+        writer.value(kTypeNames[static_cast<int>(inst.type)]);
+        if (inst.type == PrimitiveType::Mesh) {
+            writer.key("mesh");
+            writer.value(strings::text(scene.getImportedMeshes()[static_cast<size_t>(inst.meshId)].path));
+        }
+        if (inst.parent >= 0) {
+            writer.key("parent");
+            writer.value(inst.parent);
+        }
+        writeVec3(writer, "position", inst.position);
+        writeVec3(writer, "rotation", inst.rotation);
+        writeVec3(writer, "scale", inst.scale);
+        writeVec3(writer, "color", inst.color);
+
+        const Material& material = scene.getMaterial(inst.materialId);
+        writer.key("material");
+        writer.beginObject();
+        writeVec3(writer, "ambient", material.ambient);
+        writeVec3(writer, "diffuse", material.diffuse);
+        writeVec3(writer, "specular", material.specular);
+        writer.key("shininess");
+        writer.value(material.shininess);
+        writer.key("ambientStrength");
+        writer.value(material.ambientStrength);
+        writer.key("diffuseStrength");
+        writer.value(material.diffuseStrength);
+        writer.key("specularStrength");
+        writer.value(material.specularStrength);
+        writer.endObject();
+
+        const std::string& texturePath = inst.hasTexture ? scene.getTexturePath(inst) : std::string();
+        if (!texturePath.empty()) {
+            writer.key("texture");
+            writer.value(texturePath);
+        }
+        writer.key("wrap");
+        writer.value(kWrapNames[static_cast<int>(inst.wrapMode)]);
+        writer.key("filter");
+        writer.value(kFilterNames[static_cast<int>(inst.filterMode)]);
+        writer.key("projection");
+        writer.value(kProjectionNames[static_cast<int>(inst.projection)]);
+        writer.key("planarAxis");
+        writer.value(kAxisNames[static_cast<int>(inst.planarAxis)]);
+        writer.key("uvScale");
+        writer.beginArray(true);
+        writer.value(inst.uvScale.x);
+        writer.value(inst.uvScale.y);
+        writer.endArray();
+        writer.key("static");
+        writer.value(inst.isStatic);
+        writer.key("castsShadow");
+        writer.value(inst.castsShadow);
+        writer.endObject();
+    }
+
+    bool setComponent(glm::vec3& target, int component, double value) {
+        if (component < 0 || component > 2) {
+            return false;
+        }
+        target[component] = static_cast<float>(value);
+        return true;
+    }
+
+    // Builds one light or instance at a time from the event stream and stages it as its object closes;
+    // apply() hands the lot to the scene once the file parsed. Only the open containers are tracked.
+    class SceneJsonHandler : public JsonHandler {
+    public:
+        // the main light starts from the scene's, keys the file leaves out keep their values
+        explicit SceneJsonHandler(const LightSettings& current) : light(current) {}
+
+        bool startObject() override {
+            beginValue();
+            if (levels.size() == 2 && levels[1].isArray) {
+                if (section() == "instances") {
+                    resetInstance();
+                }
+                else if (section() == "pointLights") {
+                    pointLight = PointLight();
+                }
+            }
+            pushLevel(false);
+            return true;
+        }
+
+        bool endObject() override {
+            levels.pop_back();
+            if (levels.size() == 2 && levels[1].isArray) {
+                if (section() == "instances") {
+                    commitInstance();
+                }
+                else if (section() == "pointLights") {
+                    pointLights.push_back(pointLight);
+                }
+            }
+            return true;
+        }
+
+        bool startArray() override {
+            beginValue();
+            pushLevel(true);
+            return true;
+        }
+
+        bool endArray() override {
+            levels.pop_back();
+            return true;
+        }
+
+        bool key(const std::string& name) override {
+            levels.back().key = name;
+            return true;
+        }
+
+        bool number(double value) override {
+            const int component = beginValue();
+            if (levels.size() == 1 && levels[0].key == "version") {
+                version = static_cast<int>(value);
+                return version <= kJsonVersion;
+            }
+            if (section() == "light") {
+                numberForLight(field(1, component), value, component);
+            }
+            else if (section() == "pointLights") {
+                numberForPointLight(field(2, component), value, component);
+            }
+            else if (section() == "instances") {
+                numberForInstance(field(2, component), value, component);
+            }
+            return true;
+        }
+
+        bool string(const std::string& text) override {
+            const int component = beginValue();
+            if (section() != "instances") {
+                return true;
+            }
+            const Field f = field(2, component);
+            if (!f.name || f.sub) {
+                return true;
+            }
+            const std::string& name = *f.name;
+            if (name == "type") {
+                setEnum(instance.type, findName(kTypeNames, text));
+            }
+            else if (name == "mesh") {
+                meshPath = text;
+            }
+            else if (name == "texture") {
+                texturePath = text;
+            }
+            else if (name == "wrap") {
+                setEnum(instance.wrapMode, findName(kWrapNames, text));
+            }
+            else if (name == "filter") {
+                setEnum(instance.filterMode, findName(kFilterNames, text));
+            }
+            else if (name == "projection") {
+                setEnum(instance.projection, findName(kProjectionNames, text));
+            }
+            else if (name == "planarAxis") {
+                setEnum(instance.planarAxis, findName(kAxisNames, text));
+            }
+            return true;
+        }
+
+        bool boolean(bool value) override {
+            const int component = beginValue();
+            if (section() != "instances") {
+                return true;
+            }
+            const Field f = field(2, component);
+            if (f.name && !f.sub && *f.name == "static") {
+                instance.isStatic = value;
+            }
+            else if (f.name && !f.sub && *f.name == "castsShadow") {
+                instance.castsShadow = value;
+            }
+            return true;
+        }
+
+        bool null() override {
+            beginValue();
+            return true;
+        }
+
+        // everything is staged while parsing, so a bad file leaves the scene alone; this replaces it
+        void apply(SceneRenderer& scene) {
+            scene.clear();
+            scene.clearPointLights();
+            scene.clearLightSelection();
+            scene.getLightSettings() = light;
+            for (const PointLight& staged : pointLights) {
+                scene.addPointLight(staged);
+            }
+
+            std::map<std::string, int> meshIds; // path -> scene mesh id, imported once
+            std::vector<int> loadedIndex;       // file element -> scene instance, -1 when skipped
+            loadedIndex.reserve(staged.size());
+            for (const StagedInstance& element : staged) {
+                PrimitiveInstance inst = element.instance;
+                if (inst.type == PrimitiveType::Mesh) {
+                    auto found = meshIds.find(element.meshPath);
+                    if (found == meshIds.end()) {
+                        found = meshIds.emplace(element.meshPath, element.meshPath.empty() ? -1 : scene.importMesh(element.meshPath)).first;
+                    }
+                    inst.meshId = found->second;
+                }
+                inst.parent = -1;
+                const int index = scene.addInstance(inst, element.material, element.texturePath);
+                if (index < 0) {
+                    ++skipped;
+                }
+                loadedIndex.push_back(index);
+            }
+
+            // parents may come later in the file and skipped elements shift indices, so links are made last
+            for (size_t i = 0; i < staged.size(); ++i) {
+                const int index = loadedIndex[i];
+                const int fileParent = staged[i].instance.parent;
+                if (index < 0 || fileParent < 0 || fileParent >= static_cast<int>(loadedIndex.size())) {
+                    continue;
+                }
+                const int parent = loadedIndex[static_cast<size_t>(fileParent)];
+                if (parent >= 0) {
+                    SceneFileInstance record = toSceneFileInstance(scene.getInstances()[static_cast<size_t>(index)]);
+                    record.parent = parent + 1;
+                    scene.setInstanceFields(index, record);
+                }
+            }
+        }
+
+        int getVersion() const { return version; }
+        size_t getSkipped() const { return skipped; }
+        size_t getUnknownNames() const { return unknownNames; }
+
+    private:
+        struct StagedInstance {
+            PrimitiveInstance instance{}; // parent is the element index in the file
+            Material material;
+            std::string meshPath;
+            std::string texturePath;
+        };
+
+        struct Level {
+            bool isArray = false;
+            std::string key; // member being read, objects only
+            int index = 0;   // next element, arrays only
+        };
+
+        // a scalar's place below the element object at depth base: field, optional sub-object field
+        struct Field {
+            const std::string* name = nullptr;
+            const std::string* sub = nullptr;
+        };
+
+        void pushLevel(bool isArray) {
+            levels.emplace_back();
+            levels.back().isArray = isArray;
+        }
+
+        const std::string& section() const {
+            static const std::string kNone;
+            return levels.empty() ? kNone : levels[0].key;
+        }
+
+        // advances the parent array and returns the element index, or -1 inside an object
+        int beginValue() {
+            if (levels.empty() || !levels.back().isArray) {
+                return -1;
+            }
+            return levels.back().index++;
+        }
+
+        Field field(size_t base, int component) const {
+            Field f;
+            const size_t end = component >= 0 ? levels.size() - 1 : levels.size();
+            if (end <= base || levels[base].isArray) {
+                return f;
+            }
+            f.name = &levels[base].key;
+            if (end == base + 2 && !levels[base + 1].isArray) {
+                f.sub = &levels[base + 1].key;
+            }
+            else if (end > base + 1) {
+                f.name = nullptr; // deeper than any known field
+            }
+            return f;
+        }
+
+        template <typename Enum>
+        void setEnum(Enum& target, int index) {
+            if (index < 0) {
+                ++unknownNames;
+                return;
+            }
+            target = static_cast<Enum>(index);
+        }
+
+        void numberForLight(const Field& f, double value, int component) {
+            if (!f.name || f.sub) {
+                return;
+            }
+            const std::string& name = *f.name;
+            if (name == "position") setComponent(light.position, component, value);
+            else if (name == "color") setComponent(light.color, component, value);
+            else if (name == "ambient") light.ambient = static_cast<float>(value);
+            else if (name == "diffuse") light.diffuse = static_cast<float>(value);
+            else if (name == "specular") light.specular = static_cast<float>(value);
+            else if (name == "shininess") light.shininess = static_cast<float>(value);
+        }
+
+        void numberForPointLight(const Field& f, double value, int component) {
+            if (!f.name || f.sub) {
+                return;
+            }
+            const std::string& name = *f.name;
+            if (name == "position") setComponent(pointLight.position, component, value);
+            else if (name == "color") setComponent(pointLight.color, component, value);
+            else if (name == "intensity") pointLight.intensity = static_cast<float>(value);
+            else if (name == "radius") pointLight.radius = static_cast<float>(value);
+        }
+
+        void numberForInstance(const Field& f, double value, int component) {
+            if (!f.name) {
+                return;
+            }
+            const std::string& name = *f.name;
+            if (f.sub) {
+                if (name != "material") {
+                    return;
+                }
+                const std::string& sub = *f.sub;
+                if (sub == "ambient") setComponent(material.ambient, component, value);
+                else if (sub == "diffuse") setComponent(material.diffuse, component, value);
+                else if (sub == "specular") setComponent(material.specular, component, value);
+                else if (sub == "shininess") material.shininess = static_cast<float>(value);
+                else if (sub == "ambientStrength") material.ambientStrength = static_cast<float>(value);
+                else if (sub == "diffuseStrength") material.diffuseStrength = static_cast<float>(value);
+                else if (sub == "specularStrength") material.specularStrength = static_cast<float>(value);
+                return;
+            }
+            if (name == "position") setComponent(instance.position, component, value);
+            else if (name == "rotation") setComponent(instance.rotation, component, value);
+            else if (name == "scale") setComponent(instance.scale, component, value);
+            else if (name == "color") setComponent(instance.color, component, value);
+            else if (name == "uvScale" && (component == 0 || component == 1)) {
+                instance.uvScale[component] = static_cast<float>(value);
+            }
+            else if (name == "parent" && component < 0) {
+                instance.parent = static_cast<int>(value); // element index in the file, see apply()
+            }
+        }
+
+        void resetInstance() {
+            instance = PrimitiveInstance{};
+            instance.type = PrimitiveType::Cube;
+            instance.position = glm::vec3(0.0f);
+            instance.rotation = glm::vec3(0.0f);
+            instance.scale = glm::vec3(1.0f);
+            instance.color = glm::vec3(1.0f);
+            material = Material();
+            meshPath.clear();
+            texturePath.clear();
+        }
+
+        void commitInstance() {
+            staged.push_back({ instance, material, meshPath, texturePath });
+        }
+
+        std::vector<Level> levels;
+        PrimitiveInstance instance{};
+        Material material;
+        std::string meshPath;
+        std::string texturePath;
+        PointLight pointLight;
+        LightSettings light;
+        std::vector<PointLight> pointLights;
+        std::vector<StagedInstance> staged;
+        int version = 0;
+        size_t skipped = 0;
+        size_t unknownNames = 0;
+    };
+}
+
+bool exportSceneJson(const SceneRenderer& scene, const std::string& path) {
+    TRACE_ZONE("exportSceneJson");
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot create " << tempPath << std::endl;
+            return false;
+        }
+        JsonWriter writer(out);
+        writer.beginObject();
+        writer.key("format");
+        writer.value("cg-scene");
+        writer.key("version");
+        writer.value(kJsonVersion);
+
+        const LightSettings& light = scene.getLightSettings();
+        writer.key("light");
+        writer.beginObject();
+        writeVec3(writer, "position", light.position);
+        writeVec3(writer, "color", light.color);
+        writer.key("ambient");
+        writer.value(light.ambient);
+        writer.key("diffuse");
+        writer.value(light.diffuse);
+        writer.key("specular");
+        writer.value(light.specular);
+        writer.key("shininess");
+        writer.value(light.shininess);
+        writer.endObject();
+
+        writer.key("pointLights");
+        writer.beginArray();
+        for (const PointLight& pointLight : scene.getPointLights()) {
+            writer.beginObject();
+            writeVec3(writer, "position", pointLight.position);
+            writeVec3(writer, "color", pointLight.color);
+            writer.key("intensity");
+            writer.value(pointLight.intensity);
+            writer.key("radius");
+            writer.value(pointLight.radius);
+            writer.endObject();
+        }
+        writer.endArray();
+
+        writer.key("instances");
+        writer.beginArray();
+        for (const PrimitiveInstance& inst : scene.getInstances()) {
+            writeInstance(writer, scene, inst);
+        }
+        writer.endArray();
+        writer.endObject();
+
+        if (!out.flush()) {
+            std::cerr << "Failed to write " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool importSceneJson(SceneRenderer& scene, const std::string& path) {
+    TRACE_ZONE("importSceneJson");
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << path << std::endl;
+        return false;
+    }
+
+    SceneJsonHandler handler(scene.getLightSettings());
+    JsonReader reader(in);
+    if (!reader.parse(handler)) {
+        // nothing was touched yet, the scene stays as it was
+        if (handler.getVersion() > kJsonVersion) {
+            std::cerr << path << ": scene version " << handler.getVersion() << " is newer than this build" << std::endl;
+        }
+        else {
+            std::cerr << path << ": " << reader.getError() << std::endl;
+        }
+        return false;
+    }
+
+    SceneReplaceScope replace(scene);
+    handler.apply(scene);
+    if (handler.getSkipped() > 0 || handler.getUnknownNames() > 0) {
+        std::cerr << path << ": skipped " << handler.getSkipped() << " instances, " << handler.getUnknownNames()
+                  << " unknown enum names" << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+#include "scene.h"
+
+// Human-diffable scene interchange (.json). Both directions stream through json_stream.h; an import
+// stages the parsed elements and only replaces the scene once the whole file read cleanly. Textures and
+// meshes are stored by path.
+bool exportSceneJson(const SceneRenderer& scene, const std::string& path);
+// replaces instances, point lights and the main light; unknown keys are ignored. On failure the scene
+// is left untouched
+bool importSceneJson(SceneRenderer& scene, const std::string& path);
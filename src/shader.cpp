@@ -29,31 +29,36 @@ void Shader::use() const {
     glUseProgram(programId);
 }
 
-void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-    const GLint loc = glGetUniformLocation(programId, name.c_str());
+void Shader::setMat4(const char* name, const glm::mat4& mat) const {
+    const GLint loc = glGetUniformLocation(programId, name);
     glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
 }
 
-void Shader::setVec2(const std::string& name, const glm::vec2& value) const {
-    const GLint loc = glGetUniformLocation(programId, name.c_str());
+void Shader::setVec2(const char* name, const glm::vec2& value) const {
+    const GLint loc = glGetUniformLocation(programId, name);
     glUniform2fv(loc, 1, glm::value_ptr(value));
 }
 
-void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-    const GLint loc = glGetUniformLocation(programId, name.c_str());
+void Shader::setVec3(const char* name, const glm::vec3& value) const {
+    const GLint loc = glGetUniformLocation(programId, name);
     glUniform3fv(loc, 1, glm::value_ptr(value));
 }
 
-void Shader::setFloat(const std::string& name, float value) const {
-    const GLint loc = glGetUniformLocation(programId, name.c_str());
+void Shader::setFloat(const char* name, float value) const {
+    const GLint loc = glGetUniformLocation(programId, name);
     glUniform1f(loc, value);
 }
 
-void Shader::setInt(const std::string& name, int value) const {
-    const GLint loc = glGetUniformLocation(programId, name.c_str());
+void Shader::setInt(const char* name, int value) const {
+    const GLint loc = glGetUniformLocation(programId, name);
     glUniform1i(loc, value);
 }
 
+void Shader::setIVec3(const char* name, const glm::ivec3& value) const {
+    const GLint loc = glGetUniformLocation(programId, name);
+    glUniform3i(loc, value.x, value.y, value.z);
+}
+
 GLuint Shader::compile(GLenum type, const char* source) {
     GLuint shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, nullptr);
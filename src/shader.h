@@ -13,11 +13,12 @@ public:
     void use() const;
     GLuint id() const { return programId; }
 
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
-    void setVec2(const std::string& name, const glm::vec2& value) const;
-    void setVec3(const std::string& name, const glm::vec3& value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setInt(const std::string& name, int value) const;
+    void setMat4(const char* name, const glm::mat4& mat) const;
+    void setVec2(const char* name, const glm::vec2& value) const;
+    void setVec3(const char* name, const glm::vec3& value) const;
+    void setFloat(const char* name, float value) const;
+    void setInt(const char* name, int value) const;
+    void setIVec3(const char* name, const glm::ivec3& value) const;
 
 private:
     GLuint programId = 0;
@@ -0,0 +1,324 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    bool rayHitsBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boxMin,
+        const glm::vec3& boxMax, float maxDistance) {
+        const glm::vec3 t1 = (boxMin - origin) * inverseDirection;
+        const glm::vec3 t2 = (boxMax - origin) * inverseDirection;
+        const glm::vec3 nearT = glm::min(t1, t2);
+        const glm::vec3 farT = glm::max(t1, t2);
+        const float enter = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+        const float exit = std::min(std::min(farT.x, farT.y), farT.z);
+        return enter <= exit && enter <= maxDistance;
+    }
+
+    float boxDistance2(const glm::vec3& point, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        const glm::vec3 offset = point - glm::clamp(point, boxMin, boxMax);
+        return glm::dot(offset, offset);
+    }
+}
+
+SpatialIndex::SpatialIndex() {
+    clear();
+}
+
+void SpatialIndex::clear() {
+    nodes.assign(1, Node{});
+    nodes[0].halfSize = kInitialHalfSize;
+    freeNodes.clear();
+    objects.clear();
+    freeObject = -1;
+    stats = Stats{};
+}
+
+SpatialIndex::Stats SpatialIndex::getStats() const {
+    Stats result = stats;
+    result.nodes = nodes.size() - freeNodes.size();
+    return result;
+}
+
+int SpatialIndex::insert(int item, const glm::vec3& center, float radius) {
+    int handle = freeObject;
+    if (handle >= 0) {
+        freeObject = objects[static_cast<size_t>(handle)].slot;
+    }
+    else {
+        handle = static_cast<int>(objects.size());
+        objects.emplace_back();
+    }
+    Object& object = objects[static_cast<size_t>(handle)];
+    object.center = center;
+    object.radius = radius;
+    object.item = item;
+    object.node = -1;
+    object.live = true;
+    ++stats.objects;
+    place(handle);
+    return handle;
+}
+
+void SpatialIndex::update(int handle, const glm::vec3& center, float radius) {
+    Object& object = objects[static_cast<size_t>(handle)];
+    object.center = center;
+    object.radius = radius;
+    if (fitsLoose(nodes[static_cast<size_t>(object.node)], center, radius)) {
+        ++stats.inPlaceMoves;
+        return;
+    }
+    ++stats.relocations;
+    detach(handle);
+    place(handle);
+}
+
+void SpatialIndex::remove(int handle) {
+    Object& object = objects[static_cast<size_t>(handle)];
+    if (!object.live) {
+        return;
+    }
+    detach(handle);
+    object.live = false;
+    object.item = -1;
+    object.slot = freeObject;
+    freeObject = handle;
+    --stats.objects;
+}
+
+bool SpatialIndex::fitsRoot(const glm::vec3& center, float radius) const {
+    const Node& root = nodes[0];
+    const glm::vec3 offset = glm::abs(center - root.center);
+    return offset.x <= root.halfSize && offset.y <= root.halfSize && offset.z <= root.halfSize && radius <= root.halfSize;
+}
+
+bool SpatialIndex::fitsLoose(const Node& node, const glm::vec3& center, float radius) const {
+    const glm::vec3 offset = glm::abs(center - node.center) + glm::vec3(radius);
+    const float loose = 2.0f * node.halfSize;
+    return offset.x <= loose && offset.y <= loose && offset.z <= loose;
+}
+
+bool SpatialIndex::withinLimit(const glm::vec3& center, float radius) {
+    // written so NaN fails every comparison
+    const glm::vec3 offset = glm::abs(center);
+    return offset.x <= kMaxHalfSize && offset.y <= kMaxHalfSize && offset.z <= kMaxHalfSize && radius <= kMaxHalfSize;
+}
+
+void SpatialIndex::place(int handle) {
+    const glm::vec3 center = objects[static_cast<size_t>(handle)].center;
+    const float radius = objects[static_cast<size_t>(handle)].radius;
+    int node = 0;
+    if (withinLimit(center, radius)) {
+        if (!fitsRoot(center, radius)) {
+            growRoot(); // places this one as well
+            return;
+        }
+        // down to the deepest cell whose child would be too small; with loose bounds twice the cell,
+        // a sphere no larger than the cell's half size always fits once its centre is inside
+        while (nodes[static_cast<size_t>(node)].depth < kMaxDepth && radius <= nodes[static_cast<size_t>(node)].halfSize * 0.5f) {
+            node = childFor(node, center);
+        }
+    }
+    Node& target = nodes[static_cast<size_t>(node)];
+    Object& object = objects[static_cast<size_t>(handle)];
+    object.node = node;
+    object.slot = static_cast<int>(target.objects.size());
+    target.objects.push_back(handle);
+}
+
+void SpatialIndex::detach(int handle) {
+    Object& object = objects[static_cast<size_t>(handle)];
+    int node = object.node;
+    std::vector<int>& list = nodes[static_cast<size_t>(node)].objects;
+    const int moved = list.back();
+    list[static_cast<size_t>(object.slot)] = moved;
+    objects[static_cast<size_t>(moved)].slot = object.slot;
+    list.pop_back();
+    object.node = -1;
+
+    // drop cells left with nothing in or below them
+    while (node != 0 && nodes[static_cast<size_t>(node)].objects.empty() && nodes[static_cast<size_t>(node)].childCount == 0) {
+        const Node& empty = nodes[static_cast<size_t>(node)];
+        Node& parent = nodes[static_cast<size_t>(empty.parent)];
+        parent.children[empty.octant] = -1;
+        --parent.childCount;
+        freeNodes.push_back(node);
+        node = empty.parent;
+    }
+}
+
+int SpatialIndex::childFor(int node, const glm::vec3& center) {
+    const glm::vec3 parentCenter = nodes[static_cast<size_t>(node)].center;
+    const int octant = (center.x >= parentCenter.x ? 1 : 0) | (center.y >= parentCenter.y ? 2 : 0) |
+        (center.z >= parentCenter.z ? 4 : 0);
+    int child = nodes[static_cast<size_t>(node)].children[octant];
+    if (child >= 0) {
+        return child;
+    }
+
+    Node created;
+    created.halfSize = nodes[static_cast<size_t>(node)].halfSize * 0.5f;
+    created.center = parentCenter + glm::vec3((octant & 1) ? created.halfSize : -created.halfSize,
+        (octant & 2) ? created.halfSize : -created.halfSize, (octant & 4) ? created.halfSize : -created.halfSize);
+    created.parent = node;
+    created.octant = octant;
+    created.depth = nodes[static_cast<size_t>(node)].depth + 1;
+    if (!freeNodes.empty()) {
+        child = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[static_cast<size_t>(child)] = std::move(created);
+    }
+    else {
+        child = static_cast<int>(nodes.size());
+        nodes.push_back(std::move(created)); // invalidates references into nodes
+    }
+    nodes[static_cast<size_t>(node)].children[octant] = child;
+    ++nodes[static_cast<size_t>(node)].childCount;
+    return child;
+}
+
+void SpatialIndex::growRoot() {
+    float halfSize = nodes[0].halfSize;
+    for (const Object& object : objects) {
+        if (!object.live || !withinLimit(object.center, object.radius)) {
+            continue; // parked in the root, see place()
+        }
+        const glm::vec3 offset = glm::abs(object.center);
+        const float needed = std::max(std::max(offset.x, offset.y), std::max(offset.z, object.radius));
+        while (halfSize < needed) {
+            halfSize *= 2.0f;
+        }
+    }
+    nodes.assign(1, Node{});
+    nodes[0].halfSize = halfSize;
+    freeNodes.clear();
+    for (size_t handle = 0; handle < objects.size(); ++handle) {
+        if (objects[handle].live) {
+            place(static_cast<int>(handle));
+        }
+    }
+    ++stats.rebuilds;
+}
+
+void SpatialIndex::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+    std::vector<RayHit>& out) const {
+    out.clear();
+    const glm::vec3 inverseDirection = glm::vec3(1.0f) / direction;
+    const float a = glm::dot(direction, direction);
+    if (a <= 0.0f) {
+        return;
+    }
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        const Node& node = nodes[static_cast<size_t>(stack.back())];
+        stack.pop_back();
+        if (!rayHitsBox(origin, inverseDirection, looseMin(node), looseMax(node), maxDistance)) {
+            continue;
+        }
+        for (int handle : node.objects) {
+            const Object& object = objects[static_cast<size_t>(handle)];
+            const glm::vec3 offset = origin - object.center;
+            const float b = glm::dot(offset, direction);
+            const float c = glm::dot(offset, offset) - object.radius * object.radius;
+            if (c <= 0.0f) {
+                out.push_back({ 0.0f, object.item }); // starts inside
+                continue;
+            }
+            const float discriminant = b * b - a * c;
+            if (discriminant < 0.0f || b > 0.0f) {
+                continue; // missed, or pointing away
+            }
+            const float t = (-b - std::sqrt(discriminant)) / a;
+            if (t <= maxDistance) {
+                out.push_back({ t, object.item });
+            }
+        }
+        for (int child : node.children) {
+            if (child >= 0) {
+                stack.push_back(child);
+            }
+        }
+    }
+}
+
+void SpatialIndex::queryFrustum(const Frustum& frustum, bool enclosed, std::vector<int>& out) const {
+    out.clear();
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        const Node& node = nodes[static_cast<size_t>(stack.back())];
+        stack.pop_back();
+        if (!frustum.touchesBox(looseMin(node), looseMax(node))) {
+            continue;
+        }
+        for (int handle : node.objects) {
+            const Object& object = objects[static_cast<size_t>(handle)];
+            if (enclosed ? frustum.enclosesSphere(object.center, object.radius) :
+                frustum.touchesSphere(object.center, object.radius)) {
+                out.push_back(object.item);
+            }
+        }
+        for (int child : node.children) {
+            if (child >= 0) {
+                stack.push_back(child);
+            }
+        }
+    }
+}
+
+void SpatialIndex::queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& out) const {
+    out.clear();
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        const Node& node = nodes[static_cast<size_t>(stack.back())];
+        stack.pop_back();
+        const glm::vec3 nodeMin = looseMin(node);
+        const glm::vec3 nodeMax = looseMax(node);
+        if (nodeMin.x > boxMax.x || nodeMin.y > boxMax.y || nodeMin.z > boxMax.z ||
+            nodeMax.x < boxMin.x || nodeMax.y < boxMin.y || nodeMax.z < boxMin.z) {
+            continue;
+        }
+        for (int handle : node.objects) {
+            const Object& object = objects[static_cast<size_t>(handle)];
+            if (boxDistance2(object.center, boxMin, boxMax) <= object.radius * object.radius) {
+                out.push_back(object.item);
+            }
+        }
+        for (int child : node.children) {
+            if (child >= 0) {
+                stack.push_back(child);
+            }
+        }
+    }
+}
+
+int SpatialIndex::nearest(const glm::vec3& point, float maxDistance, float* distance) const {
+    int best = -1;
+    float bestDistance2 = maxDistance * maxDistance;
+    std::vector<int> stack(1, 0);
+    while (!stack.empty()) {
+        const Node& node = nodes[static_cast<size_t>(stack.back())];
+        stack.pop_back();
+        // centres can sit anywhere in the loose bounds, so those bound the search
+        if (boxDistance2(point, looseMin(node), looseMax(node)) > bestDistance2) {
+            continue;
+        }
+        for (int handle : node.objects) {
+            const Object& object = objects[static_cast<size_t>(handle)];
+            const glm::vec3 offset = object.center - point;
+            const float distance2 = glm::dot(offset, offset);
+            if (distance2 <= bestDistance2) {
+                bestDistance2 = distance2;
+                best = object.item;
+            }
+        }
+        for (int child : node.children) {
+            if (child >= 0) {
+                stack.push_back(child);
+            }
+        }
+    }
+    if (distance && best >= 0) {
+        *distance = std::sqrt(bestDistance2);
+    }
+    return best;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "frustum.h"
+
+// Loose octree over bounding spheres. Each node's loose bounds are twice its cell, so an object is
+// stored in the deepest cell whose half size still covers its radius, and it keeps that node for as
+// long as it stays inside the loose bounds: small moves are a bounds check, only larger ones detach
+// it and insert it again. The root grows (and everything is re-inserted) when something leaves it.
+//
+// Objects are addressed by the handle insert() returns; queries report the caller's item instead,
+// which can be renumbered with setItem() when the caller's indices shift.
+class SpatialIndex {
+public:
+    struct RayHit {
+        float t;  // where the ray enters the bounding sphere, 0 when it starts inside
+        int item;
+    };
+
+    struct Stats {
+        size_t objects = 0;
+        size_t nodes = 0;
+        size_t inPlaceMoves = 0; // update() calls that stayed in their node
+        size_t relocations = 0;  // update() calls that had to re-insert
+        size_t rebuilds = 0;     // root growth
+    };
+
+    SpatialIndex();
+
+    void clear();
+    int insert(int item, const glm::vec3& center, float radius);
+    void update(int handle, const glm::vec3& center, float radius);
+    void remove(int handle);
+    void setItem(int handle, int item) { objects[static_cast<size_t>(handle)].item = item; }
+    size_t size() const { return stats.objects; }
+    Stats getStats() const;
+
+    // every sphere the ray enters before maxDistance, unordered; direction need not be normalized
+    // (t is then in units of it)
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<RayHit>& out) const;
+    // enclosed: the sphere lies entirely inside, otherwise it only has to touch the frustum
+    void queryFrustum(const Frustum& frustum, bool enclosed, std::vector<int>& out) const;
+    void queryBox(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& out) const;
+    // item whose centre is closest to point, -1 when none is within maxDistance
+    int nearest(const glm::vec3& point, float maxDistance, float* distance = nullptr) const;
+
+private:
+    static constexpr int kMaxDepth = 8;
+    static constexpr float kInitialHalfSize = 32.0f;
+    // the root never grows past this; objects further out, or with NaN/inf bounds (a singular parent
+    // matrix, say), are parked in the root where the queries' bounds tests mostly skip them
+    static constexpr float kMaxHalfSize = 1.0e7f;
+
+    struct Node {
+        glm::vec3 center = glm::vec3(0.0f);
+        float halfSize = 0.0f; // of the cell; the loose bounds are twice as large
+        int parent = -1;
+        int octant = 0;        // slot in the parent's children
+        int depth = 0;
+        int children[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+        int childCount = 0;
+        std::vector<int> objects; // handles
+    };
+
+    struct Object {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        int item = -1;
+        int node = -1; // -1 while free or being placed
+        int slot = 0;  // position in the node's objects; next free handle while free
+        bool live = false;
+    };
+
+    bool fitsRoot(const glm::vec3& center, float radius) const;
+    bool fitsLoose(const Node& node, const glm::vec3& center, float radius) const;
+    static bool withinLimit(const glm::vec3& center, float radius);
+    void place(int handle);
+    void detach(int handle);
+    int childFor(int node, const glm::vec3& center);
+    // doubles the root until every object within the limit fits and inserts them all again
+    void growRoot();
+    glm::vec3 looseMin(const Node& node) const { return node.center - glm::vec3(2.0f * node.halfSize); }
+    glm::vec3 looseMax(const Node& node) const { return node.center + glm::vec3(2.0f * node.halfSize); }
+
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::vector<int> freeNodes;
+    std::vector<Object> objects;
+    int freeObject = -1;
+    Stats stats;
+};
@@ -0,0 +1,79 @@
+#include "string_table.h"
+
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace strings {
+
+    namespace {
+        constexpr uint32_t kChunkBits = 10;
+        constexpr uint32_t kChunkSize = 1u << kChunkBits;
+        constexpr uint32_t kMaxChunks = 4096; // 4M strings
+
+        struct Table {
+            std::atomic<std::string*> chunks[kMaxChunks] = {};
+            std::atomic<uint32_t> size{ 0 };
+            std::mutex mutex; // writers only
+            // keys view the stored strings, which never move
+            std::unordered_map<std::string_view, StringId> ids;
+
+            Table() {
+                chunks[0].store(new std::string[kChunkSize], std::memory_order_release);
+                ids.emplace(std::string_view(), kEmptyString);
+                size.store(1, std::memory_order_release);
+            }
+            ~Table() {
+                for (std::atomic<std::string*>& chunk : chunks) {
+                    delete[] chunk.load(std::memory_order_relaxed);
+                }
+            }
+        };
+
+        Table& table() {
+            static Table instance;
+            return instance;
+        }
+    }
+
+    StringId intern(const std::string& text) {
+        if (text.empty()) {
+            return kEmptyString;
+        }
+        Table& t = table();
+        std::lock_guard<std::mutex> lock(t.mutex);
+        const auto found = t.ids.find(text);
+        if (found != t.ids.end()) {
+            return found->second;
+        }
+        const uint32_t id = t.size.load(std::memory_order_relaxed);
+        const uint32_t chunk = id >> kChunkBits;
+        if (chunk >= kMaxChunks) {
+            return kEmptyString; // out of ids; the caller sees an empty string rather than a wrong one
+        }
+        std::string* strings = t.chunks[chunk].load(std::memory_order_relaxed);
+        if (!strings) {
+            strings = new std::string[kChunkSize];
+            t.chunks[chunk].store(strings, std::memory_order_release);
+        }
+        std::string& stored = strings[id & (kChunkSize - 1)];
+        stored = text;
+        t.ids.emplace(std::string_view(stored), id);
+        t.size.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    const std::string& text(StringId id) {
+        static const std::string kNone;
+        Table& t = table();
+        if (id >= t.size.load(std::memory_order_acquire)) {
+            return kNone;
+        }
+        return t.chunks[id >> kChunkBits].load(std::memory_order_acquire)[id & (kChunkSize - 1)];
+    }
+
+    size_t count() {
+        return table().size.load(std::memory_order_acquire);
+    }
+}
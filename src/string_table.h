@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// 32-bit handle of an interned string; equal strings always get the same id, 0 is the empty string
+using StringId = uint32_t;
+constexpr StringId kEmptyString = 0;
+
+// Process-wide string interner for asset paths and display names, so records can hold an id and
+// compare it instead of owning a std::string. Interning takes a lock; text() does not: strings sit
+// in fixed-size chunks that never move, and an id is only handed out after its string is in place.
+// Strings are never freed, which suits the few hundred paths a session touches.
+namespace strings {
+
+    StringId intern(const std::string& text);
+    // reading is safe from any thread that obtained the id
+    const std::string& text(StringId id);
+    // distinct strings interned so far, the empty one included
+    size_t count();
+}
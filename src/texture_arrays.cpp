@@ -0,0 +1,203 @@
+#include "texture_arrays.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "stb_image.h"
+#include "trace.h"
+
+namespace {
+    // bilinear resample of an RGBA8 image to size x size
+    std::vector<unsigned char> resampleSquare(const unsigned char* src, int width, int height, int size) {
+        std::vector<unsigned char> dst(static_cast<size_t>(size) * size * 4);
+        const float sx = static_cast<float>(width) / static_cast<float>(size);
+        const float sy = static_cast<float>(height) / static_cast<float>(size);
+        for (int y = 0; y < size; ++y) {
+            const float fy = std::max(0.0f, (static_cast<float>(y) + 0.5f) * sy - 0.5f);
+            const int y0 = std::min(static_cast<int>(fy), height - 1);
+            const int y1 = std::min(y0 + 1, height - 1);
+            const float ty = fy - static_cast<float>(y0);
+            for (int x = 0; x < size; ++x) {
+                const float fx = std::max(0.0f, (static_cast<float>(x) + 0.5f) * sx - 0.5f);
+                const int x0 = std::min(static_cast<int>(fx), width - 1);
+                const int x1 = std::min(x0 + 1, width - 1);
+                const float tx = fx - static_cast<float>(x0);
+                for (int c = 0; c < 4; ++c) {
+                    const float a = src[(y0 * width + x0) * 4 + c] * (1.0f - tx) + src[(y0 * width + x1) * 4 + c] * tx;
+                    const float b = src[(y1 * width + x0) * 4 + c] * (1.0f - tx) + src[(y1 * width + x1) * 4 + c] * tx;
+                    dst[(static_cast<size_t>(y) * size + x) * 4 + c] = static_cast<unsigned char>(a * (1.0f - ty) + b * ty + 0.5f);
+                }
+            }
+        }
+        return dst;
+    }
+}
+
+TextureArrayPool::~TextureArrayPool() {
+    destroy();
+}
+
+void TextureArrayPool::destroy() {
+    for (Page& page : pages) {
+        if (page.texture) {
+            glDeleteTextures(1, &page.texture);
+        }
+        page = Page{};
+    }
+    byPath.clear();
+    if (linearSampler) {
+        glDeleteSamplers(1, &linearSampler);
+        glDeleteSamplers(1, &nearestSampler);
+        linearSampler = nearestSampler = 0;
+    }
+}
+
+bool TextureArrayPool::acquire(StringId path, TextureSlot& slot) {
+    if (path == kEmptyString) {
+        return false;
+    }
+    const auto existing = byPath.find(path);
+    if (existing != byPath.end()) {
+        slot = existing->second;
+        ++pages[slot.page].refs[static_cast<size_t>(slot.layer)];
+        return true;
+    }
+    TRACE_ZONE("TextureArrayPool::load");
+
+    int width = 0, height = 0, channels = 0;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load(strings::text(path).c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!data) {
+        return false;
+    }
+
+    // smallest size class that holds the larger side without downscaling, capped at kMaxSize
+    int page = 0;
+    while (page < kPageCount - 1 && pageSize(page) < std::max(width, height)) {
+        ++page;
+    }
+    const int size = pageSize(page);
+    const int layer = allocateLayer(page);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pages[page].texture);
+    if (width == size && height == size) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+    else {
+        const std::vector<unsigned char> resized = resampleSquare(data, width, height, size);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, resized.data());
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    stbi_image_free(data);
+
+    pages[page].refs[static_cast<size_t>(layer)] = 1;
+    pages[page].paths[static_cast<size_t>(layer)] = path;
+    slot.page = page;
+    slot.layer = layer;
+    byPath[path] = slot;
+    return true;
+}
+
+void TextureArrayPool::release(TextureSlot& slot) {
+    if (!slot.valid()) {
+        return;
+    }
+    Page& page = pages[slot.page];
+    int& refs = page.refs[static_cast<size_t>(slot.layer)];
+    if (refs > 0 && --refs == 0) {
+        // the layer's contents stay until it is reused
+        byPath.erase(page.paths[static_cast<size_t>(slot.layer)]);
+        page.paths[static_cast<size_t>(slot.layer)] = kEmptyString;
+    }
+    slot = TextureSlot{};
+}
+
+void TextureArrayPool::addRef(const TextureSlot& slot) {
+    if (slot.valid()) {
+        ++pages[slot.page].refs[static_cast<size_t>(slot.layer)];
+    }
+}
+
+StringId TextureArrayPool::pathOf(const TextureSlot& slot) const {
+    if (!slot.valid() || slot.layer >= pages[slot.page].capacity) {
+        return kEmptyString;
+    }
+    return pages[slot.page].paths[static_cast<size_t>(slot.layer)];
+}
+
+int TextureArrayPool::allocateLayer(int pageIndex) {
+    Page& page = pages[pageIndex];
+    for (int i = 0; i < page.capacity; ++i) {
+        if (page.refs[static_cast<size_t>(i)] == 0) {
+            return i;
+        }
+    }
+
+    // full: allocate twice the layers and copy the old ones over on the GPU
+    const int size = pageSize(pageIndex);
+    const int capacity = page.capacity == 0 ? 4 : page.capacity * 2;
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    if (page.texture) {
+        GLint previousRead = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+        GLuint copyFbo = 0;
+        glGenFramebuffers(1, &copyFbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFbo);
+        for (int layer = 0; layer < page.capacity; ++layer) {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, page.texture, 0, layer);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0, size, size);
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previousRead));
+        glDeleteFramebuffers(1, &copyFbo);
+        glDeleteTextures(1, &page.texture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    const int firstNew = page.capacity;
+    page.texture = texture;
+    page.capacity = capacity;
+    page.refs.resize(static_cast<size_t>(capacity), 0);
+    page.paths.resize(static_cast<size_t>(capacity), kEmptyString);
+    return firstNew;
+}
+
+void TextureArrayPool::bind(GLuint linearUnit, GLuint nearestUnit) {
+    if (!linearSampler) {
+        // wrap modes are applied in the shader, so both samplers repeat
+        glGenSamplers(1, &linearSampler);
+        glGenSamplers(1, &nearestSampler);
+        glSamplerParameteri(linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glSamplerParameteri(linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(nearestSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glSamplerParameteri(nearestSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        for (GLuint sampler : { linearSampler, nearestSampler }) {
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+    }
+
+    for (int i = 0; i < kPageCount; ++i) {
+        glActiveTexture(GL_TEXTURE0 + linearUnit + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, pages[i].texture);
+        glBindSampler(linearUnit + i, linearSampler);
+        glActiveTexture(GL_TEXTURE0 + nearestUnit + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, pages[i].texture);
+        glBindSampler(nearestUnit + i, nearestSampler);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+int TextureArrayPool::pageCount() const {
+    int count = 0;
+    for (const Page& page : pages) {
+        count += page.texture ? 1 : 0;
+    }
+    return count;
+}
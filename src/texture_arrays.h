@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "string_table.h"
+
+struct TextureSlot {
+    int page = -1;
+    int layer = -1;
+    bool valid() const { return page >= 0 && layer >= 0; }
+};
+
+// All instance textures live in one GL_TEXTURE_2D_ARRAY per power-of-two size class, so the
+// whole set is bound once per frame and instances only carry a page/layer pair.
+// Images are resampled to the size class; the same file path (by interned id) shares one layer.
+class TextureArrayPool {
+public:
+    static constexpr int kMinSize = 128;
+    static constexpr int kMaxSize = 2048;
+    static constexpr int kPageCount = 5; // 128, 256, 512, 1024, 2048
+
+    TextureArrayPool() = default;
+    ~TextureArrayPool();
+
+    TextureArrayPool(const TextureArrayPool&) = delete;
+    TextureArrayPool& operator=(const TextureArrayPool&) = delete;
+
+    // loads (or re-references) the image at path; false when it cannot be decoded
+    bool acquire(StringId path, TextureSlot& slot);
+    void release(TextureSlot& slot);
+    // another user of an already acquired slot, without the path lookup
+    void addRef(const TextureSlot& slot);
+    // file the slot was loaded from; empty for free layers
+    StringId pathOf(const TextureSlot& slot) const;
+    // binds page i to linearUnit + i and nearestUnit + i with the matching sampler objects
+    void bind(GLuint linearUnit, GLuint nearestUnit);
+    void destroy();
+
+    int pageCount() const;
+    int layerCount() const { return static_cast<int>(byPath.size()); }
+
+private:
+    struct Page {
+        GLuint texture = 0;
+        int capacity = 0;
+        std::vector<int> refs; // per layer, 0 = free
+        std::vector<StringId> paths;
+    };
+
+    static int pageSize(int page) { return kMinSize << page; }
+    int allocateLayer(int page);
+
+    Page pages[kPageCount];
+    std::unordered_map<StringId, TextureSlot> byPath;
+    GLuint linearSampler = 0;
+    GLuint nearestSampler = 0;
+};
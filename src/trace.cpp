@@ -0,0 +1,158 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+    std::atomic<bool> gEnabled{ false };
+
+    namespace {
+        struct Event {
+            const char* name;
+            uint64_t startNs;
+            uint64_t endNs;
+        };
+
+        // ~1.5 MB per thread, several seconds of heavy instrumentation at 60 fps
+        constexpr size_t kRingEvents = 1 << 16;
+
+        // written by its own thread; the mutex is only ever contended while dumping
+        struct ThreadBuffer {
+            std::mutex mutex;
+            std::vector<Event> events;
+            size_t head = 0;
+            unsigned id = 0;
+            std::string name;
+        };
+
+        std::mutex registryMutex;
+
+        std::vector<std::shared_ptr<ThreadBuffer>>& registry() {
+            // buffers outlive their threads so a dump still sees finished workers
+            static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            return buffers;
+        }
+
+        ThreadBuffer& localBuffer() {
+            thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+                auto created = std::make_shared<ThreadBuffer>();
+                created->events.reserve(kRingEvents);
+                std::lock_guard<std::mutex> lock(registryMutex);
+                created->id = static_cast<unsigned>(registry().size()) + 1;
+                created->name = "Thread " + std::to_string(created->id);
+                registry().push_back(created);
+                return created;
+            }();
+            return *buffer;
+        }
+
+        void writeEscaped(std::ostream& out, const std::string& text) {
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out << '\\' << c;
+                }
+                else if (static_cast<unsigned char>(c) >= 0x20) {
+                    out << c;
+                }
+            }
+        }
+    }
+
+    void setEnabled(bool enabled) {
+        nowNs(); // pin the epoch before the first zone
+        gEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    uint64_t nowNs() {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs) {
+        ThreadBuffer& buffer = localBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.size() < kRingEvents) {
+            buffer.events.push_back({ name, startNs, endNs });
+        }
+        else {
+            buffer.events[buffer.head] = { name, startNs, endNs };
+        }
+        buffer.head = (buffer.head + 1) % kRingEvents;
+    }
+
+    void setThreadName(const char* name) {
+        ThreadBuffer& buffer = localBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.name = name;
+    }
+
+    bool dumpChromeTrace(const std::string& path, double seconds) {
+        const uint64_t now = nowNs();
+        const uint64_t window = static_cast<uint64_t>(std::max(0.0, seconds) * 1.0e9);
+        const uint64_t cutoff = now > window ? now - window : 0;
+
+        struct ThreadEvents {
+            unsigned id;
+            std::string name;
+            std::vector<Event> events;
+        };
+        std::vector<ThreadEvents> threads;
+        {
+            std::lock_guard<std::mutex> registryLock(registryMutex);
+            for (const auto& buffer : registry()) {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                ThreadEvents copy{ buffer->id, buffer->name, {} };
+                for (const Event& event : buffer->events) {
+                    if (event.endNs >= cutoff) {
+                        copy.events.push_back(event);
+                    }
+                }
+                threads.push_back(std::move(copy));
+            }
+        }
+
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        size_t eventCount = 0;
+        for (ThreadEvents& thread : threads) {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.id
+                << ",\"name\":\"thread_name\",\"args\":{\"name\":\"";
+            writeEscaped(out, thread.name);
+            out << "\"}}";
+            first = false;
+
+            // parents start first; on ties the longer (outer) zone must come first
+            std::sort(thread.events.begin(), thread.events.end(), [](const Event& a, const Event& b) {
+                return a.startNs != b.startNs ? a.startNs < b.startNs : a.endNs > b.endNs;
+            });
+            for (const Event& event : thread.events) {
+                out << ",\n{\"ph\":\"X\",\"cat\":\"cpu\",\"pid\":1,\"tid\":" << thread.id << ",\"name\":\"";
+                writeEscaped(out, event.name);
+                out << "\",\"ts\":" << static_cast<double>(event.startNs) / 1000.0
+                    << ",\"dur\":" << static_cast<double>(event.endNs - event.startNs) / 1000.0 << "}";
+            }
+            eventCount += thread.events.size();
+        }
+        out << "\n]}\n";
+        if (!out) {
+            std::cerr << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+        std::cout << "Wrote " << eventCount << " trace events to " << path << std::endl;
+        return true;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// CPU instrumentation: scoped zones recorded into per-thread ring buffers and exported as
+// Chrome trace_event JSON (opens in Perfetto or chrome://tracing). While recording is off a
+// zone costs one relaxed atomic load.
+namespace trace {
+
+    extern std::atomic<bool> gEnabled;
+
+    inline bool isEnabled() { return gEnabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // nanoseconds on the steady clock since the first call
+    uint64_t nowNs();
+    // name must be a string literal or otherwise outlive the trace
+    void record(const char* name, uint64_t startNs, uint64_t endNs);
+    // shows up as the thread's label in the viewer
+    void setThreadName(const char* name);
+
+    // writes every zone that ended within the last `seconds`; false if the file can't be written
+    bool dumpChromeTrace(const std::string& path, double seconds);
+
+    class Zone {
+    public:
+        explicit Zone(const char* zoneName) : name(isEnabled() ? zoneName : nullptr) {
+            if (name) {
+                start = nowNs();
+            }
+        }
+        ~Zone() {
+            if (name) {
+                record(name, start, nowNs());
+            }
+        }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char* name;
+        uint64_t start = 0;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
@@ -1,24 +1,40 @@
 #define IMGUI_IMPL_OPENGL_LOADER_GLAD
 #include "ui_layer.h"
 
+#include "dynamic_resolution.h"
+#include "frame_pacer.h"
+#include "gpu_profiler.h"
+#include "redraw_scheduler.h"
+#include "scene_journal.h"
+#include "undo_history.h"
+#include "scene_json.h"
+#include "trace.h"
+
 #include <cstdio>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <filesystem>
+#include <iostream>
+#include <random>
 #include <string>
 
+#ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
 #include <commdlg.h>
+#endif
 
 #include"Auth.h"
 
 namespace {
-    std::string OpenTextureFileDialog() {
+    std::string OpenFileDialog(const char* filter) {
+#ifdef _WIN32
         char fileBuffer[MAX_PATH] = { 0 };
         OPENFILENAMEA ofn{};
         ofn.lStructSize = sizeof(ofn);
         ofn.hwndOwner = nullptr;
-        ofn.lpstrFilter = "Image Files\0*.png;*.jpg;*.jpeg;*.bmp;*.tga;*.hdr\0All Files\0*.*\0";
+        ofn.lpstrFilter = filter;
         ofn.nFilterIndex = 1;
         ofn.lpstrFile = fileBuffer;
         ofn.nMaxFile = MAX_PATH;
@@ -30,6 +46,48 @@ namespace {
             return std::string(fileBuffer);
         }
         return {};
+#else
+        (void)filter;
+        std::cerr << "File dialogs are only available on Windows" << std::endl;
+        return {};
+#endif
+    }
+
+    std::string OpenTextureFileDialog() {
+        return OpenFileDialog("Image Files\0*.png;*.jpg;*.jpeg;*.bmp;*.tga;*.hdr\0All Files\0*.*\0");
+    }
+
+    std::string OpenMeshFileDialog() {
+        return OpenFileDialog("Mesh Files\0*.obj;*.glb\0All Files\0*.*\0");
+    }
+
+    const char* const kSceneFilter = "Scene Files\0*.cgscene;*.json\0All Files\0*.*\0";
+
+    // .json goes through the streaming interchange format, anything else is the binary .cgscene
+    bool isJsonScene(const std::string& path) {
+        return std::filesystem::path(path).extension() == ".json";
+    }
+
+    std::string SaveSceneFileDialog() {
+#ifdef _WIN32
+        char fileBuffer[MAX_PATH] = "scene.cgscene";
+        OPENFILENAMEA ofn{};
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = nullptr;
+        ofn.lpstrFilter = kSceneFilter;
+        ofn.nFilterIndex = 1;
+        ofn.lpstrFile = fileBuffer;
+        ofn.nMaxFile = MAX_PATH;
+        ofn.lpstrDefExt = "cgscene";
+        ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST | OFN_EXPLORER;
+        if (GetSaveFileNameA(&ofn) == TRUE) {
+            return std::string(fileBuffer);
+        }
+        return {};
+#else
+        std::cerr << "File dialogs are only available on Windows" << std::endl;
+        return {};
+#endif
     }
 }
 
@@ -66,6 +124,7 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
     if (!initialized) {
         return;
     }
+    TRACE_ZONE("UiLayer::draw");
 
     ImGuiIO& io = ImGui::GetIO();
 
@@ -84,25 +143,30 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
         ImGui::RadioButton("Scale", reinterpret_cast<int*>(&mode), static_cast<int>(TransformMode::Scale));
 
         const auto& instances = scene.getInstances();
-        const int selected = scene.getSelectedIndex();
         if (instances.empty()) {
             ImGui::TextDisabled("No primitives");
         }
         else {
-            for (size_t i = 0; i < instances.size(); ++i) {
-                char label[64];
-                snprintf(label, sizeof(label), "%zu: %s", i, typeLabel(instances[i].type));
-                if (ImGui::Selectable(label, static_cast<int>(i) == selected)) {
-                    scene.select(static_cast<int>(i));
-                }
-            }
+            drawHierarchy(scene);
         }
 
         ImGui::Separator();
-        ImGui::TextDisabled("R/F/T/G/Y/H Transform Axis\nDouble-click left button to select/deselect, drag to pan\nMouse wheel adjusts depth");
+        ImGui::TextDisabled("R/F/T/G/Y/H Transform Axis\nDouble-click left button to select/deselect, drag to pan\n"
+            "Shift+click adds, Ctrl+click toggles; in Select mode drag a box\n(rightwards: enclosed, leftwards: touching)\n"
+            "Mouse wheel adjusts depth");
     }
     ImGui::End();
 
+    if (marqueeActive) {
+        ImDrawList* drawList = ImGui::GetForegroundDrawList();
+        const ImVec2 p0(std::min(marqueeStart.x, marqueeEnd.x), std::min(marqueeStart.y, marqueeEnd.y));
+        const ImVec2 p1(std::max(marqueeStart.x, marqueeEnd.x), std::max(marqueeStart.y, marqueeEnd.y));
+        // solid while selecting enclosed instances, faint fill for touching ones
+        const bool enclosed = marqueeEnd.x >= marqueeStart.x;
+        drawList->AddRectFilled(p0, p1, enclosed ? IM_COL32(90, 150, 255, 40) : IM_COL32(90, 255, 150, 30));
+        drawList->AddRect(p0, p1, enclosed ? IM_COL32(90, 150, 255, 220) : IM_COL32(90, 255, 150, 220));
+    }
+
     // speed hint at top center
     ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, 8.0f), ImGuiCond_Always, ImVec2(0.5f, 0.0f));
     ImGui::SetNextWindowBgAlpha(0.2f);
@@ -114,11 +178,11 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
 
     // inspector panel (right)
     const bool hasSelection = scene.getSelectedIndex() >= 0;
-    const float target = hasSelection ? 1.0f : 0.0f;
+    inspectorTarget = hasSelection ? 1.0f : 0.0f;
     const float dt = io.DeltaTime;
     const float speed = 6.0f;
     const float alpha = std::clamp(dt * speed, 0.0f, 1.0f);
-    inspectorProgress = inspectorProgress + (target - inspectorProgress) * alpha;
+    inspectorProgress = inspectorProgress + (inspectorTarget - inspectorProgress) * alpha;
 
     const float sidebarWidth = 340.0f;
     if (inspectorProgress > 0.01f) {
@@ -132,21 +196,44 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
             const PrimitiveInstance* inst = scene.getSelected();
             if (inst) {
                 ImGui::Text("Entity Properties");
+                const size_t selectionSize = scene.getSelection().size();
+                if (selectionSize > 1) {
+                    ImGui::SameLine();
+                    ImGui::TextColored(ImVec4(0.6f, 0.8f, 1.0f, 1.0f), "(%zu selected, edits apply to all)", selectionSize);
+                }
                 ImGui::Separator();
                 ImGui::Text("Type: %s", typeLabel(inst->type));
+                if (inst->type == PrimitiveType::Mesh && inst->meshId >= 0 &&
+                    inst->meshId < static_cast<int>(scene.getImportedMeshes().size())) {
+                    const ImportedMeshInfo& meshInfo = scene.getImportedMeshes()[static_cast<size_t>(inst->meshId)];
+                    ImGui::TextDisabled("%s (%u tris, %s %.1f ms)", strings::text(meshInfo.name).c_str(), meshInfo.indexCount / 3,
+                        meshInfo.fromCache ? "cache" : "parsed", meshInfo.loadMs);
+                }
 
                 PrimitiveInstance* editable = scene.getSelectedMutable();
                 if (editable) {
+                    const PrimitiveInstance before = *editable;
+                    bool edited = false; // direct field edits, reported to the scene below
+                    if (editable->parent >= 0) {
+                        ImGui::TextDisabled("Child of %d: %s, transform is relative to it", editable->parent,
+                            typeLabel(scene.getInstances()[static_cast<size_t>(editable->parent)].type));
+                        ImGui::SameLine();
+                        if (ImGui::SmallButton("Unparent")) {
+                            scene.setParent(scene.getSelectedIndex(), -1);
+                        }
+                    }
                     // Position
                     ImGui::Separator();
                     ImGui::Text("Position (X Y Z)");
                     ImGui::SameLine();
                     if (ImGui::Button("Reset##pos")) {
                         editable->position = glm::vec3(0.0f);
+                        edited = true;
                     }
                     float pos[3] = { editable->position.x, editable->position.y, editable->position.z };
                     if (ImGui::InputFloat3("##pos", pos, "%.3f")) {
                         editable->position = glm::vec3(pos[0], pos[1], pos[2]);
+                        edited = true;
                     }
 
                     // Rotation
@@ -155,10 +242,12 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
                     ImGui::SameLine();
                     if (ImGui::Button("Reset##rot")) {
                         editable->rotation = glm::vec3(0.0f);
+                        edited = true;
                     }
                     float rot[3] = { editable->rotation.x, editable->rotation.y, editable->rotation.z };
                     if (ImGui::InputFloat3("##rot", rot, "%.2f")) {
                         editable->rotation = glm::vec3(rot[0], rot[1], rot[2]);
+                        edited = true;
                     }
 
                     // Scale
@@ -168,6 +257,7 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
                     if (ImGui::Button("Reset##scl")) {
                         editable->scale = glm::vec3(1.0f);
                         if (editable->type == PrimitiveType::Plane) { editable->scale.y = 1.0f; }
+                        edited = true;
                     }
                     float scl[3] = { editable->scale.x, editable->scale.y, editable->scale.z };
                     if (ImGui::InputFloat3("##scl", scl, "%.3f")) {
@@ -177,90 +267,95 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
                         }
                         newScale = glm::max(newScale, glm::vec3(0.1f));
                         editable->scale = newScale;
+                        edited = true;
                     }
 
                     // Color
                     ImGui::Separator();
                     ImGui::Text("Color");
                     ImGui::SameLine();
+                    Material material = scene.getMaterial(editable->materialId);
                     if (ImGui::Button("Reset##color")) {
                         editable->color = scene.getDefaultColor(editable->type);
-                        editable->matDiffuse = editable->color;
-                        editable->matAmbient = editable->color * 0.2f;
+                        material.diffuse = editable->color;
+                        material.ambient = editable->color * 0.2f;
+                        scene.setSelectionMaterial(material);
+                        edited = true;
                     }
                     if (ImGui::ColorEdit3("##color", reinterpret_cast<float*>(&editable->color))) {
-                        editable->matDiffuse = editable->color;
+                        material.diffuse = editable->color;
+                        scene.setSelectionMaterial(material);
+                        edited = true;
                     }
 
                     ImGui::Separator();
                     ImGui::Text("Material");
                     ImGui::SameLine();
+                    // presets intern into the table, so every instance with the same preset shares one entry
                     if (ImGui::Button("Reset##mat")) {
-                        glm::vec3 amb, diff, spec;
-                        float shin = 32.0f;
-                        float ambStr = 1.0f, diffStr = 1.0f, specStr = 1.0f;
-                        scene.getDefaultMaterial(amb, diff, spec, shin, ambStr, diffStr, specStr);
-                        diff = editable->color;
-                        amb = diff * 0.2f;
-                        editable->matAmbient = amb;
-                        editable->matDiffuse = diff;
-                        editable->matSpecular = spec;
-                        editable->matShininess = shin;
-                        editable->matAmbientStrength = ambStr;
-                        editable->matDiffuseStrength = diffStr;
-                        editable->matSpecularStrength = specStr;
+                        scene.setSelectionMaterial(scene.defaultMaterialFor(editable->color));
                     }
                     ImGui::SameLine();
                     if (ImGui::Button("Metal")) {
-                        editable->matAmbient = editable->color * 0.1f;
-                        editable->matDiffuse = editable->color * 0.6f;
-                        editable->matSpecular = glm::vec3(0.95f);
-                        editable->matAmbientStrength = 0.6f;
-                        editable->matDiffuseStrength = 0.9f;
-                        editable->matSpecularStrength = 1.5f;
-                        editable->matShininess = 96.0f;
+                        Material metal;
+                        metal.ambient = editable->color * 0.1f;
+                        metal.diffuse = editable->color * 0.6f;
+                        metal.specular = glm::vec3(0.95f);
+                        metal.ambientStrength = 0.6f;
+                        metal.diffuseStrength = 0.9f;
+                        metal.specularStrength = 1.5f;
+                        metal.shininess = 96.0f;
+                        scene.setSelectionMaterial(metal);
                     }
                     ImGui::SameLine();
                     if (ImGui::Button("Plastic")) {
-                        editable->matAmbient = editable->color * 0.2f;
-                        editable->matDiffuse = editable->color;
-                        editable->matSpecular = glm::vec3(0.5f);
-                        editable->matAmbientStrength = 0.8f;
-                        editable->matDiffuseStrength = 1.0f;
-                        editable->matSpecularStrength = 0.9f;
-                        editable->matShininess = 48.0f;
+                        Material plastic;
+                        plastic.ambient = editable->color * 0.2f;
+                        plastic.diffuse = editable->color;
+                        plastic.specular = glm::vec3(0.5f);
+                        plastic.ambientStrength = 0.8f;
+                        plastic.diffuseStrength = 1.0f;
+                        plastic.specularStrength = 0.9f;
+                        plastic.shininess = 48.0f;
+                        scene.setSelectionMaterial(plastic);
                     }
                     if (ImGui::Button("Rubber")) {
-                        editable->matAmbient = editable->color * 0.4f;
-                        editable->matDiffuse = editable->color * 0.6f;
-                        editable->matSpecular = glm::vec3(0.1f);
-                        editable->matAmbientStrength = 1.2f;
-                        editable->matDiffuseStrength = 0.8f;
-                        editable->matSpecularStrength = 0.2f;
-                        editable->matShininess = 8.0f;
+                        Material rubber;
+                        rubber.ambient = editable->color * 0.4f;
+                        rubber.diffuse = editable->color * 0.6f;
+                        rubber.specular = glm::vec3(0.1f);
+                        rubber.ambientStrength = 1.2f;
+                        rubber.diffuseStrength = 0.8f;
+                        rubber.specularStrength = 0.2f;
+                        rubber.shininess = 8.0f;
+                        scene.setSelectionMaterial(rubber);
                     }
                     if (ImGui::Button("Default")) {
-                        glm::vec3 amb, diff, spec;
-                        float shin = 32.0f;
-                        float ambStr = 1.0f, diffStr = 1.0f, specStr = 1.0f;
-                        scene.getDefaultMaterial(amb, diff, spec, shin, ambStr, diffStr, specStr);
-                        diff = editable->color;
-                        amb = diff * 0.2f;
-                        editable->matAmbient = amb;
-                        editable->matDiffuse = diff;
-                        editable->matSpecular = spec;
-                        editable->matShininess = shin;
-                        editable->matAmbientStrength = ambStr;
-                        editable->matDiffuseStrength = diffStr;
-                        editable->matSpecularStrength = specStr;
-                    }
-                    ImGui::ColorEdit3("Ambient", reinterpret_cast<float*>(&editable->matAmbient));
-                    ImGui::SliderFloat("Ambient Strength", &editable->matAmbientStrength, 0.0f, 2.0f, "%.2f");
-                    ImGui::ColorEdit3("Diffuse", reinterpret_cast<float*>(&editable->matDiffuse));
-                    ImGui::SliderFloat("Diffuse Strength", &editable->matDiffuseStrength, 0.0f, 2.0f, "%.2f");
-                    ImGui::ColorEdit3("Specular", reinterpret_cast<float*>(&editable->matSpecular));
-                    ImGui::SliderFloat("Specular Strength", &editable->matSpecularStrength, 0.0f, 2.0f, "%.2f");
-                    ImGui::SliderFloat("Shininess", &editable->matShininess, 1.0f, 256.0f, "%.0f");
+                        scene.setSelectionMaterial(scene.defaultMaterialFor(editable->color));
+                    }
+
+                    const int users = scene.getMaterials().users(editable->materialId);
+                    ImGui::TextDisabled("Material #%d, used by %d instance%s", editable->materialId, users, users == 1 ? "" : "s");
+                    if (users > 1) {
+                        ImGui::Checkbox("Edit shared material", &editSharedMaterial);
+                    }
+                    material = scene.getMaterial(editable->materialId);
+                    bool materialChanged = false;
+                    materialChanged |= ImGui::ColorEdit3("Ambient", reinterpret_cast<float*>(&material.ambient));
+                    materialChanged |= ImGui::SliderFloat("Ambient Strength", &material.ambientStrength, 0.0f, 2.0f, "%.2f");
+                    materialChanged |= ImGui::ColorEdit3("Diffuse", reinterpret_cast<float*>(&material.diffuse));
+                    materialChanged |= ImGui::SliderFloat("Diffuse Strength", &material.diffuseStrength, 0.0f, 2.0f, "%.2f");
+                    materialChanged |= ImGui::ColorEdit3("Specular", reinterpret_cast<float*>(&material.specular));
+                    materialChanged |= ImGui::SliderFloat("Specular Strength", &material.specularStrength, 0.0f, 2.0f, "%.2f");
+                    materialChanged |= ImGui::SliderFloat("Shininess", &material.shininess, 1.0f, 256.0f, "%.0f");
+                    if (materialChanged) {
+                        if (users > 1 && editSharedMaterial) {
+                            scene.editMaterial(editable->materialId, material);
+                        }
+                        else {
+                            scene.setSelectionMaterial(material);
+                        }
+                    }
 
                     ImGui::Separator();
                     ImGui::Text("Texture");
@@ -278,7 +373,7 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
                         scene.removeTextureFromSelected();
                     }
                     if (editable->hasTexture) {
-                        ImGui::TextColored(ImVec4(0.7f, 0.9f, 0.7f, 1.0f), "%s loaded", editable->textureName.c_str());
+                        ImGui::TextColored(ImVec4(0.7f, 0.9f, 0.7f, 1.0f), "%s loaded", strings::text(editable->textureName).c_str());
                     }
                     else {
                         ImGui::TextDisabled("No texture");
@@ -288,20 +383,21 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
                     const char* wrapItems[] = { "Repeat", "Clamp to Edge", "Mirrored Repeat" };
                     if (ImGui::Combo("Wrap Mode", &wrapIdx, wrapItems, IM_ARRAYSIZE(wrapItems))) {
                         editable->wrapMode = static_cast<TextureWrapMode>(wrapIdx);
-                        scene.applyTextureSettings(*editable);
+                        edited = true;
                     }
 
                     int filterIdx = static_cast<int>(editable->filterMode);
                     const char* filterItems[] = { "Nearest", "Linear" };
                     if (ImGui::Combo("Filter Mode", &filterIdx, filterItems, IM_ARRAYSIZE(filterItems))) {
                         editable->filterMode = static_cast<TextureFilterMode>(filterIdx);
-                        scene.applyTextureSettings(*editable);
+                        edited = true;
                     }
 
                     int projIdx = static_cast<int>(editable->projection);
                     const char* projItems[] = { "Planar", "Triplanar", "Spherical", "Cylindrical", "Cube" };
                     if (ImGui::Combo("Projection", &projIdx, projItems, IM_ARRAYSIZE(projItems))) {
                         editable->projection = static_cast<TextureProjection>(projIdx);
+                        edited = true;
                     }
 
                     if (editable->projection == TextureProjection::Planar) {
@@ -309,14 +405,25 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
                         const char* axisItems[] = { "Normal X", "Normal Y", "Normal Z" };
                         if (ImGui::Combo("Planar Axis", &axisIdx, axisItems, IM_ARRAYSIZE(axisItems))) {
                             editable->planarAxis = static_cast<PlanarAxis>(axisIdx);
+                            edited = true;
                         }
                     }
 
-                    ImGui::InputFloat2("UV Scale", reinterpret_cast<float*>(&editable->uvScale), "%.3f");
-                    ImGui::SliderFloat2("UV Scale Slider", reinterpret_cast<float*>(&editable->uvScale), 0.1f, 8.0f, "%.2f");
+                    edited |= ImGui::InputFloat2("UV Scale", reinterpret_cast<float*>(&editable->uvScale), "%.3f");
+                    edited |= ImGui::SliderFloat2("UV Scale Slider", reinterpret_cast<float*>(&editable->uvScale), 0.1f, 8.0f, "%.2f");
 
                     ImGui::Separator();
-                    if (ImGui::Button("Delete Entity")) {
+                    bool isStatic = editable->isStatic;
+                    if (ImGui::Checkbox("Static (bake while frozen)", &isStatic)) {
+                        scene.setSelectionStatic(isStatic);
+                    }
+                    edited |= ImGui::Checkbox("Cast Shadows", &editable->castsShadow);
+                    if (edited) {
+                        scene.noteSelectionEdited(before);
+                    }
+
+                    ImGui::Separator();
+                    if (ImGui::Button(selectionSize > 1 ? "Delete Selection" : "Delete Entity")) {
                         scene.removeSelected();
                     }
 
@@ -334,6 +441,8 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
     ImGui::SetNextWindowBgAlpha(0.9f);
     if (ImGui::Begin("Light", nullptr, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoCollapse)) {
         LightSettings& light = scene.getLightSettings();
+        const LightSettings lightBefore = light;
+        bool lightEdited = false;
 
         ImGui::Text("Light Controls");
         ImGui::Separator();
@@ -342,32 +451,219 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
         ImGui::SameLine();
         if (ImGui::Button("Reset##lightpos")) {
             light.position = glm::vec3(-2.0f, 4.0f, 2.0f);
+            lightEdited = true;
         }
         float lpos[3] = { light.position.x, light.position.y, light.position.z };
         if (ImGui::InputFloat3("##lightpos", lpos, "%.3f")) {
             light.position = glm::vec3(lpos[0], lpos[1], lpos[2]);
+            lightEdited = true;
         }
 
         ImGui::Text("Color");
         ImGui::SameLine();
         if (ImGui::Button("Reset##lightcol")) {
             light.color = glm::vec3(1.0f);
+            lightEdited = true;
         }
-        ImGui::ColorEdit3("##lightcolor", reinterpret_cast<float*>(&light.color));
+        lightEdited |= ImGui::ColorEdit3("##lightcolor", reinterpret_cast<float*>(&light.color));
 
         ImGui::Separator();
         ImGui::Text("Intensities");
         const float minI = 0.0f, maxI = 2.0f;
-        ImGui::SliderFloat("Ambient", &light.ambient, minI, maxI, "%.2f");
-        ImGui::SliderFloat("Diffuse", &light.diffuse, minI, maxI, "%.2f");
-        ImGui::SliderFloat("Specular", &light.specular, minI, maxI, "%.2f");
-        ImGui::SliderFloat("Shininess", &light.shininess, 1.0f, 128.0f, "%.0f");
+        lightEdited |= ImGui::SliderFloat("Ambient", &light.ambient, minI, maxI, "%.2f");
+        lightEdited |= ImGui::SliderFloat("Diffuse", &light.diffuse, minI, maxI, "%.2f");
+        lightEdited |= ImGui::SliderFloat("Specular", &light.specular, minI, maxI, "%.2f");
+        lightEdited |= ImGui::SliderFloat("Shininess", &light.shininess, 1.0f, 128.0f, "%.0f");
         if (ImGui::Button("Reset##light")) {
             light.ambient = 0.15f;
             light.diffuse = 0.75f;
             light.specular = 0.25f;
             light.shininess = 32.0f;
+            lightEdited = true;
+        }
+        if (lightEdited) {
+            scene.noteLightEdited(lightBefore);
         }
+
+        auto& pointLights = scene.getPointLights();
+        char header[64];
+        snprintf(header, sizeof(header), "Point Lights (%zu)###pointlights", pointLights.size());
+        if (ImGui::CollapsingHeader(header)) {
+            if (ImGui::Button("Add Light")) {
+                PointLight pointLight;
+                pointLight.position = camera.GetPosition() + camera.GetFront() * 4.0f;
+                scene.selectLight(scene.addPointLight(pointLight));
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear Lights")) {
+                scene.clearPointLights();
+            }
+
+            const int selectedLight = scene.getSelectedLight();
+            if (ImGui::BeginListBox("##pointlightlist", ImVec2(-FLT_MIN, 5.0f * ImGui::GetTextLineHeightWithSpacing()))) {
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(pointLights.size()));
+                while (clipper.Step()) {
+                    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                        char label[48];
+                        snprintf(label, sizeof(label), "Light %d", i);
+                        if (ImGui::Selectable(label, i == selectedLight)) {
+                            scene.clearSelection();
+                            scene.selectLight(i);
+                        }
+                    }
+                }
+                ImGui::EndListBox();
+            }
+
+            if (selectedLight >= 0 && selectedLight < static_cast<int>(pointLights.size())) {
+                PointLight& pointLight = pointLights[static_cast<size_t>(selectedLight)];
+                const PointLight pointLightBefore = pointLight;
+                bool pointLightEdited = false;
+                pointLightEdited |= ImGui::InputFloat3("Position##pl", reinterpret_cast<float*>(&pointLight.position), "%.3f");
+                pointLightEdited |= ImGui::ColorEdit3("Color##pl", reinterpret_cast<float*>(&pointLight.color));
+                pointLightEdited |= ImGui::SliderFloat("Intensity##pl", &pointLight.intensity, 0.0f, 4.0f, "%.2f");
+                pointLightEdited |= ImGui::SliderFloat("Radius##pl", &pointLight.radius, 0.5f, 20.0f, "%.1f");
+                if (pointLightEdited) {
+                    scene.notePointLightEdited(selectedLight, pointLightBefore);
+                }
+                if (ImGui::Button("Remove Light")) {
+                    scene.removePointLight(selectedLight);
+                }
+            }
+
+            ImGui::Separator();
+            ImGui::Text("Benchmark Scene");
+            ImGui::InputInt("Lights##bench", &benchLightCount, 16, 128);
+            ImGui::InputInt("Primitives##bench", &benchPrimitiveCount, 16, 128);
+            benchLightCount = std::clamp(benchLightCount, 0, 4096);
+            benchPrimitiveCount = std::clamp(benchPrimitiveCount, 0, 100000);
+            if (ImGui::Button("Build Benchmark Scene")) {
+                buildLightBenchmark(scene, benchLightCount, benchPrimitiveCount);
+            }
+        }
+    }
+    ImGui::End();
+
+    drawProfilerPanel();
+    drawHistoryPanel(scene);
+    drawScatterPanel(scene);
+
+    // render settings (bottom-left, above the bottom bar)
+    ImGui::SetNextWindowPos(ImVec2(12.0f, io.DisplaySize.y - 64.0f - 12.0f), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (ImGui::Begin("Rendering", nullptr, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_AlwaysAutoResize)) {
+        RenderSettings& settings = scene.getRenderSettings();
+        const RenderStats& stats = scene.getStats();
+        ImGui::Checkbox("Depth Pre-pass", &settings.depthPrepass);
+        ImGui::BeginDisabled(settings.depthPrepass);
+        ImGui::Checkbox("Front-to-back Sort", &settings.frontToBack);
+        ImGui::EndDisabled();
+        ImGui::Checkbox("Show Overdraw", &settings.showOverdraw);
+        if (redrawScheduler) {
+            bool onDemand = redrawScheduler->isOnDemand();
+            if (ImGui::Checkbox("On-demand Rendering", &onDemand)) {
+                redrawScheduler->setOnDemand(onDemand);
+            }
+        }
+        ImGui::Checkbox("Shadows", &settings.shadows);
+        ImGui::BeginDisabled(!settings.shadows);
+        const char* filterLabels[] = { "Hard", "PCF 8 taps", "PCF 20 taps" };
+        int filter = static_cast<int>(settings.shadowFilter);
+        if (ImGui::Combo("Shadow Filter", &filter, filterLabels, IM_ARRAYSIZE(filterLabels))) {
+            settings.shadowFilter = static_cast<ShadowFilter>(filter);
+        }
+        const int sizes[] = { 512, 1024, 2048 };
+        const char* sizeLabels[] = { "512", "1024", "2048" };
+        int sizeIndex = settings.shadowMapSize <= 512 ? 0 : (settings.shadowMapSize <= 1024 ? 1 : 2);
+        if (ImGui::Combo("Shadow Map Size", &sizeIndex, sizeLabels, IM_ARRAYSIZE(sizeLabels))) {
+            settings.shadowMapSize = sizes[sizeIndex];
+        }
+        ImGui::SliderFloat("Shadow Bias", &settings.shadowBias, 0.0f, 0.3f, "%.3f");
+        ImGui::EndDisabled();
+        if (dynamicResolution) {
+            DynamicResolution::Settings& resolution = dynamicResolution->getSettings();
+            ImGui::Checkbox("Dynamic Resolution", &resolution.enabled);
+            if (resolution.enabled) {
+                ImGui::SliderFloat("GPU Budget", &resolution.targetMs, 4.0f, 33.0f, "%.1f ms");
+            }
+            else {
+                ImGui::SliderFloat("Render Scale", &resolution.fixedScale, DynamicResolution::kMinScale,
+                    DynamicResolution::kMaxScale, "%.2f");
+            }
+            const DynamicResolution::Stats& resolutionStats = dynamicResolution->getStats();
+            ImGui::TextDisabled("Viewport: %.0f%% (%dx%d)  GPU: %.2f ms", resolutionStats.scale * 100.0f,
+                resolutionStats.renderWidth, resolutionStats.renderHeight, resolutionStats.gpuMs);
+        }
+        if (framePacer && ImGui::CollapsingHeader("Frame Pacing")) {
+            FramePacer::Settings pacing = framePacer->getSettings();
+            bool changed = false;
+            const char* syncLabels[] = { "Off", "VSync", "Adaptive VSync" };
+            int sync = static_cast<int>(pacing.sync);
+            if (ImGui::Combo("Swap Interval", &sync, syncLabels, IM_ARRAYSIZE(syncLabels))) {
+                pacing.sync = static_cast<FramePacer::SyncMode>(sync);
+                changed = true;
+            }
+            if (!framePacer->adaptiveSupported()) {
+                ImGui::TextDisabled("Adaptive vsync unsupported, falls back to VSync");
+            }
+            changed |= ImGui::SliderInt("FPS Cap", &pacing.targetFps, 0, 240, pacing.targetFps == 0 ? "off" : "%d");
+            changed |= ImGui::Checkbox("Smooth Delta Time", &pacing.smoothDelta);
+            if (changed) {
+                framePacer->apply(pacing);
+            }
+
+            const FramePacer::Stats& pacingStats = framePacer->getStats();
+            ImGui::Text("Frame: %.2f ms  jitter: %.2f ms  p99: %.2f ms  max: %.2f ms", pacingStats.meanMs,
+                pacingStats.jitterMs, pacingStats.p99Ms, pacingStats.maxMs);
+            if (ImGui::BeginTable("pacing_modes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("Mode");
+                ImGui::TableSetupColumn("Mean");
+                ImGui::TableSetupColumn("Jitter");
+                ImGui::TableSetupColumn("p99");
+                ImGui::TableSetupColumn("Max");
+                ImGui::TableHeadersRow();
+                for (const auto& entry : framePacer->getModeHistory()) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(entry.first.c_str());
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", entry.second.meanMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", entry.second.jitterMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", entry.second.p99Ms);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", entry.second.maxMs);
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::Separator();
+        ImGui::Text("Draw calls: %d  state changes: %d", stats.drawCalls, stats.stateChanges);
+        if (redrawScheduler && redrawScheduler->isOnDemand()) {
+            const RedrawScheduler::Stats& redrawStats = redrawScheduler->getStats();
+            ImGui::Text("Frames: %d/s  skipped: %.0f%%  idle: %.0f%%", redrawStats.renderedFrames,
+                redrawStats.skippedFraction * 100.0f, redrawStats.idleFraction * 100.0f);
+            ImGui::TextDisabled("Idle total: %.1f s", redrawStats.idleSeconds);
+        }
+        ImGui::Text("Pre-pass: %.3f ms  Colour: %.3f ms", stats.prepassMs, stats.colorPassMs);
+        ImGui::TextDisabled("Avg pre-pass strategy: %.3f ms", stats.prepassStrategyMs);
+        ImGui::TextDisabled("Avg sorted strategy:   %.3f ms", stats.sortedStrategyMs);
+        ImGui::Text("Point lights: %d  refs: %d  assign: %.3f ms", stats.pointLights, stats.clusterLightRefs,
+            stats.clusterBuildMs);
+        ImGui::Text("Texture arrays: %d pages, %d layers", stats.texturePages, stats.textureLayers);
+        ImGui::Text("Materials: %d shared by %zu instances  upload: %d B", stats.materials, scene.instanceCount(),
+            stats.materialUploads);
+        ImGui::Text("Shadow: %.3f ms  faces this frame: %d  updates: %d", stats.shadowPassMs,
+            stats.shadowFacesRendered, stats.shadowMapUpdates);
+        ImGui::Text("World transforms updated: %d", stats.transformsUpdated);
+        const FrameArena& arena = scene.getFrameArena();
+        ImGui::Text("Heap allocations in draw: %d  frame arena: %.1f / %.1f KB", stats.heapAllocations,
+            static_cast<double>(arena.peak()) / 1024.0, static_cast<double>(arena.capacity()) / 1024.0);
+        const SpatialIndex::Stats spatial = scene.getSpatialIndex().getStats();
+        ImGui::Text("Octree: %zu nodes  moves in place: %zu  relocated: %zu", spatial.nodes, spatial.inPlaceMoves,
+            spatial.relocations);
     }
     ImGui::End();
 
@@ -405,6 +701,24 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
             if (ImGui::MenuItem("Cube")) {
                 scene.addPrimitive(PrimitiveType::Cube, spawnPos);
             }
+            ImGui::Separator();
+            const auto& imported = scene.getImportedMeshes();
+            for (size_t i = 0; i < imported.size(); ++i) {
+                char meshLabel[128];
+                snprintf(meshLabel, sizeof(meshLabel), "%s##mesh%zu", strings::text(imported[i].name).c_str(), i);
+                if (ImGui::MenuItem(meshLabel)) {
+                    scene.addMeshInstance(static_cast<int>(i), spawnPos);
+                }
+            }
+            if (ImGui::MenuItem("Import Mesh...")) {
+                const std::string path = OpenMeshFileDialog();
+                if (!path.empty()) {
+                    const int meshId = scene.importMesh(path);
+                    if (meshId >= 0) {
+                        scene.addMeshInstance(meshId, spawnPos);
+                    }
+                }
+            }
             ImGui::EndPopup();
         }
 
@@ -414,6 +728,43 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
             scene.clear();
         }
 
+        ImGui::SameLine();
+        if (ImGui::Button("Save Scene")) {
+            const std::string path = SaveSceneFileDialog();
+            if (!path.empty()) {
+                if (isJsonScene(path)) {
+                    exportSceneJson(scene, path);
+                }
+                else {
+                    scene.saveScene(path);
+                }
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load Scene")) {
+            const std::string path = OpenFileDialog(kSceneFilter);
+            if (!path.empty()) {
+                if (isJsonScene(path)) {
+                    importSceneJson(scene, path);
+                }
+                else {
+                    scene.loadScene(path);
+                }
+            }
+        }
+
+        ImGui::SameLine();
+        bool freeze = scene.isFreezeStatic();
+        if (ImGui::Checkbox("Freeze Static", &freeze)) {
+            scene.setFreezeStatic(freeze);
+        }
+        if (freeze) {
+            const RenderStats& stats = scene.getStats();
+            ImGui::SameLine();
+            ImGui::TextDisabled("%d batches, %d instances, %d draw calls saved", stats.staticBatches,
+                stats.batchedInstances, stats.drawCallsSaved);
+        }
+
         ImGui::SameLine();
         ImGui::TextDisabled("Use the bottom bar buttons to generate or clear primitives");
 
@@ -423,6 +774,263 @@ void UiLayer::draw(SceneRenderer& scene, const Camera& camera) {
     ImGui::End();
 }
 
+void UiLayer::drawProfilerPanel() {
+    if (!gpuProfiler) {
+        return;
+    }
+    const ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, 48.0f), ImGuiCond_FirstUseEver, ImVec2(0.5f, 0.0f));
+    ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (ImGui::Begin("GPU Profiler", nullptr, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_AlwaysAutoResize)) {
+        bool enabled = gpuProfiler->isEnabled();
+        if (ImGui::Checkbox("Enabled", &enabled)) {
+            gpuProfiler->setEnabled(enabled);
+        }
+        ImGui::SameLine();
+        ImGui::TextDisabled("avg of %d frames, %d dropped", GpuProfiler::kWindowFrames, gpuProfiler->droppedFrames());
+
+        const auto& zones = gpuProfiler->getResults();
+        // bars are relative to the whole frame, the first (root) zone
+        const float frameMs = zones.empty() ? 0.0f : zones.front().avgMs;
+        if (ImGui::BeginTable("gpu_zones", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("Zone");
+            ImGui::TableSetupColumn("Avg ms");
+            ImGui::TableSetupColumn("Max ms");
+            ImGui::TableSetupColumn("Share", ImGuiTableColumnFlags_WidthFixed, 120.0f);
+            ImGui::TableHeadersRow();
+            for (const GpuProfiler::ZoneStats& zone : zones) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                // Indent(0) would use the style default, so offset the cursor instead
+                ImGui::SetCursorPosX(ImGui::GetCursorPosX() + static_cast<float>(zone.depth) * 12.0f);
+                ImGui::TextUnformatted(zone.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", zone.avgMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", zone.maxMs);
+                ImGui::TableNextColumn();
+                ImGui::ProgressBar(frameMs > 0.0f ? zone.avgMs / frameMs : 0.0f, ImVec2(-1.0f, 0.0f), "");
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+void UiLayer::drawHierarchy(SceneRenderer& scene) {
+    scene.updateTransforms();
+    const auto& instances = scene.getInstances();
+    const auto& hierarchy = scene.getHierarchy();
+    int reparent = -1; // applied after the loop, the hierarchy is rebuilt by it
+    int newParent = -1;
+    if (ImGui::BeginListBox("##hierarchy", ImVec2(-FLT_MIN, 12.0f * ImGui::GetTextLineHeightWithSpacing()))) {
+        // the rows the current open states leave visible, a collapsed node skips its subtree; nodes start
+        // collapsed, so a big scene is one row per root and only the rows in view are submitted
+        ImGuiStorage* storage = ImGui::GetStateStorage();
+        hierarchyRows.clear();
+        for (size_t entry = 0; entry < hierarchy.size();) {
+            const HierarchyNode& node = hierarchy[entry];
+            hierarchyRows.push_back(static_cast<int>(entry));
+            const bool leaf = node.end == static_cast<int>(entry) + 1;
+            const ImGuiID id = ImGui::GetID(reinterpret_cast<void*>(static_cast<intptr_t>(node.instance)));
+            entry = !leaf && storage->GetInt(id, 0) != 0 ? entry + 1 : static_cast<size_t>(node.end);
+        }
+
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(hierarchyRows.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const int entry = hierarchyRows[static_cast<size_t>(row)];
+                const HierarchyNode& node = hierarchy[static_cast<size_t>(entry)];
+                // rows are drawn flat, so the depth is indented by hand instead of through TreePush
+                const float indent = static_cast<float>(node.depth) * ImGui::GetStyle().IndentSpacing;
+                if (indent > 0.0f) {
+                    ImGui::Indent(indent);
+                }
+                const bool leaf = node.end == entry + 1;
+                ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth |
+                    ImGuiTreeNodeFlags_NoTreePushOnOpen;
+                if (leaf) {
+                    flags |= ImGuiTreeNodeFlags_Leaf;
+                }
+                if (scene.isSelected(node.instance)) {
+                    flags |= ImGuiTreeNodeFlags_Selected;
+                }
+                const PrimitiveInstance& inst = instances[static_cast<size_t>(node.instance)];
+                ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<intptr_t>(node.instance)), flags, "%d: %s",
+                    node.instance, typeLabel(inst.type));
+                if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
+                    const ImGuiIO& io = ImGui::GetIO();
+                    scene.select(node.instance, io.KeyCtrl ? SelectMode::Toggle : io.KeyShift ? SelectMode::Add : SelectMode::Replace);
+                }
+                // drag one entry onto another to parent it there
+                if (ImGui::BeginDragDropSource()) {
+                    ImGui::SetDragDropPayload("INSTANCE", &node.instance, sizeof(int));
+                    ImGui::Text("%d: %s", node.instance, typeLabel(inst.type));
+                    ImGui::EndDragDropSource();
+                }
+                if (ImGui::BeginDragDropTarget()) {
+                    if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("INSTANCE")) {
+                        reparent = *static_cast<const int*>(payload->Data);
+                        newParent = node.instance;
+                    }
+                    ImGui::EndDragDropTarget();
+                }
+                if (indent > 0.0f) {
+                    ImGui::Unindent(indent);
+                }
+            }
+        }
+        ImGui::EndListBox();
+    }
+    ImGui::TextDisabled("(drop here to unparent)");
+    if (ImGui::BeginDragDropTarget()) {
+        if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("INSTANCE")) {
+            reparent = *static_cast<const int*>(payload->Data);
+            newParent = -1;
+        }
+        ImGui::EndDragDropTarget();
+    }
+    if (reparent >= 0) {
+        scene.setParent(reparent, newParent);
+    }
+}
+
+void UiLayer::drawScatterPanel(SceneRenderer& scene) {
+    const ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(ImVec2(12.0f, io.DisplaySize.y * 0.5f + 160.0f), ImGuiCond_FirstUseEver, ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (ImGui::Begin("Scatter", nullptr, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_AlwaysAutoResize)) {
+        ScatterSettings& settings = scatterSettings;
+        ImGui::InputInt("Count##scatter", &settings.count, 100, 1000);
+        settings.count = std::clamp(settings.count, 1, 100000);
+
+        int pattern = static_cast<int>(settings.pattern);
+        const char* patternItems[] = { "Jittered Grid", "Poisson Disk" };
+        if (ImGui::Combo("Pattern", &pattern, patternItems, IM_ARRAYSIZE(patternItems))) {
+            settings.pattern = static_cast<ScatterPattern>(pattern);
+        }
+        ImGui::BeginDisabled(settings.mixTypes);
+        int type = static_cast<int>(settings.type);
+        const char* typeItems[] = { "Cube", "Sphere", "Cylinder", "Plane" };
+        if (ImGui::Combo("Primitive##scatter", &type, typeItems, IM_ARRAYSIZE(typeItems))) {
+            settings.type = static_cast<PrimitiveType>(type);
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::Checkbox("Mix", &settings.mixTypes);
+
+        ImGui::DragFloatRange2("Scale", &settings.scaleMin, &settings.scaleMax, 0.01f, 0.05f, 10.0f, "%.2f");
+        ImGui::Checkbox("Uniform Scale", &settings.uniformScale);
+        ImGui::SliderFloat3("Max Rotation", reinterpret_cast<float*>(&settings.maxRotation), 0.0f, 180.0f, "%.0f");
+        ImGui::ColorEdit3("Base Color##scatter", reinterpret_cast<float*>(&settings.color));
+        ImGui::SliderFloat("Color Jitter", &settings.colorJitter, 0.0f, 1.0f, "%.2f");
+        ImGui::SliderInt("Variants", &settings.variants, 1, 32);
+        int seed = static_cast<int>(settings.seed);
+        if (ImGui::InputInt("Seed", &seed)) {
+            settings.seed = static_cast<uint32_t>(seed);
+        }
+
+        // a selected plane or cube is filled instead of the region
+        const PrimitiveInstance* selected = scene.getSelected();
+        const bool onSurface = selected && (selected->type == PrimitiveType::Plane || selected->type == PrimitiveType::Cube);
+        if (onSurface) {
+            ImGui::TextDisabled("Target: surface of the selected %s", typeLabel(selected->type));
+        }
+        else {
+            ImGui::InputFloat3("Region Min", reinterpret_cast<float*>(&settings.regionMin), "%.1f");
+            ImGui::InputFloat3("Region Max", reinterpret_cast<float*>(&settings.regionMax), "%.1f");
+        }
+
+        if (ImGui::Button("Scatter")) {
+            const auto start = std::chrono::steady_clock::now();
+            ScatterSurface surface;
+            if (onSurface) {
+                surface.type = selected->type;
+                surface.world = scene.getWorldMatrix(scene.getSelectedIndex());
+            }
+            ScatterResult result;
+            buildScatter(settings, onSurface ? &surface : nullptr, scene, scene.getWorkerPool(), result);
+            scene.addInstances(result.instances, result.palette);
+            lastScatterCount = static_cast<int>(result.instances.size());
+            lastScatterMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            // the next press gives a different layout
+            ++settings.seed;
+        }
+        if (lastScatterCount >= 0) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("placed %d in %.1f ms", lastScatterCount, lastScatterMs);
+        }
+    }
+    ImGui::End();
+}
+
+void UiLayer::drawHistoryPanel(SceneRenderer& scene) {
+    UndoHistory* history = scene.getHistory();
+    if (!history) {
+        return;
+    }
+    const ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(ImVec2(12.0f, io.DisplaySize.y * 0.5f), ImGuiCond_FirstUseEver, ImVec2(0.0f, 0.5f));
+    ImGui::SetNextWindowSize(ImVec2(260.0f, 300.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (ImGui::Begin("History", nullptr, ImGuiWindowFlags_NoSavedSettings)) {
+        ImGui::BeginDisabled(!history->canUndo());
+        if (ImGui::Button("Undo")) {
+            history->undo(scene);
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::BeginDisabled(!history->canRedo());
+        if (ImGui::Button("Redo")) {
+            history->redo(scene);
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (ImGui::Button("Clear##history")) {
+            history->clear();
+        }
+
+        int limitMb = static_cast<int>(history->getMemoryLimit() >> 20);
+        ImGui::SetNextItemWidth(100.0f);
+        if (ImGui::InputInt("Limit MB", &limitMb, 1, 8)) {
+            history->setMemoryLimit(static_cast<size_t>(std::clamp(limitMb, 1, 1024)) << 20);
+        }
+        ImGui::TextDisabled("%.2f MB used, %zu entries", static_cast<double>(history->getMemoryUsed()) / (1024.0 * 1024.0),
+            history->getEntries().size());
+
+        // row 0 is the state before every entry; clicking a row undoes or redoes up to it
+        const auto& entries = history->getEntries();
+        const size_t cursor = history->getCursor();
+        if (ImGui::BeginListBox("##historylist", ImVec2(-FLT_MIN, -FLT_MIN))) {
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(entries.size()) + 1);
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                    const size_t count = static_cast<size_t>(row);
+                    const char* label = row == 0 ? "(start)" : entries[count - 1].label.c_str();
+                    ImGui::PushID(row);
+                    if (count > cursor) {
+                        ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+                    }
+                    if (ImGui::Selectable(label, count == cursor)) {
+                        history->jumpTo(scene, count);
+                    }
+                    if (count > cursor) {
+                        ImGui::PopStyleColor();
+                    }
+                    ImGui::PopID();
+                }
+            }
+            ImGui::EndListBox();
+        }
+    }
+    ImGui::End();
+}
+
 void UiLayer::render() {
     if (!initialized) {
         return;
@@ -455,6 +1063,44 @@ bool UiLayer::WantCaptureKeyboard() const {
     return ImGui::GetIO().WantCaptureKeyboard;
 }
 
+void UiLayer::buildLightBenchmark(SceneRenderer& scene, int lightCount, int primitiveCount) {
+    // fixed seed so runs are comparable
+    std::mt19937 rng(1234u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // one snapshot afterwards instead of a journal record per primitive and light; the history starts over
+    SceneReplaceScope replace(scene);
+    scene.clear();
+    scene.clearPointLights();
+    scene.clearLightSelection();
+
+    const int side = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(primitiveCount)))));
+    const float spacing = 1.6f;
+    const float extent = static_cast<float>(side) * spacing * 0.5f;
+    const PrimitiveType types[] = { PrimitiveType::Cube, PrimitiveType::Sphere, PrimitiveType::Cylinder };
+    for (int i = 0; i < primitiveCount; ++i) {
+        const glm::vec3 pos(static_cast<float>(i % side) * spacing - extent, 0.5f, static_cast<float>(i / side) * spacing - extent);
+        scene.addPrimitive(types[i % 3], pos);
+    }
+    scene.addPrimitive(PrimitiveType::Plane, glm::vec3(0.0f));
+    scene.select(static_cast<int>(scene.instanceCount()) - 1);
+    scene.scaleSelected(glm::vec3(extent + 1.0f, 0.0f, extent + 1.0f));
+    scene.clearSelection();
+
+    for (int i = 0; i < lightCount; ++i) {
+        PointLight pointLight;
+        pointLight.position = glm::vec3((unit(rng) * 2.0f - 1.0f) * extent, 0.5f + unit(rng) * 2.5f, (unit(rng) * 2.0f - 1.0f) * extent);
+        pointLight.color = glm::vec3(0.3f) + 0.7f * glm::vec3(unit(rng), unit(rng), unit(rng));
+        pointLight.intensity = 1.0f;
+        pointLight.radius = 3.0f;
+        scene.addPointLight(pointLight);
+    }
+}
+
+bool UiLayer::isAnimating() const {
+    return std::fabs(inspectorTarget - inspectorProgress) > 0.005f;
+}
+
 void UiLayer::applyStyle() {
     ImGui::StyleColorsDark();
     ImGuiStyle& style = ImGui::GetStyle();
@@ -480,6 +1126,7 @@ const char* UiLayer::typeLabel(PrimitiveType type) const {
     case PrimitiveType::Sphere: return "Sphere";
     case PrimitiveType::Cylinder: return "Cylinder";
     case PrimitiveType::Plane: return "Plane";
+    case PrimitiveType::Mesh: return "Mesh";
     }
     return "Unknown";
 }
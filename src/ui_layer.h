@@ -4,6 +4,12 @@
 
 #include "scene.h"
 #include "camera.h"
+#include "scatter.h"
+
+class DynamicResolution;
+class FramePacer;
+class GpuProfiler;
+class RedrawScheduler;
 
 class UiLayer {
 public:
@@ -21,14 +27,47 @@ public:
 
     enum class TransformMode { Select, Translate, Rotate, Scale };
     TransformMode getMode() const { return mode; }
+    void setMode(TransformMode transformMode) { mode = transformMode; }
     void setCameraSpeed(float speed) { cameraSpeed = speed; }
+    void setRedrawScheduler(RedrawScheduler* scheduler) { redrawScheduler = scheduler; }
+    void setFramePacer(FramePacer* pacer) { framePacer = pacer; }
+    void setDynamicResolution(DynamicResolution* resolution) { dynamicResolution = resolution; }
+    void setGpuProfiler(GpuProfiler* profiler) { gpuProfiler = profiler; }
+    // rectangle being dragged out in the viewport, in window coordinates
+    void setMarquee(bool active, const glm::vec2& start, const glm::vec2& end) {
+        marqueeActive = active;
+        marqueeStart = start;
+        marqueeEnd = end;
+    }
+    // true while a panel transition is still moving
+    bool isAnimating() const;
 
 private:
     void applyStyle();
+    void drawProfilerPanel();
+    void drawHistoryPanel(SceneRenderer& scene);
+    void drawHierarchy(SceneRenderer& scene);
+    void drawScatterPanel(SceneRenderer& scene);
+    void buildLightBenchmark(SceneRenderer& scene, int lightCount, int primitiveCount);
     const char* typeLabel(PrimitiveType type) const;
 
     bool initialized = false;
     TransformMode mode = TransformMode::Select;
     float cameraSpeed = 0.0f;
     float inspectorProgress = 0.0f;
+    float inspectorTarget = 0.0f;
+    RedrawScheduler* redrawScheduler = nullptr;
+    FramePacer* framePacer = nullptr;
+    DynamicResolution* dynamicResolution = nullptr;
+    GpuProfiler* gpuProfiler = nullptr;
+    bool editSharedMaterial = true;
+    int benchLightCount = 256;
+    int benchPrimitiveCount = 400;
+    std::vector<int> hierarchyRows; // hierarchy entries drawHierarchy shows, rebuilt each frame
+    ScatterSettings scatterSettings;
+    int lastScatterCount = -1;
+    double lastScatterMs = 0.0;
+    bool marqueeActive = false;
+    glm::vec2 marqueeStart = glm::vec2(0.0f);
+    glm::vec2 marqueeEnd = glm::vec2(0.0f);
 };
@@ -0,0 +1,507 @@
+#include "undo_history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+    template <typename T>
+    std::vector<char> pack(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "undo states are stored as raw bytes");
+        std::vector<char> data(sizeof(T));
+        std::memcpy(data.data(), &value, sizeof(T));
+        return data;
+    }
+
+    template <typename T>
+    bool unpack(const std::vector<char>& data, T& value) {
+        if (data.size() != sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data.data(), sizeof(T));
+        return true;
+    }
+
+    bool sameVec3(const float a[3], const float b[3]) {
+        return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    }
+
+    // after undo/redo the instances whose fields changed are selected, so the edit can be seen
+    void selectEdited(SceneRenderer& scene, const UndoEntry& entry) {
+        std::vector<int> edited;
+        for (const UndoCommand& command : entry.commands) {
+            if (command.op == UndoOp::Fields) {
+                edited.push_back(command.index);
+            }
+        }
+        if (!edited.empty()) {
+            scene.select(edited, SelectMode::Replace);
+        }
+    }
+
+    // keeps the state from before the gesture and takes the latest after it; false when the entry
+    // has no command for the same state yet
+    bool mergeCommand(UndoEntry& open, UndoCommand& command, size_t& memoryUsed) {
+        for (UndoCommand& existing : open.commands) {
+            if (existing.op == command.op && existing.index == command.index) {
+                const size_t previous = existing.before.capacity() + existing.after.capacity();
+                existing.after = std::move(command.after);
+                const size_t current = existing.before.capacity() + existing.after.capacity();
+                open.bytes = open.bytes - previous + current;
+                memoryUsed = memoryUsed - previous + current;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+bool UndoHistory::undo(SceneRenderer& scene) {
+    if (!canUndo()) {
+        return false;
+    }
+    seal();
+    const UndoEntry& entry = entries[cursor - 1];
+    // the inverse edits go through the normal mutators (so the journal sees them) but are not recorded again
+    UndoHistory* attached = scene.getHistory();
+    scene.setHistory(nullptr);
+    for (auto it = entry.commands.rbegin(); it != entry.commands.rend(); ++it) {
+        apply(scene, *it, true);
+    }
+    selectEdited(scene, entry);
+    scene.setHistory(attached);
+    --cursor;
+    seal(); // later edits start a new entry instead of joining the one now on top
+    return true;
+}
+
+bool UndoHistory::redo(SceneRenderer& scene) {
+    if (!canRedo()) {
+        return false;
+    }
+    seal();
+    const UndoEntry& entry = entries[cursor];
+    UndoHistory* attached = scene.getHistory();
+    scene.setHistory(nullptr);
+    for (const UndoCommand& command : entry.commands) {
+        apply(scene, command, false);
+    }
+    selectEdited(scene, entry);
+    scene.setHistory(attached);
+    ++cursor;
+    seal();
+    return true;
+}
+
+void UndoHistory::jumpTo(SceneRenderer& scene, size_t count) {
+    count = std::min(count, entries.size());
+    while (cursor > count && undo(scene)) {
+    }
+    while (cursor < count && redo(scene)) {
+    }
+}
+
+void UndoHistory::clear() {
+    entries.clear();
+    cursor = 0;
+    memoryUsed = 0;
+}
+
+void UndoHistory::seal() {
+    if (cursor > 0) {
+        entries[cursor - 1].sealed = true;
+    }
+}
+
+void UndoHistory::beginGroup(const std::string& label, bool coalesce) {
+    if (groupDepth++ == 0) {
+        groupLabel = label;
+        groupStarted = false;
+        groupCoalesce = coalesce;
+    }
+}
+
+void UndoHistory::endGroup() {
+    if (groupDepth > 0 && --groupDepth == 0) {
+        groupStarted = false;
+        if (!groupCoalesce) {
+            seal();
+        }
+    }
+}
+
+void UndoHistory::setMemoryLimit(size_t bytes) {
+    memoryLimit = bytes;
+    evict();
+}
+
+size_t UndoHistory::commandBytes(const UndoCommand& command) {
+    return sizeof(UndoCommand) + command.before.capacity() + command.after.capacity();
+}
+
+void UndoHistory::push(UndoCommand command, int target, bool lightTarget, bool structural) {
+    // a new edit drops whatever could have been redone
+    while (entries.size() > cursor) {
+        memoryUsed -= entries.back().bytes;
+        entries.pop_back();
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (groupDepth > 0) {
+        if (!groupStarted && groupCoalesce && !entries.empty()) {
+            // the same multi-instance gesture as the open entry continues it
+            const UndoEntry& open = entries.back();
+            const double idle = std::chrono::duration<double>(now - open.touched).count();
+            groupStarted = !open.sealed && open.group && open.label == groupLabel && idle < kCoalesceSeconds;
+        }
+        if (groupStarted) {
+            if (entries.empty()) {
+                return; // the group outgrew the memory limit and was evicted already
+            }
+            UndoEntry& open = entries.back();
+            open.touched = now;
+            if (!groupCoalesce || !mergeCommand(open, command, memoryUsed)) {
+                const size_t bytes = commandBytes(command);
+                open.commands.push_back(std::move(command));
+                open.bytes += bytes;
+                memoryUsed += bytes;
+            }
+            evict();
+            return;
+        }
+        structural = !groupCoalesce;
+    }
+    if (!structural && groupDepth == 0 && !entries.empty()) {
+        UndoEntry& open = entries.back();
+        const double idle = std::chrono::duration<double>(now - open.touched).count();
+        if (!open.sealed && open.target == target && open.lightTarget == lightTarget && idle < kCoalesceSeconds) {
+            open.touched = now;
+            if (mergeCommand(open, command, memoryUsed)) {
+                evict();
+                return;
+            }
+            const size_t bytes = commandBytes(command);
+            open.commands.push_back(std::move(command));
+            open.bytes += bytes;
+            memoryUsed += bytes;
+            evict();
+            return;
+        }
+    }
+
+    UndoEntry entry;
+    entry.label = groupDepth > 0 && !groupLabel.empty() ? groupLabel : describe(command);
+    entry.group = groupDepth > 0;
+    entry.target = entry.group ? -1 : target; // single edits never join a group
+    entry.lightTarget = lightTarget;
+    entry.sealed = structural;
+    entry.touched = now;
+    entry.bytes = sizeof(UndoEntry) + entry.label.capacity() + commandBytes(command);
+    entry.commands.push_back(std::move(command));
+    memoryUsed += entry.bytes;
+    entries.push_back(std::move(entry));
+    cursor = entries.size();
+    groupStarted = groupDepth > 0;
+    evict();
+}
+
+void UndoHistory::evict() {
+    // what could be redone goes first, newest first; applied entries only from the oldest end
+    while (memoryUsed > memoryLimit && entries.size() > cursor) {
+        memoryUsed -= entries.back().bytes;
+        entries.pop_back();
+    }
+    while (memoryUsed > memoryLimit && cursor > 0) {
+        memoryUsed -= entries.front().bytes;
+        entries.pop_front();
+        --cursor;
+    }
+}
+
+std::string UndoHistory::describe(const UndoCommand& command) {
+    const std::string index = std::to_string(command.index);
+    switch (command.op) {
+    case UndoOp::Fields: {
+        SceneFileInstance before{};
+        SceneFileInstance after{};
+        if (unpack(command.before, before) && unpack(command.after, after)) {
+            if (before.parent != after.parent) return "Parent instance " + index;
+            if (!sameVec3(before.position, after.position)) return "Move instance " + index;
+            if (!sameVec3(before.rotation, after.rotation)) return "Rotate instance " + index;
+            if (!sameVec3(before.scale, after.scale)) return "Scale instance " + index;
+        }
+        return "Edit instance " + index;
+    }
+    case UndoOp::Material: return "Material of instance " + index;
+    case UndoOp::SharedMaterial: return "Shared material via instance " + index;
+    case UndoOp::Texture: return (command.after.empty() ? "Remove texture from instance " : "Texture on instance ") + index;
+    case UndoOp::Instance: return (command.before.empty() ? "Add instance " : "Delete instance ") + index;
+    case UndoOp::Instances: return "Clear primitives";
+    case UndoOp::InstanceRange: return "Add instances from " + index;
+    case UndoOp::Light: return "Edit main light";
+    case UndoOp::PointLight: return "Edit point light " + index;
+    case UndoOp::PointLightSlot: return (command.before.empty() ? "Add point light " : "Remove point light ") + index;
+    case UndoOp::PointLights: return "Clear point lights";
+    }
+    return "Edit";
+}
+
+void UndoHistory::apply(SceneRenderer& scene, const UndoCommand& command, bool undoing) {
+    const std::vector<char>& state = undoing ? command.before : command.after;
+    const int index = command.index;
+    const bool validInstance = index >= 0 && index < static_cast<int>(scene.instanceCount());
+    switch (command.op) {
+    case UndoOp::Fields: {
+        SceneFileInstance record{};
+        if (validInstance && unpack(state, record)) {
+            scene.setInstanceFields(index, record);
+        }
+        break;
+    }
+    case UndoOp::Material:
+    case UndoOp::SharedMaterial: {
+        SceneFileMaterial record{};
+        if (!validInstance || !unpack(state, record)) {
+            break;
+        }
+        if (command.op == UndoOp::Material) {
+            scene.setInstanceMaterial(index, fromSceneFileMaterial(record));
+        }
+        else {
+            scene.editMaterial(scene.getInstances()[static_cast<size_t>(index)].materialId, fromSceneFileMaterial(record));
+        }
+        break;
+    }
+    case UndoOp::Texture:
+        if (validInstance) {
+            scene.select(index);
+            if (state.empty()) {
+                scene.removeTextureFromSelected();
+            }
+            else {
+                scene.loadTextureForSelected(std::string(state.begin(), state.end()));
+            }
+        }
+        break;
+    case UndoOp::Instance:
+        if (state.empty()) {
+            scene.removeInstance(index);
+        }
+        else {
+            SceneFileInstanceState instance;
+            size_t offset = 0;
+            if (readInstanceState(state.data(), state.size(), offset, instance)) {
+                scene.select(scene.insertInstance(index, instance));
+            }
+        }
+        break;
+    case UndoOp::Instances: {
+        scene.clear();
+        SceneFileInstanceState instance;
+        size_t offset = 0;
+        while (offset < state.size() && readInstanceState(state.data(), state.size(), offset, instance)) {
+            scene.insertInstance(static_cast<int>(scene.instanceCount()), instance);
+        }
+        break;
+    }
+    case UndoOp::InstanceRange: {
+        if (state.empty()) {
+            scene.truncateInstances(index);
+            break;
+        }
+        // back through addInstances in one pass, each instance with its own palette entry
+        std::vector<PrimitiveInstance> batch;
+        std::vector<Material> palette;
+        SceneFileInstanceState instance;
+        size_t offset = 0;
+        while (offset < state.size() && readInstanceState(state.data(), state.size(), offset, instance)) {
+            PrimitiveInstance inst = fromSceneFileInstance(instance.record);
+            if (inst.type == PrimitiveType::Mesh) {
+                inst.meshId = scene.importMesh(instance.meshPath);
+                if (inst.meshId < 0) {
+                    inst.type = PrimitiveType::Cube; // keeps later indices lined up
+                }
+            }
+            inst.materialId = static_cast<int>(palette.size());
+            palette.push_back(fromSceneFileMaterial(instance.material));
+            batch.push_back(inst);
+        }
+        scene.addInstances(batch, palette);
+        break;
+    }
+    case UndoOp::Light: {
+        LightSettings light;
+        if (unpack(state, light)) {
+            const LightSettings previous = scene.getLightSettings();
+            scene.getLightSettings() = light;
+            scene.noteLightEdited(previous);
+        }
+        break;
+    }
+    case UndoOp::PointLight: {
+        PointLight pointLight;
+        auto& pointLights = scene.getPointLights();
+        if (index >= 0 && index < static_cast<int>(pointLights.size()) && unpack(state, pointLight)) {
+            const PointLight previous = pointLights[static_cast<size_t>(index)];
+            pointLights[static_cast<size_t>(index)] = pointLight;
+            scene.notePointLightEdited(index, previous);
+        }
+        break;
+    }
+    case UndoOp::PointLightSlot: {
+        PointLight pointLight;
+        if (state.empty()) {
+            scene.removePointLight(index);
+        }
+        else if (unpack(state, pointLight)) {
+            scene.insertPointLight(index, pointLight);
+        }
+        break;
+    }
+    case UndoOp::PointLights: {
+        scene.clearPointLights();
+        const size_t count = state.size() / sizeof(PointLight);
+        for (size_t i = 0; i < count; ++i) {
+            PointLight pointLight;
+            std::memcpy(&pointLight, state.data() + i * sizeof(PointLight), sizeof(PointLight));
+            scene.addPointLight(pointLight);
+        }
+        break;
+    }
+    }
+}
+
+void UndoHistory::recordFields(int index, const SceneFileInstance& before, const SceneFileInstance& after) {
+    if (std::memcmp(&before, &after, sizeof(before)) == 0) {
+        return;
+    }
+    UndoCommand command;
+    command.op = UndoOp::Fields;
+    command.index = index;
+    command.before = pack(before);
+    command.after = pack(after);
+    push(std::move(command), index, false, false);
+}
+
+void UndoHistory::recordMaterial(UndoOp op, int index, const Material& before, const Material& after) {
+    UndoCommand command;
+    command.op = op;
+    command.index = index;
+    command.before = pack(toSceneFileMaterial(before));
+    command.after = pack(toSceneFileMaterial(after));
+    if (command.before == command.after) {
+        return;
+    }
+    push(std::move(command), index, false, false);
+}
+
+void UndoHistory::recordTexture(int index, const std::string& before, const std::string& after) {
+    UndoCommand command;
+    command.op = UndoOp::Texture;
+    command.index = index;
+    command.before.assign(before.begin(), before.end());
+    command.after.assign(after.begin(), after.end());
+    push(std::move(command), index, false, true);
+}
+
+void UndoHistory::recordAdd(const SceneRenderer& scene, int index) {
+    UndoCommand command;
+    command.op = UndoOp::Instance;
+    command.index = index;
+    appendInstanceState(command.after, scene.captureInstance(index));
+    push(std::move(command), index, false, true);
+}
+
+void UndoHistory::recordRemove(const SceneRenderer& scene, int index) {
+    recordRemove(index, scene.captureInstance(index));
+}
+
+void UndoHistory::recordRemove(int index, const SceneFileInstanceState& state) {
+    UndoCommand command;
+    command.op = UndoOp::Instance;
+    command.index = index;
+    appendInstanceState(command.before, state);
+    push(std::move(command), index, false, true);
+}
+
+void UndoHistory::recordAddRange(const SceneRenderer& scene, int first) {
+    const size_t count = scene.instanceCount() - static_cast<size_t>(first);
+    const size_t estimate = count * (sizeof(SceneFileInstance) + sizeof(SceneFileMaterial) + 8);
+    if (estimate > memoryLimit) {
+        clear(); // as with recordClear, it could never be kept
+        return;
+    }
+    UndoCommand command;
+    command.op = UndoOp::InstanceRange;
+    command.index = first;
+    command.after.reserve(estimate);
+    for (size_t i = static_cast<size_t>(first); i < scene.instanceCount(); ++i) {
+        appendInstanceState(command.after, scene.captureInstance(static_cast<int>(i)));
+    }
+    push(std::move(command), -1, false, true);
+}
+
+void UndoHistory::recordClear(const SceneRenderer& scene) {
+    // a clear bigger than the whole budget could never be kept, so don't encode it at all
+    const size_t estimate = scene.instanceCount() * (sizeof(SceneFileInstance) + sizeof(SceneFileMaterial) + 8);
+    if (estimate > memoryLimit) {
+        clear();
+        return;
+    }
+    UndoCommand command;
+    command.op = UndoOp::Instances;
+    command.before.reserve(estimate);
+    for (size_t i = 0; i < scene.instanceCount(); ++i) {
+        appendInstanceState(command.before, scene.captureInstance(static_cast<int>(i)));
+    }
+    push(std::move(command), -1, false, true);
+}
+
+void UndoHistory::recordLight(const LightSettings& before, const LightSettings& after) {
+    UndoCommand command;
+    command.op = UndoOp::Light;
+    command.before = pack(before);
+    command.after = pack(after);
+    if (command.before == command.after) {
+        return;
+    }
+    push(std::move(command), -1, true, false);
+}
+
+void UndoHistory::recordPointLight(int index, const PointLight& before, const PointLight& after) {
+    UndoCommand command;
+    command.op = UndoOp::PointLight;
+    command.index = index;
+    command.before = pack(before);
+    command.after = pack(after);
+    if (command.before == command.after) {
+        return;
+    }
+    push(std::move(command), index, true, false);
+}
+
+void UndoHistory::recordAddPointLight(int index, const PointLight& pointLight) {
+    UndoCommand command;
+    command.op = UndoOp::PointLightSlot;
+    command.index = index;
+    command.after = pack(pointLight);
+    push(std::move(command), index, true, true);
+}
+
+void UndoHistory::recordRemovePointLight(int index, const PointLight& pointLight) {
+    UndoCommand command;
+    command.op = UndoOp::PointLightSlot;
+    command.index = index;
+    command.before = pack(pointLight);
+    push(std::move(command), index, true, true);
+}
+
+void UndoHistory::recordClearPointLights(const std::vector<PointLight>& pointLights) {
+    UndoCommand command;
+    command.op = UndoOp::PointLights;
+    command.before.resize(pointLights.size() * sizeof(PointLight));
+    if (!pointLights.empty()) {
+        std::memcpy(command.before.data(), pointLights.data(), command.before.size());
+    }
+    push(std::move(command), -1, true, true);
+}
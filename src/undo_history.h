@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+#include "scene_file.h"
+
+// What a command's before/after states describe. Within one entry every command touches different
+// state, so undoing them in reverse and redoing them in order never overlaps.
+enum class UndoOp : uint8_t {
+    Fields,         // SceneFileInstance: transform, colour, texture mapping and flags of one instance
+    Material,       // SceneFileMaterial the instance points at
+    SharedMaterial, // SceneFileMaterial of a shared entry, addressed through an instance using it
+    Texture,        // texture path, empty = untextured
+    Instance,       // SceneFileInstanceState at index, empty = absent (add / remove)
+    Instances,      // every instance (clear)
+    InstanceRange,  // SceneFileInstanceStates from index to the end, back to back, empty = absent (bulk add)
+    Light,          // LightSettings
+    PointLight,     // PointLight at index
+    PointLightSlot, // PointLight at index, empty = absent (add / remove)
+    PointLights     // every point light (clear)
+};
+
+struct UndoCommand {
+    UndoOp op = UndoOp::Fields;
+    int index = -1;
+    std::vector<char> before; // encoded state, see UndoOp
+    std::vector<char> after;
+};
+
+struct UndoEntry {
+    std::string label;
+    std::vector<UndoCommand> commands;
+    int target = -1;     // instance or light index continuous edits coalesce on
+    bool lightTarget = false;
+    bool sealed = false; // structural changes never absorb later commands
+    bool group = false;  // recorded between beginGroup() and endGroup()
+    std::chrono::steady_clock::time_point touched;
+    size_t bytes = 0;
+};
+
+// Command-based undo/redo. SceneRenderer reports each mutation with compact before/after states;
+// continuous manipulation of one object (held keys, drags, slider edits) coalesces into the open
+// entry until it is sealed or left alone for kCoalesceSeconds. Once the history outgrows its memory
+// limit, redo entries are dropped first, then the oldest applied ones.
+class UndoHistory {
+public:
+    bool undo(SceneRenderer& scene);
+    bool redo(SceneRenderer& scene);
+    // undoes or redoes until `count` entries are applied, for the history panel
+    void jumpTo(SceneRenderer& scene, size_t count);
+    bool canUndo() const { return cursor > 0; }
+    bool canRedo() const { return cursor < entries.size(); }
+    void clear();
+    // ends coalescing, e.g. when the mouse button that drove a drag is released
+    void seal();
+    // commands recorded until endGroup() form one entry, e.g. deleting an instance with its children.
+    // A coalescing group (moving several selected instances) continues an open entry with the same
+    // label, like continuous edits of a single instance do
+    void beginGroup(const std::string& label, bool coalesce = false);
+    void endGroup();
+
+    const std::deque<UndoEntry>& getEntries() const { return entries; }
+    // entries [0, cursor) are applied, the rest can be redone
+    size_t getCursor() const { return cursor; }
+    void setMemoryLimit(size_t bytes);
+    size_t getMemoryLimit() const { return memoryLimit; }
+    size_t getMemoryUsed() const { return memoryUsed; }
+
+    // called by SceneRenderer's mutators
+    void recordFields(int index, const SceneFileInstance& before, const SceneFileInstance& after);
+    void recordMaterial(UndoOp op, int index, const Material& before, const Material& after);
+    void recordTexture(int index, const std::string& before, const std::string& after);
+    void recordAdd(const SceneRenderer& scene, int index);
+    void recordRemove(const SceneRenderer& scene, int index);
+    // a removal whose state was captured up front, see SceneRenderer::removeSelected
+    void recordRemove(int index, const SceneFileInstanceState& state);
+    // instances [first, end) appended by SceneRenderer::addInstances
+    void recordAddRange(const SceneRenderer& scene, int first);
+    void recordClear(const SceneRenderer& scene);
+    void recordLight(const LightSettings& before, const LightSettings& after);
+    void recordPointLight(int index, const PointLight& before, const PointLight& after);
+    void recordAddPointLight(int index, const PointLight& pointLight);
+    void recordRemovePointLight(int index, const PointLight& pointLight);
+    void recordClearPointLights(const std::vector<PointLight>& pointLights);
+
+private:
+    static constexpr double kCoalesceSeconds = 0.5;
+    static constexpr size_t kDefaultMemoryLimit = 32u << 20;
+
+    void push(UndoCommand command, int target, bool lightTarget, bool structural);
+    void evict();
+    void apply(SceneRenderer& scene, const UndoCommand& command, bool undoing);
+    static size_t commandBytes(const UndoCommand& command);
+    static std::string describe(const UndoCommand& command);
+
+    std::deque<UndoEntry> entries;
+    size_t cursor = 0;
+    size_t memoryLimit = kDefaultMemoryLimit;
+    size_t memoryUsed = 0;
+    int groupDepth = 0;
+    std::string groupLabel;
+    bool groupStarted = false; // the group's entry was created and is entries.back()
+    bool groupCoalesce = false;
+};
@@ -0,0 +1,96 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "trace.h"
+
+WorkerPool::WorkerPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        const unsigned hw = std::thread::hardware_concurrency();
+        threadCount = hw > 1 ? std::min(hw - 1, 7u) : 0;
+    }
+    for (unsigned i = 0; i <= threadCount; ++i) {
+        arenas.push_back(std::make_unique<FrameArena>());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&WorkerPool::workerLoop, this, i + 1);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, size_t minChunk, const RangeFn& fn) {
+    if (count == 0) {
+        return;
+    }
+    const size_t chunk = std::max(minChunk, (count + size() - 1) / size());
+    if (workers.empty() || chunk >= count) {
+        fn(0, count, 0);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job = &fn;
+    jobCount = count;
+    chunkSize = chunk;
+    nextChunk = 0;
+    chunkTotal = (count + chunk - 1) / chunk;
+    chunksDone = 0;
+    ++generation;
+    wake.notify_all();
+
+    // the caller works through chunks as well instead of idling
+    while (nextChunk < chunkTotal) {
+        const size_t c = nextChunk++;
+        lock.unlock();
+        fn(c * chunk, std::min(count, (c + 1) * chunk), 0);
+        lock.lock();
+        ++chunksDone;
+    }
+    done.wait(lock, [this] { return chunksDone == chunkTotal; });
+    job = nullptr;
+}
+
+void WorkerPool::resetArenas() {
+    for (auto& workerArena : arenas) {
+        workerArena->reset();
+    }
+}
+
+void WorkerPool::workerLoop(unsigned worker) {
+    trace::setThreadName(("Worker " + std::to_string(worker)).c_str());
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || (generation != seen && job && nextChunk < chunkTotal); });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        while (job && nextChunk < chunkTotal) {
+            const size_t c = nextChunk++;
+            const RangeFn* fn = job;
+            const size_t begin = c * chunkSize;
+            const size_t end = std::min(jobCount, (c + 1) * chunkSize);
+            lock.unlock();
+            {
+                TRACE_ZONE("Worker chunk");
+                (*fn)(begin, end, worker);
+            }
+            lock.lock();
+            if (++chunksDone == chunkTotal) {
+                done.notify_one();
+            }
+        }
+    }
+}
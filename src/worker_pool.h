@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_arena.h"
+
+// Persistent worker threads for splitting per-frame CPU work; the calling thread takes part too.
+class WorkerPool {
+public:
+    // begin/end range of the split, plus the index of the thread running it (0 = caller). A non-owning
+    // view of the callable, so handing over a lambda never allocates the way std::function can
+    class RangeFn {
+    public:
+        template <class Fn>
+        RangeFn(const Fn& fn)
+            : object(&fn), call([](const void* target, size_t begin, size_t end, unsigned worker) {
+                (*static_cast<const Fn*>(target))(begin, end, worker);
+            }) {}
+        void operator()(size_t begin, size_t end, unsigned worker) const { call(object, begin, end, worker); }
+
+    private:
+        const void* object;
+        void (*call)(const void*, size_t, size_t, unsigned);
+    };
+
+    explicit WorkerPool(unsigned threadCount = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // total participants including the caller
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // splits [0, count) into contiguous chunks of at least minChunk and blocks until all are done
+    void parallelFor(size_t count, size_t minChunk, const RangeFn& fn);
+
+    // scratch memory for jobs, one arena per participant (indexed like the worker argument) so no two
+    // threads share one; the owner resets them between frames, while no job is running
+    FrameArena& arena(unsigned worker) { return *arenas[worker]; }
+    void resetArenas();
+
+private:
+    void workerLoop(unsigned worker);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const RangeFn* job = nullptr;
+    size_t jobCount = 0;
+    size_t chunkSize = 0;
+    size_t nextChunk = 0;
+    size_t chunkTotal = 0;
+    size_t chunksDone = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+};